@@ -7,57 +7,66 @@
 #include <ctype.h>
 #include <phidget22.h>
 #include "PhidgetHelperFunctions.h"
+#include "../gps_log.h"
+#include "../geodesy.h"
+#include "../mission.h" //Waypoint
+#include "../fmt.h"
 
 #define SERIAL_NO 131244 //GPS Device Serial Number (stores code 1984)
-#define PI 3.1459f 
 
 volatile int stop = 0;
 
-//GPS waypoint typedef
-typedef struct waypoints {
-	double lat;
-	double lon;
-	//double ms;
-} Waypoint;
 
 /*################# Function Prototypes #################*/
 //Function to Calculate the desired heading to a specified destination waypoint
 double findDestBearing(Waypoint current, Waypoint destination) {
-	//All values must be converted to radians for use with math library trig functions
-	double dLong = abs(destination.lon - current.lon);	
-	double X = cos(destination.lat) * sin(dLong);
-	double Y = (cos(current.lat) * sin(destination.lat)) - (sin(current.lat) * cos(destination.lat) * cos(dLong));
-	double bearing = atan2(X, Y) * 180.0f/PI;
-	return bearing+180.0f;
+	//Great-circle initial bearing, 0 to 360 clockwise from north
+	return Geo_Bearing(current.lat, current.lon, destination.lat, destination.lon);
 }
 /*-------------------------------------------------------*/
 double getBearingError(double heading, double bearing) { 
 	//double heading = 0.0f;
 	//PhidgetGPS_getHeading(ch, &heading);	
-	double error = bearing - heading;
+	double error = fmod(bearing - heading + 360.0, 360.0); //0 to 360, clockwise
 	return error;
 }
 /*-------------------------------------------------------*/
-void createLogFile(FILE *logfile, char filename[]) {
-	filename = strcat(filename, ".csv"); //Attach csv extension to filename variable
-	logfile = fopen(filename, "w"); //Create logfile with filename specified
-	if (!logfile) {
-		printf("fopen failed! -- No logging...");
+int createLogFile(char filename[]) {
+	char path[256];
+	snprintf(path, sizeof(path), "%s.csv", filename); //Attach csv extension to filename
+	if (Log_Open(path, "lat, long\n") != 0) { //Create logfile with filename specified and column headings
+		printf("Log_Open failed! -- No logging...");
+		return -1;
 	}
-	fprintf(logfile, "lat, long\n"); //Print column headings
+	return 0;
 }
 /*-------------------------------------------------------*/
-void printLogFile(FILE *logfile, Waypoint current) {
-	fprintf(logfile, "%9.7f,%9.7f\n", current.lat, current.lon);
+void printLogFile(Waypoint current, double heading, uint32_t timeMs, int fixState) {
+	LogRecord rec = {current.lat, current.lon, heading, timeMs, fixState};
+	Log_Write(&rec); //Queued for the logger's writer thread, never blocks
 }
 /*-------------------------------------------------------*/
-void closeLogFile(FILE *logfile) {
-	//fflush(logfile);
-	if(!logfile) {
-		printf("Error! -- Cannot Close logfile!");
-	} else {
-		fclose(logfile);
-	}
+void printStatus(int sec, Waypoint current, double bearing, double heading, double error) {
+	char out[4 * FMT_DOUBLE_MAX + FMT_INT_MAX + 128];
+	char *e = Fmt_Str(out, "t=");
+	e = Fmt_Int(e, sec);
+	e = Fmt_Str(e, " -- Lat.:");
+	e = Fmt_Double(e, current.lat, 9, 5);
+	e = Fmt_Str(e, "N -- Lon.:");
+	e = Fmt_Double(e, current.lon, 9, 5);
+	e = Fmt_Str(e, "W\n Heading to Destination = ");
+	e = Fmt_Double(e, bearing, 5, 2);
+	e = Fmt_Str(e, " Degrees\nActual Heading = ");
+	e = Fmt_Double(e, heading, 5, 2);
+	e = Fmt_Str(e, " Degrees -- Error = ");
+	e = Fmt_Double(e, error, 5, 2);
+	e = Fmt_Str(e, " Degrees\n");
+	fwrite(out, 1, (size_t)(e - out), stdout);
+}
+/*-------------------------------------------------------*/
+void closeLogFile(void) {
+	Log_Close();
+	Log_PrintStats();
 }
 /*-------------------------------------------------------*/
 void signal_callback_handler(int signum) {
@@ -75,7 +84,6 @@ int main(int argc, char *argv[]) {
 	PhidgetGPSHandle ch;
 	PhidgetGPS_create(&ch);
 
-	FILE *GPSLog; //File for logging position data
 	//Initialise variables
 	int fixState = 0;
 	double heading = 0.0f;
@@ -83,7 +91,7 @@ int main(int argc, char *argv[]) {
 	double error = 0.0f;
 
 	char logname[] = "log1";
-	createLogFile(GPSLog, logname);
+	createLogFile(logname);
 
 	//Specify Serial No.
 	Phidget_setDeviceSerialNumber((PhidgetHandle)ch, SERIAL_NO);
@@ -125,21 +133,16 @@ int main(int argc, char *argv[]) {
 			printf("NO GPS FIX!\n");
 		}
 		//Print Data to Logfile
-		//printLogFile(GPSLog, wp0);
-		fprintf(GPSLog, "%9.7f,%9.7f\n", wp0.lat, wp0.lon);
-		//fprintf(GPSLog, "%9.7f,%9.7f\n", wp0.lat, wp0.lon);
-
-		//Print GPS position to Terminal
-		printf("t=%d -- Lat.:%9.5fN -- Lon.:%9.5fW\n", logtime.tm_sec, wp0.lat, wp0.lon);
-		//Print Heading and Error information to Terminal
-		printf(" Heading to Destination = %5.2f Degrees\n", bearing);
-		printf("Actual Heading = %5.2f Degrees -- Error = %5.2f Degrees\n", heading, error);
+		printLogFile(wp0, heading, (((logtime.tm_hour * 60 + logtime.tm_min) * 60 + logtime.tm_sec) * 1000 + logtime.tm_ms), fixState);
+
+		//Print GPS position, heading and error information to Terminal
+		printStatus(logtime.tm_sec, wp0, bearing, heading, error);
 		//fclose(GPSLog);
 		sleep(1); //Polling Delay 1s
 		
 	}
 
-	closeLogFile(GPSLog); //runs Fclose
+	closeLogFile(); //Flushes and syncs the logger
 	printf("Cleaning up...\n");
 	Phidget_close((PhidgetHandle)ch);
 	PhidgetGPS_delete(&ch);
@@ -7,11 +7,12 @@
 
 #include <phidget22.h>
 #include "PhidgetHelperFunctions.h"
+#include "../gps_log.h"
+#include "../geodesy.h"
+#include "status_panel.h"
 
 #define SERIAL_NO 131244 //Phidget Serial. No
 
-#define PI 3.1459f
-
 volatile int stop = 0; //Flag to exit infinite loop
 
 
@@ -24,15 +25,12 @@ void sig_handler(int signum) {
 
 /*-------------------------------------------------------*/
 double getTargetBearing(double lat, double lon, double tLat, double tLon) {
-	double dLon = abs(tLon - lon);
-	double X = cos(tLat) * sin(dLon);
-	double Y = (cos(lat) * sin(tLat)) - (sin(lat) * cos(tLat) * cos(dLon));
-	return (atan2(X, Y) * (180.0f/PI)) + 180.0f;
+	return Geo_Bearing(lat, lon, tLat, tLon);
 }
 
 /*-------------------------------------------------------*/
 double getBearingError(double head, double bearing) {
-	return bearing - head;
+	return fmod(bearing - head + 360.0, 360.0); //0 to 360, clockwise
 }
 /*-------------------------------------------------------*/
 
@@ -40,7 +38,7 @@ int main() {
 
 	signal(SIGINT, sig_handler);	
 
-	FILE *fp =  fopen("myGPS_data.csv", "w");
+	Log_Open("myGPS_data.csv", "lat,lon\n");
 	
 	//Create Variables for position data
 	double lat = 0.0f;
@@ -60,7 +58,6 @@ int main() {
 	Phidget_openWaitForAttachment((PhidgetHandle)myGPS, 5000); //Open channel and wait up to 5s
 	//Enter file header info
 	//fprintf(fp,"myGPS_data.csv\n");
-	fprintf(fp, "lat,lon\n");
 	//printf("#########################\nLocation:\033[s\n#########################\nHeading:\nBearing:\nError:\n#########################\033[u");
 	while(!stop) {
 		//Get Positional Data
@@ -69,13 +66,15 @@ int main() {
 		//Get Heading Data
 		PhidgetGPS_getHeading(myGPS, &head);
 		bearingToTarget = getTargetBearing(lat, lon, tLat, tLon);
-		error = bearingToTarget - head;
+		error = getBearingError(head, bearingToTarget);
 		//Printout Positional Data
-		fprintf(fp,"%9.7f,%9.7f\n", lat, lon);
-		printf("--------------------------------------\nLocation: %9.7f N %9.7f W\n--------------------------------------\nHeading: %5.2f \nTarget Bearing: %5.2f \nError:%5.2f\033[5A", lat, lon, head, bearingToTarget, error);
+		LogRecord rec = {lat, lon, head, 0, 0};
+		Log_Write(&rec);
+		printStatus(lat, lon, head, bearingToTarget, error);
 		sleep(1);
 	}
-	fclose(fp);
+	Log_Close();
+	Log_PrintStats();
 	return 0;
 	
 }
@@ -0,0 +1,27 @@
+#ifndef STATUS_PANEL_h_
+#define STATUS_PANEL_h_
+
+#include <stdio.h>
+#include "../fmt.h"
+
+  /* Console status panel shared by GPS_logger and GPS_navigator1: position, heading, target bearing and error,
+    then the cursor is moved back up so the next call redraws the panel in place.
+   */
+
+static inline void printStatus(double lat, double lon, double head, double bearing, double error) {
+	char out[5 * FMT_DOUBLE_MAX + 128];
+	char *e = Fmt_Str(out, "--------------------------------------\nLocation: ");
+	e = Fmt_Double(e, lat, 9, 7);
+	e = Fmt_Str(e, " N ");
+	e = Fmt_Double(e, lon, 9, 7);
+	e = Fmt_Str(e, " W\n--------------------------------------\nHeading: ");
+	e = Fmt_Double(e, head, 5, 2);
+	e = Fmt_Str(e, " \nTarget Bearing: ");
+	e = Fmt_Double(e, bearing, 5, 2);
+	e = Fmt_Str(e, " \nError:");
+	e = Fmt_Double(e, error, 5, 2);
+	e = Fmt_Str(e, "\033[5A");
+	fwrite(out, 1, (size_t)(e - out), stdout);
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: checkpoint.c
+Source Description: Double-buffered, checksummed mission checkpoint in a memory-mapped file, written every tick
+                    and synced from its own thread
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "checkpoint.h"
+#include "crc32.h"
+
+#define CKPT_FILE_SIZE (2 * CKPT_SLOT_SIZE)
+
+_Static_assert(sizeof(CkptRecord) <= CKPT_SLOT_SIZE, "CkptRecord must fit in a slot");
+
+static pthread_t syncThread;
+static atomic_int syncRunning;
+static void *syncMap;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: recordCrc
+Function Description: CRC-32 of a record up to its crc field
+Input Parameters: r - record
+Output Parameters: CRC
+/---------------------------------------------------------------------------------------------------------*/
+static uint32_t recordCrc(const CkptRecord *r) {
+	return Crc32(0, r, offsetof(CkptRecord, crc));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: slotValid
+Function Description: Whether a slot holds an intact record of this layout
+Input Parameters: r - slot contents
+Output Parameters: 1 if intact
+/---------------------------------------------------------------------------------------------------------*/
+static int slotValid(const CkptRecord *r) {
+	return r->magic == CKPT_MAGIC && r->version == CKPT_VERSION && r->crc == recordCrc(r);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: syncLoop
+Function Description: The sync thread. Flushes the mapping to the card every CKPT_SYNC_MS, off the control thread
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *syncLoop(void *arg) {
+	struct timespec period = {CKPT_SYNC_MS / 1000, (CKPT_SYNC_MS % 1000) * 1000000L};
+	while (atomic_load(&syncRunning)) {
+		nanosleep(&period, NULL);
+		msync(syncMap, CKPT_FILE_SIZE, MS_SYNC);
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Ckpt_Open
+Function Description: Opens or creates the checkpoint file, maps both slots and picks the newest intact record.
+                      The next save goes to the other slot, so the record just read stays on disk until a newer
+                      one is complete
+Input Parameters: c - checkpoint, path - file, last - newest intact record out
+Output Parameters: 1 if a record was found, 0 if not, -1 if the file can't be opened or mapped
+/---------------------------------------------------------------------------------------------------------*/
+int Ckpt_Open(Checkpoint *c, const char *path, CkptRecord *last) {
+	memset(c, 0, sizeof(*c));
+	c->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (c->fd < 0)
+		return -1;
+	if (ftruncate(c->fd, CKPT_FILE_SIZE) != 0) {
+		close(c->fd);
+		return -1;
+	}
+	void *map = mmap(NULL, CKPT_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+	if (map == MAP_FAILED) {
+		close(c->fd);
+		return -1;
+	}
+	c->map = map;
+
+	const CkptRecord *a = (const CkptRecord *)c->map;
+	const CkptRecord *b = (const CkptRecord *)(c->map + CKPT_SLOT_SIZE);
+	const CkptRecord *best = NULL;
+	if (slotValid(a))
+		best = a;
+	if (slotValid(b) && (!best || b->seq > best->seq))
+		best = b;
+	if (best) {
+		*last = *best;
+		c->seq = best->seq;
+	}
+
+	syncMap = c->map;
+	atomic_store(&syncRunning, 1);
+	if (pthread_create(&syncThread, NULL, syncLoop, NULL) != 0)
+		atomic_store(&syncRunning, 0);
+	return best ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Ckpt_Save
+Function Description: Completes the record and copies it into the slot the previous save did not use. The slot is
+                      chosen by sequence number, so it alternates
+Input Parameters: c - checkpoint, rec - record, header fields are filled in
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Ckpt_Save(Checkpoint *c, CkptRecord *rec) {
+	struct timespec ts;
+	if (!c->map)
+		return;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	rec->magic = CKPT_MAGIC;
+	rec->version = CKPT_VERSION;
+	rec->seq = ++c->seq;
+	rec->wallNs = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	rec->pad = 0;
+	rec->crc = recordCrc(rec);
+	memcpy(c->map + (rec->seq & 1) * CKPT_SLOT_SIZE, rec, sizeof(*rec));
+	c->saves++;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Ckpt_Usable
+Function Description: Checks a record belongs to the route and is recent. A small negative age is accepted, since
+                      the clock of a Pi without a battery-backed RTC can be stepped back. One beyond
+                      CKPT_MAX_SKEW_S means the clock was reset, so the record's real age is unknown and it is
+                      treated as stale
+Input Parameters: rec - record, routeId - Ckpt_RouteId of the loaded route, ageMs - age out
+Output Parameters: 1 if the rover can resume from it
+/---------------------------------------------------------------------------------------------------------*/
+int Ckpt_Usable(const CkptRecord *rec, uint32_t routeId, int64_t *ageMs) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	*ageMs = ((int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec - rec->wallNs) / 1000000;
+	return rec->routeId == routeId && *ageMs < CKPT_MAX_AGE_S * 1000LL && *ageMs > -CKPT_MAX_SKEW_S * 1000LL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Ckpt_RouteId
+Function Description: Identifies a route so a checkpoint is never applied to a different one
+Input Parameters: wps - waypoint array, len - its size in bytes
+Output Parameters: CRC-32 of the waypoints
+/---------------------------------------------------------------------------------------------------------*/
+uint32_t Ckpt_RouteId(const void *wps, size_t len) {
+	return Crc32(0, wps, len);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Ckpt_Close
+Function Description: Stops the sync thread, then syncs and unmaps the file
+Input Parameters: c - checkpoint
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Ckpt_Close(Checkpoint *c) {
+	if (!c->map)
+		return;
+	if (atomic_exchange(&syncRunning, 0))
+		pthread_join(syncThread, NULL);
+	msync(c->map, CKPT_FILE_SIZE, MS_SYNC);
+	munmap(c->map, CKPT_FILE_SIZE);
+	close(c->fd);
+	c->map = NULL;
+}
@@ -0,0 +1,78 @@
+#ifndef CHECKPOINT_h_
+#define CHECKPOINT_h_
+
+#include <stdint.h>
+#include <stddef.h>
+
+  /* Crash-safe mission checkpoint. The file holds two slots, each on its own page, and the control thread writes
+    the whole record into the older slot every tick through a shared mapping: a memcpy and a CRC, no syscall. The
+    record carries a sequence number and a CRC-32, so a write torn by a crash leaves the other slot as the newest
+    intact record. A process crash loses nothing, since the pages live in the page cache. A sync thread msyncs
+    the mapping every CKPT_SYNC_MS, which bounds what a power loss can take.
+
+    On start-up Ckpt_Open returns the newest intact record. The rover resumes from it if it was written for the
+    same route less than CKPT_MAX_AGE_S ago, or less than CKPT_MAX_SKEW_S in the future: it restores the mission
+    progress, re-applies the saved wheel commands, and steers on the saved pose (dead-reckoned by the estimator
+    with -e) for up to CKPT_TRUST_MS while the GPS attaches and gets a fix.
+   */
+
+#define CKPT_DEFAULT_PATH "rover.ckpt"
+#define CKPT_MAGIC        0x54504b43u  //"CKPT"
+#define CKPT_VERSION      1
+#define CKPT_SLOT_SIZE    4096         //One page per slot
+#define CKPT_SYNC_MS      500          //Longest a saved record can sit unsynced
+#define CKPT_MAX_AGE_S    300          //Older checkpoints are ignored
+#define CKPT_MAX_SKEW_S   60           //Checkpoints dated further in the future than this are ignored
+#define CKPT_TRUST_MS     3000         //Longest the rover drives on the saved pose without a fix
+
+//Everything needed to pick up where the rover stopped
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t seq;            //Higher is newer
+	int64_t wallNs;          //CLOCK_REALTIME when saved, monotonic time does not survive a reboot
+	uint32_t routeId;        //Ckpt_RouteId of the mission
+	uint32_t leg;            //Target waypoint
+	uint32_t count;          //Route length
+	int32_t status;          //MissionStatus
+	uint64_t arrivals;
+	double fixLat, fixLon;   //Last good fix
+	double fixHead, fixSpeed;
+	uint32_t fixTimeMs;
+	int32_t fixState;
+	double lat, lon;         //Pose steered on
+	double head;             //Heading estimate (degrees)
+	double speed;            //km/h
+	double posSd;            //Position standard deviation (m)
+	double dutyL, dutyR;     //Commanded wheel duties
+	double appliedL, appliedR;  //Duties the ramps had reached
+	uint32_t crc;            //CRC-32 of everything above
+	uint32_t pad;
+} CkptRecord;
+
+//Checkpoint file
+typedef struct {
+	uint8_t *map;
+	int fd;
+	uint64_t seq;            //Sequence of the last record written
+	unsigned long saves;
+} Checkpoint;
+
+//Maps the file, creating it if needed. Returns 1 and fills in last if it holds an intact record, 0 if not,
+//-1 if the file could not be mapped. Starts the sync thread
+int Ckpt_Open(Checkpoint *c, const char *path, CkptRecord *last);
+
+//Writes a record into the older slot, filling in the header, sequence and CRC. No system call
+void Ckpt_Save(Checkpoint *c, CkptRecord *rec);
+
+//Whether a record can be resumed on a route: same route, not too old, not too far in the future. Returns its age
+//in ms through ageMs
+int Ckpt_Usable(const CkptRecord *rec, uint32_t routeId, int64_t *ageMs);
+
+//Identifies a route by the CRC-32 of its waypoint array
+uint32_t Ckpt_RouteId(const void *wps, size_t len);
+
+//Stops the sync thread, syncs and unmaps the file
+void Ckpt_Close(Checkpoint *c);
+
+#endif
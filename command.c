@@ -0,0 +1,285 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: command.c
+Source Description: Live command channel: a loopback UDP listener that parses operator commands and hands them to
+                    the control thread through a lock-free ring
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "command.h"
+
+static Command ring[CMD_RING_SIZE];
+static _Atomic uint32_t ringHead;   //Next slot the listener fills
+static _Atomic uint32_t ringTail;   //Next slot the control thread applies
+
+static int sock = -1;
+static pthread_t listener;
+static atomic_int running;
+
+//Listener counters, read after it has stopped
+static unsigned long received = 0, rejected = 0;
+
+//Control thread counters
+static unsigned long applied = 0;
+static uint64_t waitSumNs = 0, waitMaxNs = 0;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: parseNumber
+Function Description: Reads the next word as a number within a range
+Input Parameters: save - strtok_r state, lo, hi - accepted range, out - value
+Output Parameters: 1 if there was a word and it was a number in range, 0 if there was no word, -1 if it was bad
+/---------------------------------------------------------------------------------------------------------*/
+static int parseNumber(char **save, double lo, double hi, double *out) {
+	char *word = strtok_r(NULL, " \t\r\n", save), *end;
+	if (!word)
+		return 0;
+	*out = strtod(word, &end);
+	return *end == '\0' && *out >= lo && *out <= hi ? 1 : -1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: parseInt
+Function Description: Reads the next word as a whole number within a range, so a duty is never silently truncated
+Input Parameters: save - strtok_r state, lo, hi - accepted range, out - value
+Output Parameters: 1 if there was a word and it was a whole number in range, 0 if there was no word, -1 if it was bad
+/---------------------------------------------------------------------------------------------------------*/
+static int parseInt(char **save, int lo, int hi, int *out) {
+	double v;
+	int rc = parseNumber(save, lo, hi, &v);
+	if (rc != 1)
+		return rc;
+	if (v != floor(v))
+		return -1;
+	*out = (int)v;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: parse
+Function Description: Parses one command into a slot. Routes are loaded and projected here, off the control thread
+Input Parameters: text - the command, cmd - slot to fill
+Output Parameters: NULL on success, otherwise the reason it was refused
+/---------------------------------------------------------------------------------------------------------*/
+static const char *parse(char *text, Command *cmd) {
+	char *save;
+	char *verb = strtok_r(text, " \t\r\n", &save);
+	double a, b;
+	int rc;
+
+	if (!verb)
+		return "empty command";
+	if (strcmp(verb, "goto") == 0) {
+		Waypoint wps[CMD_MAX_WPS];
+		size_t n = 0;
+		while ((rc = parseNumber(&save, -90.0, 90.0, &a)) == 1) {
+			if (n == CMD_MAX_WPS)
+				return "too many waypoints";
+			if (parseNumber(&save, -180.0, 180.0, &b) != 1)
+				return "expected lat lon pairs";
+			wps[n].lat = a;
+			wps[n].lon = b;
+			n++;
+		}
+		if (rc < 0 || n == 0)
+			return "expected lat lon pairs";
+		if (Mission_Init(&cmd->route, wps, n, MISSION_ARRIVE_M, MISSION_HYST_M) != 0)
+			return "out of memory";
+		cmd->type = CMD_ROUTE;
+	} else if (strcmp(verb, "route") == 0) {
+		char *path = strtok_r(NULL, "\r\n", &save);
+		while (path && isspace((unsigned char)*path))
+			path++;
+		if (!path || !*path)
+			return "expected a file";
+		if (Mission_Load(&cmd->route, path, MISSION_ARRIVE_M, MISSION_HYST_M) != 0)
+			return "cannot read the route";
+		cmd->type = CMD_ROUTE;
+	} else if (strcmp(verb, "pause") == 0) {
+		cmd->type = CMD_PAUSE;
+	} else if (strcmp(verb, "stop") == 0) {
+		cmd->type = CMD_STOP;
+	} else if (strcmp(verb, "resume") == 0) {
+		cmd->type = CMD_RESUME;
+	} else if (strcmp(verb, "speed") == 0) {
+		//Same ranges as the profile's full_speed and turn_speed
+		if (parseInt(&save, 1, 100, &cmd->fullSpeed) != 1)
+			return "expected a whole full speed from 1 to 100";
+		rc = parseInt(&save, 0, 100, &cmd->turnSpeed);
+		if (rc < 0)
+			return "expected a whole turn speed from 0 to 100";
+		if (rc == 0)
+			cmd->turnSpeed = -1; //Unchanged
+		cmd->type = CMD_SPEED;
+	} else {
+		return "unknown command";
+	}
+	if (strtok_r(NULL, " \t\r\n", &save))
+		return "unexpected words after the command";
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: queue
+Function Description: Parses a command into the next free slot and publishes it to the control thread. The slot
+                      may still hold the route a previous command replaced, which is freed first
+Input Parameters: text - the command, rxNs - arrival time
+Output Parameters: NULL if queued, otherwise the reason it was refused
+/---------------------------------------------------------------------------------------------------------*/
+static const char *queue(char *text, uint64_t rxNs) {
+	uint32_t head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ringTail, memory_order_acquire);
+	if (head - tail >= CMD_RING_SIZE)
+		return "busy, try again";
+
+	Command *cmd = &ring[head & (CMD_RING_SIZE - 1)];
+	Mission_Free(&cmd->route);
+	const char *err = parse(text, cmd);
+	if (err) {
+		Mission_Free(&cmd->route);
+		return err;
+	}
+	cmd->rxNs = rxNs;
+	atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: listenerThread
+Function Description: Receives command datagrams and replies to each one. The receive times out so Cmd_Stop is seen
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *listenerThread(void *arg) {
+	char buf[CMD_MAX_LEN + 1], reply[96];
+	struct sockaddr_in from;
+
+	while (atomic_load(&running)) {
+		socklen_t fromLen = sizeof(from);
+		ssize_t len = recvfrom(sock, buf, CMD_MAX_LEN, 0, (struct sockaddr *)&from, &fromLen);
+		if (len < 0)
+			continue;
+		buf[len] = '\0';
+		received++;
+		const char *err = queue(buf, nowNs());
+		if (err)
+			rejected++;
+		snprintf(reply, sizeof(reply), err ? "error: %s\n" : "ok\n", err);
+		sendto(sock, reply, strlen(reply), MSG_DONTWAIT, (struct sockaddr *)&from, fromLen);
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Cmd_Start
+Function Description: Binds the command port on the loopback interface only, and starts the listener
+Input Parameters: port - UDP port
+Output Parameters: 0 on success, -1 if the port can't be bound or the thread can't be created
+/---------------------------------------------------------------------------------------------------------*/
+int Cmd_Start(int port) {
+	struct sockaddr_in addr;
+	struct timeval tv = {0, 200000};
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	atomic_store(&ringHead, 0);
+	atomic_store(&ringTail, 0);
+	atomic_store(&running, 1);
+	if (pthread_create(&listener, NULL, listenerThread, NULL) != 0) {
+		atomic_store(&running, 0);
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Cmd_Next
+Function Description: Looks for a queued command
+Input Parameters: N/A
+Output Parameters: The oldest command not yet released, or NULL
+/---------------------------------------------------------------------------------------------------------*/
+Command *Cmd_Next(void) {
+	uint32_t tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+	if (tail == atomic_load_explicit(&ringHead, memory_order_acquire))
+		return NULL;
+	return &ring[tail & (CMD_RING_SIZE - 1)];
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Cmd_Release
+Function Description: Returns the command from Cmd_Next to the listener, timing how long it waited
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Cmd_Release(void) {
+	uint32_t tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+	uint64_t wait = nowNs() - ring[tail & (CMD_RING_SIZE - 1)].rxNs;
+	applied++;
+	waitSumNs += wait;
+	if (wait > waitMaxNs)
+		waitMaxNs = wait;
+	atomic_store_explicit(&ringTail, tail + 1, memory_order_release);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Cmd_Stop
+Function Description: Stops the listener, closes the socket and frees the routes left in the slots
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Cmd_Stop(void) {
+	if (sock < 0)
+		return;
+	if (atomic_exchange(&running, 0))
+		pthread_join(listener, NULL);
+	close(sock);
+	sock = -1;
+	for (int i = 0; i < CMD_RING_SIZE; i++)
+		Mission_Free(&ring[i].route);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Cmd_PrintStats
+Function Description: Prints the commands received, refused and applied, and how long they waited for a tick
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Cmd_PrintStats(void) {
+	printf("Commands: %lu received, %lu refused, %lu applied (waited %.2f ms mean, %.2f ms max)\n", received,
+		rejected, applied, applied ? waitSumNs / 1e6 / applied : 0.0, waitMaxNs / 1e6);
+}
@@ -0,0 +1,52 @@
+#ifndef COMMAND_h_
+#define COMMAND_h_
+
+#include <stdint.h>
+#include "mission.h"
+
+  /* Live command channel. A listener thread takes one text command per UDP datagram on the loopback interface,
+    parses it and queues it for the control thread in a lock-free ring, then replies "ok" or "error: ..." to the
+    sender. The control thread calls Cmd_Next once per tick, which is two atomic loads: no lock, no system call.
+
+      goto lat lon [lat lon ...]   replace the route (up to CMD_MAX_WPS waypoints)
+      route <file>                 replace the route with a CSV, GPX or track file on the rover
+      pause                        ramp the wheels down and hold position on the route
+      stop                         cut the motors at once and hold
+      resume                       carry on after pause or stop
+      speed <full> [turn]          FullSpeed (1 to 100) and TurnSpeed (0 to 100) duty limits, whole numbers
+
+    A new route is built, projected and allocated on the listener thread, so the control thread only swaps it in.
+    The route it replaces is left in the command slot and freed by the listener when the slot is reused.
+   */
+
+#define CMD_DEFAULT_PORT 5006
+#define CMD_RING_SIZE    8       //Commands queued for the control thread (power of 2)
+#define CMD_MAX_WPS      64      //Waypoints in one goto
+#define CMD_MAX_LEN      1400    //Longest command datagram
+
+typedef enum {CMD_ROUTE = 0, CMD_PAUSE, CMD_STOP, CMD_RESUME, CMD_SPEED} CmdType;
+
+//A parsed command
+typedef struct {
+	CmdType type;
+	Mission route;           //CMD_ROUTE, swapped with the running mission
+	int fullSpeed, turnSpeed;  //CMD_SPEED
+	uint64_t rxNs;           //When the datagram arrived
+} Command;
+
+//Binds 127.0.0.1:port and starts the listener thread. Returns -1 if the port can't be bound
+int Cmd_Start(int port);
+
+//Oldest queued command, or NULL. Control thread only, never blocks
+Command *Cmd_Next(void);
+
+//Hands the command back once it has been applied
+void Cmd_Release(void);
+
+//Stops the listener and frees any queued routes
+void Cmd_Stop(void);
+
+//Prints the command counts and how long commands waited for the control thread
+void Cmd_PrintStats(void);
+
+#endif
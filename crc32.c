@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: crc32.c
+Source Description: Table driven CRC-32 used to detect torn or corrupted records on the SD card
+/---------------------------------------------------------------------------------------------------------*/
+
+#include "crc32.h"
+
+static uint32_t table[256];
+static int tableReady = 0;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: buildTable
+Function Description: Fills the byte lookup table for the reflected 0xEDB88320 polynomial
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void buildTable(void) {
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (int k = 0; k < 8; k++)
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		table[i] = c;
+	}
+	tableReady = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Crc32
+Function Description: Computes the CRC-32 of a buffer
+Input Parameters: crc - previous CRC (0 to start), data, len - bytes to checksum
+Output Parameters: Updated CRC
+/---------------------------------------------------------------------------------------------------------*/
+uint32_t Crc32(uint32_t crc, const void *data, size_t len) {
+	const uint8_t *p = data;
+
+	if (!tableReady)
+		buildTable();
+
+	crc = ~crc;
+	while (len--)
+		crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
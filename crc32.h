@@ -0,0 +1,10 @@
+#ifndef CRC32_h_
+#define CRC32_h_
+
+#include <stdint.h>
+#include <stddef.h>
+
+//IEEE 802.3 CRC-32 of len bytes, continuing from crc (start with 0)
+uint32_t Crc32(uint32_t crc, const void *data, size_t len);
+
+#endif
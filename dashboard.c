@@ -0,0 +1,266 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: dashboard.c
+Source Description: Rate-limited terminal dashboard that redraws only the fields that changed, on its own thread
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "dashboard.h"
+#include "seqlock.h"
+#include "prof.h"
+#include "fmt.h"
+
+#define DASH_FIELDS 8
+#define DASH_TEXT   64     //Longest field text
+#define DASH_COL    17     //Column the values start in
+
+_Static_assert(sizeof(DashState) % 8 == 0, "DashState must be a multiple of 8 bytes for the seqlock");
+
+static DashState shared __attribute__((aligned(8)));
+static SeqLock lock = SEQLOCK_INIT;
+static pthread_t dashThread;
+static atomic_int running;
+static int64_t periodNs;
+
+//Screen layout: the rows holding each field, below a header and a rule
+static const char *labels[DASH_FIELDS] = {
+	"Location:", "Heading:", "Target Bearing:", "Heading Error:", "Speed:", "Waypoint:", "Steering:", "GPS:"
+};
+static const int rows[DASH_FIELDS] = {1, 3, 4, 5, 6, 7, 8, 9};
+#define DASH_ROWS 10
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: setField
+Function Description: Copies formatted text into a field, truncated to fit
+Input Parameters: field - field text, start, end - formatted text
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void setField(char field[DASH_TEXT], const char *start, const char *end) {
+	size_t len = (size_t)(end - start);
+	if (len > DASH_TEXT - 1)
+		len = DASH_TEXT - 1;
+	memcpy(field, start, len);
+	field[len] = '\0';
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: formatFields
+Function Description: Formats each dashboard field, with the same text as the printf formats in the comments
+Input Parameters: s - state, text - one string per field
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void formatFields(const DashState *s, char text[DASH_FIELDS][DASH_TEXT]) {
+	char buf[2 * FMT_DOUBLE_MAX + 2 * FMT_INT_MAX + sizeof(s->mode) + 32];
+	char *e;
+
+	e = Fmt_Double(buf, s->lat, 9, 7);          //"%9.7f N %9.7f W"
+	e = Fmt_Str(e, " N ");
+	e = Fmt_Double(e, s->lon, 9, 7);
+	e = Fmt_Str(e, " W");
+	setField(text[0], buf, e);
+	setField(text[1], buf, Fmt_Double(buf, s->head, 5, 2));
+	setField(text[2], buf, Fmt_Double(buf, s->bearing, 5, 2));
+	setField(text[3], buf, Fmt_Double(buf, s->error, 5, 2));
+	e = Fmt_Double(buf, s->speed, 0, 1);        //"%.1f km/h"
+	setField(text[4], buf, Fmt_Str(e, " km/h"));
+	e = Fmt_Int(buf, s->leg);                   //"%d/%d: %.1f m, %.1f m off track"
+	*e++ = '/';
+	e = Fmt_Int(e, s->count);
+	e = Fmt_Str(e, ": ");
+	e = Fmt_Double(e, s->distance, 0, 1);
+	e = Fmt_Str(e, " m, ");
+	e = Fmt_Double(e, s->crossTrack, 0, 1);
+	setField(text[5], buf, Fmt_Str(e, " m off track"));
+	e = Fmt_Str(buf, s->mode);                  //"%s, duty %d %d"
+	e = Fmt_Str(e, ", duty ");
+	e = Fmt_Int(e, s->dutyL);
+	*e++ = ' ';
+	setField(text[6], buf, Fmt_Int(e, s->dutyR));
+	snprintf(text[7], DASH_TEXT, "%s%s", s->fixState ? "fix" : "no fix", s->arrived ? ", mission complete" : "");
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: drawFull
+Function Description: Draws the whole dashboard below the cursor, leaving the cursor on the line after it
+Input Parameters: out - buffer, size - its size, text - field text
+Output Parameters: Bytes written to out
+/---------------------------------------------------------------------------------------------------------*/
+static size_t drawFull(char *out, size_t size, char text[DASH_FIELDS][DASH_TEXT]) {
+	size_t n = 0;
+	for (int r = 0, f = 0; r < DASH_ROWS && n < size; r++) {
+		if (f < DASH_FIELDS && rows[f] == r) {
+			n += snprintf(out + n, size - n, "%-*s%s\033[K\n", DASH_COL - 1, labels[f], text[f]);
+			f++;
+		} else {
+			n += snprintf(out + n, size - n, "--------------------------------------\n");
+		}
+	}
+	return n < size ? n : size;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: drawChanges
+Function Description: Rewrites only the fields whose text differs from the last frame, moving up to each one and
+                      back to the line below the dashboard
+Input Parameters: out - buffer, size - its size, text - new field text, last - text on screen
+Output Parameters: Bytes written to out
+/---------------------------------------------------------------------------------------------------------*/
+static size_t drawChanges(char *out, size_t size, char text[DASH_FIELDS][DASH_TEXT], char last[DASH_FIELDS][DASH_TEXT]) {
+	size_t n = 0;
+	for (int f = 0; f < DASH_FIELDS && n < size; f++) {
+		if (strcmp(text[f], last[f]) == 0)
+			continue;
+		int up = DASH_ROWS - rows[f];
+		n += snprintf(out + n, size - n, "\033[%dA\033[%dG%s\033[K\033[%dB\r", up, DASH_COL, text[f], up);
+	}
+	return n < size ? n : size;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: drawPlain
+Function Description: One line per frame for pipes and files
+Input Parameters: out - buffer, size - its size, s - state
+Output Parameters: Bytes written to out
+/---------------------------------------------------------------------------------------------------------*/
+static size_t drawPlain(char *out, size_t size, const DashState *s) {
+	char line[8 * FMT_DOUBLE_MAX + 4 * FMT_INT_MAX + sizeof(s->mode) + 64];
+	char *e;
+
+	//"%9.7f,%9.7f head %5.2f bearing %5.2f error %5.2f wp %d/%d %.1f m xt %.1f m %s %d %d%s\n"
+	e = Fmt_Double(line, s->lat, 9, 7);
+	*e++ = ',';
+	e = Fmt_Double(e, s->lon, 9, 7);
+	e = Fmt_Str(e, " head ");
+	e = Fmt_Double(e, s->head, 5, 2);
+	e = Fmt_Str(e, " bearing ");
+	e = Fmt_Double(e, s->bearing, 5, 2);
+	e = Fmt_Str(e, " error ");
+	e = Fmt_Double(e, s->error, 5, 2);
+	e = Fmt_Str(e, " wp ");
+	e = Fmt_Int(e, s->leg);
+	*e++ = '/';
+	e = Fmt_Int(e, s->count);
+	*e++ = ' ';
+	e = Fmt_Double(e, s->distance, 0, 1);
+	e = Fmt_Str(e, " m xt ");
+	e = Fmt_Double(e, s->crossTrack, 0, 1);
+	e = Fmt_Str(e, " m ");
+	e = Fmt_Str(e, s->mode);
+	*e++ = ' ';
+	e = Fmt_Int(e, s->dutyL);
+	*e++ = ' ';
+	e = Fmt_Int(e, s->dutyR);
+	e = Fmt_Str(e, s->arrived ? " complete\n" : "\n");
+
+	size_t n = (size_t)(e - line);
+	if (n > size)
+		n = size;
+	memcpy(out, line, n);
+	return n;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: dashLoop
+Function Description: The dashboard thread. Each period reads the latest state and draws what changed, and prints
+                      the latency dump when one was requested, redrawing in full after it. The sleep is resumed
+                      after a signal; if it fails otherwise, that is reported once and a plain period sleep paces
+                      the thread instead
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *dashLoop(void *arg) {
+	static char last[DASH_FIELDS][DASH_TEXT], text[DASH_FIELDS][DASH_TEXT];
+	static char out[2048];
+	int tty = isatty(STDOUT_FILENO);
+	int drawn = 0;
+	unsigned lastSeq = 0;
+	unsigned long sleepFailed = 0;
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	for (int final = 0; !final; ) {
+		final = !atomic_load(&running); //One last frame after Dash_Stop
+
+		DashState s;
+		unsigned seq = SeqLock_Load(&lock, &shared, &s, sizeof(s));
+		if (seq != 0 && seq != lastSeq) {
+			size_t n;
+			lastSeq = seq;
+			if (tty) {
+				formatFields(&s, text);
+				n = drawn ? drawChanges(out, sizeof(out), text, last) : drawFull(out, sizeof(out), text);
+				memcpy(last, text, sizeof(last));
+				drawn = 1;
+			} else {
+				n = drawPlain(out, sizeof(out), &s);
+			}
+			fwrite(out, 1, n, stdout);
+			fflush(stdout);
+		}
+
+		if (!final && Prof_Poll()) { //SIGUSR1 latency dump, printed here so the control loop never waits on stdout
+			fflush(stdout);
+			drawn = 0;
+			lastSeq = 0;
+		}
+
+		next.tv_nsec += periodNs;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		if (!final) {
+			int err;
+			while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)) == EINTR && atomic_load(&running))
+				;
+			if (err != 0 && err != EINTR) {
+				if (!sleepFailed++)
+					printf("Dashboard: clock_nanosleep failed (%s)\n", strerror(err));
+				usleep((useconds_t)(periodNs / 1000));
+			}
+		}
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Dash_Start
+Function Description: Starts the dashboard thread
+Input Parameters: rateHz - refresh rate, DASH_DEFAULT_HZ if not positive
+Output Parameters: 0 on success, -1 if the thread could not be started
+/---------------------------------------------------------------------------------------------------------*/
+int Dash_Start(double rateHz) {
+	periodNs = (int64_t)(1e9 / (rateHz > 0.0 ? rateHz : DASH_DEFAULT_HZ));
+	atomic_store(&running, 1);
+	if (pthread_create(&dashThread, NULL, dashLoop, NULL) != 0) {
+		atomic_store(&running, 0);
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Dash_Publish
+Function Description: Hands the latest state to the dashboard thread
+Input Parameters: s - state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Dash_Publish(const DashState *s) {
+	SeqLock_Store(&lock, &shared, s, sizeof(*s));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Dash_Stop
+Function Description: Stops the dashboard thread after it draws the last published state
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Dash_Stop(void) {
+	if (atomic_exchange(&running, 0))
+		pthread_join(dashThread, NULL);
+}
@@ -0,0 +1,40 @@
+#ifndef DASHBOARD_h_
+#define DASHBOARD_h_
+
+#include <stdint.h>
+
+  /* Terminal dashboard on its own thread. The control loop hands over the latest state with Dash_Publish, a
+    seqlock store that never waits. The dashboard thread wakes at a fixed refresh rate, skips the frame if
+    nothing was published, and on a terminal only rewrites the fields whose text changed, in place. When stdout is
+    not a terminal (a pipe or a file), it writes one plain line per changed frame instead. Only this thread writes
+    to stdout while it runs, so a slow SSH session or a full pipe holds up the dashboard, never the motors.
+   */
+
+#define DASH_DEFAULT_HZ 10
+
+//State shown by the dashboard, a multiple of 8 bytes for the seqlock
+typedef struct {
+	double lat, lon;
+	double head;         //Heading used for steering
+	double bearing;      //Bearing to the target waypoint
+	double error;        //Heading error, 0 to 360
+	double speed;        //km/h
+	double distance;     //To the target waypoint (m)
+	double crossTrack;   //Off the active leg (m)
+	int32_t leg, count;  //Target waypoint (from 1) and route length
+	int32_t dutyL, dutyR;
+	int32_t fixState;
+	int32_t arrived;     //Mission complete
+	char mode[24];       //Steering mode or turn table entry
+} DashState;
+
+//Starts the dashboard thread redrawing at rateHz. Returns -1 if the thread could not be started
+int Dash_Start(double rateHz);
+
+//Hands the latest state to the dashboard, never blocks
+void Dash_Publish(const DashState *s);
+
+//Draws the last state and stops the thread, leaving the cursor below the dashboard
+void Dash_Stop(void);
+
+#endif
@@ -0,0 +1,319 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: estimator.c
+Source Description: Extended Kalman filter fusing GPS fixes with the applied wheel duties, so the control loop can
+                    run on a predicted pose between fixes
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <string.h>
+#include "estimator.h"
+#include "geodesy.h"
+
+#define N EST_STATES
+enum {SE = 0, SN, SH, SV, SW};  //State indices
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_Defaults
+Function Description: Parameters for the rover: drive geometry as rover_model.c, noise from the recorded logs
+Input Parameters: p - parameters to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Est_Defaults(EstParams *p) {
+	p->maxSpeed = 0.8;
+	p->track = 0.25;
+	p->tau = 0.15;
+	p->qPos = 0.01;
+	p->qHead = 0.01;
+	p->qSpeed = 0.05;
+	p->qYaw = 1.0;
+	p->rPos = 0.5;
+	p->rHead = 5.0;
+	p->rSpeed = 0.1;
+	p->headMinSpeed = 0.2;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_Init
+Function Description: Sets up an estimator with no state yet
+Input Parameters: est - estimator, p - parameters
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Est_Init(Estimator *est, const EstParams *p) {
+	memset(est, 0, sizeof(*est));
+	est->p = *p;
+	NavFrame_Init(&est->frame, 0.0, 0.0, 0.0);
+}
+
+//Heading difference wrapped to [-pi, pi)
+static double wrapPi(double a) {
+	a = fmod(a + GEO_PI, 2.0 * GEO_PI);
+	if (a < 0.0)
+		a += 2.0 * GEO_PI;
+	return a - GEO_PI;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: propagate
+Function Description: Advances a state through the drive model, and its covariance when P is given
+Input Parameters: p - parameters, x - state, P - covariance or NULL, dt - seconds, dutyL, dutyR - applied duties
+Output Parameters: x, P updated in place
+/---------------------------------------------------------------------------------------------------------*/
+static void propagate(const EstParams *p, double *x, double P[N][N], double dt, double dutyL, double dutyR) {
+	if (dt <= 0.0)
+		return;
+	double vl = dutyL / 100.0 * p->maxSpeed, vr = dutyR / 100.0 * p->maxSpeed;
+	double vCmd = 0.5 * (vl + vr), wCmd = (vl - vr) / p->track;
+	double a = p->tau > 0.0 ? 1.0 - exp(-dt / p->tau) : 1.0;
+	double s = sin(x[SH]), c = cos(x[SH]);
+
+	if (P) {
+		double F[N][N] = {{0}};
+		for (int i = 0; i < N; i++)
+			F[i][i] = 1.0;
+		F[SE][SH] = x[SV] * c * dt;
+		F[SE][SV] = s * dt;
+		F[SN][SH] = -x[SV] * s * dt;
+		F[SN][SV] = c * dt;
+		F[SH][SW] = dt;
+		F[SV][SV] = 1.0 - a;
+		F[SW][SW] = 1.0 - a;
+
+		double FP[N][N];
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < N; j++) {
+				double sum = 0.0;
+				for (int k = 0; k < N; k++)
+					sum += F[i][k] * P[k][j];
+				FP[i][j] = sum;
+			}
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < N; j++) {
+				double sum = 0.0;
+				for (int k = 0; k < N; k++)
+					sum += FP[i][k] * F[j][k];
+				P[i][j] = sum;
+			}
+		P[SE][SE] += p->qPos * dt;
+		P[SN][SN] += p->qPos * dt;
+		P[SH][SH] += p->qHead * dt;
+		P[SV][SV] += p->qSpeed * dt;
+		P[SW][SW] += p->qYaw * dt;
+	}
+
+	x[SE] += x[SV] * s * dt;
+	x[SN] += x[SV] * c * dt;
+	x[SH] = wrapPi(x[SH] + x[SW] * dt);
+	x[SV] += a * (vCmd - x[SV]);
+	x[SW] += a * (wCmd - x[SW]);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: advance
+Function Description: Moves the filter forward to a time with the duties in force. Earlier times are ignored
+Input Parameters: est - estimator, tNs - new time
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void advance(Estimator *est, uint64_t tNs) {
+	if (!est->initialised || tNs <= est->tNs) {
+		if (!est->initialised)
+			est->tNs = tNs;
+		return;
+	}
+	propagate(&est->p, est->x, est->P, (tNs - est->tNs) / 1e9, est->dutyL, est->dutyR);
+	est->tNs = tNs;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_Command
+Function Description: Records the duties applied from a time on, after predicting up to that time
+Input Parameters: est - estimator, tNs - time the duties took effect, dutyL, dutyR - wheel duties [-100, 100]
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Est_Command(Estimator *est, uint64_t tNs, double dutyL, double dutyR) {
+	advance(est, tNs);
+	est->dutyL = dutyL;
+	est->dutyR = dutyR;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: updateScalar
+Function Description: Kalman update of one state with a direct measurement, gated on the normalised innovation.
+                      A measurement of -x[idx] is fused by passing its innovation negated
+Input Parameters: est - estimator, idx - state measured, y - innovation, r - measurement variance
+Output Parameters: 1 if fused, 0 if gated out
+/---------------------------------------------------------------------------------------------------------*/
+static int updateScalar(Estimator *est, int idx, double y, double r) {
+	double S = est->P[idx][idx] + r;
+	if (y * y / S > EST_GATE_SCALAR)
+		return 0;
+	double K[N];
+	for (int i = 0; i < N; i++)
+		K[i] = est->P[i][idx] / S;
+	for (int i = 0; i < N; i++)
+		est->x[i] += K[i] * y;
+	double row[N];
+	memcpy(row, est->P[idx], sizeof(row));
+	for (int i = 0; i < N; i++)
+		for (int j = 0; j < N; j++)
+			est->P[i][j] -= K[i] * row[j];
+	est->x[SH] = wrapPi(est->x[SH]);
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: updatePosition
+Function Description: Kalman update with a 2D position measurement, gated on the Mahalanobis distance
+Input Parameters: est - estimator, e, n - measured position in the frame
+Output Parameters: 1 if fused, 0 if gated out
+/---------------------------------------------------------------------------------------------------------*/
+static int updatePosition(Estimator *est, double e, double n) {
+	double r = est->p.rPos * est->p.rPos;
+	double ye = e - est->x[SE], yn = n - est->x[SN];
+	double s00 = est->P[SE][SE] + r, s01 = est->P[SE][SN], s11 = est->P[SN][SN] + r;
+	double det = s00 * s11 - s01 * s01;
+	if (det <= 0.0)
+		return 0;
+	double i00 = s11 / det, i01 = -s01 / det, i11 = s00 / det;
+	if (ye * (i00 * ye + i01 * yn) + yn * (i01 * ye + i11 * yn) > EST_GATE_POS)
+		return 0;
+
+	double K[N][2];
+	for (int i = 0; i < N; i++) {
+		K[i][0] = est->P[i][SE] * i00 + est->P[i][SN] * i01;
+		K[i][1] = est->P[i][SE] * i01 + est->P[i][SN] * i11;
+	}
+	for (int i = 0; i < N; i++)
+		est->x[i] += K[i][0] * ye + K[i][1] * yn;
+	double rowE[N], rowN[N];
+	memcpy(rowE, est->P[SE], sizeof(rowE));
+	memcpy(rowN, est->P[SN], sizeof(rowN));
+	for (int i = 0; i < N; i++)
+		for (int j = 0; j < N; j++)
+			est->P[i][j] -= K[i][0] * rowE[j] + K[i][1] * rowN[j];
+	est->x[SH] = wrapPi(est->x[SH]);
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: resetOnFix
+Function Description: Starts the filter at a fix: frame anchored there, heading from the fix, wide covariance
+Input Parameters: est - estimator, tNs - fix time, lat, lon, head, speed - fix
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void resetOnFix(Estimator *est, uint64_t tNs, double lat, double lon, double head, double speed) {
+	NavFrame_Anchor(&est->frame, lat, lon);
+	memset(est->x, 0, sizeof(est->x));
+	memset(est->P, 0, sizeof(est->P));
+	est->x[SH] = wrapPi(head * (GEO_PI / 180.0));
+	est->x[SV] = speed;
+	est->P[SE][SE] = est->P[SN][SN] = est->p.rPos * est->p.rPos;
+	est->P[SH][SH] = GEO_PI * GEO_PI;
+	est->P[SV][SV] = 0.25;
+	est->P[SW][SW] = 1.0;
+	est->tNs = tNs;
+	est->initialised = 1;
+	est->rejectRun = 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_Seed
+Function Description: Starts the filter on a saved pose. Position keeps its saved uncertainty (at least one GPS
+                      standard deviation) and heading is trusted to one course standard deviation, since the rover
+                      has not moved while stopped
+Input Parameters: est - estimator, tNs - time of the pose, pose - saved pose
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Est_Seed(Estimator *est, uint64_t tNs, const EstPose *pose) {
+	double sd = pose->posSd > est->p.rPos ? pose->posSd : est->p.rPos;
+	double headSd = est->p.rHead * (GEO_PI / 180.0);
+
+	resetOnFix(est, tNs, pose->lat, pose->lon, pose->head, pose->speed);
+	est->P[SE][SE] = est->P[SN][SN] = sd * sd;
+	est->P[SH][SH] = headSd * headSd;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_Fix
+Function Description: Predicts to the fix time and fuses position, then speed and course over ground when the
+                      rover is moving fast enough for the course to mean anything. The frame is re-anchored on the
+                      estimate when it drifts NAV_REANCHOR_M from the origin
+Input Parameters: est - estimator, tNs - fix time, lat, lon - position, head - course over ground (degrees),
+                  speed - GPS speed (m/s), haveHead - head and speed are valid
+Output Parameters: 1 if the position was fused, 0 if it was gated out
+/---------------------------------------------------------------------------------------------------------*/
+int Est_Fix(Estimator *est, uint64_t tNs, double lat, double lon, double head, double speed, int haveHead) {
+	est->fixes++;
+	if (!est->initialised) {
+		resetOnFix(est, tNs, lat, lon, haveHead ? head : 0.0, haveHead ? speed : 0.0);
+		return 1;
+	}
+	advance(est, tNs);
+
+	NavPoint m;
+	NavFrame_Project(&est->frame, lat, lon, &m);
+	if (m.e * m.e + m.n * m.n > NAV_REANCHOR_M * NAV_REANCHOR_M) {
+		double sLat, sLon;
+		NavPoint s = {est->x[SE], est->x[SN]};
+		NavFrame_Unproject(&est->frame, &s, &sLat, &sLon);
+		NavFrame_Anchor(&est->frame, sLat, sLon);
+		est->x[SE] = est->x[SN] = 0.0;
+		NavFrame_Project(&est->frame, lat, lon, &m);
+	}
+
+	int accepted = updatePosition(est, m.e, m.n);
+	if (!accepted) {
+		est->rejected++;
+		if (++est->rejectRun >= EST_MAX_REJECTS) {
+			est->resets++;
+			resetOnFix(est, tNs, lat, lon, haveHead ? head : est->x[SH] * (180.0 / GEO_PI), haveHead ? speed : 0.0);
+			return 1;
+		}
+		return 0;
+	}
+	est->rejectRun = 0;
+
+	if (haveHead) {
+		//GPS speed measures |v|, so the Jacobian is the sign of v: with v < 0 the innovation is applied negated,
+		//moving v toward -speed rather than toward zero
+		double sign = est->x[SV] < 0.0 ? -1.0 : 1.0;
+		updateScalar(est, SV, sign * (speed - fabs(est->x[SV])), est->p.rSpeed * est->p.rSpeed);
+		if (speed >= est->p.headMinSpeed && est->x[SV] > 0.0) {
+			double rH = est->p.rHead * (GEO_PI / 180.0);
+			updateScalar(est, SH, wrapPi(head * (GEO_PI / 180.0) - est->x[SH]), rH * rH);
+		}
+	}
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_PoseAt
+Function Description: Predicts the mean state to a time with the duties in force, leaving the filter unchanged
+Input Parameters: est - estimator, tNs - time to predict to
+Output Parameters: pose - predicted pose, returns 0, or -1 before the first fix
+/---------------------------------------------------------------------------------------------------------*/
+int Est_PoseAt(const Estimator *est, uint64_t tNs, EstPose *pose) {
+	if (!est->initialised)
+		return -1;
+	double x[N];
+	memcpy(x, est->x, sizeof(x));
+	if (tNs > est->tNs)
+		propagate(&est->p, x, NULL, (tNs - est->tNs) / 1e9, est->dutyL, est->dutyR);
+
+	NavPoint pt = {x[SE], x[SN]};
+	NavFrame_Unproject(&est->frame, &pt, &pose->lat, &pose->lon);
+	pose->head = fmod(x[SH] * (180.0 / GEO_PI) + 360.0, 360.0);
+	pose->speed = x[SV];
+	pose->yawRate = x[SW] * (180.0 / GEO_PI);
+	pose->posSd = sqrt(est->P[SE][SE] + est->P[SN][SN]);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Est_Free
+Function Description: Frees the estimator
+Input Parameters: est - estimator
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Est_Free(Estimator *est) {
+	NavFrame_Free(&est->frame);
+}
@@ -0,0 +1,77 @@
+#ifndef ESTIMATOR_h_
+#define ESTIMATOR_h_
+
+#include <stdint.h>
+#include "nav_frame.h"
+
+  /* Extended Kalman filter over position (east, north in a local nav frame), heading, speed and yaw rate. The
+    process model is a differential drive following the wheel duties actually applied (Motors_GetDuties): speed
+    and yaw rate lag the commanded values with time constant tau, and position and heading integrate them. GPS
+    position, course over ground and speed are fused as they arrive. Each is gated on its Mahalanobis distance,
+    and after EST_MAX_REJECTS position rejections in a row the filter resets onto the fix rather than trusting a
+    diverged state. Est_PoseAt() predicts the mean to any timestamp without changing the filter, so control can run
+    at a fixed rate between fixes.
+   */
+
+#define EST_STATES 5
+#define EST_GATE_POS   13.8   //Chi-square, 2 degrees of freedom, 99.9%
+#define EST_GATE_SCALAR 10.8  //Chi-square, 1 degree of freedom, 99.9%
+#define EST_MAX_REJECTS 5
+
+typedef struct {
+	double maxSpeed;     //Wheel speed at 100% duty (m/s)
+	double track;        //Wheel separation (m)
+	double tau;          //Speed and yaw rate time constant (s)
+	double qPos;         //Process noise spectral densities: position (m^2/s)
+	double qHead;        //heading (rad^2/s)
+	double qSpeed;       //speed ((m/s)^2/s)
+	double qYaw;         //yaw rate ((rad/s)^2/s)
+	double rPos;         //GPS position standard deviation (m)
+	double rHead;        //Course over ground standard deviation (degrees)
+	double rSpeed;       //GPS speed standard deviation (m/s)
+	double headMinSpeed; //GPS course is only fused above this speed (m/s)
+} EstParams;
+
+//Estimated pose
+typedef struct {
+	double lat, lon;    //Position (degrees)
+	double head;        //Heading, 0 to 360
+	double speed;       //Forward speed (m/s)
+	double yawRate;     //Degrees/s, clockwise
+	double posSd;       //Position standard deviation (m)
+} EstPose;
+
+typedef struct {
+	EstParams p;
+	NavFrame frame;
+	double x[EST_STATES];              //e, n, heading (rad), speed, yaw rate (rad/s)
+	double P[EST_STATES][EST_STATES];
+	double dutyL, dutyR;               //Wheel duties applied since tNs
+	uint64_t tNs;                      //Time of the state
+	int initialised;
+	int rejectRun;                     //Consecutive rejected positions
+	unsigned long fixes, rejected, resets;
+} Estimator;
+
+//Fills in parameters matching the rover model
+void Est_Defaults(EstParams *p);
+
+//Sets up an estimator, it initialises itself on the first position fix
+void Est_Init(Estimator *est, const EstParams *p);
+
+//Starts the filter on a saved pose instead of a fix, so it can dead-reckon before the first fix after a restart
+void Est_Seed(Estimator *est, uint64_t tNs, const EstPose *pose);
+
+//Records the wheel duties applied from time tNs onwards
+void Est_Command(Estimator *est, uint64_t tNs, double dutyL, double dutyR);
+
+//Fuses a GPS fix taken at tNs: position, course over ground (degrees) and speed (m/s). Returns 1 if the position was accepted
+int Est_Fix(Estimator *est, uint64_t tNs, double lat, double lon, double head, double speed, int haveHead);
+
+//Predicted pose at any time at or after the last fix or command. Returns -1 before the first fix
+int Est_PoseAt(const Estimator *est, uint64_t tNs, EstPose *pose);
+
+//Frees the estimator
+void Est_Free(Estimator *est);
+
+#endif
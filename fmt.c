@@ -0,0 +1,112 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: fmt.c
+Source Description: Locale-free, allocation-free formatting of fixed-precision doubles and integers into caller
+                    buffers, byte-for-byte the same as printf
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "fmt.h"
+
+#define FMT_MAX_PREC 17
+#define FMT_EXACT_MAX 4503599627370496.0  //2^52: below this, x - floor(x) is exact and 0.5 is on the grid
+
+static const double pow10d[FMT_MAX_PREC + 1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+	1e13, 1e14, 1e15, 1e16, 1e17};
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: pad
+Function Description: Right-aligns text in a field, as printf does for a width without the '-' flag
+Input Parameters: out - buffer, text, len - text to copy, width - field width
+Output Parameters: End of the written text
+/---------------------------------------------------------------------------------------------------------*/
+static char *pad(char *out, const char *text, size_t len, int width) {
+	for (int i = (int)len; i < width; i++)
+		*out++ = ' ';
+	memcpy(out, text, len);
+	return out + len;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Fmt_Double
+Function Description: Formats |v| * 10^prec rounded to an integer, then puts the point in. The product is split
+                      into its rounded value and exact error with fma, so the rounding decision is made on the
+                      exact value: the fraction of the rounded product is on a grid that includes 0.5, and the
+                      error is under half a grid step, so it only matters on an exact half, where it breaks the
+                      tie; a true tie rounds to even
+Input Parameters: out - buffer with FMT_DOUBLE_MAX bytes free, v - value, width - field width, prec - decimals
+Output Parameters: End of the written text
+/---------------------------------------------------------------------------------------------------------*/
+char *Fmt_Double(char *out, double v, int width, int prec) {
+	char tmp[FMT_DOUBLE_MAX];
+
+	if (prec < 0 || prec > FMT_MAX_PREC || !isfinite(v) || fabs(v) * pow10d[prec] >= FMT_EXACT_MAX) {
+		int len = snprintf(tmp, sizeof(tmp), "%*.*f", width, prec, v);
+		if (len < 0)
+			len = 0;
+		if (len > (int)sizeof(tmp) - 1)
+			len = (int)sizeof(tmp) - 1;
+		memcpy(out, tmp, (size_t)len);
+		return out + len;
+	}
+
+	double p = pow10d[prec];
+	double x = fabs(v) * p;
+	double err = fma(fabs(v), p, -x);
+	double r = floor(x);
+	double f = x - r;
+	if (f > 0.5 || (f == 0.5 && (err > 0.0 || (err == 0.0 && fmod(r, 2.0) != 0.0))))
+		r += 1.0;
+
+	//Digits from the right
+	uint64_t n = (uint64_t)r;
+	char *t = tmp + sizeof(tmp);
+	for (int i = 0; i < prec; i++) {
+		*--t = (char)('0' + n % 10);
+		n /= 10;
+	}
+	if (prec > 0)
+		*--t = '.';
+	do {
+		*--t = (char)('0' + n % 10);
+		n /= 10;
+	} while (n);
+	if (signbit(v))
+		*--t = '-';
+
+	return pad(out, t, (size_t)(tmp + sizeof(tmp) - t), width);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Fmt_Int
+Function Description: Formats a signed integer
+Input Parameters: out - buffer with FMT_INT_MAX bytes free, v - value
+Output Parameters: End of the written text
+/---------------------------------------------------------------------------------------------------------*/
+char *Fmt_Int(char *out, long v) {
+	char tmp[FMT_INT_MAX];
+	char *t = tmp + sizeof(tmp);
+	unsigned long n = v < 0 ? 0ul - (unsigned long)v : (unsigned long)v;
+
+	do {
+		*--t = (char)('0' + n % 10);
+		n /= 10;
+	} while (n);
+	if (v < 0)
+		*--t = '-';
+	return pad(out, t, (size_t)(tmp + sizeof(tmp) - t), 0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Fmt_Str
+Function Description: Copies a string without its terminator
+Input Parameters: out - buffer, s - string
+Output Parameters: End of the written text
+/---------------------------------------------------------------------------------------------------------*/
+char *Fmt_Str(char *out, const char *s) {
+	size_t len = strlen(s);
+	memcpy(out, s, len);
+	return out + len;
+}
@@ -0,0 +1,26 @@
+#ifndef FMT_h_
+#define FMT_h_
+
+#include <stddef.h>
+
+  /* Number formatting for the log writer and console output without printf: no format string parsing, no locale,
+    no stdio lock and no allocation. Each function writes into the caller's buffer and returns the end of what it
+    wrote, so a line is built by chaining calls.
+    Fmt_Double gives the same bytes as printf("%*.*f", width, prec, v). It works out the digits with an exact
+    product (fma) and rounds ties to even on the binary value, as glibc does. Values it can't do that way (more than
+    about 15 digits before the point plus prec, infinities, NaN) go through snprintf.
+   */
+
+#define FMT_DOUBLE_MAX 64  //Room to leave for one Fmt_Double (output longer than 63 bytes is truncated)
+#define FMT_INT_MAX    24  //Room to leave for one Fmt_Int
+
+//v as printf("%*.*f", width, prec, v). prec 0 to 17
+char *Fmt_Double(char *out, double v, int width, int prec);
+
+//v as printf("%ld", v)
+char *Fmt_Int(char *out, long v);
+
+//s without its terminator
+char *Fmt_Str(char *out, const char *s);
+
+#endif
@@ -0,0 +1,431 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: geodesy.c
+Source Description: Spherical earth bearing, distance, destination and cross-track kernels. Scalar versions use
+                    libm, batch versions run on SIMD lanes through GCC vector extensions with polynomial
+                    sin/cos/atan2 so the whole batch stays in vector registers
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "geodesy.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define GEO_LANES 4
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GEO_LANES 2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GEO_LANES 2
+#else
+#define GEO_LANES 2 //32-bit NEON has no double lanes, GCC lowers the vectors to VFP instructions
+#endif
+
+//Vectors per loop pass. Each kernel is one long dependency chain, so a pass works on four independent vectors to
+//keep the pipeline full instead of waiting on the latency of the last operation. With one, the SSE2 kernels were
+//slower than libm (tools/geo_bench.c)
+#define GEO_UNROLL 4
+
+
+typedef double vdouble __attribute__((vector_size(GEO_LANES * sizeof(double))));
+typedef int64_t vlong __attribute__((vector_size(GEO_LANES * sizeof(double))));
+
+#define GEO_INLINE static inline __attribute__((always_inline)) //Kernels pass whole vectors, so never call one
+
+#define DEG2RAD (GEO_PI / 180.0)
+#define RAD2DEG (180.0 / GEO_PI)
+
+#define ROUND_MAGIC 6755399441055744.0 //1.5 * 2^52, adding it rounds to an integer held in the low mantissa bits
+
+//pi/2 split so k * PIO2_1 and k * PIO2_2 are exact for the quadrant counts seen here (Cody-Waite)
+#define PIO2_1  1.57079632673412561417e+00
+#define PIO2_2  6.07710050630396597660e-11
+#define PIO2_2T 2.02226624879595063154e-21
+
+#define T3P8     2.41421356237309504880  //tan(3pi/8)
+#define MOREBITS 6.123233995736765886130e-17  //pi/2 - (double)pi/2
+
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: wrap360
+Function Description: Normalises an angle in degrees to [0, 360)
+Input Parameters: deg - angle
+Output Parameters: Normalised angle
+/---------------------------------------------------------------------------------------------------------*/
+static double wrap360(double deg) {
+	deg = fmod(deg, 360.0);
+	if (deg < 0.0)
+		deg += 360.0;
+	return deg >= 360.0 ? 0.0 : deg;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_Bearing
+Function Description: Initial great-circle bearing from point 1 to point 2
+Input Parameters: lat1, lon1 - start, lat2, lon2 - end
+Output Parameters: Bearing in [0, 360)
+/---------------------------------------------------------------------------------------------------------*/
+double Geo_Bearing(double lat1, double lon1, double lat2, double lon2) {
+	double p1 = lat1 * DEG2RAD, p2 = lat2 * DEG2RAD;
+	double dl = (lon2 - lon1) * DEG2RAD;
+	double sh = sin(dl * 0.5);
+	double x = sin(dl) * cos(p2);
+	double y = sin(p2 - p1) + 2.0 * sin(p1) * cos(p2) * sh * sh; //cos(p1)sin(p2) - sin(p1)cos(p2)cos(dl) without the cancellation for close points
+	return wrap360(atan2(x, y) * RAD2DEG);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_Distance
+Function Description: Great-circle distance between two points by the haversine formula
+Input Parameters: lat1, lon1, lat2, lon2 - the points
+Output Parameters: Distance in metres
+/---------------------------------------------------------------------------------------------------------*/
+double Geo_Distance(double lat1, double lon1, double lat2, double lon2) {
+	double sp = sin((lat2 - lat1) * DEG2RAD * 0.5);
+	double sl = sin((lon2 - lon1) * DEG2RAD * 0.5);
+	double a = sp * sp + cos(lat1 * DEG2RAD) * cos(lat2 * DEG2RAD) * sl * sl;
+	if (a > 1.0)
+		a = 1.0;
+	return 2.0 * GEO_EARTH_RADIUS * atan2(sqrt(a), sqrt(1.0 - a));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_Destination
+Function Description: Point reached by travelling along a great circle from a start point
+Input Parameters: lat, lon - start, bearing - initial bearing, dist - distance in metres
+Output Parameters: lat2, lon2 - destination, longitude in [-180, 180)
+/---------------------------------------------------------------------------------------------------------*/
+void Geo_Destination(double lat, double lon, double bearing, double dist, double *lat2, double *lon2) {
+	double p1 = lat * DEG2RAD, t = bearing * DEG2RAD, d = dist / GEO_EARTH_RADIUS;
+	double sp2 = sin(p1) * cos(d) + cos(p1) * sin(d) * cos(t);
+	if (sp2 > 1.0)
+		sp2 = 1.0;
+	else if (sp2 < -1.0)
+		sp2 = -1.0;
+	double p2 = asin(sp2);
+	double l2 = lon + atan2(sin(t) * sin(d) * cos(p1), cos(d) - sin(p1) * sp2) * RAD2DEG;
+	*lat2 = p2 * RAD2DEG;
+	*lon2 = wrap360(l2 + 180.0) - 180.0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_CrossTrack
+Function Description: Signed distance of a point from the great circle through a path's two ends
+Input Parameters: lat1, lon1 - path start, lat2, lon2 - path end, lat3, lon3 - point
+Output Parameters: Distance in metres, positive when the point is right of the path
+/---------------------------------------------------------------------------------------------------------*/
+double Geo_CrossTrack(double lat1, double lon1, double lat2, double lon2, double lat3, double lon3) {
+	double d13 = Geo_Distance(lat1, lon1, lat3, lon3) / GEO_EARTH_RADIUS;
+	double dt = (Geo_Bearing(lat1, lon1, lat3, lon3) - Geo_Bearing(lat1, lon1, lat2, lon2)) * DEG2RAD;
+	return asin(sin(d13) * sin(dt)) * GEO_EARTH_RADIUS;
+}
+
+
+/*--------------------------------------------VECTOR KERNELS----------------------------------------------*/
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vsel
+Function Description: Lane-wise select, mask lanes are all ones or all zeros as produced by vector comparisons
+Input Parameters: mask, a - taken where mask is set, b - taken elsewhere
+Output Parameters: Selected lanes
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vsel(vlong mask, vdouble a, vdouble b) {
+	return (vdouble)(((vlong)a & mask) | ((vlong)b & ~mask));
+}
+
+//Broadcast a scalar to every lane
+GEO_INLINE vdouble vset(double c) {
+	vdouble v;
+	for (int i = 0; i < GEO_LANES; i++)
+		v[i] = c;
+	return v;
+}
+
+//Lane-wise absolute value and sign transfer
+GEO_INLINE vdouble vabs(vdouble x) {
+	return (vdouble)((vlong)x & ~(vlong)vset(-0.0));
+}
+
+GEO_INLINE vdouble vcopysign(vdouble mag, vdouble sgn) {
+	vlong sign = (vlong)vset(-0.0);
+	return (vdouble)(((vlong)mag & ~sign) | ((vlong)sgn & sign));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vsqrt
+Function Description: Lane-wise square root using the hardware instruction where there is one
+Input Parameters: x - input lanes
+Output Parameters: Square roots
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vsqrt(vdouble x) {
+#if defined(__AVX__)
+	return (vdouble)_mm256_sqrt_pd((__m256d)x);
+#elif defined(__SSE2__)
+	return (vdouble)_mm_sqrt_pd((__m128d)x);
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	return (vdouble)vsqrtq_f64((float64x2_t)x);
+#else
+	vdouble r;
+	for (int i = 0; i < GEO_LANES; i++)
+		r[i] = sqrt(x[i]);
+	return r;
+#endif
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vsincos
+Function Description: Lane-wise sine and cosine. Cody-Waite reduction by pi/2 then the fdlibm minimax polynomials
+                      on [-pi/4, pi/4]; within 2 ulp of libm for |x| < 1e5 radians
+Input Parameters: x - angles in radians
+Output Parameters: s - sines, c - cosines
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE void vsincos(vdouble x, vdouble *s, vdouble *c) {
+	vdouble kf = x * (2.0 / GEO_PI) + ROUND_MAGIC;
+	vlong q = (vlong)kf & 3;
+	kf = kf - ROUND_MAGIC;
+
+	vdouble r = x - kf * PIO2_1;
+	r = r - kf * PIO2_2;
+	r = r - kf * PIO2_2T;
+	vdouble z = r * r;
+
+	vdouble ps = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 +
+		z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 +
+		z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+	vdouble pc = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 +
+		z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 +
+		z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+
+	//Quadrant 1 and 3 swap sine and cosine, quadrants 2 and 3 negate sine, 1 and 2 negate cosine. The masks are
+	//built with 64-bit subtract and shift, which SSE2 has, rather than 64-bit compares, which it lacks
+	vlong swap = -(q & 1);
+	vdouble sv = vsel(swap, pc, ps);
+	vdouble cv = vsel(swap, ps, pc);
+	*s = (vdouble)((vlong)sv ^ (q & 2) << 62);
+	*c = (vdouble)((vlong)cv ^ ((q + 1) & 2) << 62);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vsin / vcos
+Function Description: Lane-wise sine alone, for kernels that need no cosine of the same angle. Reduced by pi, so
+                      there is one polynomial and a sign flip instead of two polynomials and a quadrant select: the
+                      Taylor series to x^21, whose truncation error on [-pi/2, pi/2] is below 1.2e-18. Cosine is
+                      the sine of pi/2 - x
+Input Parameters: x - angles in radians
+Output Parameters: Sines, or cosines
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vsin(vdouble x) {
+	vdouble kf = x * (1.0 / GEO_PI) + ROUND_MAGIC;
+	vlong odd = ((vlong)kf & 1) << 63;
+	kf = kf - ROUND_MAGIC;
+
+	vdouble r = x - kf * (2.0 * PIO2_1);
+	r = r - kf * (2.0 * PIO2_2);
+	r = r - kf * (2.0 * PIO2_2T);
+	vdouble z = r * r;
+
+	vdouble p = vset(-1.0 / 51090942171709440000.0);
+	p = p * z + 1.0 / 121645100408832000.0;
+	p = p * z - 1.0 / 355687428096000.0;
+	p = p * z + 1.0 / 1307674368000.0;
+	p = p * z - 1.0 / 6227020800.0;
+	p = p * z + 1.0 / 39916800.0;
+	p = p * z - 1.0 / 362880.0;
+	p = p * z + 1.0 / 5040.0;
+	p = p * z - 1.0 / 120.0;
+	p = p * z + 1.0 / 6.0;
+	vdouble sv = r - r * z * p;
+	return (vdouble)((vlong)sv ^ odd);
+}
+
+GEO_INLINE vdouble vcos(vdouble x) {
+	return vsin((PIO2_1 - x) + PIO2_2);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vatan2
+Function Description: Lane-wise atan2. The ratio is reduced to [0, 0.66] as in Cephes atan and evaluated with its
+                      rational approximation; within 2 ulp of libm
+Input Parameters: y, x - coordinates
+Output Parameters: Angles in (-pi, pi]
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vatan2(vdouble y, vdouble x) {
+	vdouble ay = vabs(y), ax = vabs(x);
+	vdouble t = ay / ax;
+
+	vlong big = t > T3P8;
+	vlong mid = (t > 0.66) & ~big;
+	vdouble u = vsel(big, -1.0 / t, vsel(mid, (t - 1.0) / (t + 1.0), t));
+	vdouble base = vsel(big, vset(GEO_PI / 2), vsel(mid, vset(GEO_PI / 4), vset(0.0)));
+	vdouble extra = vsel(big, vset(0.5 * MOREBITS), vsel(mid, vset(0.25 * MOREBITS), vset(0.0)));
+
+	vdouble z = u * u;
+	vdouble p = (((-8.750608600031904122785e-01 * z - 1.615753718733365076637e+01) * z
+		- 7.500855792314704667340e+01) * z - 1.228866684490136173410e+02) * z - 6.485021904942025371773e+01;
+	vdouble q = ((((z + 2.485846490142306297962e+01) * z + 1.650270098316988542046e+02) * z
+		+ 4.328810604912902668951e+02) * z + 4.853903996359136964868e+02) * z + 1.945506571482613964425e+02;
+	vdouble a = base + (u * (z * p / q) + u + extra);
+
+	a = vsel((ay == 0.0) & (ax == 0.0), vset(0.0), a); //atan2(0, 0) = 0, the ratio above was NaN
+	a = vsel(x < 0.0, GEO_PI - a, a);
+	return vcopysign(a, y);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vwrap360
+Function Description: Lane-wise normalisation of an angle in degrees to [0, 360)
+Input Parameters: deg - angles
+Output Parameters: Normalised angles
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vwrap360(vdouble deg) {
+	vdouble k = (deg * (1.0 / 360.0) + ROUND_MAGIC) - ROUND_MAGIC;
+	deg = deg - k * 360.0;
+	deg = vsel(deg < 0.0, deg + 360.0, deg);
+	return vsel(deg >= 360.0, vset(0.0), deg);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vbearing
+Function Description: Lane-wise initial bearing, same well conditioned form as Geo_Bearing
+Input Parameters: sp1 - sine of start latitude, lat1, lat2 - start and end latitudes, dlon - longitude difference,
+                  all in radians
+Output Parameters: Bearings in radians, (-pi, pi]
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vbearing(vdouble sp1, vdouble lat1, vdouble lat2, vdouble dlon) {
+	vdouble cp2 = vcos(lat2), sdp = vsin(lat2 - lat1), sh, ch;
+	vsincos(dlon * 0.5, &sh, &ch);
+	return vatan2(2.0 * sh * ch * cp2, sdp + 2.0 * sp1 * cp2 * sh * sh);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: vhaversine
+Function Description: Lane-wise central angle between two points. cos(lat1) cos(lat2) is taken as
+                      cos^2(mean lat) - sin^2(dlat / 2), so it takes three sines rather than four sines and cosines
+Input Parameters: lat1, lon1, lat2, lon2 - points in radians
+Output Parameters: Central angles in radians
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE vdouble vhaversine(vdouble lat1, vdouble lon1, vdouble lat2, vdouble lon2) {
+	vdouble sp = vsin((lat2 - lat1) * 0.5);
+	vdouble sl = vsin((lon2 - lon1) * 0.5);
+	vdouble cm = vcos((lat1 + lat2) * 0.5);
+	vdouble a = sp * sp + (cm * cm - sp * sp) * sl * sl;
+	a = vsel(a > 1.0, vset(1.0), a);
+	return 2.0 * vatan2(vsqrt(a), vsqrt(1.0 - a));
+}
+
+//Load n <= GEO_LANES values, the tail lanes of a short load are zero
+GEO_INLINE vdouble vload(const double *p, size_t n) {
+	vdouble v = {0};
+	memcpy(&v, p, n * sizeof(double));
+	return v;
+}
+
+GEO_INLINE void vstore(double *p, vdouble v, size_t n) {
+	memcpy(p, &v, n * sizeof(double));
+}
+
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: bearingBlock / distanceBlock / destinationBlock / crossTrackBlock
+Function Description: One vector of each batch kernel, elements i to i+k-1
+Input Parameters: as the batch function, i - first element, k - lanes to load and store (GEO_LANES but at the tail)
+Output Parameters: as the batch function
+/---------------------------------------------------------------------------------------------------------*/
+GEO_INLINE void bearingBlock(const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+	double *out, size_t i, size_t k) {
+	vdouble p1 = vload(lat1 + i, k) * DEG2RAD;
+	vdouble p2 = vload(lat2 + i, k) * DEG2RAD;
+	vdouble dl = (vload(lon2 + i, k) - vload(lon1 + i, k)) * DEG2RAD;
+	vstore(out + i, vwrap360(vbearing(vsin(p1), p1, p2, dl) * RAD2DEG), k);
+}
+
+GEO_INLINE void distanceBlock(const double *lat1, const double *lon1, const double *lat2, const double *lon2,
+	double *out, size_t i, size_t k) {
+	vdouble c = vhaversine(vload(lat1 + i, k) * DEG2RAD, vload(lon1 + i, k) * DEG2RAD,
+		vload(lat2 + i, k) * DEG2RAD, vload(lon2 + i, k) * DEG2RAD);
+	vstore(out + i, c * GEO_EARTH_RADIUS, k);
+}
+
+GEO_INLINE void destinationBlock(const double *lat, const double *lon, const double *bearing, const double *dist,
+	double *lat2, double *lon2, size_t i, size_t k) {
+	vdouble sp1, cp1, st, ct, sd, cd;
+	vsincos(vload(lat + i, k) * DEG2RAD, &sp1, &cp1);
+	vsincos(vload(bearing + i, k) * DEG2RAD, &st, &ct);
+	vsincos(vload(dist + i, k) * (1.0 / GEO_EARTH_RADIUS), &sd, &cd);
+
+	vdouble sp2 = sp1 * cd + cp1 * sd * ct;
+	sp2 = vsel(sp2 > 1.0, vset(1.0), vsel(sp2 < -1.0, vset(-1.0), sp2));
+	vdouble p2 = vatan2(sp2, vsqrt(1.0 - sp2 * sp2)); //asin
+	vdouble dl = vatan2(st * sd * cp1, cd - sp1 * sp2);
+
+	vstore(lat2 + i, p2 * RAD2DEG, k);
+	vstore(lon2 + i, vwrap360(vload(lon + i, k) + dl * RAD2DEG + 180.0) - 180.0, k);
+}
+
+GEO_INLINE void crossTrackBlock(vdouble p1, vdouble l1, vdouble sp1, double t12, const double *lat3,
+	const double *lon3, double *out, size_t i, size_t k) {
+	vdouble p3 = vload(lat3 + i, k) * DEG2RAD;
+	vdouble l3 = vload(lon3 + i, k) * DEG2RAD;
+
+	vdouble d13 = vhaversine(p1, l1, p3, l3);
+	vdouble t13 = vbearing(sp1, p1, p3, l3 - l1);
+	vdouble x = vsin(d13) * vsin(t13 - t12);
+	vstore(out + i, vatan2(x, vsqrt(1.0 - x * x)) * GEO_EARTH_RADIUS, k); //asin
+}
+
+//Runs block over 0 to n-1: GEO_UNROLL whole vectors per pass, then the tail one vector at a time
+#define GEO_BATCH(n, block, ...) do { \
+		size_t i_ = 0; \
+		for (; i_ + GEO_UNROLL * GEO_LANES <= (n); i_ += GEO_UNROLL * GEO_LANES) \
+			for (int u_ = 0; u_ < GEO_UNROLL; u_++) \
+				block(__VA_ARGS__, i_ + u_ * GEO_LANES, GEO_LANES); \
+		for (; i_ < (n); i_ += GEO_LANES) \
+			block(__VA_ARGS__, i_, (n) - i_ < GEO_LANES ? (n) - i_ : GEO_LANES); \
+	} while (0)
+
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_BearingBatch
+Function Description: Initial bearings for n point pairs
+Input Parameters: lat1, lon1 - starts, lat2, lon2 - ends, n - number of pairs
+Output Parameters: out - bearings in [0, 360)
+/---------------------------------------------------------------------------------------------------------*/
+void Geo_BearingBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *out, size_t n) {
+	GEO_BATCH(n, bearingBlock, lat1, lon1, lat2, lon2, out);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_DistanceBatch
+Function Description: Haversine distances for n point pairs
+Input Parameters: lat1, lon1 - starts, lat2, lon2 - ends, n - number of pairs
+Output Parameters: out - distances in metres
+/---------------------------------------------------------------------------------------------------------*/
+void Geo_DistanceBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *out, size_t n) {
+	GEO_BATCH(n, distanceBlock, lat1, lon1, lat2, lon2, out);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_DestinationBatch
+Function Description: Destination points for n starts, bearings and distances
+Input Parameters: lat, lon - starts, bearing - initial bearings, dist - distances in metres, n - number of points
+Output Parameters: lat2, lon2 - destinations, longitudes in [-180, 180)
+/---------------------------------------------------------------------------------------------------------*/
+void Geo_DestinationBatch(const double *lat, const double *lon, const double *bearing, const double *dist,
+	double *lat2, double *lon2, size_t n) {
+	GEO_BATCH(n, destinationBlock, lat, lon, bearing, dist, lat2, lon2);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Geo_CrossTrackBatch
+Function Description: Cross-track distances of n points from one path, the path's own terms are computed once
+Input Parameters: lat1, lon1 - path start, lat2, lon2 - path end, lat3, lon3 - points, n - number of points
+Output Parameters: out - distances in metres, positive right of the path
+/---------------------------------------------------------------------------------------------------------*/
+void Geo_CrossTrackBatch(double lat1, double lon1, double lat2, double lon2, const double *lat3, const double *lon3,
+	double *out, size_t n) {
+	double t12 = Geo_Bearing(lat1, lon1, lat2, lon2) * DEG2RAD;
+	vdouble p1 = vset(lat1 * DEG2RAD), l1 = vset(lon1 * DEG2RAD);
+	GEO_BATCH(n, crossTrackBlock, p1, l1, vsin(p1), t12, lat3, lon3, out);
+}
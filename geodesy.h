@@ -0,0 +1,45 @@
+#ifndef GEODESY_h_
+#define GEODESY_h_
+
+#include <stddef.h>
+
+  /* Spherical earth geodesy. All angles are degrees, all distances metres.
+
+    The scalar functions use libm. The batch functions take struct-of-arrays inputs and run on SIMD lanes
+    (AVX: 4 doubles, SSE2 and AArch64 NEON: 2 doubles; elsewhere the same code is lowered to scalar
+    instructions) with their own sin/cos/atan2 polynomials, four vectors per loop pass. Against the scalar functions
+    the batch results are accurate to:
+
+      Geo_BearingBatch      |error| <= 1e-13 degrees
+      Geo_DistanceBatch     |error| <= 2e-8 m
+      Geo_DestinationBatch  |error| <= 1e-11 degrees for |lat| <= 80, longitude degrades to 1e-7 degrees at 89.9
+      Geo_CrossTrackBatch   |error| <= 1e-8 m for points within 1000 km of the path start
+
+    as measured by tools/geo_bench.c over 2 million random pairs at separations from 1 mm to 2000 km. The spherical
+    model itself is within 0.5% of the WGS84 ellipsoid, which dwarfs the numerical error.
+   */
+
+#define GEO_PI           3.14159265358979323846
+#define GEO_EARTH_RADIUS 6371008.8  //Mean earth radius (m)
+
+//Initial great-circle bearing from point 1 to point 2, in [0, 360)
+double Geo_Bearing(double lat1, double lon1, double lat2, double lon2);
+
+//Haversine distance between two points
+double Geo_Distance(double lat1, double lon1, double lat2, double lon2);
+
+//Point reached by travelling dist metres from lat, lon on an initial bearing
+void Geo_Destination(double lat, double lon, double bearing, double dist, double *lat2, double *lon2);
+
+//Signed distance of point 3 from the great circle through points 1 and 2, positive to the right
+double Geo_CrossTrack(double lat1, double lon1, double lat2, double lon2, double lat3, double lon3);
+
+//Batch versions over n elements. Output arrays may not alias inputs
+void Geo_BearingBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *out, size_t n);
+void Geo_DistanceBatch(const double *lat1, const double *lon1, const double *lat2, const double *lon2, double *out, size_t n);
+void Geo_DestinationBatch(const double *lat, const double *lon, const double *bearing, const double *dist,
+	double *lat2, double *lon2, size_t n);
+void Geo_CrossTrackBatch(double lat1, double lon1, double lat2, double lon2, const double *lat3, const double *lon3,
+	double *out, size_t n);
+
+#endif
@@ -0,0 +1,127 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: gps_fix.c
+Source Description: Publishes GPS events as one consistent snapshot and lets the control thread sleep until it changes
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include "gps_fix.h"
+
+static pthread_mutex_t fixLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fixCond;
+static GPSFix latest;	//Guarded by fixLock
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: GPSFix_NowNs
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+uint64_t GPSFix_NowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: publish
+Function Description: Bumps the sequence number and wakes the control thread. Must be called with fixLock held
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void publish(void) {
+	latest.seq++;
+	latest.rxNs = GPSFix_NowNs();
+	pthread_cond_broadcast(&fixCond);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: GPSFix_SetPosition
+Function Description: Publishes a position event. Position, GPS time and fix state are captured together
+Input Parameters: lat, lon - reported position, timeMs - GPS time of day, fixState - fix state,
+                  haveTime - 0 if the GPS time could not be read (the previous time is kept)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void GPSFix_SetPosition(double lat, double lon, uint32_t timeMs, int fixState, int haveTime) {
+	pthread_mutex_lock(&fixLock);
+	latest.lat = lat;
+	latest.lon = lon;
+	latest.fixState = fixState;
+	if (haveTime)
+		latest.timeMs = timeMs;
+	publish();
+	latest.posRxNs = latest.rxNs;
+	pthread_mutex_unlock(&fixLock);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: GPSFix_SetHeading
+Function Description: Publishes a heading event
+Input Parameters: head, speed - reported course over ground and velocity
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void GPSFix_SetHeading(double head, double speed) {
+	pthread_mutex_lock(&fixLock);
+	latest.head = head;
+	latest.speed = speed;
+	publish();
+	pthread_mutex_unlock(&fixLock);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: GPSFix_SetFixState
+Function Description: Publishes a fix state change so the control thread can react to losing the fix straight away
+Input Parameters: fixState - new fix state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void GPSFix_SetFixState(int fixState) {
+	pthread_mutex_lock(&fixLock);
+	latest.fixState = fixState;
+	publish();
+	pthread_mutex_unlock(&fixLock);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: GPSFix_Init
+Function Description: Sets up the snapshot mailbox. The condition variable waits on the monotonic clock so 
+                      timeouts are not affected by the GPS setting the system time
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void GPSFix_Init(void) {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&fixCond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: GPSFix_Wait
+Function Description: Sleeps until a snapshot newer than lastSeq exists, then copies it out under the lock
+Input Parameters: out - snapshot to fill, lastSeq - sequence number already consumed, timeoutMs - maximum wait
+Output Parameters: 1 if a new snapshot was copied, 0 on timeout
+/---------------------------------------------------------------------------------------------------------*/
+int GPSFix_Wait(GPSFix *out, uint32_t lastSeq, int timeoutMs) {
+	struct timespec deadline;
+	int rc = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeoutMs / 1000;
+	deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&fixLock);
+	while (latest.seq == lastSeq && rc != ETIMEDOUT)
+		rc = pthread_cond_timedwait(&fixCond, &fixLock, &deadline);
+	int fresh = (latest.seq != lastSeq);
+	if (fresh)
+		*out = latest;
+	pthread_mutex_unlock(&fixLock);
+
+	return fresh;
+}
@@ -0,0 +1,33 @@
+#ifndef GPS_FIX_h_
+#define GPS_FIX_h_
+
+#include <stdint.h>
+
+//One consistent GPS snapshot handed from the GPS event thread to the control thread
+typedef struct {
+	double lat;         //Latitude (degrees)
+	double lon;         //Longitude (degrees)
+	double head;        //Heading (degrees)
+	double speed;       //Velocity reported with the heading (km/h)
+	uint32_t timeMs;    //GPS time of day (ms since UTC midnight)
+	int fixState;       //Position fix state (1 = fix)
+	uint32_t seq;       //Incremented every time a handler publishes new data
+	uint64_t rxNs;      //Monotonic time the newest field arrived
+	uint64_t posRxNs;   //Monotonic time the newest position arrived, heading and fix state events leave it
+} GPSFix;
+
+//Snapshot mailbox initialisation function
+void GPSFix_Init(void);
+
+//Publish functions, called from the GPS backend's event handlers
+void GPSFix_SetPosition(double lat, double lon, uint32_t timeMs, int fixState, int haveTime);
+void GPSFix_SetHeading(double head, double speed);
+void GPSFix_SetFixState(int fixState);
+
+//Block until a snapshot newer than lastSeq is published, or timeoutMs elapses
+int GPSFix_Wait(GPSFix *out, uint32_t lastSeq, int timeoutMs);
+
+//Monotonic clock in nanoseconds
+uint64_t GPSFix_NowNs(void);
+
+#endif
@@ -0,0 +1,390 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: gps_log.c
+Source Description: Asynchronous position logger. The control thread drops records into a lock-free ring and 
+                    a writer thread packs them into aligned blocks, so SD card stalls never reach the motors
+/---------------------------------------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "gps_log.h"
+#include "track.h"
+#include "fmt.h"
+
+  /* Data path
+
+    control thread --Log_Write--> ring[LOG_RING_SIZE] --writer thread--> block[LOG_BLOCK_SIZE] --pwrite--> file
+
+    The file offset of every write is a multiple of 4096. A block is written once it is full, and the part of the
+    current block that changed since the last write is rewritten (page aligned) every LOG_SYNC_MS before fdatasync.
+
+    In track format every LOG_BLOCK_SIZE block is one track block, so its header page is rewritten as well.
+   */
+
+#define LOG_PAGE 4096
+
+static LogRecord ring[LOG_RING_SIZE];
+static _Atomic uint32_t ringHead;   //Next slot the control thread fills
+static _Atomic uint32_t ringTail;   //Next slot the writer thread drains
+
+static _Atomic uint64_t statWritten, statDropped, statFlushes, statSyncs;
+static _Atomic uint64_t statFlushMax, statFlushTotal, statSyncMax, statErrors;
+
+static int logFd = -1;
+static char *block;                 //Aligned block buffer, owned by the writer thread
+static size_t blockFill;            //Bytes used in the current block
+static size_t blockWritten;         //Bytes of the current block already on the card
+static off_t blockOffset;           //File offset of the current block
+static off_t preallocEnd;           //End of the reserved region
+static int trackFormat;             //Binary track instead of CSV text
+static TrackBlock trk;              //Track encoder over the block buffer
+static pthread_t writer;
+static atomic_int running;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: atomicMax
+Function Description: Raises a counter to value if it is larger
+Input Parameters: counter - the maximum to update, value - new sample
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void atomicMax(_Atomic uint64_t *counter, uint64_t value) {
+	uint64_t old = atomic_load_explicit(counter, memory_order_relaxed);
+	while (value > old && !atomic_compare_exchange_weak_explicit(counter, &old, value, memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: preallocate
+Function Description: Reserves card space ahead of the write position without changing the visible file size,
+                      so the filesystem does not allocate (and update metadata) on every block
+Input Parameters: upTo - file offset that must be reserved
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void preallocate(off_t upTo) {
+	if (upTo <= preallocEnd)
+		return;
+#ifdef FALLOC_FL_KEEP_SIZE
+	if (fallocate(logFd, FALLOC_FL_KEEP_SIZE, preallocEnd, LOG_PREALLOC_SIZE) == 0) {
+		preallocEnd += LOG_PREALLOC_SIZE;
+		return;
+	}
+#endif
+	preallocEnd = upTo + LOG_PREALLOC_SIZE; //Filesystem can't reserve, don't retry for a while
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: writeRange
+Function Description: Writes part of the current block to its place in the file and records the latency
+Input Parameters: start, end - byte range of the block buffer
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void writeRange(size_t start, size_t end) {
+	uint64_t t0 = nowNs();
+	ssize_t n = pwrite(logFd, block + start, end - start, blockOffset + (off_t)start);
+	uint64_t dt = nowNs() - t0;
+
+	if (n != (ssize_t)(end - start))
+		atomic_fetch_add_explicit(&statErrors, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&statFlushes, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&statFlushTotal, dt, memory_order_relaxed);
+	atomicMax(&statFlushMax, dt);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: writeBlock
+Function Description: Writes the unwritten part of the current block, starting from the page it begins in.
+                      A track block's header changes with every point, so its first page is rewritten too
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void writeBlock(void) {
+	if (blockFill == blockWritten)
+		return;
+
+	size_t start = blockWritten & ~(size_t)(LOG_PAGE - 1);
+	if (trackFormat) {
+		Track_BlockFinish(&trk, LOG_BLOCK_SIZE);
+		if (start > 0)
+			writeRange(0, LOG_PAGE);
+	}
+	writeRange(start, blockFill);
+	blockWritten = blockFill;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nextBlock
+Function Description: Writes out the current block and starts the next one
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void nextBlock(void) {
+	writeBlock();
+	blockOffset += LOG_BLOCK_SIZE;
+	blockFill = 0;
+	blockWritten = 0;
+	preallocate(blockOffset + LOG_BLOCK_SIZE);
+	if (trackFormat) {
+		Track_BlockInit(&trk, (uint8_t *)block, LOG_BLOCK_SIZE);
+		blockFill = trk.len;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: appendBytes
+Function Description: Copies bytes into the block buffer, writing and recycling the block each time it fills
+Input Parameters: data, len - bytes to append
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void appendBytes(const char *data, size_t len) {
+	while (len > 0) {
+		size_t room = LOG_BLOCK_SIZE - blockFill;
+		size_t n = len < room ? len : room;
+		memcpy(block + blockFill, data, n);
+		blockFill += n;
+		data += n;
+		len -= n;
+
+		if (blockFill == LOG_BLOCK_SIZE)
+			nextBlock();
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: syncFile
+Function Description: Writes whatever is pending and forces it onto the card
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void syncFile(void) {
+	writeBlock();
+
+	uint64_t t0 = nowNs();
+	if (fdatasync(logFd) != 0)
+		atomic_fetch_add_explicit(&statErrors, 1, memory_order_relaxed);
+	atomicMax(&statSyncMax, nowNs() - t0);
+	atomic_fetch_add_explicit(&statSyncs, 1, memory_order_relaxed);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: appendPoint
+Function Description: Delta encodes a record into the current track block, starting a new block when it is full
+Input Parameters: rec - record to encode
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void appendPoint(const LogRecord *rec) {
+	TrackPoint pt = {rec->lat, rec->lon, rec->head, rec->timeMs, rec->fixState};
+
+	if (Track_BlockAppend(&trk, &pt) != 0) {
+		blockFill = trk.len;
+		nextBlock();
+		Track_BlockAppend(&trk, &pt);
+	}
+	blockFill = trk.len;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: drainRing
+Function Description: Formats every queued record into the block buffer
+Input Parameters: N/A
+Output Parameters: Number of records drained
+/---------------------------------------------------------------------------------------------------------*/
+static uint32_t drainRing(void) {
+	uint32_t tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&ringHead, memory_order_acquire);
+	char line[2 * FMT_DOUBLE_MAX + 2];
+
+	for (uint32_t i = tail; i != head; i++) {
+		const LogRecord *rec = &ring[i & (LOG_RING_SIZE - 1)];
+		if (trackFormat) {
+			appendPoint(rec);
+			continue;
+		}
+		char *end = Fmt_Double(line, rec->lat, 9, 7);
+		*end++ = ',';
+		end = Fmt_Double(end, rec->lon, 9, 7);
+		*end++ = '\n';
+		appendBytes(line, (size_t)(end - line));
+	}
+
+	atomic_store_explicit(&ringTail, head, memory_order_release);
+	atomic_fetch_add_explicit(&statWritten, head - tail, memory_order_relaxed);
+	return head - tail;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: writerThread
+Function Description: Drains the ring every LOG_DRAIN_MS and syncs every LOG_SYNC_MS until the logger is closed
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *writerThread(void *arg) {
+	struct timespec drain = {0, LOG_DRAIN_MS * 1000000L};
+	uint64_t lastSync = nowNs();
+
+	while (atomic_load(&running)) {
+		nanosleep(&drain, NULL);
+		drainRing();
+		if (nowNs() - lastSync >= LOG_SYNC_MS * 1000000ull) {
+			syncFile();
+			lastSync = nowNs();
+		}
+	}
+
+	drainRing();
+	if (!trackFormat || trk.count > 0)
+		syncFile();
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: openLog
+Function Description: Creates the log file, reserves space for it, queues the header and starts the writer
+Input Parameters: filename - file to create, header - CSV text written before the first record (may be NULL),
+                  track - 1 to write the binary track format
+Output Parameters: 0 on success, -1 if the file or buffer could not be created
+/---------------------------------------------------------------------------------------------------------*/
+static int openLog(const char *filename, const char *header, int track) {
+	logFd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (logFd < 0) {
+		printf("Log open failed! -- No logging...\n");
+		return -1;
+	}
+	if (posix_memalign((void **)&block, LOG_PAGE, LOG_BLOCK_SIZE) != 0) {
+		close(logFd);
+		logFd = -1;
+		return -1;
+	}
+
+	trackFormat = track;
+	blockFill = blockWritten = 0;
+	blockOffset = preallocEnd = 0;
+	preallocate(LOG_BLOCK_SIZE);
+	if (trackFormat) {
+		Track_BlockInit(&trk, (uint8_t *)block, LOG_BLOCK_SIZE);
+		blockFill = trk.len;
+	} else if (header) {
+		appendBytes(header, strlen(header));
+	}
+
+	atomic_store(&ringHead, 0);
+	atomic_store(&ringTail, 0);
+	atomic_store(&running, 1);
+	if (pthread_create(&writer, NULL, writerThread, NULL) != 0) {
+		atomic_store(&running, 0);
+		close(logFd);
+		logFd = -1;
+		free(block);
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Log_Open
+Function Description: Starts a CSV log in the rover's "%9.7f,%9.7f" format
+Input Parameters: filename - file to create, header - text written before the first record (may be NULL)
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int Log_Open(const char *filename, const char *header) {
+	return openLog(filename, header, 0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Log_OpenTrack
+Function Description: Starts a log in the native binary track format (see track.h)
+Input Parameters: filename - file to create
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int Log_OpenTrack(const char *filename) {
+	return openLog(filename, NULL, 1);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Log_Write
+Function Description: Copies a record into the ring. Never blocks; if the writer has fallen a full ring behind the
+                      record is counted as dropped instead
+Input Parameters: rec - record to queue
+Output Parameters: 0 if queued, -1 if dropped
+/---------------------------------------------------------------------------------------------------------*/
+int Log_Write(const LogRecord *rec) {
+	uint32_t head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ringTail, memory_order_acquire);
+
+	if (logFd < 0 || head - tail >= LOG_RING_SIZE) {
+		atomic_fetch_add_explicit(&statDropped, 1, memory_order_relaxed);
+		return -1;
+	}
+	ring[head & (LOG_RING_SIZE - 1)] = *rec;
+	atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Log_Close
+Function Description: Stops the writer thread once everything queued is on the card, then closes the file
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Log_Close(void) {
+	if (logFd < 0)
+		return;
+
+	atomic_store(&running, 0);
+	pthread_join(writer, NULL);
+	close(logFd);
+	logFd = -1;
+	free(block);
+	block = NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Log_GetStats
+Function Description: Copies the logger counters
+Input Parameters: stats - structure to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Log_GetStats(LogStats *stats) {
+	stats->written = atomic_load_explicit(&statWritten, memory_order_relaxed);
+	stats->dropped = atomic_load_explicit(&statDropped, memory_order_relaxed);
+	stats->flushes = atomic_load_explicit(&statFlushes, memory_order_relaxed);
+	stats->syncs = atomic_load_explicit(&statSyncs, memory_order_relaxed);
+	stats->flushMaxNs = atomic_load_explicit(&statFlushMax, memory_order_relaxed);
+	stats->flushTotalNs = atomic_load_explicit(&statFlushTotal, memory_order_relaxed);
+	stats->syncMaxNs = atomic_load_explicit(&statSyncMax, memory_order_relaxed);
+	stats->errors = atomic_load_explicit(&statErrors, memory_order_relaxed);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Log_PrintStats
+Function Description: Prints the logger counters
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Log_PrintStats(void) {
+	LogStats s;
+	Log_GetStats(&s);
+
+	printf("Log: %llu records, %llu dropped, %llu errors\n",
+		(unsigned long long)s.written, (unsigned long long)s.dropped, (unsigned long long)s.errors);
+	printf("Log: %llu writes (avg %.3f ms, max %.3f ms), %llu syncs (max %.3f ms)\n",
+		(unsigned long long)s.flushes, s.flushes ? s.flushTotalNs / 1e6 / s.flushes : 0.0, s.flushMaxNs / 1e6,
+		(unsigned long long)s.syncs, s.syncMaxNs / 1e6);
+}
@@ -0,0 +1,52 @@
+#ifndef GPS_LOG_h_
+#define GPS_LOG_h_
+
+#include <stdint.h>
+
+//One position record handed from the control thread to the writer thread
+typedef struct {
+	double lat;         //Latitude (degrees)
+	double lon;         //Longitude (degrees)
+	double head;        //Heading (degrees)
+	uint32_t timeMs;    //GPS time of day (ms since UTC midnight)
+	int32_t fixState;   //Position fix state
+} LogRecord;
+
+//Logger counters, safe to read while the logger is running
+typedef struct {
+	uint64_t written;       //Records formatted into the file
+	uint64_t dropped;       //Records rejected because the ring was full
+	uint64_t flushes;       //Block writes issued
+	uint64_t syncs;         //fdatasync calls issued
+	uint64_t flushMaxNs;    //Slowest block write
+	uint64_t flushTotalNs;  //Sum of all block write times
+	uint64_t syncMaxNs;     //Slowest fdatasync
+	uint64_t errors;        //Failed writes or syncs
+} LogStats;
+
+//Logger tuning
+#define LOG_RING_SIZE     4096          //Records buffered between control and writer thread (power of 2)
+#define LOG_BLOCK_SIZE    (64 * 1024)   //Bytes per aligned block write
+#define LOG_PREALLOC_SIZE (4 * 1024 * 1024) //Bytes reserved on the card ahead of the write position
+#define LOG_SYNC_MS       1000          //Longest time a record can sit unsynced
+#define LOG_DRAIN_MS      20            //Writer thread wake interval
+
+//Create the log file, write the header text and start the writer thread
+int Log_Open(const char *filename, const char *header);
+
+//Create a binary track log (see track.h) and start the writer thread
+int Log_OpenTrack(const char *filename);
+
+//Queue a record without blocking. Returns 0 if queued, -1 if dropped
+int Log_Write(const LogRecord *rec);
+
+//Drain the ring, sync the file and stop the writer thread
+void Log_Close(void);
+
+//Copy the current counters
+void Log_GetStats(LogStats *stats);
+
+//Print the counters to the terminal
+void Log_PrintStats(void);
+
+#endif
@@ -3,9 +3,13 @@ Source Name: gps_motors.c
 Source Description: Functions to drive the motors in various diractions
 /---------------------------------------------------------------------------------------------------------*/
 
-#include <wiringPi.h>
-#include <softPwm.h>
+#include <stdio.h>
+#include <time.h>
+#include "hal.h"
+#include "pwm_engine.h"
+#include "motor_ctrl.h"
 #include "gps_motors.h"
+#include "prof.h"
 
   /* motor driver truth table
    
@@ -15,25 +19,78 @@ Source Description: Functions to drive the motors in various diractions
      0    |    1   |    1   | Motor clockwise
      1    |    0   |    1   | Motor anti-clockwise
      1    |    1   |    1   | Motor off
+
+    Every function below is a wheel command for the motor controller (motor_ctrl.c), which ramps toward it and
+    only writes the pins and duties that change. Positive commands are forwards (0 1), negative backwards (1 0).
    */
 
+static MotorCtrl motors;
+static uint64_t lastTickNs;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nowNs(void){
+
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Motors_Update
+Function Description: Advances the motor ramps by the time since the last update and writes any changes. Called
+                      by every drive function, and may be called on its own each control tick to finish a ramp
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Motors_Update(void){
+
+ uint64_t now = nowNs();
+ MotorCtrl_Tick (&motors, (now - lastTickNs) / 1e9);
+ lastTickNs = now;
+ PROF_ADD (PROF_GPIO, nowNs() - now);
+
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Motors_Drive
+Function Description: Continuous drive command for both wheels
+Input Parameters: left, right - wheel commands in [-100, 100], negative drives the wheel backwards
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Motors_Drive(int left, int right){
+
+ MotorCtrl_Command (&motors, left, right);
+ Motors_Update ();
+
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Motors_SetLimits
+Function Description: Sets the ramp limits applied to every drive command
+Input Parameters: accel - % duty per second, maxStep - % duty per update (0 = unlimited)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Motors_SetLimits(double accel, double maxStep){
+
+ MotorCtrl_SetLimits (&motors, accel, maxStep);
+
+}
+
 /*---------------------------------------------------------------------------------------------------------/
 Function Name: Motors_Disable
-Function Description: Disables the motor enable pins
+Function Description: Disables the motor enable pins immediately, without ramping
 Input Parameters: N/A
 Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Motors_Disable(){
 
- //Left Motor Off
- digitalWrite (L_Dir1, LOW); 
- digitalWrite (L_Dir2, LOW);
- softPwmWrite (L_En, 0);	//PWM enable Off
-
- //Right Motor Off
- digitalWrite (R_Dir1, LOW);
- digitalWrite (R_Dir2, LOW);
- softPwmWrite (R_En, 0);	//PWM enable off
+ MotorCtrl_Stop (&motors); //Direction pins low, PWM enables off
 
 }
 
@@ -45,15 +102,7 @@ Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Forwards(int intensity){
 
- //Left Motor Forwards
- digitalWrite (L_Dir1, LOW);
- digitalWrite (L_Dir2, HIGH);
- softPwmWrite (L_En, intensity); //PWM enable @ 'intensity'%
-
- //Right Motor Forwards
- digitalWrite (R_Dir1, LOW);
- digitalWrite (R_Dir2, HIGH);
- softPwmWrite (R_En, intensity); //PWM enable @ 'intensity'%
+ Motors_Drive (intensity, intensity); //Left and Right Motor Forwards @ 'intensity'%
 
 }
 
@@ -65,15 +114,7 @@ Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Backwards(int intensity){
 
- //Left Motor Backwards
- digitalWrite (L_Dir1, HIGH);
- digitalWrite (L_Dir2, LOW);
- softPwmWrite (L_En, intensity); //PWM enable @ 'intensity'%
-
- //Right Motor Backwards
- digitalWrite (R_Dir1, HIGH);
- digitalWrite (R_Dir2, LOW);
- softPwmWrite (R_En, intensity); //PWM enable @ 'intensity'%
+ Motors_Drive (-intensity, -intensity); //Left and Right Motor Backwards @ 'intensity'%
 
 }
 
@@ -85,15 +126,7 @@ Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Hard_Left(){
 
- //Left Motor Forwards
- digitalWrite (L_Dir1, LOW);
- digitalWrite (L_Dir2, HIGH);
- softPwmWrite (L_En, 100); //PWM enable @ 100%
-
- //Right Motor Backwards
- digitalWrite (R_Dir1, HIGH);
- digitalWrite (R_Dir2, LOW);
- softPwmWrite (R_En, 100); //PWM enable @ 100%
+ Motors_Drive (100, -100); //Left Motor Forwards, Right Motor Backwards @ 100%
 
 }
 
@@ -105,15 +138,7 @@ Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Hard_Right(){
 
- //Left Motor Backwards
- digitalWrite (L_Dir1, HIGH);
- digitalWrite (L_Dir2, LOW);
- softPwmWrite (L_En, 100); //PWM enable @ 100%
-
- //Right Motor Forwards
- digitalWrite (R_Dir1, LOW);
- digitalWrite (R_Dir2, HIGH);
- softPwmWrite (R_En, 100); //PWM enable @ 100%
+ Motors_Drive (-100, 100); //Left Motor Backwards, Right Motor Forwards @ 100%
 
 }
 
@@ -125,15 +150,32 @@ Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Smooth_Turn(int intensityL, int intensityR){
 
- //Left Motor Forwards
- digitalWrite (L_Dir1, LOW);
- digitalWrite (L_Dir2, HIGH);
- softPwmWrite (L_En, intensityL); //PWM enable @ 'intensityL'%
+ Motors_Drive (intensityL, intensityR); //Left and Right Motor Forwards @ 'intensityL'%, 'intensityR'%
 
- //Right Motor Forwards
- digitalWrite (R_Dir1, LOW);
- digitalWrite (R_Dir2, HIGH);
- softPwmWrite (R_En, intensityR); //PWM enable @ 'intensityR'%
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Motors_PrintStats
+Function Description: Prints how many GPIO writes the motor controller issued and how many it avoided
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Motors_PrintStats(void){
+
+ printf("Motors: %lu GPIO writes, %lu skipped as unchanged\n", motors.gpioWrites, motors.gpioSkipped);
+
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Motors_GetDuties
+Function Description: Reads the wheel duties currently applied, part way through any ramp, for the state estimator
+Input Parameters: left, right - duties out [-100, 100]
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Motors_GetDuties(double *left, double *right){
+
+ *left = motors.cmdL;
+ *right = motors.cmdR;
 
 }
 
@@ -145,15 +187,22 @@ Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void Motors_Init(void){
   	
-  wiringPiSetup (); //Initialises wiringPi pin mapping
+  static const MotorPins pins = {L_Dir1, L_Dir2, L_En, R_Dir1, R_Dir2, R_En};
+
+  HAL_Setup (); //Initialises wiringPi pin mapping
   
-  pinMode (L_Dir1, OUTPUT); //Left Motor Drive 1
-  pinMode (L_Dir2, OUTPUT); //Left Motor 1 Drive 2
-  softPwmCreate(L_En, 0, 100); //Left Motor 1 Enable
+  HAL_PinMode (L_Dir1); //Left Motor Drive 1
+  HAL_PinMode (L_Dir2); //Left Motor 1 Drive 2
+  PWM_AddChannel(L_En, 0); //Left Motor 1 Enable
   
-  pinMode (R_Dir1, OUTPUT); //Right Motor 2 Drive 1
-  pinMode (R_Dir2, OUTPUT); //Right Motor 2 Drive 2
-  softPwmCreate(R_En, 0, 100); //Left Motor 1 Enable
+  HAL_PinMode (R_Dir1); //Right Motor 2 Drive 1
+  HAL_PinMode (R_Dir2); //Right Motor 2 Drive 2
+  PWM_AddChannel(R_En, 0); //Left Motor 1 Enable
+  
+  PWM_Init(PWM_DEFAULT_FREQ, 100); //One PWM thread for both enable pins, 0-100% duty
+
+  MotorCtrl_Init(&motors, &pins, MOTOR_DEFAULT_ACCEL, MOTOR_DEFAULT_STEP); //Starts stopped
+  lastTickNs = nowNs();
   
 /*------------------------------------MOTOR TEST FUNCTION-------------------------------------------------*/
   /* while(1){
@@ -176,4 +225,3 @@ void Motors_Init(void){
   
   */
 }
-
@@ -16,6 +16,11 @@ void Motors_Init(void);
 
 //Motor control functions
 void Motors_Disable();
+void Motors_Drive(int left, int right);
+void Motors_Update(void);
+void Motors_SetLimits(double accel, double maxStep);
+void Motors_PrintStats(void);
+void Motors_GetDuties(double *left, double *right);
 void Forwards(int intensity);
 void Backwards(int intensity);
 void Hard_Left();
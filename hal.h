@@ -0,0 +1,88 @@
+#ifndef HAL_h_
+#define HAL_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gps_fix.h"
+
+  /* Hardware abstraction layer
+
+    Build with -DHAL_MOCK to replace wiringPi and phidget22 with in-process mocks (hal_mock.c) that record every
+    pin write (including every PWM edge from pwm_engine.c) and serve scripted GPS fixes, so the rover code runs on any Linux box. Without it the GPIO
+    calls below are plain macros onto wiringPi, so the hardware build has no extra calls at all, and the GPS
+    calls are implemented on phidget22 in hal_phidget.c.
+   */
+
+#ifdef HAL_MOCK
+
+#define LOW    0
+#define HIGH   1
+#define OUTPUT 1
+
+#define HAL_MOCK_PINS  64        //Highest pin number the mock tracks
+#define HAL_MOCK_LOG   65536     //Writes kept in the mock's write log (oldest are overwritten)
+
+//One recorded GPIO write
+typedef struct {
+	uint64_t tNs;       //Monotonic time of the write
+	int32_t pin;
+	int32_t value;      //Level written
+} HALWrite;
+
+//Mock GPIO functions
+int HAL_Setup(void);
+void HAL_PinMode(int pin);
+void HAL_DigitalWrite(int pin, int value);
+
+//Inspect the mock: current pin level, total writes seen, and the recorded write log (oldest first)
+int HALMock_PinValue(int pin);
+uint64_t HALMock_WriteCount(void);
+size_t HALMock_GetWrites(HALWrite *out, size_t max);
+int HALMock_SaveWrites(const char *path);
+void HALMock_Reset(void);
+
+//Script the mock GPS from an array of fixes or a CSV/GPX/track file, replayed at rateHz when the fixes carry no time
+void HALMock_SetScript(const GPSFix *fixes, size_t count, double rateHz);
+int HALMock_LoadScript(const char *path, double rateHz);
+
+//Simulate slow enumeration and unplugging: the mock GPS attaches delayMs after HAL_GPS_Open, and is detached for
+//lenMs from atMs after attaching (fixes due meanwhile are dropped). With leadMs it re-attaches sending the fix state
+//and heading first, and no position for leadMs more. Call before HAL_GPS_Open
+#define HAL_MOCK_OUTAGES 8
+void HALMock_SetAttachDelay(uint32_t delayMs);
+int HALMock_AddOutage(uint32_t atMs, uint32_t lenMs, uint32_t leadMs);
+
+#else
+
+#include <wiringPi.h>
+
+#define HAL_Setup()                     wiringPiSetup()
+#define HAL_PinMode(pin)                pinMode((pin), OUTPUT)
+#define HAL_DigitalWrite(pin, value)    digitalWrite((pin), (value))
+
+#endif
+
+//Attach and detach events: any device seen by the device manager, and the GPS channel itself. Both are called on
+//the backend's event thread
+typedef void (*HALDeviceFn)(int serial, const char *name, int attached);
+typedef void (*HALChannelFn)(int attached);
+
+//Start reporting device attach and detach (PhidgetManager). Devices already present are reported at once
+int HAL_Devices_Open(HALDeviceFn fn);
+void HAL_Devices_Close(void);
+
+//Report the GPS channel attaching and detaching. Call before HAL_GPS_Open
+void HAL_GPS_SetAttachHandler(HALChannelFn fn);
+
+//Open the GPS. With events set, fixes are published to the gps_fix mailbox as they arrive (GPSFix_Wait). With a
+//timeout of 0 it returns at once and the channel attaches whenever the device appears, and again after every
+//re-plug
+int HAL_GPS_Open(int serial, int events, int timeoutMs);
+
+//Read the current GPS state with the getters (polling mode)
+void HAL_GPS_Poll(GPSFix *out);
+
+//Close the GPS
+void HAL_GPS_Close(void);
+
+#endif
@@ -0,0 +1,400 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: hal_mock.c
+Source Description: Headless mock backend of the hardware abstraction layer. Records GPIO writes with 
+                    time stamps and serves scripted GPS fixes, so the rover code runs without a Pi or a GPS
+/---------------------------------------------------------------------------------------------------------*/
+
+#ifdef HAL_MOCK
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "hal.h"
+#include "track_io.h"
+
+static atomic_int pinValue[HAL_MOCK_PINS];
+static HALWrite writeLog[HAL_MOCK_LOG];
+static _Atomic uint64_t writeCount;
+
+static GPSFix *script = NULL;       //Scripted fixes, timeMs is the offset from the start of the script
+static size_t scriptLen = 0;
+static uint64_t gpsOpenNs;
+static uint64_t gpsAttachNs;        //Script time zero, attachDelayMs after opening
+static pthread_t gpsThread;
+static atomic_int gpsRunning;
+static atomic_int gpsAttached;
+static int gpsEvents;
+static int gpsSerial;
+
+//Scripted attach delay and outages
+typedef struct {
+	uint32_t atMs, lenMs, leadMs;
+} MockOutage;
+static uint32_t attachDelayMs = 0;
+static MockOutage outages[HAL_MOCK_OUTAGES];
+static int outageCount = 0;
+static HALDeviceFn deviceFn = NULL;
+static HALChannelFn gpsAttachFn = NULL;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: record
+Function Description: Stores a write in the log and updates the pin's current value. Safe from any thread
+Input Parameters: pin, value - the write
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void record(int pin, int value) {
+	uint64_t n = atomic_fetch_add_explicit(&writeCount, 1, memory_order_relaxed);
+	HALWrite *w = &writeLog[n % HAL_MOCK_LOG];
+	w->tNs = GPSFix_NowNs();
+	w->pin = pin;
+	w->value = value;
+	if (pin >= 0 && pin < HAL_MOCK_PINS)
+		atomic_store_explicit(&pinValue[pin], value, memory_order_relaxed);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_Setup / HAL_PinMode / HAL_DigitalWrite
+Function Description: Mock GPIO. Every write is recorded, nothing touches hardware
+Input Parameters: pin - wiringPi pin number, value - level
+Output Parameters: 0 from the setup functions
+/---------------------------------------------------------------------------------------------------------*/
+int HAL_Setup(void) {
+	return 0;
+}
+
+void HAL_PinMode(int pin) {
+}
+
+void HAL_DigitalWrite(int pin, int value) {
+	record(pin, value);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_PinValue
+Function Description: Last level written to a pin
+Input Parameters: pin - pin number
+Output Parameters: Value, 0 for pins never written
+/---------------------------------------------------------------------------------------------------------*/
+int HALMock_PinValue(int pin) {
+	return (pin >= 0 && pin < HAL_MOCK_PINS) ? atomic_load_explicit(&pinValue[pin], memory_order_relaxed) : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_WriteCount
+Function Description: Number of GPIO writes since start or the last reset, including any overwritten in the log
+Input Parameters: N/A
+Output Parameters: Write count
+/---------------------------------------------------------------------------------------------------------*/
+uint64_t HALMock_WriteCount(void) {
+	return atomic_load_explicit(&writeCount, memory_order_relaxed);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_GetWrites
+Function Description: Copies the recorded writes, oldest first. Call once writers are idle
+Input Parameters: out - destination, max - capacity of out
+Output Parameters: Number of writes copied
+/---------------------------------------------------------------------------------------------------------*/
+size_t HALMock_GetWrites(HALWrite *out, size_t max) {
+	uint64_t total = HALMock_WriteCount();
+	uint64_t first = total > HAL_MOCK_LOG ? total - HAL_MOCK_LOG : 0;
+	size_t n = 0;
+
+	for (uint64_t i = first; i < total && n < max; i++)
+		out[n++] = writeLog[i % HAL_MOCK_LOG];
+	return n;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_SaveWrites
+Function Description: Writes the recorded GPIO log as CSV
+Input Parameters: path - file to create
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int HALMock_SaveWrites(const char *path) {
+	HALWrite *w = malloc(HAL_MOCK_LOG * sizeof(HALWrite));
+	FILE *fp = fopen(path, "w");
+
+	if (!w || !fp) {
+		free(w);
+		if (fp)
+			fclose(fp);
+		return -1;
+	}
+	size_t n = HALMock_GetWrites(w, HAL_MOCK_LOG);
+	fprintf(fp, "t_ns,pin,value\n");
+	for (size_t i = 0; i < n; i++)
+		fprintf(fp, "%llu,%d,%d\n", (unsigned long long)w[i].tNs, w[i].pin, w[i].value);
+	free(w);
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_Reset
+Function Description: Clears the write log and pin values
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HALMock_Reset(void) {
+	atomic_store(&writeCount, 0);
+	for (int i = 0; i < HAL_MOCK_PINS; i++)
+		atomic_store(&pinValue[i], 0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_SetScript
+Function Description: Sets the fixes the mock GPS serves. Fixes without GPS time are spaced at rateHz, otherwise
+                      they are served at their recorded spacing
+Input Parameters: fixes, count - fixes to serve in order, rateHz - rate for untimed fixes
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HALMock_SetScript(const GPSFix *fixes, size_t count, double rateHz) {
+	int timed = 0;
+
+	free(script);
+	script = malloc(count * sizeof(GPSFix));
+	scriptLen = script ? count : 0;
+	for (size_t i = 0; i < scriptLen; i++)
+		timed |= (fixes[i].timeMs != fixes[0].timeMs);
+	for (size_t i = 0; i < scriptLen; i++) {
+		script[i] = fixes[i];
+		if (!timed)
+			script[i].timeMs = (uint32_t)(i * 1000.0 / (rateHz > 0.0 ? rateHz : 1.0));
+		else
+			script[i].timeMs = fixes[i].timeMs - fixes[0].timeMs;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_LoadScript
+Function Description: Loads the mock GPS script from a CSV, GPX or track file
+Input Parameters: path - file to load, rateHz - rate for untimed fixes
+Output Parameters: 0 on success, -1 if the file can't be read
+/---------------------------------------------------------------------------------------------------------*/
+int HALMock_LoadScript(const char *path, double rateHz) {
+	TrackList list = {0};
+	if (TrackIO_Load(path, &list) != 0)
+		return -1;
+
+	GPSFix *fixes = calloc(list.count ? list.count : 1, sizeof(GPSFix));
+	if (!fixes) {
+		TrackIO_Free(&list);
+		return -1;
+	}
+	for (size_t i = 0; i < list.count; i++) {
+		fixes[i].lat = list.pts[i].lat;
+		fixes[i].lon = list.pts[i].lon;
+		fixes[i].head = list.pts[i].head;
+		fixes[i].timeMs = list.pts[i].timeMs;
+		fixes[i].fixState = list.pts[i].fixState;
+	}
+	HALMock_SetScript(fixes, list.count, rateHz);
+	free(fixes);
+	TrackIO_Free(&list);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_SetAttachDelay
+Function Description: Sets how long the mock GPS takes to attach after opening, like a slow USB enumeration
+Input Parameters: delayMs - attach delay
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HALMock_SetAttachDelay(uint32_t delayMs) {
+	attachDelayMs = delayMs;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HALMock_AddOutage
+Function Description: Schedules the mock GPS to be unplugged for a while. Outages must be added in time order
+Input Parameters: atMs - start, from attachment, lenMs - how long it stays detached, leadMs - how long after
+                  re-attaching only the fix state and heading are sent, 0 to send positions straight away
+Output Parameters: 0 on success, -1 if HAL_MOCK_OUTAGES are already scheduled or it overlaps the previous one
+/---------------------------------------------------------------------------------------------------------*/
+int HALMock_AddOutage(uint32_t atMs, uint32_t lenMs, uint32_t leadMs) {
+	if (outageCount == HAL_MOCK_OUTAGES)
+		return -1;
+	if (outageCount > 0) {
+		const MockOutage *prev = &outages[outageCount - 1];
+		if (atMs < prev->atMs + prev->lenMs + prev->leadMs)
+			return -1;
+	}
+	outages[outageCount].atMs = atMs;
+	outages[outageCount].lenMs = lenMs;
+	outages[outageCount].leadMs = leadMs;
+	outageCount++;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_Devices_Open / HAL_Devices_Close / HAL_GPS_SetAttachHandler
+Function Description: Mock device manager and GPS channel events. The mock GPS is the only device
+Input Parameters: fn - event handler
+Output Parameters: 0 from HAL_Devices_Open
+/---------------------------------------------------------------------------------------------------------*/
+int HAL_Devices_Open(HALDeviceFn fn) {
+	deviceFn = fn;
+	return 0;
+}
+
+void HAL_Devices_Close(void) {
+	deviceFn = NULL;
+}
+
+void HAL_GPS_SetAttachHandler(HALChannelFn fn) {
+	gpsAttachFn = fn;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sleepUntil
+Function Description: Sleeps to an absolute monotonic time, resuming after a signal. Any other failure is
+                      reported once and the script goes on without the wait
+Input Parameters: ns - wake time
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sleepUntil(uint64_t ns) {
+	static atomic_int reported;
+	struct timespec ts = {(time_t)(ns / 1000000000ull), (long)(ns % 1000000000ull)};
+	int err;
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR)
+		;
+	if (err != 0 && !atomic_exchange(&reported, 1))
+		printf("Mock GPS: clock_nanosleep failed (%s), the script is not being paced\n", strerror(err));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: setAttached
+Function Description: Plugs or unplugs the mock GPS, reporting it as the manager and the channel would
+Input Parameters: attached - new state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void setAttached(int attached) {
+	atomic_store(&gpsAttached, attached);
+	if (deviceFn)
+		deviceFn(gpsSerial, "Mock GPS", attached);
+	if (gpsAttachFn)
+		gpsAttachFn(attached);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: scriptIndex
+Function Description: Index of the scripted fix that is current at a time after attaching
+Input Parameters: elapsedMs - time since the GPS attached
+Output Parameters: Fix index
+/---------------------------------------------------------------------------------------------------------*/
+static size_t scriptIndex(uint64_t elapsedMs) {
+	size_t i = 0;
+	while (i + 1 < scriptLen && script[i + 1].timeMs <= elapsedMs)
+		i++;
+	return i;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: gpsEventThread
+Function Description: Attaches the mock GPS after the attach delay, then publishes each scripted fix to gps_fix at
+                      its scheduled time, like the Phidget event thread. Scheduled outages detach it, and fixes
+                      that fall due while it is detached are dropped. An outage with a lead re-attaches like a
+                      phidget that reports its fix state and heading before its first position
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *gpsEventThread(void *arg) {
+	uint64_t downUntil = 0;
+	int o = 0;
+
+	sleepUntil(gpsAttachNs);
+	setAttached(1);
+	for (size_t i = 0; i < scriptLen && atomic_load(&gpsRunning); i++) {
+		uint64_t due = gpsAttachNs + (uint64_t)script[i].timeMs * 1000000ull;
+		for (; o < outageCount && gpsAttachNs + outages[o].atMs * 1000000ull <= due; o++) {
+			sleepUntil(gpsAttachNs + outages[o].atMs * 1000000ull);
+			setAttached(0);
+			downUntil = gpsAttachNs + ((uint64_t)outages[o].atMs + outages[o].lenMs) * 1000000ull;
+			sleepUntil(downUntil);
+			setAttached(1);
+			if (outages[o].leadMs > 0) {
+				if (gpsEvents) {
+					GPSFix_SetFixState(script[i].fixState);
+					GPSFix_SetHeading(script[i].head, script[i].speed);
+				}
+				downUntil += outages[o].leadMs * 1000000ull;
+				sleepUntil(downUntil);
+			}
+		}
+		if (due < downUntil)
+			continue;
+		sleepUntil(due);
+		if (gpsEvents) {
+			GPSFix_SetPosition(script[i].lat, script[i].lon, script[i].timeMs, script[i].fixState, 1);
+			GPSFix_SetHeading(script[i].head, script[i].speed);
+		}
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_Open
+Function Description: Starts serving the script. A thread attaches the GPS and, in event mode, publishes fixes
+                      as they fall due. With a timeout it waits for the attach delay
+Input Parameters: serial - reported to the device handler, events - 1 to publish events to gps_fix,
+                  timeoutMs - attach timeout, 0 not to wait
+Output Parameters: 0 on success, -1 if no script has been set or the attach delay exceeds the timeout
+/---------------------------------------------------------------------------------------------------------*/
+int HAL_GPS_Open(int serial, int events, int timeoutMs) {
+	if (scriptLen == 0)
+		return -1;
+
+	gpsSerial = serial;
+	gpsEvents = events;
+	gpsOpenNs = GPSFix_NowNs();
+	gpsAttachNs = gpsOpenNs + attachDelayMs * 1000000ull;
+	atomic_store(&gpsRunning, 1);
+	if (pthread_create(&gpsThread, NULL, gpsEventThread, NULL) != 0) {
+		atomic_store(&gpsRunning, 0);
+		return -1;
+	}
+	if (timeoutMs <= 0)
+		return 0;
+	if (attachDelayMs > (uint32_t)timeoutMs) {
+		sleepUntil(gpsOpenNs + timeoutMs * 1000000ull);
+		return -1;
+	}
+	sleepUntil(gpsAttachNs);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_Poll
+Function Description: Returns the scripted fix that is current now. While detached the snapshot is left as it was,
+                      as the Phidget getters fail
+Input Parameters: out - snapshot to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HAL_GPS_Poll(GPSFix *out) {
+	if (!atomic_load(&gpsAttached))
+		return;
+	uint32_t seq = out->seq;
+	*out = script[scriptIndex((GPSFix_NowNs() - gpsAttachNs) / 1000000ull)];
+	out->seq = seq + 1;
+	out->rxNs = out->posRxNs = GPSFix_NowNs();
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_Close
+Function Description: Stops the event thread
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HAL_GPS_Close(void) {
+	if (atomic_exchange(&gpsRunning, 0)) {
+		pthread_cancel(gpsThread);
+		pthread_join(gpsThread, NULL);
+	}
+	atomic_store(&gpsAttached, 0);
+}
+
+#endif
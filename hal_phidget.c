@@ -0,0 +1,206 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: hal_phidget.c
+Source Description: Phidget22 GPS backend of the hardware abstraction layer
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <phidget22.h>
+#include "hal.h"
+#include "prof.h"
+
+static PhidgetGPSHandle gps = NULL;
+static PhidgetManagerHandle manager = NULL;
+static HALDeviceFn deviceFn = NULL;
+static HALChannelFn gpsAttachFn = NULL;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: timeToMs
+Function Description: Converts a PhidgetGPS_Time to milliseconds since UTC midnight
+Input Parameters: t - GPS time of day
+Output Parameters: Milliseconds since midnight
+/---------------------------------------------------------------------------------------------------------*/
+static uint32_t timeToMs(const PhidgetGPS_Time *t) {
+	return (((uint32_t)t->tm_hour * 60u + (uint32_t)t->tm_min) * 60u + (uint32_t)t->tm_sec) * 1000u + (uint32_t)t->tm_ms;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: onPositionChange
+Function Description: Phidget position event. Captures position, GPS time and fix state together
+Input Parameters: ch - GPS channel, ctx - unused, latitude, longitude, altitude - reported position
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void CCONV onPositionChange(PhidgetGPSHandle ch, void *ctx, double latitude, double longitude, double altitude) {
+	PhidgetGPS_Time t;
+	int fixState = 0;
+	PROF_START(tRead);
+	int haveTime = (PhidgetGPS_getTime(ch, &t) == EPHIDGET_OK);
+	PhidgetGPS_getPositionFixState(ch, &fixState);
+	PROF_END(PROF_GPS_READ, tRead);
+	GPSFix_SetPosition(latitude, longitude, haveTime ? timeToMs(&t) : 0, fixState, haveTime);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: onHeadingChange
+Function Description: Phidget heading event. Captures heading and velocity
+Input Parameters: ch - GPS channel, ctx - unused, heading, velocity - reported course over ground
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void CCONV onHeadingChange(PhidgetGPSHandle ch, void *ctx, double heading, double velocity) {
+	GPSFix_SetHeading(heading, velocity);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: onFixStateChange
+Function Description: Phidget fix state event
+Input Parameters: ch - GPS channel, ctx - unused, positionFixState - new fix state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void CCONV onFixStateChange(PhidgetGPSHandle ch, void *ctx, int positionFixState) {
+	GPSFix_SetFixState(positionFixState);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: onGPSAttach / onGPSDetach
+Function Description: Phidget channel attach and detach events for the GPS
+Input Parameters: ch - GPS channel, ctx - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void CCONV onGPSAttach(PhidgetHandle ch, void *ctx) {
+	if (gpsAttachFn)
+		gpsAttachFn(1);
+}
+
+static void CCONV onGPSDetach(PhidgetHandle ch, void *ctx) {
+	if (gpsAttachFn)
+		gpsAttachFn(0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: onManagerAttach / onManagerDetach
+Function Description: PhidgetManager attach and detach events, as in HelloWorld_Example, passed on by serial number
+Input Parameters: m - manager, ctx - unused, device - the device
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void CCONV onManagerAttach(PhidgetManagerHandle m, void *ctx, PhidgetHandle device) {
+	int serial = 0;
+	const char *name = "";
+	Phidget_getDeviceSerialNumber(device, &serial);
+	Phidget_getDeviceName(device, &name);
+	if (deviceFn)
+		deviceFn(serial, name, 1);
+}
+
+static void CCONV onManagerDetach(PhidgetManagerHandle m, void *ctx, PhidgetHandle device) {
+	int serial = 0;
+	const char *name = "";
+	Phidget_getDeviceSerialNumber(device, &serial);
+	Phidget_getDeviceName(device, &name);
+	if (deviceFn)
+		deviceFn(serial, name, 0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_Devices_Open
+Function Description: Opens a PhidgetManager that reports every device attach and detach
+Input Parameters: fn - called for each event
+Output Parameters: 0 on success, -1 if the manager could not be opened
+/---------------------------------------------------------------------------------------------------------*/
+int HAL_Devices_Open(HALDeviceFn fn) {
+	deviceFn = fn;
+	if (PhidgetManager_create(&manager) != EPHIDGET_OK)
+		return -1;
+	PhidgetManager_setOnAttachHandler(manager, onManagerAttach, NULL);
+	PhidgetManager_setOnDetachHandler(manager, onManagerDetach, NULL);
+	if (PhidgetManager_open(manager) != EPHIDGET_OK) {
+		PhidgetManager_delete(&manager);
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_Devices_Close
+Function Description: Closes the device manager
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HAL_Devices_Close(void) {
+	if (!manager)
+		return;
+	PhidgetManager_close(manager);
+	PhidgetManager_delete(&manager);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_SetAttachHandler
+Function Description: Sets the function told when the GPS channel attaches or detaches
+Input Parameters: fn - handler
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HAL_GPS_SetAttachHandler(HALChannelFn fn) {
+	gpsAttachFn = fn;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_Open
+Function Description: Creates the GPS channel, registers the change handlers before opening so no events are
+                      missed, then opens it. With a timeout it waits for attachment. Without one it returns at
+                      once: phidget22 keeps an open channel matched, attaching it when the device appears and
+                      again each time it is plugged back in
+Input Parameters: serial - device serial number, events - 1 to publish events to gps_fix, timeoutMs - attach timeout,
+                  0 not to wait
+Output Parameters: 0 on success, -1 if the channel could not be created or opened, or did not attach in time
+/---------------------------------------------------------------------------------------------------------*/
+int HAL_GPS_Open(int serial, int events, int timeoutMs) {
+	if (PhidgetGPS_create(&gps) != EPHIDGET_OK)
+		return -1;
+	Phidget_setDeviceSerialNumber((PhidgetHandle)gps, serial);
+	Phidget_setOnAttachHandler((PhidgetHandle)gps, onGPSAttach, NULL);
+	Phidget_setOnDetachHandler((PhidgetHandle)gps, onGPSDetach, NULL);
+
+	if (events) {
+		PhidgetGPS_setOnPositionChangeHandler(gps, onPositionChange, NULL);
+		PhidgetGPS_setOnHeadingChangeHandler(gps, onHeadingChange, NULL);
+		PhidgetGPS_setOnPositionFixStateChangeHandler(gps, onFixStateChange, NULL);
+	}
+	if (timeoutMs <= 0)
+		return Phidget_open((PhidgetHandle)gps) == EPHIDGET_OK ? 0 : -1;
+	return Phidget_openWaitForAttachment((PhidgetHandle)gps, timeoutMs) == EPHIDGET_OK ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_Poll
+Function Description: Fills a snapshot from the getters, as the original polling loop did
+Input Parameters: out - snapshot to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HAL_GPS_Poll(GPSFix *out) {
+	PhidgetGPS_Time t;
+
+	PROF_START(tRead);
+	int havePos = PhidgetGPS_getLatitude(gps, &out->lat) == EPHIDGET_OK;
+	havePos &= PhidgetGPS_getLongitude(gps, &out->lon) == EPHIDGET_OK;
+	PhidgetGPS_getHeading(gps, &out->head);
+	PhidgetGPS_getVelocity(gps, &out->speed);
+	PhidgetGPS_getPositionFixState(gps, &out->fixState);
+	if (PhidgetGPS_getTime(gps, &t) == EPHIDGET_OK)
+		out->timeMs = timeToMs(&t);
+	PROF_END(PROF_GPS_READ, tRead);
+	out->seq++;
+	out->rxNs = GPSFix_NowNs();
+	if (havePos)
+		out->posRxNs = out->rxNs; //Only a position read counts as a new position for Sup_GPSReady
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HAL_GPS_Close
+Function Description: Closes and deletes the GPS channel
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HAL_GPS_Close(void) {
+	if (!gps)
+		return;
+	Phidget_close((PhidgetHandle)gps);
+	PhidgetGPS_delete(&gps);
+}
@@ -0,0 +1,144 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: heading_ctrl.c
+Source Description: Continuous PID heading controller producing proportional left/right wheel duties
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <string.h>
+#include "heading_ctrl.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HeadingCtrl_Defaults
+Function Description: Default gains, tuned on the rover model (tools/ctrl_bench.c)
+Input Parameters: g - gains to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HeadingCtrl_Defaults(HeadingGains *g) {
+	static const HeadingGains defaults = {
+		.kp = 0.25, .ki = 0.01, .kd = 0.05,
+		.deadband = 2.0,
+		.iLimit = 10.0,
+		.baseDuty = 100.0,
+		.maxTurn = 100.0,
+		.pivotDeg = 180.0,
+		.dFilter = 0.2,
+		.schedSpeed = {0.0, 0.3, 1.0, 2.0},
+		.schedScale = {0.5, 1.0, 1.0, 0.6},
+	};
+	*g = defaults;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HeadingCtrl_Init
+Function Description: Sets up a controller with a set of gains
+Input Parameters: c - controller, g - gains
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HeadingCtrl_Init(HeadingCtrl *c, const HeadingGains *g) {
+	memset(c, 0, sizeof(*c));
+	c->g = *g;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HeadingCtrl_Reset
+Function Description: Clears the integral and derivative state
+Input Parameters: c - controller
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void HeadingCtrl_Reset(HeadingCtrl *c) {
+	c->integral = 0.0;
+	c->dError = 0.0;
+	c->havePrev = 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HeadingCtrl_Wrap
+Function Description: Wraps an angle difference so the controller always turns the short way
+Input Parameters: error - difference in degrees, any range
+Output Parameters: Difference in [-180, 180)
+/---------------------------------------------------------------------------------------------------------*/
+double HeadingCtrl_Wrap(double error) {
+	error = fmod(error + 180.0, 360.0);
+	if (error < 0.0)
+		error += 360.0;
+	return error - 180.0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: gainScale
+Function Description: Interpolates the gain schedule at a speed, holding the end values outside it
+Input Parameters: g - gains, speed - m/s
+Output Parameters: Gain scale
+/---------------------------------------------------------------------------------------------------------*/
+static double gainScale(const HeadingGains *g, double speed) {
+	if (speed <= g->schedSpeed[0])
+		return g->schedScale[0];
+	for (int i = 1; i < HEADING_SCHED_POINTS; i++) {
+		if (speed < g->schedSpeed[i]) {
+			double f = (speed - g->schedSpeed[i - 1]) / (g->schedSpeed[i] - g->schedSpeed[i - 1]);
+			return g->schedScale[i - 1] + f * (g->schedScale[i] - g->schedScale[i - 1]);
+		}
+	}
+	return g->schedScale[HEADING_SCHED_POINTS - 1];
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: HeadingCtrl_Update
+Function Description: One PID step. The integral is frozen while the output is saturated in the direction of the
+                      error, the derivative is low-pass filtered, and the base duty tapers to a pivot at pivotDeg
+Input Parameters: c - controller, error - bearing - heading (degrees), speed - ground speed (m/s),
+                  dt - time since the last step (s)
+Output Parameters: left, right - wheel duties in [-100, 100]
+/---------------------------------------------------------------------------------------------------------*/
+void HeadingCtrl_Update(HeadingCtrl *c, double error, double speed, double dt, int *left, int *right) {
+	const HeadingGains *g = &c->g;
+	double e = HeadingCtrl_Wrap(error);
+	double ae = fabs(e);
+	double scale = gainScale(g, speed);
+
+	if (dt <= 0.0 || dt > 1.0)
+		c->havePrev = 0; //First step or a long gap: no derivative, no integration
+	if (c->havePrev) {
+		double rate = HeadingCtrl_Wrap(e - c->lastError) / dt;
+		double a = dt / (g->dFilter + dt);
+		c->dError += a * (rate - c->dError);
+	} else {
+		c->dError = 0.0;
+	}
+	c->lastError = e;
+
+	double ep = ae < g->deadband ? 0.0 : e;
+	double turn = scale * (g->kp * ep + g->kd * c->dError) + c->integral;
+
+	//Anti-windup: integrate only when that doesn't push further into saturation
+	double step = c->havePrev ? scale * g->ki * ep * dt : 0.0;
+	int sat = fabs(turn) >= g->maxTurn;
+	if (!sat || (turn > 0.0) != (step > 0.0)) {
+		c->integral += step;
+		if (c->integral > g->iLimit)
+			c->integral = g->iLimit;
+		else if (c->integral < -g->iLimit)
+			c->integral = -g->iLimit;
+	}
+	c->havePrev = 1;
+
+	if (turn > g->maxTurn)
+		turn = g->maxTurn;
+	else if (turn < -g->maxTurn)
+		turn = -g->maxTurn;
+	c->saturated += sat;
+	c->updates++;
+
+	double base = ae >= g->pivotDeg ? 0.0 : g->baseDuty * (1.0 - ae / g->pivotDeg);
+	double l = base + turn, r = base - turn;
+
+	//Keep the differential when a wheel would exceed full duty. base >= 0 and |turn| <= 100, so only the top can
+	//be exceeded, and shifting both wheels down leaves the other within -100
+	double over = fmax(l, r) - 100.0;
+	if (over > 0.0) {
+		l -= over;
+		r -= over;
+	}
+	*left = (int)lround(fmax(-100.0, fmin(100.0, l)));
+	*right = (int)lround(fmax(-100.0, fmin(100.0, r)));
+}
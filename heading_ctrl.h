@@ -0,0 +1,52 @@
+#ifndef HEADING_CTRL_h_
+#define HEADING_CTRL_h_
+
+  /* Continuous heading controller. The error (bearing - heading) is wrapped to [-180, 180) and fed through a PID
+    whose output is the wheel differential: left = base + turn, right = base - turn, so a positive error (target
+    clockwise of the heading) speeds up the left wheel. The base duty falls linearly with the error and reaches
+    zero at pivotDeg, so large errors become an on-the-spot turn without a discontinuity. Gains are scaled by a
+    piecewise-linear schedule over GPS speed: GPS heading is noisy at walking pace and the rover overshoots more
+    when fast. The integral only accumulates while the output is not saturated in the same direction (anti-windup)
+    and is clamped to iLimit. Errors inside the deadband are treated as zero.
+   */
+
+#define HEADING_SCHED_POINTS 4
+
+typedef struct {
+	double kp, ki, kd;         //Gains in duty % per degree, per degree-second, per degree/s
+	double deadband;           //Errors below this are ignored (degrees)
+	double iLimit;             //Largest integral contribution (duty %)
+	double baseDuty;           //Forward duty with no error (%)
+	double maxTurn;            //Largest differential (duty %)
+	double pivotDeg;           //Error at which the base duty reaches zero (degrees)
+	double dFilter;            //Derivative low-pass time constant (s)
+	double schedSpeed[HEADING_SCHED_POINTS];  //Speeds of the schedule points, ascending (m/s)
+	double schedScale[HEADING_SCHED_POINTS];  //Gain scale at each point
+} HeadingGains;
+
+typedef struct {
+	HeadingGains g;
+	double integral;     //Integral contribution (duty %)
+	double lastError;
+	double dError;       //Filtered error rate (degrees/s)
+	int havePrev;
+	unsigned long updates;
+	unsigned long saturated;
+} HeadingCtrl;
+
+//Fills in the default gains
+void HeadingCtrl_Defaults(HeadingGains *g);
+
+//Sets up a controller
+void HeadingCtrl_Init(HeadingCtrl *c, const HeadingGains *g);
+
+//Clears the integral and derivative state, e.g. on a new leg
+void HeadingCtrl_Reset(HeadingCtrl *c);
+
+//Wraps an angle difference to [-180, 180)
+double HeadingCtrl_Wrap(double error);
+
+//One control step. error - bearing - heading (any range), speed - m/s, dt - s since the last step
+void HeadingCtrl_Update(HeadingCtrl *c, double error, double speed, double dt, int *left, int *right);
+
+#endif
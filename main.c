@@ -9,20 +9,41 @@ Source Description: Main code of GPS robot
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
 #include "gps_motors.h"
-
-#include <phidget22.h>
-#include "PhidgetHelperFunctions.h"
+#include "gps_fix.h"
+#include "gps_log.h"
+#include "navigator.h"
+#include "mission.h"
+#include "heading_ctrl.h"
+#include "estimator.h"
+#include "rt.h"
+#include "prof.h"
+#include "dashboard.h"
+#include "telemetry.h"
+#include "fmt.h"
+#include "hal.h"
+#include "pwm_engine.h"
+#include "supervisor.h"
+#include "checkpoint.h"
+#include "telem_stream.h"
+#include "command.h"
+#include "profile.h"
 
 #define SERIAL_NO 131244 //Phidget Serial. No
 
-#define PI 3.1459f //Mathematical operator
-
 #define FullSpeed 100
 #define TurnSpeed 80
 #define StopSpeed 0
 
+#define FIX_WAIT_MS 250 //Longest the event loop sleeps before re-checking the stop flag
+
 volatile int stop = 0; //Flag to exit infinite loop
+static int fullSpeed = FullSpeed, turnSpeed = TurnSpeed;  //Duty limits, changed by the speed command
+static const int *turnTable = turnThresholds;  //Turn table, replaced by a profile
+static DashState dash;  //State for the dashboard thread, published once per loop
 
 
 /*---------------------------------------------------------------------------------------------------------/
@@ -32,134 +53,608 @@ Input Parameters: signum
 Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
 void sig_handler(int signum) {
-	printf("\033[10BExit!\n");
 	stop = 1;
 }
 
 /*---------------------------------------------------------------------------------------------------------/
-Function Name: getTargetBearing
-Function Description: Calculates bearing to target based on the latitute and longitude data of the robot and the target
-Input Parameters: lat, lon (Robot Lat, long values), tlat, tlon (Target Lat, Long values)
-Output Parameters:The target bearing
+Function Name: set_turnmode
+Function Assigns the direction and intensity of the motors based on the error bearing between the robot and the waypoint 
+Input Parameters: f_error - The bearing error between the robot and the waypoint
+Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
-double getTargetBearing(double lat, double lon, double tLat, double tLon) {
-	double dLon = abs(tLon - lon);
-	double X = cos(tLat) * sin(dLon);
-	double Y = (cos(lat) * sin(tLat)) - (sin(lat) * cos(tLat) * cos(dLon));
-	return (atan2(X, Y) * (180.0f/PI)) + 180.0f;
+void set_turnmode(double f_error){
+	TurnMode mode = get_turnmode_table(f_error, turnTable);
+	int left = 0, right = 0;
+	if (mode == TURN_OFF) {
+		Motors_Disable(); //Default off
+	} else {
+		turnmode_duties(mode, fullSpeed, turnSpeed, &left, &right);
+		Smooth_Turn(left, right);
+	}
+	strncpy(dash.mode, turnmode_name(mode), sizeof(dash.mode) - 1);
+	dash.dutyL = left;
+	dash.dutyR = right;
 }
 
 /*---------------------------------------------------------------------------------------------------------/
-Function Name: getBearingError
-Function Description: Calculates the error value between the current bearing and the target bearing
-Input Parameters: head is the target heading, bearing is the robots current bearing 
-Output Parameters: Bearing error value
+Function Name: set_heading_pid
+Function Description: Steers with the continuous heading controller instead of the turn table
+Input Parameters: ctrl - heading controller, f_error - bearing - heading, speed - GPS speed (km/h), dt - seconds
+                  since the last fix
+Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
-
-double getBearingError(double head, double bearing) {
-	return bearing - head;
+void set_heading_pid(HeadingCtrl *ctrl, double f_error, double speed, double dt){
+	int left, right;
+	HeadingCtrl_Update(ctrl, f_error, speed / 3.6, dt, &left, &right);
+	left = left > fullSpeed ? fullSpeed : left < -fullSpeed ? -fullSpeed : left;
+	right = right > fullSpeed ? fullSpeed : right < -fullSpeed ? -fullSpeed : right;
+	Smooth_Turn(left, right);
+	double wrapped = HeadingCtrl_Wrap(f_error);
+	char text[FMT_DOUBLE_MAX + 8];
+	char *e = Fmt_Str(text, signbit(wrapped) ? "pid " : "pid +"); //"pid %+.1f"
+	e = Fmt_Double(e, wrapped, 0, 1);
+	size_t len = (size_t)(e - text) < sizeof(dash.mode) ? (size_t)(e - text) : sizeof(dash.mode) - 1;
+	memcpy(dash.mode, text, len);
+	dash.mode[len] = '\0';
+	dash.dutyL = left;
+	dash.dutyR = right;
 }
 
+
 /*---------------------------------------------------------------------------------------------------------/
-Function Name: set_turnmode
-Function Assigns the direction and intensity of the motors based on the error bearing between the robot and the waypoint 
-Input Parameters: f_error - The bearing error between the robot and the waypoint
+Function Name: printLoopStats
+Function Description: Prints how often the control loop woke and how much CPU the process used, so the polling
+                      and event driven modes can be compared on the rover
+Input Parameters: mode - name of the loop mode, wakes - number of control loop iterations, startNs - loop start time
 Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
-void set_turnmode(double f_error){
-	f_error = f_error*10.0f;	
-	int error = (int)f_error; //typecast to int for comparison
-	printf("\nerror: %d\n", error);
-	if (error < 100 || error >= 3500) {
-		Forwards(FullSpeed);
- 		printf("\nForwards\n");
-	} else if (error < 900 && error >= 100) {
-		Smooth_Turn(FullSpeed , TurnSpeed); 
-		printf("\nSmooth Left\n");
-	} else if (error < 1800 && error >= 900) {
-		Hard_Left(); 				
-		printf("\nHard Left\n");
-	} else if (error < 2700 && error >= 1800) {
-		Hard_Right(); 		
-		printf("\nHard Right\n");
-	} else if (error < 3500 && error >= 2700) {
-		Smooth_Turn(TurnSpeed, FullSpeed); 	
-		printf("\nSmooth Right\n");
-	} else {
-		Motors_Disable(); 	
-		printf("\nout of range!!!\n");		//Default off
-	
-	}
+void printLoopStats(const char *mode, unsigned long wakes, uint64_t startNs) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
 
+	double wall = (GPSFix_NowNs() - startNs) / 1e9;
+	double user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+	double sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	if (wall <= 0.0)
+		wall = 1e-9;
 
+	printf("%s loop: %lu wakes in %.1f s (%.1f wakes/s)\n", mode, wakes, wall, wakes / wall);
+	printf("CPU: user %.2f s, sys %.2f s (%.1f%% of one core)\n", user, sys, 100.0 * (user + sys) / wall);
 }
 
-
 /*---------------------------------------------------------------------------------------------------------/
 Function Name: Main
 Function Description: Main application routine
-Input Parameters: N/A 
+Input Parameters: -p to poll the GPS getters as fast as possible instead of waiting for GPS events
+                  -m file to follow the route in a GPX or CSV file instead of driving to the single target
+                  -c bucket to steer with the five-way turn table instead of the PID heading controller
+                  -P file controller profile, e.g. from tools/tune.c: turn table, FullSpeed, TurnSpeed, gains and
+                  controller (-c still picks the controller)
+                  -e hz to steer at a fixed rate on the Kalman filter's predicted pose instead of once per fix
+                  -R hz to run the loop at a fixed rate under SCHED_FIFO on its own core, with memory locked
+                  -d hz dashboard refresh rate (default 10)
+                  -b to log to the binary track myGPS_data.trk instead of myGPS_data.csv
+                  -s file -r hz (mock build only) GPS script to serve and the fix rate for untimed scripts
+                  -n to start the route afresh instead of resuming from the checkpoint in rover.ckpt
+                  -a ms -u at,len[,lead] (mock build only) GPS attach delay, and an outage of len ms from at ms
+                  after attaching, re-attaching with lead ms of fix state and heading before any position
+                  (repeatable)
+                  -U host[:port] to stream binary telemetry over UDP to a ground station (port 5005 by default)
+                  -S hz telemetry stream sample rate (default 10)
+                  -C port loopback UDP port for operator commands (default 5006, 0 for none)
 Output Parameters: N/A
 /---------------------------------------------------------------------------------------------------------*/
-int main() {
+int main(int argc, char *argv[]) {
 
-	//Setup interrupt on closing application with Ctrl + C
+	uint64_t startNs = GPSFix_NowNs();
+	int pollMode = 0;	//Event driven by default, polling kept for comparison
+	int binaryLog = 0;	//CSV log by default
+	const char *script = NULL;	//Mock GPS script
+	const char *route = NULL;	//Mission route, single target if none
+	int bucketMode = 0;	//PID heading controller by default
+	const char *ctrlName = NULL;	//Controller from -c, over the profile's
+	const char *profilePath = NULL;	//Built-in settings by default
+	double scriptRate = 10.0;
+	double estRate = 0.0;	//Steer on each fix by default
+	double rtRate = 0.0;	//Normal scheduling by default
+	double dashRate = DASH_DEFAULT_HZ;
+	int fresh = 0;	//Resume from the checkpoint by default
+	uint32_t attachDelay = 0, outageAt, outageLen, outageLead;
+	char streamHost[256] = "";	//No UDP stream by default
+	int streamPort = STREAM_DEFAULT_PORT;
+	double streamRate = STREAM_DEFAULT_HZ;
+	int cmdPort = CMD_DEFAULT_PORT;
+	int opt;
+	while ((opt = getopt(argc, argv, "pbnm:c:P:e:R:d:s:r:a:u:U:S:C:")) != -1) {
+		switch (opt) {
+			case 'p': pollMode = 1; break;
+			case 'b': binaryLog = 1; break;
+			case 'n': fresh = 1; break;
+			case 'm': route = optarg; break;
+			case 'c': ctrlName = optarg; break;
+			case 'P': profilePath = optarg; break;
+			case 'e': estRate = atof(optarg); break;
+			case 'R': rtRate = atof(optarg); break;
+			case 'd': dashRate = atof(optarg); break;
+			case 's': script = optarg; break;
+			case 'r': scriptRate = atof(optarg); break;
+			case 'a': attachDelay = (uint32_t)atoi(optarg); break;
+			case 'U':
+				if (sscanf(optarg, "%255[^:]:%d", streamHost, &streamPort) < 1) {
+					printf("Bad stream address %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'S': streamRate = atof(optarg); break;
+			case 'C': cmdPort = atoi(optarg); break;
+			case 'u':
+#ifdef HAL_MOCK
+				outageLead = 0;
+				if (sscanf(optarg, "%u,%u,%u", &outageAt, &outageLen, &outageLead) < 2
+						|| HALMock_AddOutage(outageAt, outageLen, outageLead) != 0) {
+					printf("Bad or overlapping outage %s\n", optarg);
+					return 1;
+				}
+#endif
+				break;
+			default:
+				printf("Usage: %s [-p] [-b] [-n] [-m route] [-c pid|bucket] [-P profile] [-e hz] [-R hz] [-d hz] [-s script -r hz] [-a ms] [-u at,len[,lead]] [-U host[:port]] [-S hz] [-C port]\n", argv[0]);
+				return 1;
+		}
+	}
+
+#ifdef HAL_MOCK
+	if (!script || HALMock_LoadScript(script, scriptRate) != 0) {
+		printf("Mock build needs a GPS script: -s <track.csv|gpx|trk>\n");
+		return 1;
+	}
+	HALMock_SetAttachDelay(attachDelay);
+#else
+	(void)script;
+	(void)scriptRate;
+	(void)attachDelay;
+	(void)outageAt;
+	(void)outageLen;
+	(void)outageLead;
+#endif
+
+	//Controller settings, from the profile if there is one
+	Profile profile;
+	Profile_Defaults(&profile);
+	if (profilePath) {
+		int rc = Profile_Load(profilePath, &profile);
+		if (rc != 0) {
+			if (rc < 0)
+				printf("Cannot read profile %s\n", profilePath);
+			else
+				printf("Bad setting on line %d of profile %s\n", rc, profilePath);
+			return 1;
+		}
+		printf("Profile: %s\n", profilePath);
+	}
+	if (ctrlName)
+		profile.bucket = strcmp(ctrlName, "bucket") == 0;
+	bucketMode = profile.bucket;
+	fullSpeed = profile.fullSpeed;
+	turnSpeed = profile.turnSpeed;
+	turnTable = profile.thresholds;
+
+	//Setup interrupt on closing application with Ctrl + C, and the latency dump on SIGUSR1
 	signal(SIGINT, sig_handler);	
+	Prof_Init();
 
-	//Open the file
-	FILE *fp =  fopen("myGPS_data.csv", "w");
+	//Open the log file, header info is written by the logger's writer thread
+	if (binaryLog)
+		Log_OpenTrack("myGPS_data.trk");
+	else
+		Log_Open("myGPS_data.csv", "myGPS_data.csv\nlat,lon\n");
 	
 	//Create Variables for position data
     double lat = 0.0f;      //Latitude
     double lon = 0.0f;      //Longitude
     double tLat = 50.364351f;   //Target Latitude
     double tLon = -4.141873f;   //Target Longitude
-	
+	GPSFix fix = {0};           //Latest GPS snapshot
+
+	//Load the route, its legs are projected into the local frame once and each fix is then a few multiply-adds
+	Mission mission;
+	MissionNav nav;
+	MissionStatus status;
+	if (route) {
+		if (Mission_Load(&mission, route, MISSION_ARRIVE_M, MISSION_HYST_M) != 0) {
+			printf("Cannot read route %s\n", route);
+			Log_Close();
+			return 1;
+		}
+	} else {
+		Waypoint target = {tLat, tLon};
+		Mission_Init(&mission, &target, 1, MISSION_ARRIVE_M, MISSION_HYST_M);
+	}
+	printf("Mission: %zu waypoints\n", mission.count);
+
 	
 	//Create Variables for Heading Data
     double head = 0.0f;     //Heading
     double bearingToTarget = 0.0f;  //Bearing to target
     double error = 0.0f;        //Bearing error between robot and target
 
+	//Continuous heading controller, the turn table stays available with -c bucket
+	HeadingCtrl headingCtrl;
+	HeadingCtrl_Init(&headingCtrl, &profile.gains);
+
+	//State estimator, with -e the loop steers on its prediction between fixes
+	EstParams estParams;
+	Estimator est;
+	EstPose pose;
+	Est_Defaults(&estParams);
+	Est_Init(&est, &estParams);
+	double speed = 0.0;         //Speed used by the heading controller (km/h)
+
+	//Fixed-rate ticks for -R or -e, -R sets the rate when both are given
+	double tickRate = rtRate > 0.0 ? rtRate : estRate;
+	RtTicker ticker;
+
 	//Initialise motors
 	Motors_Init(); 
-	
-	//Name and address for GPS device
-	PhidgetGPSHandle myGPS; 
-	PhidgetGPS_create(&myGPS);
 
-	 //Obtain the GPS device's serial number and open communication chanel, 5 second timeout
-	Phidget_setDeviceSerialNumber((PhidgetHandle)myGPS, SERIAL_NO);
-	Phidget_openWaitForAttachment((PhidgetHandle)myGPS, 5000); 
+	//Resume from the checkpoint when it was written for this route: progress, pose and wheel commands as they were,
+	//so the rover moves again before the GPS has even attached
+	Checkpoint ckpt;
+	CkptRecord saved = {0};
+	uint32_t routeId = Ckpt_RouteId(mission.wps, mission.count * sizeof(Waypoint));
+	uint64_t resumeUntil = 0;	//Steer on the saved pose until a fix arrives or this time passes
+	int64_t ckptAge;
+	int haveCkpt = Ckpt_Open(&ckpt, CKPT_DEFAULT_PATH, &saved);
+	if (haveCkpt < 0)
+		printf("Checkpoint: cannot open %s, running without it\n", CKPT_DEFAULT_PATH);
+	if (haveCkpt == 1 && !fresh && Ckpt_Usable(&saved, routeId, &ckptAge)) {
+		Mission_Restore(&mission, saved.leg, (MissionStatus)saved.status, saved.arrivals);
+		lat = saved.lat;
+		lon = saved.lon;
+		head = saved.head;
+		speed = saved.speed;
+		fix.lat = saved.fixLat;
+		fix.lon = saved.fixLon;
+		fix.head = saved.fixHead;
+		fix.speed = saved.fixSpeed;
+		fix.timeMs = saved.fixTimeMs;
+		fix.fixState = saved.fixState;
+		if (estRate > 0.0) {
+			EstPose seed = {saved.lat, saved.lon, saved.head, saved.speed / 3.6, 0.0, saved.posSd};
+			Est_Seed(&est, GPSFix_NowNs(), &seed);
+		}
+		if (mission.status != MISSION_ARRIVED)
+			Motors_Drive((int)lround(saved.dutyL), (int)lround(saved.dutyR));
+		resumeUntil = GPSFix_NowNs() + CKPT_TRUST_MS * 1000000ull;
+		printf("Checkpoint: resumed at waypoint %u of %u from %.1f s ago, moving %.1f ms after start\n", saved.leg + 1,
+			saved.count, ckptAge / 1e3, (GPSFix_NowNs() - startNs) / 1e6);
+	} else if (haveCkpt == 1 && !fresh) {
+		printf("Checkpoint: saved for another route or too old, starting afresh\n");
+	}
 	
-	//Enter file header info
-	fprintf(fp,"myGPS_data.csv\n");
-	fprintf(fp, "lat,lon\n");
+	//Open communication chanel to the GPS by serial number without waiting for it. Event handlers publish into
+	//gps_fix, and the motors stay off until the supervisor reports it attached with a fix
+	GPSFix_Init();
+	if (Sup_Start(SERIAL_NO, !pollMode) != 0)
+		printf("Cannot open the GPS channel\n");
+	int gpsHeld = 0;
+	dash.leg = 1;
+	dash.count = (int32_t)mission.count;
+	
+	unsigned long wakes = 0;
+	uint64_t loopStart = GPSFix_NowNs();
+	uint64_t lastTick = loopStart;
+
+	//Live state for external monitors, the rover runs without it if shared memory is unavailable
+	TelemState telem = {0};
+	unsigned long fixCount = 0;
+	if (Telem_Create() != 0)
+		printf("Telemetry: cannot create %s, continuing without it\n", TELEM_SHM_NAME);
+	telem.flags = (bucketMode ? 0 : TELEM_PID) | (estRate > 0.0 ? TELEM_ESTIMATOR : 0) | (rtRate > 0.0 ? TELEM_REALTIME : 0);
+
+	//Binary telemetry to a ground station, batched into datagrams by the stream's own thread
+	StreamSample sample = {0};
+	int64_t lateNs = 0;
+	if (streamHost[0] && Stream_Open(streamHost, streamPort, streamRate) != 0)
+		printf("Stream: cannot reach %s:%d, continuing without it\n", streamHost, streamPort);
+
+	//Operator commands, parsed by their own thread and picked up once per tick
+	CmdType held = CMD_RESUME;	//CMD_PAUSE or CMD_STOP while the operator holds the rover
+	if (cmdPort > 0 && Cmd_Start(cmdPort) != 0)
+		printf("Commands: cannot bind 127.0.0.1:%d, continuing without them\n", cmdPort);
+
+	//Console output from here on belongs to the dashboard thread
+	if (Dash_Start(dashRate) != 0)
+		printf("Cannot start the dashboard\n");
+
+	//Real-time mode last, so the logger, PWM, GPS and dashboard threads keep their own scheduling and cores
+	if (rtRate > 0.0) {
+		RtConfig rt;
+		RT_Defaults(&rt);
+		if (RT_Enable(&rt) != 0)
+			printf("RT: running with normal scheduling where not permitted (not root?)\n");
+	}
+	if (tickRate > 0.0)
+		RT_TickerInit(&ticker, tickRate);
 
 /*--------------------------------------------MAIN WHILE LOOP---------------------------------------------*/	
 	while(!stop) {
 
-		//Get Positional Data
-		PhidgetGPS_getLatitude(myGPS, &lat);
-		PhidgetGPS_getLongitude(myGPS, &lon);
-
-		//Get Heading Data
-		PhidgetGPS_getHeading(myGPS, &head);
-		bearingToTarget = getTargetBearing(lat, lon, tLat, tLon);
-		error = abs(bearingToTarget - head);
-
-		//print positional data to file and serial terminal
-		fprintf(fp,"%9.7f,%9.7f\n", lat, lon);
-		printf("--------------------------------------\nLocation: %9.7f N %9.7f W\n--------------------------------------\nHeading: %5.2f \nTarget Bearing: %5.2f \nError:%5.2f\033[5A", lat, lon, head, bearingToTarget, error);
-		printf("\nHeading Error: %5.2f\n", error);
-		printf("\nHeading: %5.2f\n", head);
-		set_turnmode(error);
-		usleep(100);
+		PROF_START(tTick);
+
+		//Apply queued operator commands. The listener built any new route, so a swap is all that happens here
+		for (Command *cmd; (cmd = Cmd_Next()) != NULL; Cmd_Release()) {
+			switch (cmd->type) {
+				case CMD_ROUTE: {
+					Mission old = mission;
+					mission = cmd->route;
+					cmd->route = old; //Freed by the listener
+					routeId = Ckpt_RouteId(mission.wps, mission.count * sizeof(Waypoint));
+					HeadingCtrl_Reset(&headingCtrl);
+					resumeUntil = 0; //The saved pose was for the old route
+					break;
+				}
+				case CMD_STOP:
+					Motors_Disable();
+					/* fall through */
+				case CMD_PAUSE:
+					held = cmd->type;
+					resumeUntil = 0;
+					break;
+				case CMD_RESUME:
+					if (held != CMD_RESUME)
+						HeadingCtrl_Reset(&headingCtrl);
+					held = CMD_RESUME;
+					break;
+				case CMD_SPEED:
+					fullSpeed = cmd->fullSpeed;
+					if (cmd->turnSpeed >= 0)
+						turnSpeed = cmd->turnSpeed;
+					headingCtrl.g.baseDuty = fullSpeed;
+					break;
+			}
+		}
+
+		//Get Positional and Heading Data, either by polling or by sleeping until the GPS publishes a new snapshot
+		int newFix = 1;
+		if (tickRate > 0.0) {
+			//Fixed rate: sleep to the next deadline and pick up any fix that arrived during the tick
+			lateNs = RT_Wait(&ticker);
+			PROF_MARK(tTick);
+			newFix = GPSFix_Wait(&fix, fix.seq, 0);
+		}
+		if (estRate > 0.0) {
+			//Fuse the fix, then steer on the pose predicted for now
+			double dutyL, dutyR;
+			PROF_START(tEst);
+			if (newFix && (fix.lat != lat || fix.lon != lon)) { //Not just a heading update
+				Est_Fix(&est, fix.posRxNs, fix.lat, fix.lon, fix.head, fix.speed / 3.6, 1);
+				lat = fix.lat;
+				lon = fix.lon;
+			}
+			Motors_GetDuties(&dutyL, &dutyR);
+			Est_Command(&est, GPSFix_NowNs(), dutyL, dutyR);
+			if (Est_PoseAt(&est, GPSFix_NowNs(), &pose) != 0)
+				continue; //No fix yet
+			PROF_END(PROF_ESTIMATOR, tEst);
+			head = pose.head;
+			speed = pose.speed * 3.6;
+		} else {
+			if (tickRate > 0.0) {
+				if (!newFix) {
+					Motors_Update(); //Keep the ramps moving between fixes
+					continue;
+				}
+			} else if (pollMode) {
+				HAL_GPS_Poll(&fix);
+			} else if (!GPSFix_Wait(&fix, fix.seq, FIX_WAIT_MS) && !resumeUntil) {
+				continue; //While resuming, a timeout still goes through the GPS check below
+			}
+			PROF_MARK(tTick);
+			lat = fix.lat;
+			lon = fix.lon;
+			head = fix.head;
+			speed = fix.speed;
+		}
+
+		//GPS unplugged or not attached yet: stop this tick, and steer again only on a position from after it re-attaches.
+		//After a restart the saved pose is trusted for CKPT_TRUST_MS instead: the estimator dead-reckons from it
+		//with -e, otherwise the saved wheel commands carry on
+		int gpsReady = Sup_GPSReady(fix.posRxNs, fix.fixState);
+		if (gpsReady) {
+			resumeUntil = 0;
+		} else if (GPSFix_NowNs() < resumeUntil && estRate > 0.0) {
+			gpsReady = 1;
+		} else if (GPSFix_NowNs() < resumeUntil) {
+			Motors_Update();
+			if (pollMode)
+				usleep(100);
+			continue;
+		}
+		if (!gpsReady) {
+			Motors_Disable();
+			if (!gpsHeld) {
+				gpsHeld = 1;
+				snprintf(dash.mode, sizeof(dash.mode), "no GPS");
+				dash.dutyL = dash.dutyR = 0;
+				dash.fixState = 0;
+				Dash_Publish(&dash);
+			}
+			if (pollMode)
+				usleep(100);
+			continue;
+		}
+		if (gpsHeld) {
+			gpsHeld = 0;
+			HeadingCtrl_Reset(&headingCtrl); //Don't carry the integral or derivative across the outage
+			lastTick = GPSFix_NowNs();
+		}
+		wakes++;
+		if (newFix) {
+			fixCount++;
+			PROF_ADD(PROF_FIX_AGE, GPSFix_NowNs() - fix.rxNs);
+		}
+
+		PROF_START(tNav);
+		status = estRate > 0.0 ? Mission_Update(&mission, pose.lat, pose.lon, &nav) : Mission_Update(&mission, lat, lon, &nav);
+		bearingToTarget = nav.bearing;
+		error = getHeadingError(bearingToTarget, head);
+		PROF_END(PROF_NAV, tNav);
+
+		//Log each fix, the dashboard thread picks the state up at its own rate
+		if (newFix) {
+			PROF_START(tLog);
+			LogRecord rec = {fix.lat, fix.lon, fix.head, fix.timeMs, fix.fixState};
+			Log_Write(&rec);
+			PROF_END(PROF_LOG, tLog);
+		}
+		PROF_START(tControl);
+		uint64_t now = GPSFix_NowNs();
+		if (nav.arrived)
+			HeadingCtrl_Reset(&headingCtrl); //New leg
+		if (status == MISSION_ARRIVED || held == CMD_STOP)
+			Motors_Disable(); //Hold at the final waypoint, or cut by the operator
+		else if (held == CMD_PAUSE)
+			Motors_Drive(0, 0); //Ramp down and hold
+		else if (bucketMode)
+			set_turnmode(error);
+		else
+			set_heading_pid(&headingCtrl, bearingToTarget - head, speed, (now - lastTick) / 1e9);
+		lastTick = now;
+		PROF_END(PROF_CONTROL, tControl);
+
+		PROF_START(tDisplay);
+		dash.lat = estRate > 0.0 ? pose.lat : lat;
+		dash.lon = estRate > 0.0 ? pose.lon : lon;
+		dash.head = head;
+		dash.bearing = bearingToTarget;
+		dash.error = error;
+		dash.speed = speed;
+		dash.distance = nav.distance;
+		dash.crossTrack = nav.crossTrack;
+		dash.leg = (int32_t)mission.leg + 1;
+		dash.count = (int32_t)mission.count;
+		dash.fixState = fix.fixState;
+		dash.arrived = (status == MISSION_ARRIVED);
+		if (dash.arrived || held != CMD_RESUME) {
+			snprintf(dash.mode, sizeof(dash.mode), dash.arrived ? "stopped" : held == CMD_PAUSE ? "paused" : "halted");
+			dash.dutyL = dash.dutyR = 0;
+		}
+		Dash_Publish(&dash);
+
+		telem.tNs = GPSFix_NowNs();
+		telem.ticks = wakes;
+		telem.fixes = fixCount;
+		telem.fixRxNs = fix.rxNs;
+		telem.overruns = tickRate > 0.0 ? ticker.overruns : 0;
+		telem.lat = fix.lat;
+		telem.lon = fix.lon;
+		telem.gpsHead = fix.head;
+		telem.gpsSpeed = fix.speed;
+		telem.gpsTimeMs = fix.timeMs;
+		telem.fixState = fix.fixState;
+		telem.navLat = dash.lat;
+		telem.navLon = dash.lon;
+		telem.head = head;
+		telem.bearing = bearingToTarget;
+		telem.error = error;
+		telem.distance = nav.distance;
+		telem.crossTrack = nav.crossTrack;
+		telem.dutyL = dash.dutyL;
+		telem.dutyR = dash.dutyR;
+		Motors_GetDuties(&telem.appliedL, &telem.appliedR);
+		telem.leg = (int32_t)mission.leg;
+		telem.count = (int32_t)mission.count;
+		telem.status = status;
+		memcpy(telem.mode, dash.mode, sizeof(telem.mode));
+		Telem_Publish(&telem);
+
+		sample.tNs = telem.tNs;
+		sample.lat = fix.lat;
+		sample.lon = fix.lon;
+		sample.head = head;
+		sample.error = HeadingCtrl_Wrap(error);
+		sample.speed = speed;
+		sample.distance = nav.distance;
+		sample.crossTrack = nav.crossTrack;
+		sample.fixAgeMs = (telem.tNs - fix.rxNs) / 1e6;
+		sample.lateUs = lateNs / 1e3;
+		sample.dutyL = dash.dutyL;
+		sample.dutyR = dash.dutyR;
+		sample.leg = (int)mission.leg;
+		sample.fixState = fix.fixState;
+		sample.status = status;
+		Stream_Push(&sample);
+
+		//Checkpoint for a restart: a copy into the mapped file, synced by its own thread
+		CkptRecord rec = {0};
+		rec.routeId = routeId;
+		rec.leg = (uint32_t)mission.leg;
+		rec.count = (uint32_t)mission.count;
+		rec.status = status;
+		rec.arrivals = mission.arrivals;
+		rec.fixLat = fix.lat;
+		rec.fixLon = fix.lon;
+		rec.fixHead = fix.head;
+		rec.fixSpeed = fix.speed;
+		rec.fixTimeMs = fix.timeMs;
+		rec.fixState = fix.fixState;
+		rec.lat = dash.lat;
+		rec.lon = dash.lon;
+		rec.head = head;
+		rec.speed = speed;
+		rec.posSd = estRate > 0.0 ? pose.posSd : 0.0;
+		rec.dutyL = dash.dutyL;
+		rec.dutyR = dash.dutyR;
+		rec.appliedL = telem.appliedL;
+		rec.appliedR = telem.appliedR;
+		Ckpt_Save(&ckpt, &rec);
+		saved = rec;
+		PROF_END(PROF_DISPLAY, tDisplay);
+		PROF_END(PROF_TICK, tTick);
+		if (pollMode)
+			usleep(100);
 	}
 
-	//Close file to ensure buffer is successfully emptied on close & disable the motors
-	fclose(fp);
+	Dash_Stop();
+	Telem_Destroy();
+	Stream_Close();
+	Cmd_Stop();
+	printf("Exit!\n");
+	printLoopStats(estRate > 0.0 ? "Estimator" : tickRate > 0.0 ? "Fixed rate" : pollMode ? "Polling" : "Event", wakes, loopStart);
+	if (tickRate > 0.0)
+		RT_PrintStats(&ticker, rtRate > 0.0 ? "Real-time" : "Control");
+	if (estRate > 0.0)
+		printf("Estimator: %lu fixes, %lu gated out, %lu resets\n", est.fixes, est.rejected, est.resets);
+	Est_Free(&est);
+	Prof_Dump();
+
+	//Disable the motors first, then let the logger empty its buffer onto the card. The last checkpoint is saved
+	//with the wheels stopped, so a deliberate stop keeps the progress but does not drive off on the next start
 	Motors_Disable();
+	if (saved.seq) {
+		saved.dutyL = saved.dutyR = saved.appliedL = saved.appliedR = 0.0;
+		Ckpt_Save(&ckpt, &saved);
+	}
+	printf("Checkpoint: %lu saves\n", ckpt.saves);
+	Ckpt_Close(&ckpt);
+	PWM_Stop();
+	PWM_PrintJitter();
+	Motors_PrintStats();
+	Log_Close();
+	Log_PrintStats();
+	Sup_Stop();
+	Sup_PrintStats();
+	if (streamHost[0])
+		Stream_PrintStats();
+	if (cmdPort > 0)
+		Cmd_PrintStats();
+	printf("Mission: %lu of %zu waypoints reached, %lu frame re-anchors\n", mission.arrivals, mission.count, mission.frame.reanchors);
+	Mission_Free(&mission);
+#ifdef HAL_MOCK
+	printf("Mock GPIO: %llu writes, saved to mock_gpio.csv\n", (unsigned long long)HALMock_WriteCount());
+	HALMock_SaveWrites("mock_gpio.csv");
+#endif
 
 	return 0;
 	
@@ -0,0 +1,192 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: mission.c
+Source Description: Multi-waypoint route following with precomputed leg geometry, arrival radius and hysteresis
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "mission.h"
+#include "track_io.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: setLeg
+Function Description: Computes the geometry of one leg in the nav frame
+Input Parameters: leg - leg to fill, from, to - ends of the leg
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void setLeg(MissionLeg *leg, const NavPoint *from, const NavPoint *to) {
+	leg->from = *from;
+	leg->length = NavFrame_Distance(from, to);
+	if (leg->length > 0.0) {
+		leg->ue = (to->e - from->e) / leg->length;
+		leg->un = (to->n - from->n) / leg->length;
+	} else {
+		leg->ue = leg->un = 0.0;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: buildLegs
+Function Description: Recomputes every leg from the projected waypoints, after loading and after the nav frame
+                      re-anchors. Leg 0 keeps its start point, which is the first fix rather than a waypoint
+Input Parameters: m - mission, start - new start of leg 0, NULL to keep it
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void buildLegs(Mission *m, const NavPoint *start) {
+	if (start)
+		setLeg(&m->legs[0], start, &m->frame.wp[0]);
+	for (size_t i = 1; i < m->count; i++)
+		setLeg(&m->legs[i], &m->frame.wp[i - 1], &m->frame.wp[i]);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Mission_Init
+Function Description: Sets up a mission over a copy of a route, projecting it into a nav frame at its first point
+Input Parameters: m - mission, wps - route, n - number of waypoints, arriveM - arrival radius, hystM - hysteresis band
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+int Mission_Init(Mission *m, const Waypoint *wps, size_t n, double arriveM, double hystM) {
+	memset(m, 0, sizeof(*m));
+	m->arriveM = arriveM;
+	m->hystM = hystM;
+	NavFrame_Init(&m->frame, n ? wps[0].lat : 0.0, n ? wps[0].lon : 0.0, NAV_REANCHOR_M);
+	if (n == 0)
+		return 0;
+
+	m->wps = malloc(n * sizeof(Waypoint));
+	m->legs = calloc(n, sizeof(MissionLeg));
+	if (!m->wps || !m->legs) {
+		Mission_Free(m);
+		return -1;
+	}
+	memcpy(m->wps, wps, n * sizeof(Waypoint));
+	for (size_t i = 0; i < n; i++) {
+		if (NavFrame_AddWaypoint(&m->frame, wps[i].lat, wps[i].lon) < 0) {
+			Mission_Free(m);
+			return -1;
+		}
+	}
+	m->count = n;
+	buildLegs(m, NULL);
+	m->status = MISSION_ACTIVE;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Mission_Load
+Function Description: Loads a route from any file TrackIO_Load reads (CSV lat,lon rows, GPX wpt/rtept/trkpt)
+Input Parameters: m - mission, path - route file, arriveM - arrival radius, hystM - hysteresis band
+Output Parameters: 0 on success, -1 if the file can't be read or has no points
+/---------------------------------------------------------------------------------------------------------*/
+int Mission_Load(Mission *m, const char *path, double arriveM, double hystM) {
+	TrackList list = {0};
+	if (TrackIO_Load(path, &list) != 0 || list.count == 0) {
+		TrackIO_Free(&list);
+		return -1;
+	}
+	Waypoint *wps = malloc(list.count * sizeof(Waypoint));
+	if (!wps) {
+		TrackIO_Free(&list);
+		return -1;
+	}
+	for (size_t i = 0; i < list.count; i++) {
+		wps[i].lat = list.pts[i].lat;
+		wps[i].lon = list.pts[i].lon;
+	}
+	int rc = Mission_Init(m, wps, list.count, arriveM, hystM);
+	free(wps);
+	TrackIO_Free(&list);
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Mission_Update
+Function Description: Projects a fix, checks it against the active leg only and advances at most one leg. On the
+                      final waypoint the mission holds inside arriveM + hystM and resumes if pushed outside it
+Input Parameters: m - mission, lat, lon - fix
+Output Parameters: nav - bearing, distance and cross-track to the target, returns the mission status
+/---------------------------------------------------------------------------------------------------------*/
+MissionStatus Mission_Update(Mission *m, double lat, double lon, MissionNav *nav) {
+	memset(nav, 0, sizeof(*nav));
+	if (m->count == 0)
+		return MISSION_EMPTY;
+
+	NavPoint pos;
+	int reanchored = NavFrame_Update(&m->frame, lat, lon, &pos);
+	if (!m->started) {
+		m->started = 1;
+		buildLegs(m, &pos);
+	} else if (reanchored) {
+		NavPoint start;
+		NavFrame_Project(&m->frame, lat, lon, &start); //Leg 0 start is lost on a re-anchor, only matters on leg 0
+		buildLegs(m, m->leg == 0 ? &start : NULL);
+	}
+
+	const MissionLeg *leg = &m->legs[m->leg];
+	const NavPoint *target = &m->frame.wp[m->leg];
+	double de = pos.e - leg->from.e, dn = pos.n - leg->from.n;
+	double along = de * leg->ue + dn * leg->un;
+	nav->crossTrack = dn * leg->ue - de * leg->un;
+	nav->distance = NavFrame_Distance(&pos, target);
+	nav->bearing = NavFrame_Bearing(&pos, target);
+
+	double band = m->arriveM + m->hystM;
+	if (m->status == MISSION_ARRIVED) {
+		if (nav->distance > band)
+			m->status = MISSION_ACTIVE; //Pushed off the final waypoint
+		return m->status;
+	}
+
+	int passed = leg->length > 0.0 && along >= leg->length && nav->distance <= band;
+	if (nav->distance <= m->arriveM || passed) {
+		nav->arrived = 1;
+		m->arrivals++;
+		if (m->leg + 1 < m->count)
+			m->leg++;
+		else
+			m->status = MISSION_ARRIVED;
+	}
+	return m->status;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Mission_Restore
+Function Description: Puts a mission back where a checkpoint left it. The next update rebuilds the legs, and leg 0
+                      starts from that fix as it would on a fresh start
+Input Parameters: m - mission, leg - target waypoint, status - saved status, arrivals - waypoints reached so far
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Mission_Restore(Mission *m, size_t leg, MissionStatus status, unsigned long arrivals) {
+	if (m->count == 0)
+		return;
+	m->leg = leg < m->count ? leg : m->count - 1;
+	m->status = status == MISSION_ARRIVED ? MISSION_ARRIVED : MISSION_ACTIVE;
+	m->arrivals = arrivals;
+	m->started = 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Mission_Target
+Function Description: Current target waypoint
+Input Parameters: m - mission
+Output Parameters: Target, NULL for an empty mission
+/---------------------------------------------------------------------------------------------------------*/
+const Waypoint *Mission_Target(const Mission *m) {
+	return m->count ? &m->wps[m->leg] : NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Mission_Free
+Function Description: Frees the route and its nav frame
+Input Parameters: m - mission
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Mission_Free(Mission *m) {
+	free(m->wps);
+	free(m->legs);
+	NavFrame_Free(&m->frame);
+	m->wps = NULL;
+	m->legs = NULL;
+	m->count = 0;
+	m->status = MISSION_EMPTY;
+}
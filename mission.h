@@ -0,0 +1,70 @@
+#ifndef MISSION_h_
+#define MISSION_h_
+
+#include <stddef.h>
+#include "nav_frame.h"
+
+  /* Route following. A route of any length is loaded from GPX or CSV and each leg's geometry (start, unit
+    direction, length) is precomputed in the nav frame, so a tick only checks the active leg. A waypoint is reached
+    when the rover is within arriveM of it, or has crossed the line through it square to the leg while within
+    arriveM + hystM (GPS noise can carry the rover past just outside the radius). At most one leg advances per tick.
+    At the final waypoint the mission holds until the rover drifts beyond arriveM + hystM, then steers back.
+   */
+
+#define MISSION_ARRIVE_M 3.0 //Default arrival radius (m)
+#define MISSION_HYST_M   1.0 //Default hysteresis band outside the radius (m)
+
+//GPS waypoint typedef
+typedef struct waypoints {
+	double lat;
+	double lon;
+} Waypoint;
+
+//Leg geometry in the nav frame, leg i ends at waypoint i
+typedef struct {
+	NavPoint from;   //Start of the leg
+	double ue, un;   //Unit vector along the leg
+	double length;   //Leg length (m), 0 when there is no start point yet
+} MissionLeg;
+
+typedef enum {MISSION_EMPTY = 0, MISSION_ACTIVE, MISSION_ARRIVED} MissionStatus;
+
+typedef struct {
+	Waypoint *wps;
+	MissionLeg *legs;
+	size_t count;
+	size_t leg;            //Active leg, the index of the target waypoint
+	double arriveM, hystM;
+	NavFrame frame;        //Holds the projected waypoints
+	int started;           //Leg 0 starts at the first fix
+	MissionStatus status;
+	unsigned long arrivals;
+} Mission;
+
+//Per-tick navigation output
+typedef struct {
+	double bearing;     //Bearing to the target waypoint, 0 to 360
+	double distance;    //Distance to the target waypoint (m)
+	double crossTrack;  //Distance off the active leg (m), positive right of it
+	int arrived;        //1 on the tick a waypoint was reached
+} MissionNav;
+
+//Sets up a mission over a copy of n waypoints. Returns -1 if out of memory
+int Mission_Init(Mission *m, const Waypoint *wps, size_t n, double arriveM, double hystM);
+
+//Loads a route from a CSV, GPX or track file. Returns -1 if the file can't be read or is empty
+int Mission_Load(Mission *m, const char *path, double arriveM, double hystM);
+
+//Advances the mission with a fix and fills in the steering values
+MissionStatus Mission_Update(Mission *m, double lat, double lon, MissionNav *nav);
+
+//Resumes a saved mission at a target waypoint. Leg 0, if that is the target, restarts at the next fix
+void Mission_Restore(Mission *m, size_t leg, MissionStatus status, unsigned long arrivals);
+
+//Current target waypoint, NULL for an empty mission
+const Waypoint *Mission_Target(const Mission *m);
+
+//Frees the route
+void Mission_Free(Mission *m);
+
+#endif
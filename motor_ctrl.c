@@ -0,0 +1,159 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: motor_ctrl.c
+Source Description: Stateful differential drive controller. Ramps wheel commands within acceleration and slew 
+                    limits and only writes the pins and duties that actually change
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include "hal.h"
+#include "pwm_engine.h"
+#include "motor_ctrl.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: clampCmd
+Function Description: Limits a wheel command to [-100, 100]
+Input Parameters: v - command
+Output Parameters: Clamped command
+/---------------------------------------------------------------------------------------------------------*/
+static double clampCmd(double v) {
+	return v > 100.0 ? 100.0 : (v < -100.0 ? -100.0 : v);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: rampToward
+Function Description: Moves a command toward its target by no more than step
+Input Parameters: cmd - current command, target - requested command, step - largest change allowed
+Output Parameters: New command
+/---------------------------------------------------------------------------------------------------------*/
+static double rampToward(double cmd, double target, double step) {
+	if (target > cmd + step)
+		return cmd + step;
+	if (target < cmd - step)
+		return cmd - step;
+	return target;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: writeDir
+Function Description: Writes a wheel's direction pins if the direction changed. A stopped wheel keeps its 
+                      direction so a ramp through zero does not toggle pins twice
+Input Parameters: m - controller, dir1, dir2 - the wheel's pins, cached - written direction, cmd - wheel command
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void writeDir(MotorCtrl *m, int dir1, int dir2, int *cached, double cmd) {
+	int dir = cmd > 0.0 ? 1 : (cmd < 0.0 ? -1 : *cached);
+	if (dir == *cached) {
+		m->gpioSkipped += 2;
+		return;
+	}
+	HAL_DigitalWrite(dir1, dir < 0 ? HIGH : LOW);
+	HAL_DigitalWrite(dir2, dir > 0 ? HIGH : LOW);
+	*cached = dir;
+	m->gpioWrites += 2;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: apply
+Function Description: Writes the ramped commands: changed direction pins first, then both duties in one update
+Input Parameters: m - controller
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void apply(MotorCtrl *m) {
+	writeDir(m, m->pins.lDir1, m->pins.lDir2, &m->dirL, m->cmdL);
+	writeDir(m, m->pins.rDir1, m->pins.rDir2, &m->dirR, m->cmdR);
+
+	int dutyL = (int)lround(fabs(m->cmdL));
+	int dutyR = (int)lround(fabs(m->cmdR));
+	if (dutyL == m->dutyL && dutyR == m->dutyR) {
+		m->gpioSkipped++;
+		return;
+	}
+	int en[2] = {m->pins.lEn, m->pins.rEn};
+	int duty[2] = {dutyL, dutyR};
+	PWM_SetDuties(en, duty, 2);
+	m->dutyL = dutyL;
+	m->dutyR = dutyR;
+	m->gpioWrites++;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: MotorCtrl_Init
+Function Description: Sets up the controller and drives every pin to the stopped state once
+Input Parameters: m - controller, pins - driver pins, accel - % per second, maxStep - % per tick (0 = unlimited)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void MotorCtrl_Init(MotorCtrl *m, const MotorPins *pins, double accel, double maxStep) {
+	m->pins = *pins;
+	MotorCtrl_SetLimits(m, accel, maxStep);
+	m->gpioWrites = m->gpioSkipped = 0;
+
+	m->dirL = m->dirR = 2;      //Unknown, forces the first write
+	m->dutyL = m->dutyR = -1;
+	MotorCtrl_Stop(m);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: MotorCtrl_SetLimits
+Function Description: Changes the acceleration and slew limits
+Input Parameters: m - controller, accel - % per second, maxStep - % per tick (0 = unlimited)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void MotorCtrl_SetLimits(MotorCtrl *m, double accel, double maxStep) {
+	m->accel = accel > 0.0 ? accel : 0.0;
+	m->maxStep = maxStep > 0.0 ? maxStep : 0.0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: MotorCtrl_Command
+Function Description: Sets the requested wheel commands
+Input Parameters: m - controller, left, right - wheel commands, [-100, 100], negative is backwards
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void MotorCtrl_Command(MotorCtrl *m, double left, double right) {
+	m->targetL = clampCmd(left);
+	m->targetR = clampCmd(right);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: MotorCtrl_Tick
+Function Description: Advances both wheels toward their requests within the limits, then writes what changed
+Input Parameters: m - controller, dt - seconds since the previous tick
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void MotorCtrl_Tick(MotorCtrl *m, double dt) {
+	double step = 200.0; //Full reversal
+
+	if (m->accel > 0.0 && dt >= 0.0)
+		step = m->accel * dt;
+	if (m->maxStep > 0.0 && step > m->maxStep)
+		step = m->maxStep;
+
+	m->cmdL = rampToward(m->cmdL, m->targetL, step);
+	m->cmdR = rampToward(m->cmdR, m->targetR, step);
+	apply(m);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: MotorCtrl_Stop
+Function Description: Disables both motors at once, skipping the ramp
+Input Parameters: m - controller
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void MotorCtrl_Stop(MotorCtrl *m) {
+	m->targetL = m->targetR = 0.0;
+	m->cmdL = m->cmdR = 0.0;
+
+	if (m->dirL != 0) {
+		HAL_DigitalWrite(m->pins.lDir1, LOW);
+		HAL_DigitalWrite(m->pins.lDir2, LOW);
+		m->dirL = 0;
+		m->gpioWrites += 2;
+	}
+	if (m->dirR != 0) {
+		HAL_DigitalWrite(m->pins.rDir1, LOW);
+		HAL_DigitalWrite(m->pins.rDir2, LOW);
+		m->dirR = 0;
+		m->gpioWrites += 2;
+	}
+	apply(m);
+}
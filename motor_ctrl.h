@@ -0,0 +1,43 @@
+#ifndef MOTOR_CTRL_h_
+#define MOTOR_CTRL_h_
+
+#include <stdint.h>
+
+#define MOTOR_DEFAULT_ACCEL 400.0   //Default acceleration limit (% duty per second)
+#define MOTOR_DEFAULT_STEP  50.0    //Default slew limit (% duty per tick)
+
+//Driver pins of one differential drive
+typedef struct {
+	int lDir1, lDir2, lEn;
+	int rDir1, rDir2, rEn;
+} MotorPins;
+
+//Differential drive controller. Caches what was last written so only changed pins are touched
+typedef struct {
+	MotorPins pins;
+	double accel;           //Acceleration limit (% per second), 0 = unlimited
+	double maxStep;         //Slew limit (% per tick), 0 = unlimited
+	double targetL, targetR;    //Requested wheel commands [-100, 100]
+	double cmdL, cmdR;          //Ramped wheel commands [-100, 100]
+	int dirL, dirR;             //Direction pins as written: 1 forwards, -1 backwards, 0 off
+	int dutyL, dutyR;           //Enable duties as written
+	unsigned long gpioWrites;   //Pin writes and duty updates issued
+	unsigned long gpioSkipped;  //Pin writes and duty updates avoided because nothing changed
+} MotorCtrl;
+
+//Set up the controller, write every pin once and start stopped
+void MotorCtrl_Init(MotorCtrl *m, const MotorPins *pins, double accel, double maxStep);
+
+//Change the acceleration and slew limits
+void MotorCtrl_SetLimits(MotorCtrl *m, double accel, double maxStep);
+
+//Request wheel commands in [-100, 100], negative is backwards. Applied by MotorCtrl_Tick
+void MotorCtrl_Command(MotorCtrl *m, double left, double right);
+
+//Ramp toward the request by at most min(accel * dt, maxStep) and write whatever changed
+void MotorCtrl_Tick(MotorCtrl *m, double dt);
+
+//Stop immediately, no ramp: direction pins low and both enables off
+void MotorCtrl_Stop(MotorCtrl *m);
+
+#endif
@@ -0,0 +1,174 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: nav_frame.c
+Source Description: Local east-north tangent plane. Waypoints are projected once, fixes with a few multiply-adds,
+                    so the control loop needs no spherical trig per tick
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <math.h>
+#include "nav_frame.h"
+#include "geodesy.h"
+
+#define WGS84_A  6378137.0             //Semi-major axis (m)
+#define WGS84_E2 6.69437999014e-3      //First eccentricity squared
+#define RAD_PER_DEG (GEO_PI / 180.0)
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Init
+Function Description: Sets up an empty frame
+Input Parameters: f - frame, lat0, lon0 - origin, reanchorM - distance from the origin that triggers a re-anchor,
+                  0 to never re-anchor
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void NavFrame_Init(NavFrame *f, double lat0, double lon0, double reanchorM) {
+	f->wpLat = f->wpLon = NULL;
+	f->wp = NULL;
+	f->count = f->cap = 0;
+	f->reanchors = 0;
+	f->reanchorM = reanchorM;
+	NavFrame_Anchor(f, lat0, lon0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Anchor
+Function Description: Moves the origin, recomputes the scales from the WGS84 radii of curvature there and
+                      re-projects the waypoints
+Input Parameters: f - frame, lat0, lon0 - new origin
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void NavFrame_Anchor(NavFrame *f, double lat0, double lon0) {
+	double s = sin(lat0 * RAD_PER_DEG), c = cos(lat0 * RAD_PER_DEG);
+	double w = 1.0 - WGS84_E2 * s * s;
+	double rN = WGS84_A / sqrt(w);                    //Prime vertical radius
+	double rM = WGS84_A * (1.0 - WGS84_E2) / (w * sqrt(w)); //Meridian radius
+
+	f->lat0 = lat0;
+	f->lon0 = lon0;
+	f->kLat = rM * RAD_PER_DEG;
+	f->kLon = rN * c * RAD_PER_DEG;
+	f->kLonLat = -rM * s * RAD_PER_DEG * RAD_PER_DEG; //d(rN cos(lat))/d(lat) = -rM sin(lat)
+
+	for (size_t i = 0; i < f->count; i++)
+		NavFrame_Project(f, f->wpLat[i], f->wpLon[i], &f->wp[i]);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_AddWaypoint
+Function Description: Projects a waypoint into the frame and keeps it for later re-anchors
+Input Parameters: f - frame, lat, lon - waypoint
+Output Parameters: Index of the waypoint in f->wp, -1 when out of memory
+/---------------------------------------------------------------------------------------------------------*/
+long NavFrame_AddWaypoint(NavFrame *f, double lat, double lon) {
+	if (f->count == f->cap) {
+		size_t cap = f->cap ? f->cap * 2 : 16;
+		double *wpLat = realloc(f->wpLat, cap * sizeof(double));
+		if (wpLat)
+			f->wpLat = wpLat;
+		double *wpLon = realloc(f->wpLon, cap * sizeof(double));
+		if (wpLon)
+			f->wpLon = wpLon;
+		NavPoint *wp = realloc(f->wp, cap * sizeof(NavPoint));
+		if (wp)
+			f->wp = wp;
+		if (!wpLat || !wpLon || !wp)
+			return -1;
+		f->cap = cap;
+	}
+	f->wpLat[f->count] = lat;
+	f->wpLon[f->count] = lon;
+	NavFrame_Project(f, lat, lon, &f->wp[f->count]);
+	return (long)f->count++;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_ClearWaypoints
+Function Description: Removes all waypoints, keeping the table for reuse
+Input Parameters: f - frame
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void NavFrame_ClearWaypoints(NavFrame *f) {
+	f->count = 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Project
+Function Description: Geographic to frame coordinates
+Input Parameters: f - frame, lat, lon - position
+Output Parameters: p - metres east and north of the origin
+/---------------------------------------------------------------------------------------------------------*/
+void NavFrame_Project(const NavFrame *f, double lat, double lon, NavPoint *p) {
+	double dLat = lat - f->lat0;
+	double dLon = lon - f->lon0;
+	if (dLon > 180.0)
+		dLon -= 360.0;
+	else if (dLon < -180.0)
+		dLon += 360.0;
+	p->n = dLat * f->kLat;
+	p->e = dLon * (f->kLon + dLat * f->kLonLat);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Unproject
+Function Description: Frame to geographic coordinates, the inverse of NavFrame_Project
+Input Parameters: f - frame, p - metres east and north of the origin
+Output Parameters: lat, lon - position
+/---------------------------------------------------------------------------------------------------------*/
+void NavFrame_Unproject(const NavFrame *f, const NavPoint *p, double *lat, double *lon) {
+	double dLat = p->n / f->kLat;
+	*lat = f->lat0 + dLat;
+	*lon = f->lon0 + p->e / (f->kLon + dLat * f->kLonLat);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Update
+Function Description: Projects a fix. When the fix is further than reanchorM from the origin the frame is first
+                      re-anchored on it, which re-projects every waypoint
+Input Parameters: f - frame, lat, lon - fix
+Output Parameters: p - fix in the frame, returns 1 if the frame was re-anchored
+/---------------------------------------------------------------------------------------------------------*/
+int NavFrame_Update(NavFrame *f, double lat, double lon, NavPoint *p) {
+	NavFrame_Project(f, lat, lon, p);
+	if (f->reanchorM <= 0.0 || p->e * p->e + p->n * p->n <= f->reanchorM * f->reanchorM)
+		return 0;
+	NavFrame_Anchor(f, lat, lon);
+	f->reanchors++;
+	p->e = p->n = 0.0;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Bearing
+Function Description: Grid bearing between two frame points
+Input Parameters: from, to - frame points
+Output Parameters: Bearing, 0 to 360 clockwise from north
+/---------------------------------------------------------------------------------------------------------*/
+double NavFrame_Bearing(const NavPoint *from, const NavPoint *to) {
+	double b = atan2(to->e - from->e, to->n - from->n) * (180.0 / GEO_PI);
+	return b < 0.0 ? b + 360.0 : b;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Distance
+Function Description: Straight line distance between two frame points
+Input Parameters: from, to - frame points
+Output Parameters: Distance in metres
+/---------------------------------------------------------------------------------------------------------*/
+double NavFrame_Distance(const NavPoint *from, const NavPoint *to) {
+	double de = to->e - from->e, dn = to->n - from->n;
+	return sqrt(de * de + dn * dn); //No overflow at these scales, hypot() costs several times more
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: NavFrame_Free
+Function Description: Frees the waypoint table
+Input Parameters: f - frame
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void NavFrame_Free(NavFrame *f) {
+	free(f->wpLat);
+	free(f->wpLon);
+	free(f->wp);
+	f->wpLat = f->wpLon = NULL;
+	f->wp = NULL;
+	f->count = f->cap = 0;
+}
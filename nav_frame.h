@@ -0,0 +1,63 @@
+#ifndef NAV_FRAME_h_
+#define NAV_FRAME_h_
+
+#include <stddef.h>
+
+  /* Local east-north tangent plane for per-tick navigation. Waypoints are projected once when added; each fix is
+    then two subtractions and three multiply-adds, and bearing and distance are one atan2 and one square root in metres.
+    The projection uses the WGS84 radii of curvature at the origin plus the first-order change of the east scale
+    with latitude, so positions agree with a true ENU frame to 1 mm within 100 m of the origin and 10 cm at 1 km.
+    Grid north also drifts from true north by (longitude difference) * sin(latitude), 0.01 degrees at 1 km east
+    at the rover's latitude, so the frame re-anchors on the rover once it is more than reanchorM from the origin.
+   */
+
+#define NAV_REANCHOR_M 1000.0 //Default re-anchor distance (m)
+
+//Position in the frame, metres east and north of the origin
+typedef struct {
+	double e;
+	double n;
+} NavPoint;
+
+typedef struct {
+	double lat0, lon0;   //Origin (degrees)
+	double kLat, kLon;   //Metres per degree of latitude and longitude at the origin
+	double kLonLat;      //Change of kLon per degree of latitude
+	double reanchorM;    //Distance from the origin that triggers a re-anchor, 0 = never
+	double *wpLat, *wpLon;  //Waypoints as added, kept to re-project on a re-anchor
+	NavPoint *wp;           //Waypoints in the frame
+	size_t count, cap;
+	unsigned long reanchors;
+} NavFrame;
+
+//Sets up an empty frame at an origin
+void NavFrame_Init(NavFrame *f, double lat0, double lon0, double reanchorM);
+
+//Moves the origin and re-projects the waypoints
+void NavFrame_Anchor(NavFrame *f, double lat0, double lon0);
+
+//Projects a waypoint and returns its index, or -1 when out of memory
+long NavFrame_AddWaypoint(NavFrame *f, double lat, double lon);
+
+//Removes all waypoints
+void NavFrame_ClearWaypoints(NavFrame *f);
+
+//Geographic to frame coordinates
+void NavFrame_Project(const NavFrame *f, double lat, double lon, NavPoint *p);
+
+//Frame to geographic coordinates
+void NavFrame_Unproject(const NavFrame *f, const NavPoint *p, double *lat, double *lon);
+
+//Projects a fix, re-anchoring on it first when it is too far from the origin. Returns 1 if it re-anchored
+int NavFrame_Update(NavFrame *f, double lat, double lon, NavPoint *p);
+
+//Bearing between frame points, 0 to 360 clockwise from north
+double NavFrame_Bearing(const NavPoint *from, const NavPoint *to);
+
+//Distance between frame points (m)
+double NavFrame_Distance(const NavPoint *from, const NavPoint *to);
+
+//Frees the waypoint table
+void NavFrame_Free(NavFrame *f);
+
+#endif
@@ -0,0 +1,121 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: navigator.c
+Source Description: Bearing and turn mode logic shared by the rover and the replay tool. No hardware access
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include "navigator.h"
+#include "geodesy.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: getTargetBearing
+Function Description: Calculates bearing to target based on the latitute and longitude data of the robot and the target
+Input Parameters: lat, lon (Robot Lat, long values), tlat, tlon (Target Lat, Long values)
+Output Parameters:The target bearing, 0 to 360 clockwise from north
+/---------------------------------------------------------------------------------------------------------*/
+double getTargetBearing(double lat, double lon, double tLat, double tLon) {
+	return Geo_Bearing(lat, lon, tLat, tLon);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: getBearingError
+Function Description: Calculates the error value between the current bearing and the target bearing
+Input Parameters: head is the target heading, bearing is the robots current bearing 
+Output Parameters: Bearing error value
+/---------------------------------------------------------------------------------------------------------*/
+double getBearingError(double head, double bearing) {
+	return bearing - head;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: getHeadingError
+Function Description: The error fed to get_turnmode: bearing - heading normalised to the clockwise turn needed,
+                      so 350 means 10 degrees anticlockwise
+Input Parameters: bearing - bearing to the target, head - the robots current heading
+Output Parameters: Heading error, 0 to 360
+/---------------------------------------------------------------------------------------------------------*/
+double getHeadingError(double bearing, double head) {
+	double error = fmod(getBearingError(head, bearing), 360.0);
+	if (error < 0.0)
+		error += 360.0;
+	return error >= 360.0 ? 0.0 : error;
+}
+
+//The hand-picked table set_turnmode has always used
+const int turnThresholds[TURN_THRESHOLDS] = {100, 900, 1800, 2700, 3500};
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: get_turnmode
+Function Description: Picks the motor action for the error bearing between the robot and the waypoint
+Input Parameters: f_error - The bearing error between the robot and the waypoint
+Output Parameters: Motor action
+/---------------------------------------------------------------------------------------------------------*/
+TurnMode get_turnmode(double f_error) {
+	return get_turnmode_table(f_error, turnThresholds);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: get_turnmode_table
+Function Description: Picks the motor action for the error bearing from a turn table
+Input Parameters: f_error - The bearing error between the robot and the waypoint, t - turn table (tenths of a degree)
+Output Parameters: Motor action
+/---------------------------------------------------------------------------------------------------------*/
+TurnMode get_turnmode_table(double f_error, const int t[TURN_THRESHOLDS]) {
+	f_error = f_error*10.0f;
+	int error = (int)f_error; //typecast to int for comparison
+	if (error < t[0] || error >= t[4]) {
+		return TURN_FORWARDS;
+	} else if (error < t[1] && error >= t[0]) {
+		return TURN_SMOOTH_LEFT;
+	} else if (error < t[2] && error >= t[1]) {
+		return TURN_HARD_LEFT;
+	} else if (error < t[3] && error >= t[2]) {
+		return TURN_HARD_RIGHT;
+	} else if (error < t[4] && error >= t[3]) {
+		return TURN_SMOOTH_RIGHT;
+	}
+	return TURN_OFF; //Default off
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: turnmode_check
+Function Description: Checks a turn table can be used: ascending, from 0 to 3600 tenths of a degree
+Input Parameters: t - turn table
+Output Parameters: 0 if it can, -1 if not
+/---------------------------------------------------------------------------------------------------------*/
+int turnmode_check(const int t[TURN_THRESHOLDS]) {
+	if (t[0] < 0 || t[TURN_THRESHOLDS - 1] > 3600)
+		return -1;
+	for (int i = 1; i < TURN_THRESHOLDS; i++)
+		if (t[i] < t[i - 1])
+			return -1;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: turnmode_duties
+Function Description: Wheel duties for a motor action. The hard turns pivot at full duty either way
+Input Parameters: mode - motor action, full - duty when driving straight, turn - duty of the inner wheel on a smooth turn
+Output Parameters: left, right - wheel duties, both 0 for TURN_OFF
+/---------------------------------------------------------------------------------------------------------*/
+void turnmode_duties(TurnMode mode, int full, int turn, int *left, int *right) {
+	switch (mode) {
+		case TURN_FORWARDS:     *left = full; *right = full; break;
+		case TURN_SMOOTH_LEFT:  *left = full; *right = turn; break;
+		case TURN_HARD_LEFT:    *left = 100;  *right = -100; break;
+		case TURN_HARD_RIGHT:   *left = -100; *right = 100; break;
+		case TURN_SMOOTH_RIGHT: *left = turn; *right = full; break;
+		default:                *left = 0;    *right = 0; break;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: turnmode_name
+Function Description: Display name of a motor action
+Input Parameters: mode - motor action
+Output Parameters: Name string
+/---------------------------------------------------------------------------------------------------------*/
+const char *turnmode_name(TurnMode mode) {
+	static const char *names[] = {"Forwards", "Smooth Left", "Hard Left", "Hard Right", "Smooth Right", "out of range!!!"};
+	return (mode >= TURN_FORWARDS && mode <= TURN_OFF) ? names[mode] : names[TURN_OFF];
+}
@@ -0,0 +1,37 @@
+#ifndef NAVIGATOR_h_
+#define NAVIGATOR_h_
+
+//Motor actions chosen from the heading error
+typedef enum {TURN_FORWARDS = 0, TURN_SMOOTH_LEFT, TURN_HARD_LEFT, TURN_HARD_RIGHT, TURN_SMOOTH_RIGHT, TURN_OFF} TurnMode;
+
+#define TURN_THRESHOLDS 5
+
+//Turn table: where each motor action starts, in tenths of a degree of clockwise heading error. Smooth left from
+//[0], hard left from [1], hard right from [2], smooth right from [3] and forwards again from [4]
+extern const int turnThresholds[TURN_THRESHOLDS];
+
+//Bearing from the robot to the target
+double getTargetBearing(double lat, double lon, double tLat, double tLon);
+
+//Signed difference between bearing and heading
+double getBearingError(double head, double bearing);
+
+//Clockwise turn from heading to bearing, 0 to 360
+double getHeadingError(double bearing, double head);
+
+//Motor action for a heading error
+TurnMode get_turnmode(double f_error);
+
+//Motor action for a heading error over a turn table
+TurnMode get_turnmode_table(double f_error, const int t[TURN_THRESHOLDS]);
+
+//Checks a turn table is ascending and within 0 to 3600. Returns -1 if not
+int turnmode_check(const int t[TURN_THRESHOLDS]);
+
+//Wheel duties of a motor action, as driven by set_turnmode. full, turn - straight and inner wheel duties
+void turnmode_duties(TurnMode mode, int full, int turn, int *left, int *right);
+
+//Display name of a motor action
+const char *turnmode_name(TurnMode mode);
+
+#endif
@@ -0,0 +1,256 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: pool.c
+Source Description: Work-stealing thread pool: per-worker task ranges taken from the front by their owner and
+                    split from the back by idle workers, with no locks on the task path
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pool.h"
+
+//One worker's remaining range, next in the low half and end in the high half. Own cache line each
+typedef struct {
+	_Alignas(64) _Atomic uint64_t range;
+} PoolRange;
+
+//Argument for a worker thread
+typedef struct {
+	struct Pool *pool;
+	int id;
+} PoolWorker;
+
+struct Pool {
+	int threads;
+	pthread_t tid[POOL_MAX_THREADS];
+	PoolWorker workers[POOL_MAX_THREADS];
+	PoolRange *ranges;
+
+	//Batch hand-off, once per Pool_Run
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	unsigned long batch;     //Incremented to start a batch
+	int busy;                //Workers still in the batch
+	int quit;
+	PoolFn fn;
+	void *ctx;
+
+	_Atomic unsigned long steals;
+};
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: pack / rangeNext / rangeEnd
+Function Description: Packs a range into one word and reads it back
+Input Parameters: next, end - task indices; r - packed range
+Output Parameters: Packed range, or its next or end index
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t pack(uint32_t next, uint32_t end) {
+	return (uint64_t)end << 32 | next;
+}
+
+static uint32_t rangeNext(uint64_t r) {
+	return (uint32_t)r;
+}
+
+static uint32_t rangeEnd(uint64_t r) {
+	return (uint32_t)(r >> 32);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: take
+Function Description: Takes the next task from the front of a worker's own range
+Input Parameters: r - the worker's range, task - task out
+Output Parameters: 1 if a task was taken, 0 if the range is empty
+/---------------------------------------------------------------------------------------------------------*/
+static int take(PoolRange *r, uint32_t *task) {
+	uint64_t old = atomic_load_explicit(&r->range, memory_order_relaxed);
+	while (rangeNext(old) < rangeEnd(old)) {
+		if (atomic_compare_exchange_weak_explicit(&r->range, &old, pack(rangeNext(old) + 1, rangeEnd(old)),
+			memory_order_acq_rel, memory_order_relaxed)) {
+			*task = rangeNext(old);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: steal
+Function Description: Moves the back half of the fullest other range into an idle worker's own range. Only its
+                      owner refills a range, so the thief's empty range can be overwritten with a plain store
+Input Parameters: p - pool, id - the idle worker
+Output Parameters: 1 if anything was stolen, 0 if every range is empty
+/---------------------------------------------------------------------------------------------------------*/
+static int steal(Pool *p, int id) {
+	for (;;) {
+		int victim = -1;
+		uint32_t most = 0;
+		uint64_t seen = 0;
+		for (int i = 0; i < p->threads; i++) {
+			uint64_t r = atomic_load_explicit(&p->ranges[i].range, memory_order_relaxed);
+			uint32_t left = rangeEnd(r) - rangeNext(r);
+			if (i != id && rangeNext(r) < rangeEnd(r) && left > most) {
+				victim = i;
+				most = left;
+				seen = r;
+			}
+		}
+		if (victim < 0)
+			return 0;
+
+		uint32_t split = rangeEnd(seen) - (most + 1) / 2;
+		if (atomic_compare_exchange_strong_explicit(&p->ranges[victim].range, &seen, pack(rangeNext(seen), split),
+			memory_order_acq_rel, memory_order_relaxed)) {
+			atomic_store_explicit(&p->ranges[id].range, pack(split, rangeEnd(seen)), memory_order_release);
+			atomic_fetch_add_explicit(&p->steals, 1, memory_order_relaxed);
+			return 1;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: work
+Function Description: Runs tasks from a worker's own range, stealing when it runs dry, until nothing is left
+Input Parameters: p - pool, id - worker
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void work(Pool *p, int id) {
+	uint32_t task;
+	do {
+		while (take(&p->ranges[id], &task))
+			p->fn(p->ctx, task);
+	} while (steal(p, id));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: workerThread
+Function Description: Waits for each batch, works it, and reports back
+Input Parameters: arg - PoolWorker
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *workerThread(void *arg) {
+	PoolWorker *w = arg;
+	Pool *p = w->pool;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (p->batch == seen && !p->quit)
+			pthread_cond_wait(&p->start, &p->lock);
+		if (p->quit)
+			break;
+		seen = p->batch;
+		pthread_mutex_unlock(&p->lock);
+
+		work(p, w->id);
+
+		pthread_mutex_lock(&p->lock);
+		if (--p->busy == 0)
+			pthread_cond_signal(&p->done);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Pool_Create
+Function Description: Allocates the pool and starts its workers. Fewer workers than asked for is not an error
+Input Parameters: threads - threads to work batches, the caller included
+Output Parameters: Pool, or NULL if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+Pool *Pool_Create(int threads) {
+	if (threads < 1)
+		threads = 1;
+	if (threads > POOL_MAX_THREADS)
+		threads = POOL_MAX_THREADS;
+
+	Pool *p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+	p->ranges = aligned_alloc(64, sizeof(PoolRange) * POOL_MAX_THREADS);
+	if (!p->ranges) {
+		free(p);
+		return NULL;
+	}
+	for (int i = 0; i < POOL_MAX_THREADS; i++)
+		atomic_init(&p->ranges[i].range, 0);
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->start, NULL);
+	pthread_cond_init(&p->done, NULL);
+
+	p->threads = 1;
+	for (int i = 1; i < threads; i++) {
+		p->workers[i].pool = p;
+		p->workers[i].id = i;
+		if (pthread_create(&p->tid[i], NULL, workerThread, &p->workers[i]) != 0)
+			break;
+		p->threads++;
+	}
+	return p;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Pool_Run
+Function Description: Deals out the tasks, wakes the workers, works as worker 0 and waits for the rest
+Input Parameters: p - pool, count - tasks, fn - task function, ctx - passed to fn
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Pool_Run(Pool *p, size_t count, PoolFn fn, void *ctx) {
+	uint32_t n = count > UINT32_MAX ? UINT32_MAX : (uint32_t)count;
+	for (int i = 0; i < p->threads; i++) {
+		uint32_t lo = (uint32_t)((uint64_t)n * i / p->threads);
+		uint32_t hi = (uint32_t)((uint64_t)n * (i + 1) / p->threads);
+		atomic_store_explicit(&p->ranges[i].range, pack(lo, hi), memory_order_relaxed);
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->fn = fn;
+	p->ctx = ctx;
+	p->busy = p->threads - 1;
+	p->batch++;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	work(p, 0);
+
+	pthread_mutex_lock(&p->lock);
+	while (p->busy > 0)
+		pthread_cond_wait(&p->done, &p->lock);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Pool_Threads / Pool_Steals
+Function Description: Pool size, and the number of successful steals so far
+Input Parameters: p - pool
+Output Parameters: Count
+/---------------------------------------------------------------------------------------------------------*/
+int Pool_Threads(const Pool *p) {
+	return p->threads;
+}
+
+unsigned long Pool_Steals(const Pool *p) {
+	return atomic_load_explicit(&((Pool *)p)->steals, memory_order_relaxed);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Pool_Destroy
+Function Description: Stops and joins the workers, then frees the pool
+Input Parameters: p - pool
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Pool_Destroy(Pool *p) {
+	if (!p)
+		return;
+	pthread_mutex_lock(&p->lock);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+	for (int i = 1; i < p->threads; i++)
+		pthread_join(p->tid[i], NULL);
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->start);
+	pthread_cond_destroy(&p->done);
+	free(p->ranges);
+	free(p);
+}
@@ -0,0 +1,37 @@
+#ifndef POOL_h_
+#define POOL_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+  /* Work-stealing thread pool for batches of independent tasks. Pool_Run deals the task indices out to the workers
+    in equal contiguous ranges. Each worker takes tasks from the front of its own range, and when that is empty it
+    steals the back half of the fullest other range. A range is one 64-bit word (next, end) changed only by
+    compare-and-swap, so taking a task or stealing never takes a lock. Tasks that finish early, such as rovers that
+    arrive, just leave more to steal. The calling thread works as worker 0.
+   */
+
+#define POOL_MAX_THREADS 256
+
+//Runs task number task of a batch
+typedef void (*PoolFn)(void *ctx, size_t task);
+
+typedef struct Pool Pool;
+
+//Starts threads-1 workers (the caller is the last). Returns NULL only if out of memory: workers that fail to start
+//are skipped, down to a pool where the caller runs every task itself
+Pool *Pool_Create(int threads);
+
+//Runs tasks 0 to count-1 across the pool and returns when all are done. One batch at a time
+void Pool_Run(Pool *p, size_t count, PoolFn fn, void *ctx);
+
+//Threads in the pool, the caller included
+int Pool_Threads(const Pool *p);
+
+//Successful steals over the pool's life
+unsigned long Pool_Steals(const Pool *p);
+
+//Stops the workers and frees the pool
+void Pool_Destroy(Pool *p);
+
+#endif
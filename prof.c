@@ -0,0 +1,187 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: prof.c
+Source Description: Lock-free per-stage latency histograms for the control loop, dumped on exit or SIGUSR1
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include "prof.h"
+
+#define PROF_CAL_LOOPS 100000  //Probes timed by the self-measurement
+
+typedef struct {
+	uint64_t bins[PROF_BUCKETS];  //Relaxed atomic increments
+	_Atomic uint64_t count, sum, max;
+} ProfHist;
+
+static ProfHist hists[PROF_STAGES];
+static ProfHist calHist;               //Scratch histogram for the self-measurement
+static double probeNs;                 //Measured cost of one PROF_START/PROF_END pair
+static uint64_t startNs;
+static volatile sig_atomic_t dumpRequested = 0;
+
+static const char *stageNames[PROF_STAGES] = {
+	"gps read", "fix age", "nav", "estimator", "control", "gpio", "display", "log", "tick"
+};
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: bucketOf / bucketTop
+Function Description: Maps a value to its bucket, and a bucket to the highest value it holds
+Input Parameters: ns - value, b - bucket
+Output Parameters: Bucket, or value
+/---------------------------------------------------------------------------------------------------------*/
+static int bucketOf(uint64_t ns) {
+	if (ns < PROF_SUB)
+		return (int)ns;
+	int shift = 63 - __builtin_clzll(ns) - PROF_SUB_BITS;
+	int b = (shift + 1) * PROF_SUB + (int)((ns >> shift) - PROF_SUB);
+	return b < PROF_BUCKETS ? b : PROF_BUCKETS - 1;
+}
+
+static uint64_t bucketTop(int b) {
+	if (b < PROF_SUB)
+		return (uint64_t)b;
+	int shift = b / PROF_SUB - 1;
+	uint64_t m = PROF_SUB + (uint64_t)(b % PROF_SUB);
+	return ((m + 1) << shift) - 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: record
+Function Description: Adds a sample to a histogram. Safe from any thread: every field is an atomic add, and the
+                      maximum is raised with compare-and-swap
+Input Parameters: h - histogram, ns - sample
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void record(ProfHist *h, uint64_t ns) {
+	__atomic_fetch_add(&h->bins[bucketOf(ns)], 1, __ATOMIC_RELAXED);
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->sum, ns, memory_order_relaxed);
+	uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	while (ns > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, ns, memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: onUsr1
+Function Description: SIGUSR1 handler. Only sets a flag, the dump is printed from Prof_Poll
+Input Parameters: signum
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void onUsr1(int signum) {
+	dumpRequested = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Prof_Init
+Function Description: Clears the histograms, times PROF_CAL_LOOPS probes into a scratch histogram to find the
+                      cost of one, and installs the SIGUSR1 handler
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Prof_Init(void) {
+	memset(hists, 0, sizeof(hists));
+	memset(&calHist, 0, sizeof(calHist));
+
+	uint64_t t0 = Prof_Now();
+	for (int i = 0; i < PROF_CAL_LOOPS; i++) {
+		uint64_t t = Prof_Now();
+		record(&calHist, Prof_Now() - t);
+	}
+	probeNs = (double)(Prof_Now() - t0) / PROF_CAL_LOOPS;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onUsr1;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGUSR1, &sa, NULL);
+	startNs = Prof_Now();
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Prof_Record
+Function Description: Adds one sample to a stage
+Input Parameters: stage - stage timed, ns - its duration
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Prof_Record(ProfStage stage, uint64_t ns) {
+	record(&hists[stage], ns);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Prof_Summary
+Function Description: Reads the percentiles of a stage. Each is the top of the bucket it falls in, capped at the
+                      true maximum
+Input Parameters: stage - stage to summarise, out - summary
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Prof_Summary(ProfStage stage, ProfSummary *out) {
+	const ProfHist *h = &hists[stage];
+	memset(out, 0, sizeof(*out));
+	out->count = atomic_load_explicit(&h->count, memory_order_relaxed);
+	out->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+	if (out->count == 0)
+		return;
+	out->mean = (double)atomic_load_explicit(&h->sum, memory_order_relaxed) / out->count;
+
+	//Bins may run slightly ahead of count while another thread records, the targets just land a sample later
+	const double q[3] = {0.5, 0.99, 0.999};
+	uint64_t *res[3] = {&out->p50, &out->p99, &out->p999};
+	uint64_t seen = 0;
+	int k = 0;
+	for (int b = 0; b < PROF_BUCKETS && k < 3; b++) {
+		seen += __atomic_load_n(&h->bins[b], __ATOMIC_RELAXED);
+		while (k < 3 && seen >= (uint64_t)(q[k] * out->count + 0.5)) {
+			*res[k] = bucketTop(b) < out->max ? bucketTop(b) : out->max;
+			k++;
+		}
+	}
+	for (; k < 3; k++)
+		*res[k] = out->max;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Prof_Dump
+Function Description: Prints the stages with samples in microseconds, and the probe overhead as a share of the
+                      time since Prof_Init
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Prof_Dump(void) {
+	uint64_t probes = 0;
+	printf("%-10s %10s %9s %9s %9s %9s %9s\n", "stage (us)", "count", "mean", "p50", "p99", "p99.9", "max");
+	for (int s = 0; s < PROF_STAGES; s++) {
+		ProfSummary sum;
+		Prof_Summary((ProfStage)s, &sum);
+		if (sum.count == 0)
+			continue;
+		probes += sum.count;
+		printf("%-10s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", stageNames[s], (unsigned long long)sum.count,
+			sum.mean / 1e3, sum.p50 / 1e3, sum.p99 / 1e3, sum.p999 / 1e3, sum.max / 1e3);
+	}
+#ifdef PROF_OFF
+	printf("Profiling compiled out (PROF_OFF)\n");
+#else
+	double wall = (double)(Prof_Now() - startNs);
+	printf("Profiling: %llu probes at %.0f ns each (self-measured), %.4f%% of %.1f s\n", (unsigned long long)probes,
+		probeNs, wall > 0.0 ? 100.0 * probes * probeNs / wall : 0.0, wall / 1e9);
+#endif
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Prof_Poll
+Function Description: Prints the dump if SIGUSR1 arrived since the last call. Called periodically from the thread
+                      that owns stdout
+Input Parameters: N/A
+Output Parameters: 1 if the dump was printed, 0 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int Prof_Poll(void) {
+	if (!dumpRequested)
+		return 0;
+	dumpRequested = 0;
+	Prof_Dump();
+	return 1;
+}
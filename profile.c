@@ -0,0 +1,187 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: profile.c
+Source Description: Reads and writes controller profiles: turn table, duty limits and heading controller gains
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include "profile.h"
+
+#define PROFILE_LINE_MAX 256
+
+//Heading controller settings read as one number each
+typedef struct {
+	const char *key;
+	size_t offset;           //Into HeadingGains
+	double lo, hi;           //Accepted range
+} ProfileGain;
+
+static const ProfileGain gainKeys[] = {
+	{"kp",        offsetof(HeadingGains, kp),       0.0, 100.0},
+	{"ki",        offsetof(HeadingGains, ki),       0.0, 100.0},
+	{"kd",        offsetof(HeadingGains, kd),       0.0, 100.0},
+	{"deadband",  offsetof(HeadingGains, deadband), 0.0, 180.0},
+	{"i_limit",   offsetof(HeadingGains, iLimit),   0.0, 100.0},
+	{"max_turn",  offsetof(HeadingGains, maxTurn),  0.0, 200.0},
+	{"pivot_deg", offsetof(HeadingGains, pivotDeg), 1.0, 180.0},
+	{"d_filter",  offsetof(HeadingGains, dFilter),  0.0, 10.0},
+};
+
+#define PROFILE_GAINS (sizeof(gainKeys) / sizeof(gainKeys[0]))
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Profile_Defaults
+Function Description: The settings main.c runs with when no profile is given
+Input Parameters: p - profile to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Profile_Defaults(Profile *p) {
+	p->bucket = 0;
+	p->fullSpeed = 100;
+	p->turnSpeed = 80;
+	memcpy(p->thresholds, turnThresholds, sizeof(p->thresholds));
+	HeadingCtrl_Defaults(&p->gains);
+	p->gains.baseDuty = p->fullSpeed;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: parseNumber
+Function Description: Reads the next word as a number within a range
+Input Parameters: save - strtok_r state, lo, hi - accepted range, out - value
+Output Parameters: 1 if there was a word and it was a number in range, 0 if there was no word, -1 if it was bad
+/---------------------------------------------------------------------------------------------------------*/
+static int parseNumber(char **save, double lo, double hi, double *out) {
+	char *word = strtok_r(NULL, " \t\r\n", save), *end;
+	if (!word)
+		return 0;
+	*out = strtod(word, &end);
+	return *end == '\0' && *out >= lo && *out <= hi ? 1 : -1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: parseInt
+Function Description: Reads the next word as a whole number within a range, so a duty or threshold is never
+                      silently truncated
+Input Parameters: save - strtok_r state, lo, hi - accepted range, out - value
+Output Parameters: 1 if there was a word and it was a whole number in range, 0 if there was no word, -1 if it was bad
+/---------------------------------------------------------------------------------------------------------*/
+static int parseInt(char **save, int lo, int hi, int *out) {
+	double v;
+	int rc = parseNumber(save, lo, hi, &v);
+	if (rc != 1)
+		return rc;
+	if (v != floor(v))
+		return -1;
+	*out = (int)v;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: parseLine
+Function Description: Applies one line of a profile
+Input Parameters: line - the line, comment already cut off, p - profile
+Output Parameters: 0 if the line was blank or good, -1 if not
+/---------------------------------------------------------------------------------------------------------*/
+static int parseLine(char *line, Profile *p) {
+	char *save;
+	char *key = strtok_r(line, " \t\r\n", &save);
+	double v;
+
+	if (!key)
+		return 0;
+	if (strcmp(key, "controller") == 0) {
+		char *word = strtok_r(NULL, " \t\r\n", &save);
+		if (!word || (strcmp(word, "pid") != 0 && strcmp(word, "bucket") != 0))
+			return -1;
+		p->bucket = strcmp(word, "bucket") == 0;
+	} else if (strcmp(key, "full_speed") == 0) {
+		if (parseInt(&save, 1, 100, &p->fullSpeed) != 1)
+			return -1;
+	} else if (strcmp(key, "turn_speed") == 0) {
+		if (parseInt(&save, 0, 100, &p->turnSpeed) != 1)
+			return -1;
+	} else if (strcmp(key, "turn_thresholds") == 0) {
+		int t[TURN_THRESHOLDS];
+		for (int i = 0; i < TURN_THRESHOLDS; i++)
+			if (parseInt(&save, 0, 3600, &t[i]) != 1)
+				return -1;
+		if (turnmode_check(t) != 0)
+			return -1;
+		memcpy(p->thresholds, t, sizeof(t));
+	} else {
+		size_t g = 0;
+		while (g < PROFILE_GAINS && strcmp(key, gainKeys[g].key) != 0)
+			g++;
+		if (g == PROFILE_GAINS || parseNumber(&save, gainKeys[g].lo, gainKeys[g].hi, &v) != 1)
+			return -1;
+		*(double *)((char *)&p->gains + gainKeys[g].offset) = v;
+	}
+	return strtok_r(NULL, " \t\r\n", &save) ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Profile_Load
+Function Description: Reads a profile into a copy of p and only keeps it if every line was good
+Input Parameters: path - file, p - profile, holding the values for keys the file leaves out
+Output Parameters: 0 on success, -1 if the file can't be opened, otherwise the first bad line number
+/---------------------------------------------------------------------------------------------------------*/
+int Profile_Load(const char *path, Profile *p) {
+	FILE *fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+
+	Profile next = *p;
+	char line[PROFILE_LINE_MAX];
+	int number = 0, bad = 0;
+	while (!bad && fgets(line, sizeof(line), fp)) {
+		number++;
+		char *hash = strchr(line, '#');
+		if (hash)
+			*hash = '\0';
+		if (parseLine(line, &next) != 0)
+			bad = number;
+	}
+	fclose(fp);
+	if (bad)
+		return bad;
+
+	next.gains.baseDuty = next.fullSpeed;
+	*p = next;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Profile_Save
+Function Description: Writes every setting Profile_Load reads, so the file stands on its own. Gains are written
+                      with 17 significant digits, so loading the file gives back the same doubles
+Input Parameters: path - file, p - profile, comment - heading lines, or NULL
+Output Parameters: 0 on success, -1 if the file can't be written
+/---------------------------------------------------------------------------------------------------------*/
+int Profile_Save(const char *path, const Profile *p, const char *comment) {
+	FILE *fp = fopen(path, "w");
+	if (!fp)
+		return -1;
+
+	while (comment && *comment) {
+		size_t len = strcspn(comment, "\n");
+		fprintf(fp, "# %.*s\n", (int)len, comment);
+		comment += len + (comment[len] == '\n');
+	}
+	fprintf(fp, "controller %s\n", p->bucket ? "bucket" : "pid");
+	fprintf(fp, "full_speed %d\n", p->fullSpeed);
+	fprintf(fp, "turn_speed %d\n", p->turnSpeed);
+	fprintf(fp, "turn_thresholds");
+	for (int i = 0; i < TURN_THRESHOLDS; i++)
+		fprintf(fp, " %d", p->thresholds[i]);
+	fprintf(fp, "\n");
+	for (size_t g = 0; g < PROFILE_GAINS; g++)
+		fprintf(fp, "%s %.17g\n", gainKeys[g].key, *(const double *)((const char *)&p->gains + gainKeys[g].offset));
+
+	int rc = ferror(fp) ? -1 : 0;
+	if (fclose(fp) != 0)
+		rc = -1;
+	return rc;
+}
@@ -0,0 +1,40 @@
+#ifndef PROFILE_h_
+#define PROFILE_h_
+
+#include "navigator.h"
+#include "heading_ctrl.h"
+
+  /* Controller profile: the steering settings main.c runs with, as a text file so a tuned set can be carried to
+    the rover and loaded with -P. One setting per line, the key then its values, # to the end of a line is a comment:
+
+      controller pid                          pid or bucket
+      full_speed 100                          FullSpeed duty (1 to 100), also the heading controller's base duty
+      turn_speed 80                           TurnSpeed duty (0 to 100)
+      turn_thresholds 100 900 1800 2700 3500  turn table, tenths of a degree (see navigator.h)
+      kp 0.25                                 heading controller gains, and deadband, i_limit, max_turn,
+      ki 0.01                                 pivot_deg and d_filter as in heading_ctrl.h
+      kd 0.05
+
+    Duties and thresholds must be whole numbers. Keys left out keep their current value, so a profile need only
+    hold what differs from the defaults.
+   */
+
+typedef struct {
+	int bucket;                       //1 to steer with the turn table, 0 with the heading controller
+	int fullSpeed, turnSpeed;         //FullSpeed and TurnSpeed duties
+	int thresholds[TURN_THRESHOLDS];  //Turn table (tenths of a degree)
+	HeadingGains gains;               //baseDuty is set from fullSpeed
+} Profile;
+
+//The settings main.c has without a profile: PID controller, FullSpeed 100, TurnSpeed 80, turnThresholds and the
+//default gains
+void Profile_Defaults(Profile *p);
+
+//Reads a profile over p. Returns 0 on success, -1 if the file can't be opened, otherwise the number of the first
+//bad line, in which case p is unchanged
+int Profile_Load(const char *path, Profile *p);
+
+//Writes every setting, with comment (may be NULL) as a heading. Returns -1 if the file can't be written
+int Profile_Save(const char *path, const Profile *p, const char *comment);
+
+#endif
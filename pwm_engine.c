@@ -0,0 +1,309 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: pwm_engine.c
+Source Description: One scheduler thread generating software PWM on any number of pins, replacing wiringPi's 
+                    softPwm thread per pin
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "hal.h"
+#include "pwm_engine.h"
+
+  /* Each period the thread reads a consistent copy of the duties, turns on every pin with a non-zero duty at the 
+     start of the period and then turns pins off in order of their (sorted) falling edges. Every sleep is to an 
+     absolute CLOCK_MONOTONIC deadline, so a late wake-up delays one edge but never shifts later periods, and the
+     lateness of every wake-up is measured. Pins at 0% or 100% are not written at all while their duty holds.
+   */
+
+typedef struct {
+	int64_t offsetNs;   //Falling edge time within the period
+	int ch;
+} PWMEdge;
+
+static int pins[PWM_MAX_CHANNELS];
+static int duties[PWM_MAX_CHANNELS];    //Written under dutyLock, read through dutySeq
+static atomic_int channels;
+static atomic_uint dutySeq;             //Odd while duties are being changed
+static pthread_mutex_t dutyLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t periodNs;
+static int pwmRange;
+static pthread_t pwmThread;
+static atomic_int running;
+
+static uint64_t jitterBins[PWM_JITTER_BINS];   //Only written by the PWM thread, read with relaxed atomics
+static _Atomic uint64_t jitterCount, jitterSum, jitterMax, overrunCount, sleepErrors;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: tsToNs / nsToTs
+Function Description: Conversions between timespec and nanoseconds
+Input Parameters: ts - time, ns - time in nanoseconds
+Output Parameters: Converted time
+/---------------------------------------------------------------------------------------------------------*/
+static int64_t tsToNs(const struct timespec *ts) {
+	return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static struct timespec nsToTs(int64_t ns) {
+	struct timespec ts = {(time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL)};
+	return ts;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sleepUntil
+Function Description: Sleeps to an absolute deadline and records how late the wake-up was. The sleep is resumed
+                      after a signal; any other failure is counted, reported the first time, and the edge goes
+                      ahead without its wait rather than spinning the thread that drives the motors
+Input Parameters: deadline - monotonic time in nanoseconds
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sleepUntil(int64_t deadline) {
+	struct timespec ts = nsToTs(deadline), now;
+	int err;
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR)
+		;
+	if (err != 0 && atomic_fetch_add_explicit(&sleepErrors, 1, memory_order_relaxed) == 0)
+		printf("PWM: clock_nanosleep failed (%s), edges are not being timed\n", strerror(err));
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	int64_t late = tsToNs(&now) - deadline;
+	if (late < 0)
+		late = 0;
+	uint64_t bin = (uint64_t)late / 1000;
+	__atomic_fetch_add(&jitterBins[bin < PWM_JITTER_BINS ? bin : PWM_JITTER_BINS - 1], 1, __ATOMIC_RELAXED);
+	atomic_fetch_add_explicit(&jitterCount, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&jitterSum, (uint64_t)late, memory_order_relaxed);
+	if ((uint64_t)late > atomic_load_explicit(&jitterMax, memory_order_relaxed))
+		atomic_store_explicit(&jitterMax, (uint64_t)late, memory_order_relaxed);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: loadDuties
+Function Description: Copies the duty table without locking, retrying if a writer changed it meanwhile
+Input Parameters: out - local copy, n - number of channels
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void loadDuties(int *out, int n) {
+	unsigned seq;
+	do {
+		seq = atomic_load_explicit(&dutySeq, memory_order_acquire);
+		for (int i = 0; i < n; i++)
+			out[i] = __atomic_load_n(&duties[i], __ATOMIC_RELAXED);
+		atomic_thread_fence(memory_order_acquire);
+	} while ((seq & 1) || seq != atomic_load_explicit(&dutySeq, memory_order_relaxed));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: pwmLoop
+Function Description: The scheduler thread. Runs one PWM period per iteration
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *pwmLoop(void *arg) {
+	int level[PWM_MAX_CHANNELS];
+	int duty[PWM_MAX_CHANNELS];
+	PWMEdge edges[PWM_MAX_CHANNELS];
+	struct timespec now;
+
+	for (int i = 0; i < PWM_MAX_CHANNELS; i++)
+		level[i] = -1;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t start = tsToNs(&now) + periodNs;
+
+	while (atomic_load_explicit(&running, memory_order_relaxed)) {
+		int n = atomic_load_explicit(&channels, memory_order_acquire);
+		loadDuties(duty, n);
+
+		//Sorted list of falling edges for this period
+		int nEdges = 0;
+		for (int i = 0; i < n; i++) {
+			if (duty[i] <= 0 || duty[i] >= pwmRange)
+				continue;
+			int64_t off = periodNs * duty[i] / pwmRange;
+			int j = nEdges++;
+			while (j > 0 && edges[j - 1].offsetNs > off) {
+				edges[j] = edges[j - 1];
+				j--;
+			}
+			edges[j].offsetNs = off;
+			edges[j].ch = i;
+		}
+
+		//Rising edges at the start of the period
+		sleepUntil(start);
+		for (int i = 0; i < n; i++) {
+			int want = duty[i] > 0 ? HIGH : LOW;
+			if (level[i] != want) {
+				HAL_DigitalWrite(pins[i], want);
+				level[i] = want;
+			}
+		}
+
+		//Falling edges, pins sharing a deadline are switched on one wake-up
+		for (int e = 0; e < nEdges; ) {
+			int64_t off = edges[e].offsetNs;
+			sleepUntil(start + off);
+			for (; e < nEdges && edges[e].offsetNs == off; e++) {
+				HAL_DigitalWrite(pins[edges[e].ch], LOW);
+				level[edges[e].ch] = LOW;
+			}
+		}
+
+		//Next period. If a whole period was lost, restart the schedule from now instead of bursting to catch up
+		start += periodNs;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (tsToNs(&now) > start + periodNs) {
+			atomic_fetch_add_explicit(&overrunCount, 1, memory_order_relaxed);
+			start = tsToNs(&now) + periodNs;
+		}
+	}
+
+	for (int i = 0; i < atomic_load(&channels); i++)
+		HAL_DigitalWrite(pins[i], LOW);
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_Init
+Function Description: Starts the scheduler thread, at real-time priority when the process is allowed to
+Input Parameters: freqHz - PWM frequency, range - duty steps per period
+Output Parameters: 0 on success, -1 if the thread could not be started
+/---------------------------------------------------------------------------------------------------------*/
+int PWM_Init(int freqHz, int range) {
+	pthread_attr_t attr;
+	struct sched_param sp = {sched_get_priority_max(SCHED_FIFO) - 1};
+
+	periodNs = 1000000000LL / (freqHz > 0 ? freqHz : PWM_DEFAULT_FREQ);
+	pwmRange = range > 0 ? range : PWM_DEFAULT_RANGE;
+	atomic_store(&running, 1);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &sp);
+	int rc = pthread_create(&pwmThread, &attr, pwmLoop, NULL);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0) //No permission for SCHED_FIFO, run at normal priority
+		rc = pthread_create(&pwmThread, NULL, pwmLoop, NULL);
+	if (rc != 0) {
+		atomic_store(&running, 0);
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_AddChannel
+Function Description: Adds a pin to the engine
+Input Parameters: pin - wiringPi pin number, duty - initial duty
+Output Parameters: Channel index, -1 if the engine is full
+/---------------------------------------------------------------------------------------------------------*/
+int PWM_AddChannel(int pin, int duty) {
+	pthread_mutex_lock(&dutyLock);
+	int n = atomic_load(&channels);
+	if (n >= PWM_MAX_CHANNELS) {
+		pthread_mutex_unlock(&dutyLock);
+		return -1;
+	}
+	HAL_PinMode(pin);
+	pins[n] = pin;
+	duties[n] = duty;
+	atomic_store_explicit(&channels, n + 1, memory_order_release);
+	pthread_mutex_unlock(&dutyLock);
+	return n;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_SetDuties
+Function Description: Updates several duties under one sequence bump, so the PWM thread sees all or none of them
+Input Parameters: pinList - pins to change, dutyList - new duties (clamped to the range), n - number of pins
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void PWM_SetDuties(const int *pinList, const int *dutyList, int n) {
+	pthread_mutex_lock(&dutyLock);
+	atomic_fetch_add_explicit(&dutySeq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	int count = atomic_load_explicit(&channels, memory_order_relaxed);
+	for (int k = 0; k < n; k++) {
+		int d = dutyList[k] < 0 ? 0 : (dutyList[k] > pwmRange ? pwmRange : dutyList[k]);
+		for (int i = 0; i < count; i++)
+			if (pins[i] == pinList[k])
+				__atomic_store_n(&duties[i], d, __ATOMIC_RELAXED);
+	}
+
+	atomic_fetch_add_explicit(&dutySeq, 1, memory_order_release);
+	pthread_mutex_unlock(&dutyLock);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_SetDuty
+Function Description: Updates one pin's duty
+Input Parameters: pin - pin to change, duty - new duty
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void PWM_SetDuty(int pin, int duty) {
+	PWM_SetDuties(&pin, &duty, 1);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_Stop
+Function Description: Stops the scheduler thread, which drives every pin low on its way out
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void PWM_Stop(void) {
+	if (atomic_exchange(&running, 0))
+		pthread_join(pwmThread, NULL);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_GetJitter
+Function Description: Summarises the lateness of every edge since PWM_Init
+Input Parameters: out - summary to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void PWM_GetJitter(PWMJitter *out) {
+	uint64_t count = atomic_load(&jitterCount);
+
+	memset(out, 0, sizeof(*out));
+	out->edges = count;
+	out->overruns = atomic_load(&overrunCount);
+	out->sleepErrors = atomic_load(&sleepErrors);
+	out->maxNs = atomic_load(&jitterMax);
+	if (count == 0)
+		return;
+	out->meanNs = atomic_load(&jitterSum) / count;
+
+	uint64_t seen = 0, target = count - count / 100;
+	for (int b = 0; b < PWM_JITTER_BINS; b++) {
+		seen += __atomic_load_n(&jitterBins[b], __ATOMIC_RELAXED);
+		if (seen >= target) {
+			out->p99Ns = (uint64_t)(b + 1) * 1000;
+			break;
+		}
+	}
+	if (out->p99Ns > out->maxNs)
+		out->p99Ns = out->maxNs;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: PWM_PrintJitter
+Function Description: Prints the edge jitter summary
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void PWM_PrintJitter(void) {
+	PWMJitter j;
+	PWM_GetJitter(&j);
+	printf("PWM: %llu edges, jitter mean %.1f us, p99 %.1f us, max %.1f us, %llu overruns\n",
+		(unsigned long long)j.edges, j.meanNs / 1e3, j.p99Ns / 1e3, j.maxNs / 1e3, (unsigned long long)j.overruns);
+	if (j.sleepErrors)
+		printf("  %llu sleeps failed\n", (unsigned long long)j.sleepErrors);
+}
@@ -0,0 +1,40 @@
+#ifndef PWM_ENGINE_h_
+#define PWM_ENGINE_h_
+
+#include <stdint.h>
+
+#define PWM_MAX_CHANNELS  8     //Enable pins one engine can drive
+#define PWM_DEFAULT_FREQ  100   //Hz, same period as softPwm with a range of 100
+#define PWM_DEFAULT_RANGE 100   //Duty steps per period
+#define PWM_JITTER_BINS   1000  //1us histogram bins, later edges count in the last bin
+
+//Edge timing measured by the engine
+typedef struct {
+	uint64_t edges;         //Wake-ups measured
+	uint64_t overruns;      //Periods that started over a period late and were skipped
+	uint64_t meanNs;        //Mean lateness of a wake-up against its deadline
+	uint64_t p99Ns;         //99th percentile lateness
+	uint64_t maxNs;         //Worst lateness
+	uint64_t sleepErrors;   //Sleeps that failed other than by a signal
+} PWMJitter;
+
+//Start the scheduler thread. freqHz - PWM frequency, range - duty steps per period
+int PWM_Init(int freqHz, int range);
+
+//Add an output pin, initially at duty. Returns -1 if the engine is full
+int PWM_AddChannel(int pin, int duty);
+
+//Set one pin's duty, applied from the next period
+void PWM_SetDuty(int pin, int duty);
+
+//Set several pins' duties so they all change in the same period
+void PWM_SetDuties(const int *pins, const int *duties, int n);
+
+//Drive every pin low and stop the scheduler thread
+void PWM_Stop(void);
+
+//Edge jitter measured since PWM_Init
+void PWM_GetJitter(PWMJitter *out);
+void PWM_PrintJitter(void);
+
+#endif
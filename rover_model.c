@@ -0,0 +1,143 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: rover_model.c
+Source Description: Kinematic differential-drive rover model used to benchmark controllers without hardware
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <string.h>
+#include "rover_model.h"
+#include "geodesy.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RoverModel_Defaults
+Function Description: Parameters roughly matching the rover: 0.8 m/s flat out, 25 cm track, 400 %/s slew, antenna
+                      10 cm ahead of the axle
+Input Parameters: p - parameters to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RoverModel_Defaults(RoverParams *p) {
+	p->maxSpeed = 0.8;
+	p->track = 0.25;
+	p->tau = 0.15;
+	p->accel = 400.0;
+	p->antennaOffset = 0.1;
+	p->cogMinSpeed = 0.05;
+	p->posNoise = 0.0;
+	p->headNoise = 0.0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: gaussian
+Function Description: Normal random number from an xorshift generator (Box-Muller), so runs repeat exactly
+Input Parameters: state - generator state
+Output Parameters: Sample with zero mean and unit deviation
+/---------------------------------------------------------------------------------------------------------*/
+static double gaussian(uint64_t *state) {
+	double u[2];
+	for (int i = 0; i < 2; i++) {
+		uint64_t x = *state;
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		*state = x;
+		u[i] = ((x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+	}
+	return sqrt(-2.0 * log(u[0])) * cos(2.0 * GEO_PI * u[1]);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RoverModel_Init
+Function Description: Places the model at rest
+Input Parameters: m - model, p - parameters, lat, lon - start, head - start heading, seed - noise seed
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RoverModel_Init(RoverModel *m, const RoverParams *p, double lat, double lon, double head, uint64_t seed) {
+	memset(m, 0, sizeof(*m));
+	m->p = *p;
+	m->head = head;
+	m->cog = head;
+	m->rng = seed ? seed : 0x9E3779B97F4A7C15ull;
+	NavFrame_Init(&m->frame, lat, lon, 0.0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: slew
+Function Description: Moves a value toward a target by at most a step
+Input Parameters: value, target, step
+Output Parameters: New value
+/---------------------------------------------------------------------------------------------------------*/
+static double slew(double value, double target, double step) {
+	if (target > value + step)
+		return value + step;
+	if (target < value - step)
+		return value - step;
+	return target;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RoverModel_Step
+Function Description: Advances the model. Duties slew, wheel speeds lag, then the pose is integrated at the
+                      midpoint heading
+Input Parameters: m - model, dutyL, dutyR - wheel duties, dt - time step (s)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RoverModel_Step(RoverModel *m, int dutyL, int dutyR, double dt) {
+	const RoverParams *p = &m->p;
+	m->dutyL = slew(m->dutyL, dutyL, p->accel * dt);
+	m->dutyR = slew(m->dutyR, dutyR, p->accel * dt);
+
+	double a = p->tau > 0.0 ? 1.0 - exp(-dt / p->tau) : 1.0;
+	m->vl += a * (m->dutyL / 100.0 * p->maxSpeed - m->vl);
+	m->vr += a * (m->dutyR / 100.0 * p->maxSpeed - m->vr);
+
+	double v = 0.5 * (m->vl + m->vr);
+	double w = (m->vl - m->vr) / p->track * (180.0 / GEO_PI); //Clockwise, degrees/s
+	double h = (m->head + 0.5 * w * dt) * (GEO_PI / 180.0);
+	m->e += v * sin(h) * dt;
+	m->n += v * cos(h) * dt;
+	m->head = fmod(m->head + w * dt + 360.0, 360.0);
+	m->w = w;
+	m->odometer += fabs(v) * dt;
+	m->t += dt;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RoverModel_Fix
+Function Description: Reports the model state as the GPS would: the antenna position, and its course over ground
+                      from the body velocity plus the yaw rate acting on the antenna offset
+Input Parameters: m - model
+Output Parameters: lat, lon - antenna position, head - course over ground (degrees), speed - antenna speed (m/s)
+/---------------------------------------------------------------------------------------------------------*/
+void RoverModel_Fix(RoverModel *m, double *lat, double *lon, double *head, double *speed) {
+	const RoverParams *p = &m->p;
+	double h = m->head * (GEO_PI / 180.0), w = m->w * (GEO_PI / 180.0);
+	double v = 0.5 * (m->vl + m->vr);
+
+	NavPoint pt = {m->e + p->antennaOffset * sin(h), m->n + p->antennaOffset * cos(h)};
+	if (p->posNoise > 0.0) {
+		pt.e += p->posNoise * gaussian(&m->rng);
+		pt.n += p->posNoise * gaussian(&m->rng);
+	}
+	NavFrame_Unproject(&m->frame, &pt, lat, lon);
+
+	double ve = v * sin(h) + w * p->antennaOffset * cos(h);
+	double vn = v * cos(h) - w * p->antennaOffset * sin(h);
+	*speed = sqrt(ve * ve + vn * vn);
+	if (*speed >= p->cogMinSpeed) {
+		double cog = atan2(ve, vn) * (180.0 / GEO_PI);
+		if (p->headNoise > 0.0)
+			cog += p->headNoise * gaussian(&m->rng);
+		m->cog = fmod(cog + 720.0, 360.0);
+	}
+	*head = m->cog;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RoverModel_Free
+Function Description: Frees the model
+Input Parameters: m - model
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RoverModel_Free(RoverModel *m) {
+	NavFrame_Free(&m->frame);
+}
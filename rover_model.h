@@ -0,0 +1,54 @@
+#ifndef ROVER_MODEL_h_
+#define ROVER_MODEL_h_
+
+#include <stdint.h>
+#include "nav_frame.h"
+
+  /* Kinematic differential-drive model for testing controllers off the rover. Duty commands are slew limited like
+    motor_ctrl.c, then each wheel follows its target speed with a first-order lag. The left wheel faster turns the
+    rover clockwise. Like the GPS, fixes report the antenna's course over ground, not the body heading: the antenna
+    sits antennaOffset ahead of the axle, so a pivot on the spot reads as motion at 90 degrees to the body, and
+    below cogMinSpeed the last heading is held.
+   */
+
+typedef struct {
+	double maxSpeed;   //Wheel speed at 100% duty (m/s)
+	double track;      //Wheel separation (m)
+	double tau;        //Wheel speed time constant (s)
+	double accel;      //Duty slew limit (%/s), as MOTOR_DEFAULT_ACCEL
+	double antennaOffset;  //Antenna distance ahead of the axle centre (m)
+	double cogMinSpeed;    //Antenna speed below which the reported heading is held (m/s)
+	double posNoise;   //GPS position noise, standard deviation (m)
+	double headNoise;  //Heading noise, standard deviation (degrees)
+} RoverParams;
+
+typedef struct {
+	RoverParams p;
+	NavFrame frame;     //Converts the model's metres to latitude and longitude
+	double e, n;        //Position east and north of the start (m)
+	double head;        //Heading (degrees)
+	double w;           //Yaw rate (degrees/s, clockwise)
+	double cog;         //Last reported course over ground (degrees)
+	double dutyL, dutyR;  //Slew-limited duties (%)
+	double vl, vr;      //Wheel speeds (m/s)
+	double odometer;    //Distance travelled by the centre (m)
+	double t;           //Simulated time (s)
+	uint64_t rng;
+} RoverModel;
+
+//Fills in parameters that roughly match the rover
+void RoverModel_Defaults(RoverParams *p);
+
+//Places the model at rest at a position and heading
+void RoverModel_Init(RoverModel *m, const RoverParams *p, double lat, double lon, double head, uint64_t seed);
+
+//Advances the model by dt seconds with wheel duties in [-100, 100]
+void RoverModel_Step(RoverModel *m, int dutyL, int dutyR, double dt);
+
+//A GPS fix from the current state: antenna position, course over ground (degrees) and speed (m/s), with noise
+void RoverModel_Fix(RoverModel *m, double *lat, double *lon, double *head, double *speed);
+
+//Frees the model
+void RoverModel_Free(RoverModel *m);
+
+#endif
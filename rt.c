@@ -0,0 +1,184 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: rt.c
+Source Description: Real-time scheduling for the control thread and a deadline-based tick with jitter statistics
+/---------------------------------------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "rt.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static int64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: pickCpu
+Function Description: Chooses the core for the control thread: the first core isolated from the scheduler with
+                      isolcpus= on the kernel command line, otherwise the last online core
+Input Parameters: N/A
+Output Parameters: Core number
+/---------------------------------------------------------------------------------------------------------*/
+static int pickCpu(void) {
+	int cpu = -1;
+	FILE *f = fopen("/sys/devices/system/cpu/isolated", "r");
+	if (f) {
+		if (fscanf(f, "%d", &cpu) != 1)
+			cpu = -1;
+		fclose(f);
+	}
+	if (cpu < 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		cpu = n > 0 ? (int)n - 1 : 0;
+	}
+	return cpu;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RT_Defaults
+Function Description: Default settings: SCHED_FIFO below the PWM thread, isolated or last core, memory locked
+Input Parameters: c - settings to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RT_Defaults(RtConfig *c) {
+	c->priority = RT_DEFAULT_PRIORITY;
+	c->cpu = -1;
+	c->lockMemory = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RT_Enable
+Function Description: Locks memory, pins the calling thread and raises it to SCHED_FIFO, reporting each step.
+                      Steps that are not permitted leave the thread as it was
+Input Parameters: c - settings
+Output Parameters: 0 if every requested step succeeded, -1 if any fell back
+/---------------------------------------------------------------------------------------------------------*/
+int RT_Enable(const RtConfig *c) {
+	int rc = 0;
+
+	if (c->lockMemory) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+			printf("RT: memory locked\n");
+		} else {
+			printf("RT: mlockall failed (%s), pages may fault\n", strerror(errno));
+			rc = -1;
+		}
+	}
+
+	if (c->cpu != -2) {
+		int cpu = c->cpu >= 0 ? c->cpu : pickCpu();
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (err == 0) {
+			printf("RT: control thread pinned to core %d\n", cpu);
+		} else {
+			printf("RT: cannot pin to core %d (%s)\n", cpu, strerror(err));
+			rc = -1;
+		}
+	}
+
+	if (c->priority > 0) {
+		struct sched_param sp = {c->priority};
+		int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+		if (err == 0) {
+			printf("RT: SCHED_FIFO priority %d\n", c->priority);
+		} else {
+			printf("RT: SCHED_FIFO not permitted (%s), normal scheduling\n", strerror(err));
+			rc = -1;
+		}
+	}
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RT_TickerInit
+Function Description: Starts a ticker with its first deadline one period from now
+Input Parameters: t - ticker, rateHz - tick rate
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RT_TickerInit(RtTicker *t, double rateHz) {
+	memset(t, 0, sizeof(*t));
+	t->periodNs = (int64_t)(1e9 / (rateHz > 0.0 ? rateHz : 1.0));
+	t->next = nowNs() + t->periodNs;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RT_Wait
+Function Description: Sleeps to the next absolute deadline and records the lateness of the wake-up. A tick that
+                      arrives with its deadline already gone counts as an overrun, and one a whole period behind
+                      restarts the schedule from now. The sleep is resumed after a signal; any other failure is
+                      counted, reported the first time, and the tick goes ahead without its wait
+Input Parameters: t - ticker
+Output Parameters: Lateness of the wake-up against its deadline (ns)
+/---------------------------------------------------------------------------------------------------------*/
+int64_t RT_Wait(RtTicker *t) {
+	int64_t now = nowNs();
+	if (now > t->next) {
+		t->overruns++;
+		if (now > t->next + t->periodNs) {
+			t->skipped += (uint64_t)((now - t->next) / t->periodNs);
+			t->next = now;
+		}
+	}
+
+	struct timespec ts = {(time_t)(t->next / 1000000000LL), (long)(t->next % 1000000000LL)};
+	int err;
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR)
+		;
+	if (err != 0 && t->sleepErrors++ == 0)
+		printf("RT: clock_nanosleep failed (%s), ticks are not being paced\n", strerror(err));
+	int64_t late = nowNs() - t->next;
+	if (late < 0)
+		late = 0;
+
+	int bin = 0;
+	for (int64_t us = late / 1000; us > 0 && bin < RT_HIST_BINS - 1; us >>= 1)
+		bin++;
+	t->bins[bin]++;
+	t->lateSum += (uint64_t)late;
+	if ((uint64_t)late > t->lateMax)
+		t->lateMax = (uint64_t)late;
+	t->ticks++;
+	t->next += t->periodNs;
+	return late;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: RT_PrintStats
+Function Description: Prints the tick summary and the non-empty lateness bins
+Input Parameters: t - ticker, name - loop name for the report
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void RT_PrintStats(const RtTicker *t, const char *name) {
+	printf("%s ticks: %llu at %.1f Hz, lateness mean %.1f us, max %.1f us, %llu overruns, %llu deadlines skipped\n",
+		name, (unsigned long long)t->ticks, 1e9 / t->periodNs, t->ticks ? t->lateSum / 1e3 / t->ticks : 0.0,
+		t->lateMax / 1e3, (unsigned long long)t->overruns, (unsigned long long)t->skipped);
+	if (t->sleepErrors)
+		printf("  %llu sleeps failed\n", (unsigned long long)t->sleepErrors);
+	for (int b = 0; b < RT_HIST_BINS; b++) {
+		if (!t->bins[b])
+			continue;
+		if (b == 0)
+			printf("  %9s < %6u us: %llu\n", "", 1u, (unsigned long long)t->bins[b]);
+		else if (b == RT_HIST_BINS - 1)
+			printf("  %6u us and over: %llu\n", 1u << (b - 1), (unsigned long long)t->bins[b]);
+		else
+			printf("  %6u - %6u us: %llu\n", 1u << (b - 1), 1u << b, (unsigned long long)t->bins[b]);
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef RT_h_
+#define RT_h_
+
+#include <stdint.h>
+
+  /* Opt-in real-time mode for the control thread. RT_Enable moves the calling thread to SCHED_FIFO, pins it to one
+    core (the first core in the kernel's isolcpus list when there is one, otherwise the last core) and locks the
+    process's memory so the loop never waits on a page fault. Each step that is not permitted, usually because the
+    process is not root, is reported and skipped, leaving normal scheduling. Call it after the other threads have
+    started, since new threads inherit the caller's policy and affinity.
+
+    RtTicker paces a loop on absolute CLOCK_MONOTONIC deadlines, so the tick rate does not drift with the time the
+    loop body takes. Every wake-up's lateness goes into a power-of-two histogram. A tick whose body runs past the
+    next deadline is an overrun, and if a whole period is lost the schedule restarts from now instead of bursting.
+   */
+
+#define RT_DEFAULT_PRIORITY 80  //SCHED_FIFO priority, below the PWM thread
+#define RT_HIST_BINS 16         //Lateness bins: under 1 us, 1-2 us, 2-4 us ... 16.4 ms and over
+
+//Real-time settings
+typedef struct {
+	int priority;    //SCHED_FIFO priority, 0 to stay SCHED_OTHER
+	int cpu;         //Core to pin to, -1 for an isolated core or the last one, -2 not to pin
+	int lockMemory;  //mlockall current and future pages
+} RtConfig;
+
+//Fixed-rate loop timing
+typedef struct {
+	int64_t periodNs;
+	int64_t next;            //Next deadline (monotonic ns)
+	uint64_t ticks;
+	uint64_t overruns;       //Ticks that started after their deadline had passed
+	uint64_t skipped;        //Deadlines dropped to restart the schedule
+	uint64_t sleepErrors;    //Sleeps that failed other than by a signal
+	uint64_t lateSum, lateMax;
+	uint64_t bins[RT_HIST_BINS];
+} RtTicker;
+
+//Fills in the default settings
+void RT_Defaults(RtConfig *c);
+
+//Applies the settings to the calling thread. Returns 0 if every step succeeded, -1 if any fell back
+int RT_Enable(const RtConfig *c);
+
+//Starts a ticker at rateHz, the first deadline one period from now
+void RT_TickerInit(RtTicker *t, double rateHz);
+
+//Sleeps until the next deadline, resuming after signals. Returns how late the wake-up was (ns)
+int64_t RT_Wait(RtTicker *t);
+
+//Prints the tick count, overruns and the lateness histogram
+void RT_PrintStats(const RtTicker *t, const char *name);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SEQLOCK_h_
+#define SEQLOCK_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+  /* Single-writer sequence lock for handing a small struct from one thread to others without ever blocking the
+    writer, the same scheme pwm_engine.c uses for its duty table. The sequence is odd while a write is in progress;
+    a reader copies the data and retries if the sequence was odd or changed meanwhile. The copies go word by word
+    through relaxed atomics so a torn read is detected rather than being undefined. Data must be 8-byte aligned and
+    a multiple of 8 bytes long (pad the struct). With more than one writer, serialise them first.
+   */
+
+typedef struct {
+	atomic_uint seq;
+} SeqLock;
+
+//Start value, all readers see the data as unwritten until the first store
+#define SEQLOCK_INIT {0}
+
+//Copies src into the shared data, never waits
+static inline void SeqLock_Store(SeqLock *l, void *shared, const void *src, size_t size) {
+	uint64_t *dst = (uint64_t *)shared;
+	const uint64_t *s = (const uint64_t *)src;
+
+	atomic_fetch_add_explicit(&l->seq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	for (size_t i = 0; i < size / 8; i++)
+		__atomic_store_n(&dst[i], s[i], __ATOMIC_RELAXED);
+	atomic_fetch_add_explicit(&l->seq, 1, memory_order_release);
+}
+
+//Copies the shared data into dst. Returns the sequence it read, 0 if nothing has been stored yet
+static inline unsigned SeqLock_Load(SeqLock *l, const void *shared, void *dst, size_t size) {
+	const uint64_t *src = (const uint64_t *)shared;
+	uint64_t *d = (uint64_t *)dst;
+	unsigned seq;
+
+	do {
+		seq = atomic_load_explicit(&l->seq, memory_order_acquire);
+		for (size_t i = 0; i < size / 8; i++)
+			d[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+		atomic_thread_fence(memory_order_acquire);
+	} while ((seq & 1) || seq != atomic_load_explicit(&l->seq, memory_order_relaxed));
+	return seq;
+}
+
+#endif
@@ -0,0 +1,542 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: sim_batch.c
+Source Description: Batched differential-drive simulator: rovers in struct-of-arrays form driven by the rover's own
+                    mission, turn table and heading controller, with GPS jitter measured from a stationary log
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sim_batch.h"
+#include "navigator.h"
+#include "motor_ctrl.h"
+#include "geodesy.h"
+#include "track_io.h"
+
+#define SIM_ORIGIN_LAT 50.364351  //Scenarios are laid out around the default target
+#define SIM_ORIGIN_LON -4.141873
+#define SIM_AREA_M     200.0      //Side of the square start positions are drawn from (m)
+#define SIM_FIRST_M    15.0       //Shortest distance from the start to the first waypoint (m)
+#define SIM_LEG_M      10.0       //Shortest leg (m), the longest of either is twice as long
+
+#define SIM_STILL_STEP_M 1.0      //Fix-to-fix movement below which a log is taken as standing still (m)
+#define SIM_STILL_FIXES  10       //Fewest fixes in a stationary stretch
+
+#define SIM_WIDE_ARRAYS 22        //Per-rover arrays of 8 bytes or less carved in Sim_Init, sized as doubles
+#define SIM_BYTE_ARRAYS 3         //Per-rover byte arrays carved after them
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nextRandom / uniform / gaussian
+Function Description: xorshift generator per rover, so a rover's run does not depend on which thread steps it.
+                      Uniform in (0, 1), and normal with zero mean and unit deviation (Box-Muller)
+Input Parameters: state - generator state
+Output Parameters: Random bits, or sample
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nextRandom(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+static double uniform(uint64_t *state) {
+	return ((nextRandom(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(uint64_t *state) {
+	double u = uniform(state), v = uniform(state);
+	return sqrt(-2.0 * log(u)) * cos(2.0 * GEO_PI * v);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: seedFor
+Function Description: Spreads the batch seed and rover index into a generator state (splitmix64)
+Input Parameters: seed - batch seed, i - rover
+Output Parameters: Non-zero state
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t seedFor(uint64_t seed, size_t i) {
+	uint64_t z = seed + 0x9E3779B97F4A7C15ull * (i + 1);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+	return z ? z : 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_Defaults
+Function Description: The rover model, the motor ramp limits, 10 Hz fixes and 3-waypoint routes with 10 minutes
+                      to drive them. The jitter is left at zero for SimNoise_FromLog
+Input Parameters: sp - parameters to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sim_Defaults(SimParams *sp) {
+	memset(sp, 0, sizeof(*sp));
+	RoverModel_Defaults(&sp->model);
+	sp->model.headNoise = 3.0;
+	sp->fixHz = 10.0;
+	sp->accel = MOTOR_DEFAULT_ACCEL;
+	sp->maxStep = MOTOR_DEFAULT_STEP;
+	sp->wps = 3;
+	sp->timeout = 600.0;
+	sp->seed = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_DefaultConfig
+Function Description: The settings main.c runs with
+Input Parameters: cfg - config to fill, ctrl - controller
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sim_DefaultConfig(SimConfig *cfg, SimCtrl ctrl) {
+	cfg->ctrl = ctrl;
+	cfg->fullSpeed = 100;
+	cfg->turnSpeed = 80;
+	memcpy(cfg->thresholds, turnThresholds, sizeof(cfg->thresholds));
+	HeadingCtrl_Defaults(&cfg->gains);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: SimNoise_FromLog
+Function Description: Finds each stretch of at least SIM_STILL_FIXES fixes that moved less than SIM_STILL_STEP_M
+                      from one to the next, leaving out stretches that never change (a logger repeating a lost fix).
+                      The spread about each stretch's own mean gives the deviation, the fix-to-fix steps give the
+                      correlation (1 - var(step) / 2 var), and unchanged fixes give the repeat rate. A CSV log has
+                      no time stamps, so the correlation is per fix and is applied per fix at the simulated rate
+Input Parameters: path - log, noise - model out
+Output Parameters: 0 on success, -1 if the log can't be read or nothing in it stood still
+/---------------------------------------------------------------------------------------------------------*/
+int SimNoise_FromLog(const char *path, SimNoise *noise) {
+	TrackList list = {0};
+	if (TrackIO_Load(path, &list) != 0 || list.count < SIM_STILL_FIXES) {
+		TrackIO_Free(&list);
+		return -1;
+	}
+
+	NavFrame f;
+	NavFrame_Init(&f, list.pts[0].lat, list.pts[0].lon, 0.0);
+	NavPoint *p = malloc(list.count * sizeof(NavPoint));
+	if (!p) {
+		TrackIO_Free(&list);
+		return -1;
+	}
+	for (size_t i = 0; i < list.count; i++)
+		NavFrame_Project(&f, list.pts[i].lat, list.pts[i].lon, &p[i]);
+
+	double sumE = 0.0, sumN = 0.0, sumStep = 0.0;
+	size_t fixes = 0, steps = 0, repeats = 0, runs = 0;
+	for (size_t start = 0; start < list.count; ) {
+		size_t end = start + 1;
+		while (end < list.count && NavFrame_Distance(&p[end - 1], &p[end]) < SIM_STILL_STEP_M)
+			end++;
+		size_t len = end - start;
+		double me = 0.0, mn = 0.0;
+		for (size_t i = start; i < end; i++) {
+			me += p[i].e;
+			mn += p[i].n;
+		}
+		me /= len;
+		mn /= len;
+		double se = 0.0, sn = 0.0, ss = 0.0;
+		size_t same = 0;
+		for (size_t i = start; i < end; i++) {
+			se += (p[i].e - me) * (p[i].e - me);
+			sn += (p[i].n - mn) * (p[i].n - mn);
+			if (i > start) {
+				double de = p[i].e - p[i - 1].e, dn = p[i].n - p[i - 1].n;
+				ss += de * de + dn * dn;
+				same += de == 0.0 && dn == 0.0;
+			}
+		}
+		if (len >= SIM_STILL_FIXES && se + sn > 0.0) {
+			sumE += se;
+			sumN += sn;
+			sumStep += ss;
+			fixes += len;
+			steps += len - 1;
+			repeats += same;
+			runs++;
+		}
+		start = end;
+	}
+	free(p);
+	NavFrame_Free(&f);
+	TrackIO_Free(&list);
+	if (runs == 0)
+		return -1;
+
+	noise->sdE = sqrt(sumE / fixes);
+	noise->sdN = sqrt(sumN / fixes);
+	double var = (sumE + sumN) / fixes / 2.0, stepVar = sumStep / steps / 2.0; //Per axis
+	noise->rho = 1.0 - stepVar / (2.0 * var);
+	if (noise->rho < 0.0)
+		noise->rho = 0.0;
+	if (noise->rho > 0.9999)
+		noise->rho = 0.9999;
+	noise->repeat = (double)repeats / steps;
+	noise->fixes = fixes;
+	noise->runs = runs;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: newRoute
+Function Description: Gives a rover a route of sp->wps waypoints starting from a point: the first SIM_FIRST_M to
+                      twice that away in any direction, then legs of SIM_LEG_M to twice that, each turning by up to
+                      135 degrees from the last
+Input Parameters: b - batch, i - rover, from - where the route starts, len - route length out (m)
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+static int newRoute(SimBatch *b, size_t i, const NavPoint *from, double *len) {
+	Waypoint wps[SIM_MAX_WPS];
+	NavPoint at = *from;
+	double dir = uniform(&b->rng[i]) * 360.0;
+	double dist = SIM_FIRST_M * (1.0 + uniform(&b->rng[i]));
+	*len = 0.0;
+	for (int k = 0; k < b->sp.wps; k++) {
+		at.e += dist * sin(dir * (GEO_PI / 180.0));
+		at.n += dist * cos(dir * (GEO_PI / 180.0));
+		*len += dist;
+		NavFrame_Unproject(&b->frame, &at, &wps[k].lat, &wps[k].lon);
+		dir += (uniform(&b->rng[i]) - 0.5) * 270.0;
+		dist = SIM_LEG_M * (1.0 + uniform(&b->rng[i]));
+	}
+	Mission_Free(&b->mission[i]);
+	return Mission_Init(&b->mission[i], wps, (size_t)b->sp.wps, MISSION_ARRIVE_M, MISSION_HYST_M);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: carve
+Function Description: Hands out a cache-line aligned array from the batch's block
+Input Parameters: at - next free byte, n - elements, size - element size
+Output Parameters: The array
+/---------------------------------------------------------------------------------------------------------*/
+static void *carve(uint8_t **at, size_t n, size_t size) {
+	void *p = *at;
+	*at += (n * size + 63) & ~(size_t)63;
+	return p;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_Init
+Function Description: Allocates the arrays and places every rover at rest at a random point and heading in the
+                      scenario area, with its own route and noise stream
+Input Parameters: b - batch, count - rovers, sp - parameters, cfg - controller
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+int Sim_Init(SimBatch *b, size_t count, const SimParams *sp, const SimConfig *cfg) {
+	memset(b, 0, sizeof(*b));
+	b->count = count;
+	b->sp = *sp;
+	b->cfg = *cfg;
+	if (b->sp.wps < 1)
+		b->sp.wps = 1;
+	if (b->sp.wps > SIM_MAX_WPS)
+		b->sp.wps = SIM_MAX_WPS;
+
+	//Keep the counts in step with the carve list below
+	size_t line = (count * sizeof(double) + 63) & ~(size_t)63;
+	b->block = aligned_alloc(64, line * SIM_WIDE_ARRAYS + SIM_BYTE_ARRAYS * ((count + 63) & ~(size_t)63));
+	b->mission = calloc(count, sizeof(Mission));
+	b->pid = calloc(count, sizeof(HeadingCtrl));
+	if (!b->block || !b->mission || !b->pid) {
+		Sim_Free(b);
+		return -1;
+	}
+	uint8_t *at = b->block;
+	b->e = carve(&at, count, sizeof(double));
+	b->n = carve(&at, count, sizeof(double));
+	b->head = carve(&at, count, sizeof(double));
+	b->w = carve(&at, count, sizeof(double));
+	b->vl = carve(&at, count, sizeof(double));
+	b->vr = carve(&at, count, sizeof(double));
+	b->dutyL = carve(&at, count, sizeof(double));
+	b->dutyR = carve(&at, count, sizeof(double));
+	b->cmdL = carve(&at, count, sizeof(double));
+	b->cmdR = carve(&at, count, sizeof(double));
+	b->cog = carve(&at, count, sizeof(double));
+	b->jitE = carve(&at, count, sizeof(double));
+	b->jitN = carve(&at, count, sizeof(double));
+	b->odo = carve(&at, count, sizeof(double));
+	b->lastCmdT = carve(&at, count, sizeof(double));
+	b->rng = carve(&at, count, sizeof(uint64_t));
+	b->simTime = carve(&at, count, sizeof(double));
+	b->arriveT = carve(&at, count, sizeof(double));
+	b->path = carve(&at, count, sizeof(double));
+	b->routeLen = carve(&at, count, sizeof(double));
+	b->reversals = carve(&at, count, sizeof(unsigned long));
+	b->arrivals = carve(&at, count, sizeof(unsigned long));
+	b->signL = carve(&at, count, sizeof(int8_t));
+	b->signR = carve(&at, count, sizeof(int8_t));
+	b->done = carve(&at, count, sizeof(uint8_t));
+
+	NavFrame_Init(&b->frame, SIM_ORIGIN_LAT, SIM_ORIGIN_LON, 0.0);
+	const SimNoise *nz = &b->sp.noise;
+	for (size_t i = 0; i < count; i++) {
+		b->rng[i] = seedFor(b->sp.seed, i);
+		NavPoint start = {(uniform(&b->rng[i]) - 0.5) * SIM_AREA_M, (uniform(&b->rng[i]) - 0.5) * SIM_AREA_M};
+		b->e[i] = start.e;
+		b->n[i] = start.n;
+		b->head[i] = b->cog[i] = uniform(&b->rng[i]) * 360.0;
+		b->w[i] = b->vl[i] = b->vr[i] = 0.0;
+		b->dutyL[i] = b->dutyR[i] = b->cmdL[i] = b->cmdR[i] = 0.0;
+		b->jitE[i] = nz->sdE * gaussian(&b->rng[i]); //Start with the error at its steady spread
+		b->jitN[i] = nz->sdN * gaussian(&b->rng[i]);
+		b->odo[i] = 0.0;
+		b->lastCmdT[i] = -1.0; //The first command ramps by a full step
+		b->simTime[i] = 0.0;
+		b->arriveT[i] = -1.0;
+		b->path[i] = 0.0;
+		b->reversals[i] = b->arrivals[i] = 0;
+		b->signL[i] = b->signR[i] = 0;
+		b->done[i] = 0;
+		HeadingCtrl_Init(&b->pid[i], &b->cfg.gains);
+		if (newRoute(b, i, &start, &b->routeLen[i]) != 0) {
+			Sim_Free(b);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_Chunks
+Function Description: Number of SIM_CHUNK-rover tasks in a batch
+Input Parameters: b - batch
+Output Parameters: Task count
+/---------------------------------------------------------------------------------------------------------*/
+size_t Sim_Chunks(const SimBatch *b) {
+	return (b->count + SIM_CHUNK - 1) / SIM_CHUNK;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: drive
+Function Description: A wheel command as Motors_Drive applies it: ramped by min(accel * dt, maxStep) since the last
+                      command, then written as a rounded PWM duty. Counts a reversal when a wheel's command changes
+                      direction
+Input Parameters: b - batch, i - rover, left, right - requested commands, t - time (s)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void drive(SimBatch *b, size_t i, int left, int right, double t) {
+	const SimParams *sp = &b->sp;
+	double step = 200.0;
+	if (sp->accel > 0.0)
+		step = sp->accel * (t - b->lastCmdT[i]);
+	if (sp->maxStep > 0.0 && step > sp->maxStep)
+		step = sp->maxStep;
+	b->lastCmdT[i] = t;
+
+	int sl = (left > 0) - (left < 0), sr = (right > 0) - (right < 0);
+	b->reversals[i] += (sl && b->signL[i] && sl != b->signL[i]) + (sr && b->signR[i] && sr != b->signR[i]);
+	if (sl)
+		b->signL[i] = (int8_t)sl;
+	if (sr)
+		b->signR[i] = (int8_t)sr;
+
+	double tl = left > 100 ? 100.0 : left < -100 ? -100.0 : left;
+	double tr = right > 100 ? 100.0 : right < -100 ? -100.0 : right;
+	double cl = b->cmdL[i], cr = b->cmdR[i];
+	cl = tl > cl + step ? cl + step : tl < cl - step ? cl - step : tl;
+	cr = tr > cr + step ? cr + step : tr < cr - step ? cr - step : tr;
+	b->cmdL[i] = cl;
+	b->cmdR[i] = cr;
+	b->dutyL[i] = copysign(round(fabs(cl)), cl);
+	b->dutyR[i] = copysign(round(fabs(cr)), cr);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: stopRover
+Function Description: Motors_Disable: both wheels off at once, no ramp
+Input Parameters: b - batch, i - rover, t - time (s)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void stopRover(SimBatch *b, size_t i, double t) {
+	b->cmdL[i] = b->cmdR[i] = b->dutyL[i] = b->dutyR[i] = 0.0;
+	b->lastCmdT[i] = t;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: fixAndSteer
+Function Description: One GPS fix for a rover and, if it brought a new position, one pass of the control loop:
+                      mission update, then the turn table or the heading controller
+Input Parameters: b - batch, i - rover, t - time (s)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void fixAndSteer(SimBatch *b, size_t i, double t) {
+	const SimParams *sp = &b->sp;
+	const RoverParams *p = &sp->model;
+	const SimNoise *nz = &sp->noise;
+	uint64_t *rng = &b->rng[i];
+
+	if (nz->repeat > 0.0 && uniform(rng) < nz->repeat)
+		return; //Same position again, the event loop stays asleep
+
+	double q = sqrt(1.0 - nz->rho * nz->rho);
+	b->jitE[i] = nz->rho * b->jitE[i] + q * nz->sdE * gaussian(rng);
+	b->jitN[i] = nz->rho * b->jitN[i] + q * nz->sdN * gaussian(rng);
+
+	//Antenna position and course over ground, as RoverModel_Fix
+	double h = b->head[i] * (GEO_PI / 180.0), w = b->w[i] * (GEO_PI / 180.0);
+	double sh = sin(h), ch = cos(h);
+	double v = 0.5 * (b->vl[i] + b->vr[i]);
+	NavPoint pt = {b->e[i] + p->antennaOffset * sh + b->jitE[i], b->n[i] + p->antennaOffset * ch + b->jitN[i]};
+	double ve = v * sh + w * p->antennaOffset * ch;
+	double vn = v * ch - w * p->antennaOffset * sh;
+	double speed = sqrt(ve * ve + vn * vn);
+	if (speed >= p->cogMinSpeed) {
+		double cog = atan2(ve, vn) * (180.0 / GEO_PI);
+		if (p->headNoise > 0.0)
+			cog += p->headNoise * gaussian(rng);
+		b->cog[i] = fmod(cog + 720.0, 360.0);
+	}
+	double lat, lon;
+	NavFrame_Unproject(&b->frame, &pt, &lat, &lon);
+
+	MissionNav nav;
+	if (Mission_Update(&b->mission[i], lat, lon, &nav) == MISSION_ARRIVED) {
+		b->arrivals[i]++;
+		if (b->arriveT[i] < 0.0) {
+			b->arriveT[i] = t;
+			b->path[i] = b->odo[i];
+		}
+		if (sp->patrol) {
+			NavPoint here = {b->e[i], b->n[i]};
+			double len;
+			if (newRoute(b, i, &here, &len) == 0) {
+				HeadingCtrl_Reset(&b->pid[i]);
+				return;
+			}
+		}
+		stopRover(b, i, t);
+		b->done[i] = 1;
+		b->simTime[i] = t;
+		return;
+	}
+	if (nav.arrived)
+		HeadingCtrl_Reset(&b->pid[i]);
+
+	const SimConfig *cfg = &b->cfg;
+	int left, right;
+	if (cfg->ctrl == SIM_BUCKET) {
+		TurnMode mode = get_turnmode_table(getHeadingError(nav.bearing, b->cog[i]), cfg->thresholds);
+		if (mode == TURN_OFF) {
+			stopRover(b, i, t);
+			return;
+		}
+		turnmode_duties(mode, cfg->fullSpeed, cfg->turnSpeed, &left, &right);
+	} else {
+		HeadingCtrl_Update(&b->pid[i], nav.bearing - b->cog[i], speed, t - b->lastCmdT[i], &left, &right);
+		left = left > cfg->fullSpeed ? cfg->fullSpeed : left < -cfg->fullSpeed ? -cfg->fullSpeed : left;
+		right = right > cfg->fullSpeed ? cfg->fullSpeed : right < -cfg->fullSpeed ? -cfg->fullSpeed : right;
+	}
+	drive(b, i, left, right, t);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_RunChunk
+Function Description: Steps one chunk of rovers. Fixes and control run per rover at the fix rate; the wheel and pose
+                      update runs every SIM_DT in one loop with no branches over the rovers still driving, listed
+                      afresh at each fix, so the work done follows the simulated time Sim_Summarise counts
+Input Parameters: batch - SimBatch, chunk - chunk index
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sim_RunChunk(void *batch, size_t chunk) {
+	SimBatch *b = batch;
+	const SimParams *sp = &b->sp;
+	const RoverParams *p = &sp->model;
+	size_t lo = chunk * SIM_CHUNK, hi = lo + SIM_CHUNK < b->count ? lo + SIM_CHUNK : b->count;
+
+	long fixSteps = lround(1.0 / (sp->fixHz * SIM_DT));
+	if (fixSteps < 1)
+		fixSteps = 1;
+	long steps = (long)ceil(sp->timeout / SIM_DT);
+	const double dt = SIM_DT;
+	const double lag = p->tau > 0.0 ? 1.0 - exp(-dt / p->tau) : 1.0;
+	const double vPerDuty = p->maxSpeed / 100.0;
+	const double yawPerV = (180.0 / GEO_PI) / p->track;
+	double *restrict e = b->e, *restrict n = b->n, *restrict head = b->head, *restrict w = b->w;
+	double *restrict vl = b->vl, *restrict vr = b->vr, *restrict odo = b->odo;
+	const double *restrict dutyL = b->dutyL, *restrict dutyR = b->dutyR;
+
+	size_t live[SIM_CHUNK], active = 0;
+	long s;
+	for (s = 0; s < steps; s++) {
+		if (s % fixSteps == 0) {
+			active = 0;
+			for (size_t i = lo; i < hi; i++) {
+				if (!b->done[i])
+					fixAndSteer(b, i, s * dt);
+				if (!b->done[i])
+					live[active++] = i;
+			}
+			if (active == 0)
+				break;
+		}
+		for (size_t k = 0; k < active; k++) {
+			size_t i = live[k];
+			vl[i] += lag * (dutyL[i] * vPerDuty - vl[i]);
+			vr[i] += lag * (dutyR[i] * vPerDuty - vr[i]);
+			double v = 0.5 * (vl[i] + vr[i]);
+			double wi = (vl[i] - vr[i]) * yawPerV;
+			double h = (head[i] + 0.5 * wi * dt) * (GEO_PI / 180.0);
+			e[i] += v * sin(h) * dt;
+			n[i] += v * cos(h) * dt;
+			double hd = head[i] + wi * dt;
+			hd += hd < 0.0 ? 360.0 : 0.0;
+			hd -= hd >= 360.0 ? 360.0 : 0.0;
+			head[i] = hd;
+			w[i] = wi;
+			odo[i] += fabs(v) * dt;
+		}
+	}
+	for (size_t i = lo; i < hi; i++)
+		if (!b->done[i])
+			b->simTime[i] = s * dt;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_Summarise
+Function Description: Totals and means over the batch
+Input Parameters: b - batch, s - summary out
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sim_Summarise(const SimBatch *b, SimSummary *s) {
+	memset(s, 0, sizeof(*s));
+	s->rovers = b->count;
+	double rev = 0.0;
+	for (size_t i = 0; i < b->count; i++) {
+		s->roverSeconds += b->simTime[i];
+		s->routes += b->arrivals[i];
+		rev += b->reversals[i];
+		if (b->arriveT[i] >= 0.0) {
+			s->arrived++;
+			s->meanArrive += b->arriveT[i];
+			s->meanPath += b->path[i];
+			s->meanExcess += b->routeLen[i] > 0.0 ? b->path[i] / b->routeLen[i] : 1.0;
+		}
+	}
+	if (s->arrived) {
+		s->meanArrive /= s->arrived;
+		s->meanPath /= s->arrived;
+		s->meanExcess /= s->arrived;
+	}
+	s->meanReversals = b->count ? rev / b->count : 0.0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sim_Free
+Function Description: Frees the routes and arrays
+Input Parameters: b - batch
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sim_Free(SimBatch *b) {
+	if (b->mission)
+		for (size_t i = 0; i < b->count; i++)
+			Mission_Free(&b->mission[i]);
+	free(b->mission);
+	free(b->pid);
+	free(b->block);
+	NavFrame_Free(&b->frame);
+	memset(b, 0, sizeof(*b));
+}
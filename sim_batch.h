@@ -0,0 +1,134 @@
+#ifndef SIM_BATCH_h_
+#define SIM_BATCH_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mission.h"
+#include "navigator.h"
+#include "heading_ctrl.h"
+#include "rover_model.h"
+
+  /* Batched differential-drive simulator for evaluating navigation without the rover. Thousands of independent
+    rovers are held as a struct of arrays, one array per state variable, and stepped SIM_CHUNK at a time. A chunk is one
+    pool task and runs its rovers for the whole simulation, so the chunks never wait for each other.
+
+    Each rover drives its own route through the rover's code: Mission_Update for arrival, and on every fix either the
+    turn table (get_turnmode_table and turnmode_duties, as set_turnmode drives Forwards, Smooth_Turn and
+    Hard_Left/Right) or HeadingCtrl clamped to FullSpeed as set_heading_pid. Wheel commands ramp as Motors_Drive does: by
+    min(accel * time since the last command, maxStep). The PWM duty (rounded as motor_ctrl.c writes it) sets each
+    wheel's target speed, and the wheel follows it with the model's first-order lag. The pose is integrated as
+    rover_model.c does.
+
+    GPS: a fix every 1/fixHz seconds at the antenna, with course over ground as rover_model.c reports it. Position
+    error follows a first-order Gauss-Markov process per axis, and a fix repeats the last position with probability
+    repeat, when the control loop, woken only by new positions, skips it. SimNoise_FromLog measures these from the
+    stretches of a log where the receiver stood still.
+   */
+
+#define SIM_DT      0.005   //Model step (s)
+#define SIM_CHUNK   64      //Rovers per task
+#define SIM_MAX_WPS 16      //Waypoints per generated route
+#define SIM_LOG_DEFAULT "GPS_MultiEvent/myGPS_data.csv"
+
+//GPS jitter model
+typedef struct {
+	double sdE, sdN;       //Position error standard deviation, east and north (m)
+	double rho;            //Correlation of the error from one fix to the next
+	double repeat;         //Probability a fix repeats the previous position
+	size_t fixes, runs;    //Stationary fixes and stretches the figures came from
+} SimNoise;
+
+typedef enum {SIM_BUCKET = 0, SIM_PID} SimCtrl;
+
+//Controller under test
+typedef struct {
+	SimCtrl ctrl;
+	int fullSpeed, turnSpeed;  //FullSpeed and TurnSpeed duties
+	int thresholds[TURN_THRESHOLDS];  //SIM_BUCKET turn table
+	HeadingGains gains;        //SIM_PID
+} SimConfig;
+
+//Simulation set-up, shared by every rover
+typedef struct {
+	RoverParams model;     //posNoise is unused, position error comes from noise
+	SimNoise noise;
+	double fixHz;
+	double accel, maxStep; //Motor ramp limits, as motor_ctrl.c
+	int wps;               //Waypoints per route
+	double timeout;        //Simulated seconds per rover
+	int patrol;            //1 to give a rover a new route when it completes one, 0 to stop it
+	uint64_t seed;         //Routes, start poses and noise; the same seed gives the same scenarios
+} SimParams;
+
+//Rovers and their results, one array per field
+typedef struct {
+	size_t count;
+	SimParams sp;
+	SimConfig cfg;
+	NavFrame frame;        //Scenario origin
+	void *block;           //Backing allocation of the arrays below
+
+	//Model
+	double *e, *n;         //Position (m)
+	double *head, *w;      //Heading (degrees) and yaw rate (degrees/s, clockwise)
+	double *vl, *vr;       //Wheel speeds (m/s)
+	double *dutyL, *dutyR; //PWM duties as written, signed (%)
+	double *cmdL, *cmdR;   //Ramped wheel commands (%)
+	double *cog;           //Last reported course over ground (degrees)
+	double *jitE, *jitN;   //GPS position error (m)
+	double *odo;           //Distance travelled (m)
+	double *lastCmdT;      //Time of the last wheel command (s)
+	uint64_t *rng;
+	int8_t *signL, *signR; //Direction of the last non-zero wheel command
+	uint8_t *done;
+
+	//Navigation and control
+	Mission *mission;
+	HeadingCtrl *pid;
+
+	//Results
+	double *simTime;       //Seconds simulated while driving
+	double *arriveT;       //Time the first route was completed, -1 if not
+	double *path;          //Distance travelled by then (m)
+	double *routeLen;      //Length of the first route from the start (m)
+	unsigned long *reversals;  //Wheel command direction changes
+	unsigned long *arrivals;   //Routes completed
+} SimBatch;
+
+//Totals over a batch
+typedef struct {
+	size_t rovers, arrived;
+	double roverSeconds;   //Simulated time summed over rovers
+	unsigned long routes;  //Routes completed, patrols included
+	double meanArrive;     //Mean time to complete the first route over rovers that did (s)
+	double meanPath;       //Mean distance travelled for it (m)
+	double meanExcess;     //Mean path over route length
+	double meanReversals;  //Per rover
+} SimSummary;
+
+//Parameters matching the rover, the GPS at 10 Hz and a 3-waypoint route, with noise still to be filled in
+void Sim_Defaults(SimParams *sp);
+
+//The rover's own controller settings: turn table with FullSpeed 100 and TurnSpeed 80, default PID gains
+void Sim_DefaultConfig(SimConfig *cfg, SimCtrl ctrl);
+
+//Measures the jitter from the stationary stretches of a CSV, GPX or track log. Returns -1 if it can't be read
+//or has no stretch long enough
+int SimNoise_FromLog(const char *path, SimNoise *noise);
+
+//Allocates count rovers and generates their scenarios. Returns -1 if out of memory
+int Sim_Init(SimBatch *b, size_t count, const SimParams *sp, const SimConfig *cfg);
+
+//Number of pool tasks, SIM_CHUNK rovers each
+size_t Sim_Chunks(const SimBatch *b);
+
+//Runs one chunk to the timeout, or until all its rovers have completed their routes. PoolFn signature
+void Sim_RunChunk(void *batch, size_t chunk);
+
+//Adds up the results
+void Sim_Summarise(const SimBatch *b, SimSummary *s);
+
+//Frees the batch
+void Sim_Free(SimBatch *b);
+
+#endif
@@ -0,0 +1,273 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: simplify.c
+Source Description: Douglas-Peucker track simplification with a metre tolerance, in memory or streamed through a
+                    bounded window, and time-based decimation
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "simplify.h"
+#include "nav_frame.h"
+
+#define DAY_MS 86400000ull
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: segDist2
+Function Description: Squared distance from a point to a segment, all in the local frame
+Input Parameters: ae, an - segment start, be, bn - segment end, pe, pn - point (m)
+Output Parameters: Squared distance (m^2)
+/---------------------------------------------------------------------------------------------------------*/
+static double segDist2(double ae, double an, double be, double bn, double pe, double pn) {
+	double dx = be - ae, dy = bn - an;
+	double len2 = dx * dx + dy * dy;
+	double t = len2 > 0.0 ? ((pe - ae) * dx + (pn - an) * dy) / len2 : 0.0;
+	if (t < 0.0)
+		t = 0.0;
+	else if (t > 1.0)
+		t = 1.0;
+	double x = ae + t * dx - pe, y = an + t * dy - pn;
+	return x * x + y * y;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: markKept
+Function Description: Douglas-Peucker over points 0 to count-1. Each segment is checked in a frame anchored on its
+                      start, so distances stay accurate however far the track wanders. Uses an explicit stack of
+                      segments rather than recursion, so a long straight run can't overflow the call stack
+Input Parameters: pts, count - points, tolM - tolerance, keep - flags out, stack - room for count pairs of indices
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void markKept(const TrackPoint *pts, size_t count, double tolM, uint8_t *keep, size_t *stack) {
+	double tol2 = tolM * tolM;
+	size_t top = 0;
+	NavFrame f;
+	NavPoint pb, pi;
+
+	memset(keep, 0, count);
+	keep[0] = keep[count - 1] = 1;
+	stack[top++] = 0;
+	stack[top++] = count - 1;
+	NavFrame_Init(&f, pts[0].lat, pts[0].lon, 0.0);
+
+	while (top > 0) {
+		size_t b = stack[--top];
+		size_t a = stack[--top];
+		double worst = -1.0;
+		size_t at = a;
+
+		NavFrame_Anchor(&f, pts[a].lat, pts[a].lon);
+		NavFrame_Project(&f, pts[b].lat, pts[b].lon, &pb);
+		for (size_t i = a + 1; i < b; i++) {
+			NavFrame_Project(&f, pts[i].lat, pts[i].lon, &pi);
+			double d2 = segDist2(0.0, 0.0, pb.e, pb.n, pi.e, pi.n);
+			if (d2 > worst) {
+				worst = d2;
+				at = i;
+			}
+		}
+		if (worst <= tol2)
+			continue;
+
+		//Keep the furthest point and check both halves
+		keep[at] = 1;
+		if (at - a > 1) {
+			stack[top++] = a;
+			stack[top++] = at;
+		}
+		if (b - at > 1) {
+			stack[top++] = at;
+			stack[top++] = b;
+		}
+	}
+	NavFrame_Free(&f);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_Track
+Function Description: Simplifies a whole track in memory, moving the kept points to the front
+Input Parameters: pts, n - track, tolM - tolerance (m)
+Output Parameters: Points kept, 0 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+size_t Simplify_Track(TrackPoint *pts, size_t n, double tolM) {
+	if (n < 3)
+		return n;
+
+	uint8_t *keep = malloc(n);
+	size_t *stack = malloc(2 * n * sizeof(size_t));
+	size_t kept = 0;
+
+	if (keep && stack) {
+		markKept(pts, n, tolM, keep, stack);
+		for (size_t i = 0; i < n; i++)
+			if (keep[i])
+				pts[kept++] = pts[i];
+	}
+
+	free(keep);
+	free(stack);
+	return kept;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_Init
+Function Description: Sets up a streaming simplifier
+Input Parameters: s - simplifier, tolM - tolerance (m), window - points held at most, emit, ctx - output callback
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+int Simplify_Init(Simplifier *s, double tolM, size_t window, SimplifyEmit emit, void *ctx) {
+	memset(s, 0, sizeof(*s));
+	s->tolM = tolM;
+	s->window = window < 3 ? 3 : window;
+	s->emit = emit;
+	s->ctx = ctx;
+
+	s->win = malloc(s->window * sizeof(TrackPoint));
+	s->keep = malloc(s->window);
+	s->stack = malloc(2 * s->window * sizeof(size_t));
+	if (!s->win || !s->keep || !s->stack) {
+		Simplify_Free(s);
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: emitPoint
+Function Description: Passes a kept point to the callback
+Input Parameters: s - simplifier, pt - point
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void emitPoint(Simplifier *s, const TrackPoint *pt) {
+	s->out++;
+	if (!s->err && s->emit(s->ctx, pt) != 0)
+		s->err = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: flushWindow
+Function Description: Simplifies a full window and emits the points that are settled. The segment ending at the
+                      window edge is not, so the window restarts on the kept point before it. If that would carry
+                      more than half the window over (or nothing was kept inside the window), the edge point is
+                      kept instead, so each flush frees at least half the window
+Input Parameters: s - simplifier
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void flushWindow(Simplifier *s) {
+	size_t last = s->count - 1;
+
+	markKept(s->win, s->count, s->tolM, s->keep, s->stack);
+
+	size_t restart = last - 1;
+	while (!s->keep[restart])
+		restart--;
+	if (restart == 0 || last - restart > s->window / 2)
+		restart = last;
+
+	for (size_t i = 1; i <= restart; i++)
+		if (s->keep[i])
+			emitPoint(s, &s->win[i]);
+
+	memmove(s->win, s->win + restart, (s->count - restart) * sizeof(TrackPoint));
+	s->count -= restart;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_Push
+Function Description: Adds a point. The first point is always emitted straight away
+Input Parameters: s - simplifier, pt - point
+Output Parameters: 0 on success, -1 if the callback aborted
+/---------------------------------------------------------------------------------------------------------*/
+int Simplify_Push(Simplifier *s, const TrackPoint *pt) {
+	s->win[s->count++] = *pt;
+	if (s->in++ == 0)
+		emitPoint(s, pt);
+	if (s->count == s->window)
+		flushWindow(s);
+	return s->err ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_Finish
+Function Description: Simplifies what is left in the window and emits it, ending on the track's last point
+Input Parameters: s - simplifier
+Output Parameters: 0 on success, -1 if the callback aborted
+/---------------------------------------------------------------------------------------------------------*/
+int Simplify_Finish(Simplifier *s) {
+	if (s->count >= 2) {
+		markKept(s->win, s->count, s->tolM, s->keep, s->stack);
+		for (size_t i = 1; i < s->count; i++)
+			if (s->keep[i])
+				emitPoint(s, &s->win[i]);
+	}
+	s->count = 0;
+	return s->err ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_Free
+Function Description: Releases the window
+Input Parameters: s - simplifier
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Simplify_Free(Simplifier *s) {
+	free(s->win);
+	free(s->keep);
+	free(s->stack);
+	s->win = NULL;
+	s->keep = NULL;
+	s->stack = NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_DecimateInit
+Function Description: Sets up a time decimator
+Input Parameters: d - decimator, minIntervalMs - shortest gap between kept points
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Simplify_DecimateInit(SimplifyDecimator *d, uint32_t minIntervalMs) {
+	memset(d, 0, sizeof(*d));
+	d->minIntervalMs = minIntervalMs;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_DecimateKeep
+Function Description: Keeps a point if at least minIntervalMs has passed since the last one kept. GPS time of
+                      day is unwrapped at midnight so a log running past 00:00 is not cut off
+Input Parameters: d - decimator, pt - point
+Output Parameters: 1 to keep, 0 to drop
+/---------------------------------------------------------------------------------------------------------*/
+int Simplify_DecimateKeep(SimplifyDecimator *d, const TrackPoint *pt) {
+	if (pt->timeMs == 0)
+		return 1;
+
+	uint64_t t = pt->timeMs + d->dayOffset;
+	if (d->have && t + DAY_MS / 2 < d->prevMs) {
+		d->dayOffset += DAY_MS;
+		t += DAY_MS;
+	}
+	d->prevMs = t;
+
+	if (d->have && t < d->lastMs + d->minIntervalMs)
+		return 0;
+	d->have = 1;
+	d->lastMs = t;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Simplify_SegmentError
+Function Description: Distance from a point to a segment, in a frame anchored on the segment start
+Input Parameters: a, b - segment, p - point
+Output Parameters: Distance (m)
+/---------------------------------------------------------------------------------------------------------*/
+double Simplify_SegmentError(const TrackPoint *a, const TrackPoint *b, const TrackPoint *p) {
+	NavFrame f;
+	NavPoint pb, pp;
+
+	NavFrame_Init(&f, a->lat, a->lon, 0.0);
+	NavFrame_Project(&f, b->lat, b->lon, &pb);
+	NavFrame_Project(&f, p->lat, p->lon, &pp);
+	NavFrame_Free(&f);
+	return sqrt(segDist2(0.0, 0.0, pb.e, pb.n, pp.e, pp.n));
+}
@@ -0,0 +1,70 @@
+#ifndef SIMPLIFY_h_
+#define SIMPLIFY_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "track.h"
+
+  /* Douglas-Peucker line simplification with a tolerance in metres. Every dropped point lies within the tolerance
+    of the straight segment joining the kept points either side of it, so the simplified track never strays further
+    than that from the recorded one. Distances are measured in a local east-north frame (nav_frame.h) anchored on
+    the start of each segment, so they stay accurate to millimetres however far the track wanders.
+    Simplify_Track works on a whole track in memory. The Simplifier streams: it holds a window of at most
+    `window` points, simplifies it, emits every kept point except the last segment, which is still open, and
+    carries that segment into the next window. Memory therefore stays fixed however large the log is, and the
+    tolerance still holds, because every dropped point is checked against the segment between kept points that
+    finally bracket it. Cutting at window edges can keep a few more points than a whole-track pass would.
+    The decimator drops points by time (at most one per minIntervalMs), keeping the original time stamps. It
+    gives no distance guarantee of its own, so apply it before the simplifier.
+   */
+
+#define SIMPLIFY_DEFAULT_WINDOW 4096
+
+//Called with each point the simplifier keeps, in order. Return non-zero to abort
+typedef int (*SimplifyEmit)(void *ctx, const TrackPoint *pt);
+
+//Streaming simplifier
+typedef struct {
+	double tolM;             //Tolerance (m)
+	TrackPoint *win;         //Window of points, win[0] is the last point emitted
+	uint8_t *keep;           //Points kept by the last pass over the window
+	size_t *stack;           //Segments still to check
+	size_t window, count;
+	SimplifyEmit emit;
+	void *ctx;
+	unsigned long in, out;   //Points pushed and emitted
+	int err;
+} Simplifier;
+
+//Time decimator
+typedef struct {
+	uint32_t minIntervalMs;
+	int have;
+	uint64_t lastMs;         //Unwrapped time of the last point kept
+	uint64_t prevMs;         //Unwrapped time of the last point seen
+	uint64_t dayOffset;      //GPS time of day wraps at midnight
+} SimplifyDecimator;
+
+//Simplify a track in place. Returns the number of points kept, or 0 if out of memory
+size_t Simplify_Track(TrackPoint *pts, size_t n, double tolM);
+
+//Set up a streaming simplifier holding at most window points (3 or more). Returns -1 if out of memory
+int Simplify_Init(Simplifier *s, double tolM, size_t window, SimplifyEmit emit, void *ctx);
+
+//Add the next point. Returns -1 if emit aborted
+int Simplify_Push(Simplifier *s, const TrackPoint *pt);
+
+//Emit the rest of the track, always including its last point. Returns -1 if emit aborted
+int Simplify_Finish(Simplifier *s);
+void Simplify_Free(Simplifier *s);
+
+//Set up a decimator keeping at most one point per minIntervalMs
+void Simplify_DecimateInit(SimplifyDecimator *d, uint32_t minIntervalMs);
+
+//1 if the point should be kept. Points without a time stamp (0) are always kept
+int Simplify_DecimateKeep(SimplifyDecimator *d, const TrackPoint *pt);
+
+//Distance (m) from p to the segment a-b
+double Simplify_SegmentError(const TrackPoint *a, const TrackPoint *b, const TrackPoint *p);
+
+#endif
@@ -0,0 +1,204 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: supervisor.c
+Source Description: Non-blocking device attach and hot-plug supervision on PhidgetManager and channel events
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "supervisor.h"
+#include "hal.h"
+#include "gps_fix.h"
+
+#define SUP_MAX_DEVICES 16  //Devices tracked by serial number
+#define SUP_NAME_LEN    40
+
+//A device seen by the manager
+typedef struct {
+	int serial;
+	char name[SUP_NAME_LEN];
+	int attached;
+	unsigned long attaches, detaches;
+} SupDevice;
+
+static pthread_mutex_t devLock = PTHREAD_MUTEX_INITIALIZER;
+static SupDevice devices[SUP_MAX_DEVICES];   //Guarded by devLock
+static int deviceCount = 0;
+
+//GPS channel state, set on the Phidget event threads and read by the control thread
+static int gpsSerial;
+static atomic_int gpsAttached;
+static _Atomic uint64_t gpsAttachNs, gpsDetachNs;
+static uint64_t startNs;
+
+//Outages, written on the event threads
+static _Atomic unsigned long outages;
+static _Atomic uint64_t outageSumNs, outageMaxNs, firstAttachNs;
+
+//Control thread's view, written only by Sup_GPSReady
+static int ready = 0, everReady = 0, outageSeen = 0;
+static uint64_t firstReadyNs = 0;
+static unsigned long stops = 0, recoveries = 0, fixLosses = 0;
+static uint64_t stopMaxNs = 0, recoverySumNs = 0, recoveryMaxNs = 0;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: gpsChanged
+Function Description: GPS channel attach or detach. Repeats are ignored, since the manager and the channel both
+                      report an unplug. A detach publishes a no-fix state so a control loop waiting on gps_fix
+                      wakes and stops the motors
+Input Parameters: attached - new state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void gpsChanged(int attached) {
+	uint64_t now = GPSFix_NowNs();
+
+	if (attached) {
+		if (atomic_load(&gpsAttached))
+			return;
+		uint64_t detachNs = atomic_load(&gpsDetachNs);
+		if (detachNs) {
+			uint64_t down = now - detachNs;
+			atomic_fetch_add(&outages, 1);
+			atomic_fetch_add(&outageSumNs, down);
+			if (down > atomic_load(&outageMaxNs))
+				atomic_store(&outageMaxNs, down);
+		} else {
+			atomic_store(&firstAttachNs, now);
+		}
+		atomic_store(&gpsAttachNs, now);
+		atomic_store_explicit(&gpsAttached, 1, memory_order_release);
+	} else if (atomic_exchange(&gpsAttached, 0)) {
+		atomic_store(&gpsDetachNs, now);
+		GPSFix_SetFixState(0);
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: deviceChanged
+Function Description: Manager attach or detach. Updates the device table, and treats an unplug of the GPS device
+                      as a GPS detach in case it arrives before the channel's own event
+Input Parameters: serial, name - the device, attached - new state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void deviceChanged(int serial, const char *name, int attached) {
+	pthread_mutex_lock(&devLock);
+	int i = 0;
+	while (i < deviceCount && devices[i].serial != serial)
+		i++;
+	if (i == deviceCount && deviceCount < SUP_MAX_DEVICES) {
+		devices[i].serial = serial;
+		snprintf(devices[i].name, SUP_NAME_LEN, "%s", name);
+		deviceCount++;
+	}
+	if (i < deviceCount) {
+		devices[i].attached = attached;
+		if (attached)
+			devices[i].attaches++;
+		else
+			devices[i].detaches++;
+	}
+	pthread_mutex_unlock(&devLock);
+
+	if (!attached && serial == gpsSerial)
+		gpsChanged(0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sup_Start
+Function Description: Opens the manager and the GPS channel. Neither waits for a device to attach
+Input Parameters: serial - GPS serial number, events - 1 to publish GPS events to gps_fix
+Output Parameters: 0 on success, -1 if the GPS channel could not be opened
+/---------------------------------------------------------------------------------------------------------*/
+int Sup_Start(int serial, int events) {
+	gpsSerial = serial;
+	startNs = GPSFix_NowNs();
+	if (HAL_Devices_Open(deviceChanged) != 0)
+		printf("Supervisor: no device manager, relying on channel events\n");
+	HAL_GPS_SetAttachHandler(gpsChanged);
+	return HAL_GPS_Open(serial, events, 0);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sup_GPSReady
+Function Description: Checks the GPS can be steered on, and times the transitions: detach to the first tick that
+                      stops, and re-attach to the first tick that steers again. Only a position counts as a fix:
+                      heading and fix state events also arrive after a re-attach, but the position would still be
+                      the one from before the unplug (or none at all on start-up). A lost fix while attached also
+                      holds the motors, and is counted apart from outages
+Input Parameters: posRxNs - receive time of the position the tick would use, fixState - its fix state
+Output Parameters: 1 if the GPS is attached, has a fix, and the position arrived after it attached, 0 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int Sup_GPSReady(uint64_t posRxNs, int fixState) {
+	int attached = atomic_load_explicit(&gpsAttached, memory_order_acquire);
+	int now = attached && posRxNs >= atomic_load(&gpsAttachNs) && fixState > 0;
+	outageSeen |= !attached;
+	if (now == ready)
+		return now;
+
+	uint64_t t = GPSFix_NowNs();
+	if (now && !everReady) {
+		firstReadyNs = t;
+		everReady = 1;
+		outageSeen = 0;
+	} else if (now && !outageSeen) {
+		//Fix regained without an unplug, not a re-attach
+	} else if (now) {
+		outageSeen = 0;
+		uint64_t ns = t - atomic_load(&gpsAttachNs);
+		recoveries++;
+		recoverySumNs += ns;
+		if (ns > recoveryMaxNs)
+			recoveryMaxNs = ns;
+	} else if (attached) {
+		fixLosses++;
+	} else {
+		uint64_t detachNs = atomic_load(&gpsDetachNs);
+		uint64_t ns = t > detachNs ? t - detachNs : 0;
+		stops++;
+		if (ns > stopMaxNs)
+			stopMaxNs = ns;
+	}
+	ready = now;
+	return now;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sup_Stop
+Function Description: Closes the GPS channel, then the manager
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sup_Stop(void) {
+	HAL_GPS_Close();
+	HAL_Devices_Close();
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Sup_PrintStats
+Function Description: Prints the devices seen, start-up times and GPS outage figures
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Sup_PrintStats(void) {
+	pthread_mutex_lock(&devLock);
+	for (int i = 0; i < deviceCount; i++)
+		printf("Device %s (%d): %s, %lu attaches, %lu detaches\n", devices[i].name, devices[i].serial,
+			devices[i].attached ? "attached" : "detached", devices[i].attaches, devices[i].detaches);
+	pthread_mutex_unlock(&devLock);
+
+	uint64_t first = atomic_load(&firstAttachNs);
+	if (first)
+		printf("GPS: attached %.1f ms after start, steering after %.1f ms\n", (first - startNs) / 1e6,
+			everReady ? (firstReadyNs - startNs) / 1e6 : 0.0);
+	else
+		printf("GPS: never attached\n");
+
+	unsigned long n = atomic_load(&outages);
+	printf("GPS: %lu outages (mean %.1f ms, max %.1f ms), stopped within %.2f ms, steering %.2f ms after "
+		"re-attach (mean, max %.2f ms)\n", n, n ? atomic_load(&outageSumNs) / 1e6 / n : 0.0,
+		atomic_load(&outageMaxNs) / 1e6, stops ? stopMaxNs / 1e6 : 0.0,
+		recoveries ? recoverySumNs / 1e6 / recoveries : 0.0, recoveryMaxNs / 1e6);
+	if (fixLosses)
+		printf("GPS: %lu fix losses while attached held the motors\n", fixLosses);
+}
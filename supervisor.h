@@ -0,0 +1,33 @@
+#ifndef SUPERVISOR_h_
+#define SUPERVISOR_h_
+
+#include <stdint.h>
+
+  /* Device supervisor. Sup_Start opens a PhidgetManager and the GPS channel without waiting, so the rover starts
+    at once however slowly the GPS enumerates, and phidget22 re-attaches the open channel whenever it is plugged
+    back in. The manager reports every device by serial number; the GPS channel's own attach and detach events
+    set its state. A detach also publishes a no-fix state to gps_fix, so a control loop asleep in GPSFix_Wait
+    wakes straight away.
+
+    Each tick the control loop asks Sup_GPSReady, which is a few atomic loads. It is false from a detach until a
+    position arrives after the GPS attaches again, so the loop stops the motors within one tick of an unplug and
+    never steers on a position from before it. Heading and fix state events don't count, since the phidget can send
+    them first. It is also false while the GPS reports no fix. Outages, the time to stop and the time from re-attach
+    to steering again are counted and printed on exit.
+   */
+
+//Opens the device manager and the GPS channel without waiting for either. Returns -1 if the GPS channel could
+//not be opened, the manager is optional
+int Sup_Start(int gpsSerial, int events);
+
+//Whether the GPS is attached with a fix and posRxNs (GPSFix.posRxNs of the snapshot about to be used) is from
+//after it last attached. Control thread only
+int Sup_GPSReady(uint64_t posRxNs, int fixState);
+
+//Closes the GPS channel and the manager
+void Sup_Stop(void);
+
+//Prints each device and the GPS outage and recovery figures
+void Sup_PrintStats(void);
+
+#endif
@@ -0,0 +1,320 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: telem_stream.c
+Source Description: Batched binary UDP telemetry: fixed-layout records packed into MTU-sized datagrams by a
+                    sender thread, fed from the control loop through a lock-free ring
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "telem_stream.h"
+
+#define STREAM_POLL_MS 10  //Sender thread wake interval
+
+static StreamSample ring[STREAM_RING_SIZE];
+static _Atomic uint32_t ringHead;   //Next slot the control thread fills
+static _Atomic uint32_t ringTail;   //Next slot the sender thread drains
+
+static _Atomic uint64_t statSamples, statRingDrops, statDatagrams, statSendDrops, statBytes;
+
+static int sock = -1;
+static pthread_t sender;
+static atomic_int running;
+static uint64_t periodNs;           //Between samples
+static uint64_t nextNs;             //Next sample due, control thread only
+static uint64_t t0Ns;               //Rover time origin
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: put16 / put32 / get16 / get32
+Function Description: Little-endian stores and loads, so the layout does not depend on the host
+Input Parameters: p - bytes, v - value
+Output Parameters: Loaded value
+/---------------------------------------------------------------------------------------------------------*/
+static void put16(uint8_t *p, uint16_t v) {
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+	put16(p, (uint16_t)v);
+	put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get16(const uint8_t *p) {
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: quant
+Function Description: Scales and rounds a value to an integer field, clamped to the field's range
+Input Parameters: v - value, scale - units per integer step inverse, lo, hi - field range
+Output Parameters: Field value
+/---------------------------------------------------------------------------------------------------------*/
+static int64_t quant(double v, double scale, int64_t lo, int64_t hi) {
+	double q = nearbyint(v * scale);
+	if (!(q >= (double)lo)) //Also catches NaN
+		return lo;
+	if (q > (double)hi)
+		return hi;
+	return (int64_t)q;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_Encode
+Function Description: Packs one sample into the record layout in telem_stream.h
+Input Parameters: out - STREAM_RECORD_SIZE bytes, s - sample, t0Ns - rover time origin
+Output Parameters: Bytes written
+/---------------------------------------------------------------------------------------------------------*/
+size_t Stream_Encode(uint8_t *out, const StreamSample *s, uint64_t t0Ns) {
+	put32(out + 0, (uint32_t)((s->tNs - t0Ns) / 1000000ull));
+	put32(out + 4, (uint32_t)(int32_t)quant(s->lat, 1e7, -900000000, 900000000));
+	put32(out + 8, (uint32_t)(int32_t)quant(s->lon, 1e7, -1800000000, 1800000000));
+	put16(out + 12, (uint16_t)quant(s->head, 100.0, 0, 35999));
+	put16(out + 14, (uint16_t)(int16_t)quant(s->error, 100.0, -18000, 18000));
+	put16(out + 16, (uint16_t)quant(s->speed, 100.0, 0, UINT16_MAX));
+	out[18] = (uint8_t)(int8_t)quant(s->dutyL, 1.0, -100, 100);
+	out[19] = (uint8_t)(int8_t)quant(s->dutyR, 1.0, -100, 100);
+	put16(out + 20, (uint16_t)quant(s->fixAgeMs, 10.0, 0, UINT16_MAX));
+	put16(out + 22, (uint16_t)quant(s->lateUs, 1.0, 0, UINT16_MAX));
+	put16(out + 24, (uint16_t)quant(s->leg, 1.0, 0, UINT16_MAX));
+	out[26] = (uint8_t)quant(s->fixState, 1.0, 0, UINT8_MAX);
+	out[27] = (uint8_t)quant(s->status, 1.0, 0, UINT8_MAX);
+	put16(out + 28, (uint16_t)quant(s->distance, 10.0, 0, UINT16_MAX));
+	put16(out + 30, (uint16_t)(int16_t)quant(s->crossTrack, 10.0, INT16_MIN, INT16_MAX));
+	return STREAM_RECORD_SIZE;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_DecodeHeader
+Function Description: Validates a datagram and reads its header
+Input Parameters: buf, len - datagram, h - header out
+Output Parameters: 0 if valid, -1 if not
+/---------------------------------------------------------------------------------------------------------*/
+int Stream_DecodeHeader(const uint8_t *buf, size_t len, StreamHeader *h) {
+	if (len < STREAM_HEADER_SIZE || get16(buf) != STREAM_MAGIC || buf[2] != STREAM_VERSION)
+		return -1;
+	h->count = buf[3];
+	h->seq = get32(buf + 4);
+	h->dropped = get32(buf + 8);
+	if (len != STREAM_HEADER_SIZE + (size_t)h->count * STREAM_RECORD_SIZE)
+		return -1;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_DecodeRecord
+Function Description: Unpacks one record back into engineering units
+Input Parameters: buf - datagram, i - record index, r - record out
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Stream_DecodeRecord(const uint8_t *buf, int i, StreamRecord *r) {
+	const uint8_t *p = buf + STREAM_HEADER_SIZE + (size_t)i * STREAM_RECORD_SIZE;
+	r->tMs = get32(p);
+	r->lat = (int32_t)get32(p + 4) / 1e7;
+	r->lon = (int32_t)get32(p + 8) / 1e7;
+	r->head = get16(p + 12) / 100.0;
+	r->error = (int16_t)get16(p + 14) / 100.0;
+	r->speed = get16(p + 16) / 100.0;
+	r->dutyL = (int8_t)p[18];
+	r->dutyR = (int8_t)p[19];
+	r->fixAgeMs = get16(p + 20) / 10.0;
+	r->lateUs = get16(p + 22);
+	r->leg = get16(p + 24);
+	r->fixState = p[26];
+	r->status = p[27];
+	r->distance = get16(p + 28) / 10.0;
+	r->crossTrack = (int16_t)get16(p + 30) / 10.0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sendDatagram
+Function Description: Fills in the header and sends without blocking. A datagram the socket won't take now is
+                      counted and dropped, the next one carries on
+Input Parameters: buf - datagram with count records after the header, count - records, seq - datagram number
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sendDatagram(uint8_t *buf, int count, uint32_t seq) {
+	size_t len = STREAM_HEADER_SIZE + (size_t)count * STREAM_RECORD_SIZE;
+	put16(buf, STREAM_MAGIC);
+	buf[2] = STREAM_VERSION;
+	buf[3] = (uint8_t)count;
+	put32(buf + 4, seq);
+	put32(buf + 8, (uint32_t)atomic_load_explicit(&statRingDrops, memory_order_relaxed));
+
+	if (send(sock, buf, len, MSG_DONTWAIT) == (ssize_t)len) {
+		atomic_fetch_add_explicit(&statDatagrams, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&statBytes, len, memory_order_relaxed);
+	} else {
+		atomic_fetch_add_explicit(&statSendDrops, 1, memory_order_relaxed);
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: senderThread
+Function Description: Every STREAM_POLL_MS drains the ring into the datagram being built, sending it when it is full
+                      or its first record has waited STREAM_MAX_DELAY_MS, and once more on close
+Input Parameters: arg - unused
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void *senderThread(void *arg) {
+	static uint8_t buf[STREAM_MTU_PAYLOAD];
+	struct timespec poll = {0, STREAM_POLL_MS * 1000000L};
+	uint32_t seq = 0;
+	int count = 0;
+	uint64_t firstNs = 0;
+
+	for (int last = 0; !last; ) {
+		last = !atomic_load(&running);
+		uint32_t tail = atomic_load_explicit(&ringTail, memory_order_relaxed);
+		uint32_t head = atomic_load_explicit(&ringHead, memory_order_acquire);
+
+		for (uint32_t i = tail; i != head; i++) {
+			if (count == 0)
+				firstNs = nowNs();
+			Stream_Encode(buf + STREAM_HEADER_SIZE + (size_t)count * STREAM_RECORD_SIZE, &ring[i & (STREAM_RING_SIZE - 1)], t0Ns);
+			if (++count == STREAM_MAX_RECORDS) {
+				sendDatagram(buf, count, seq++);
+				count = 0;
+			}
+		}
+		atomic_store_explicit(&ringTail, head, memory_order_release);
+
+		if (count > 0 && (last || nowNs() - firstNs >= STREAM_MAX_DELAY_MS * 1000000ull)) {
+			sendDatagram(buf, count, seq++);
+			count = 0;
+		}
+		if (!last)
+			nanosleep(&poll, NULL);
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_Open
+Function Description: Resolves the ground station, connects a non-blocking UDP socket to it and starts the sender
+Input Parameters: host - name or address, port - UDP port, rateHz - samples per second (0 or less for every tick)
+Output Parameters: 0 on success, -1 if the address can't be resolved or the socket or thread can't be created
+/---------------------------------------------------------------------------------------------------------*/
+int Stream_Open(const char *host, int port, double rateHz) {
+	struct addrinfo hints, *res;
+	char service[16];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(service, sizeof(service), "%d", port);
+	if (getaddrinfo(host, service, &hints, &res) != 0)
+		return -1;
+	sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(res);
+	if (sock < 0)
+		return -1;
+
+	periodNs = rateHz > 0.0 ? (uint64_t)(1e9 / rateHz) : 0;
+	t0Ns = nextNs = nowNs();
+	atomic_store(&ringHead, 0);
+	atomic_store(&ringTail, 0);
+	atomic_store(&running, 1);
+	if (pthread_create(&sender, NULL, senderThread, NULL) != 0) {
+		atomic_store(&running, 0);
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_Push
+Function Description: Copies a sample into the ring if one is due. Samples are spaced on a fixed schedule, which
+                      restarts from now after a gap rather than catching up
+Input Parameters: s - sample
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Stream_Push(const StreamSample *s) {
+	if (sock < 0 || s->tNs < nextNs)
+		return;
+	nextNs += periodNs;
+	if (nextNs <= s->tNs)
+		nextNs = s->tNs + periodNs;
+
+	uint32_t head = atomic_load_explicit(&ringHead, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&ringTail, memory_order_acquire);
+	atomic_fetch_add_explicit(&statSamples, 1, memory_order_relaxed);
+	if (head - tail >= STREAM_RING_SIZE) {
+		atomic_fetch_add_explicit(&statRingDrops, 1, memory_order_relaxed);
+		return;
+	}
+	ring[head & (STREAM_RING_SIZE - 1)] = *s;
+	atomic_store_explicit(&ringHead, head + 1, memory_order_release);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_Close
+Function Description: Stops the sender after it has sent what is queued, and closes the socket
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Stream_Close(void) {
+	if (sock < 0)
+		return;
+	if (atomic_exchange(&running, 0))
+		pthread_join(sender, NULL);
+	close(sock);
+	sock = -1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_GetStats
+Function Description: Copies the sender counters
+Input Parameters: out - counters
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Stream_GetStats(StreamStats *out) {
+	out->samples = atomic_load(&statSamples);
+	out->ringDrops = atomic_load(&statRingDrops);
+	out->datagrams = atomic_load(&statDatagrams);
+	out->sendDrops = atomic_load(&statSendDrops);
+	out->bytes = atomic_load(&statBytes);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Stream_PrintStats
+Function Description: Prints the sender counters
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Stream_PrintStats(void) {
+	StreamStats s;
+	Stream_GetStats(&s);
+	printf("Stream: %llu samples, %llu datagrams (%llu bytes), %llu samples and %llu datagrams dropped\n",
+		(unsigned long long)s.samples, (unsigned long long)s.datagrams, (unsigned long long)s.bytes,
+		(unsigned long long)s.ringDrops, (unsigned long long)s.sendDrops);
+}
@@ -0,0 +1,101 @@
+#ifndef TELEM_STREAM_h_
+#define TELEM_STREAM_h_
+
+#include <stdint.h>
+#include <stddef.h>
+
+  /* Binary telemetry over UDP for a ground station. The control loop hands one StreamSample per tick to
+    Stream_Push, which keeps at most one per 1/rateHz and copies it into a lock-free ring: no lock, no system call.
+    A sender thread packs the samples into fixed 32-byte little-endian records and sends a datagram when it holds
+    STREAM_MAX_RECORDS records (one Ethernet MTU) or its oldest record is STREAM_MAX_DELAY_MS old. The socket is
+    non-blocking, so a full send buffer drops a datagram instead of stalling the sender.
+
+    Datagram: header of STREAM_HEADER_SIZE bytes, then count records
+      0  u16 magic STREAM_MAGIC      2  u8 version      3  u8 count
+      4  u32 datagram sequence       8  u32 samples dropped by the sender so far
+    Record
+      0  u32 rover time (ms)         4  i32 latitude (1e-7 deg)     8  i32 longitude (1e-7 deg)
+     12  u16 heading (0.01 deg)     14  i16 heading error, -180 to 180 (0.01 deg)
+     16  u16 speed (0.01 km/h)      18  i8 left duty    19  i8 right duty
+     20  u16 fix age (0.1 ms)       22  u16 tick lateness (us)
+     24  u16 target waypoint        26  u8 fix state    27  u8 mission status
+     28  u16 distance (0.1 m)       30  i16 cross-track (0.1 m)
+    Values outside a field's range are clamped to it.
+   */
+
+#define STREAM_MAGIC        0x5452u  //"RT"
+#define STREAM_VERSION      1
+#define STREAM_HEADER_SIZE  12
+#define STREAM_RECORD_SIZE  32
+#define STREAM_MTU_PAYLOAD  1472     //1500-byte MTU less IPv4 and UDP headers
+#define STREAM_MAX_RECORDS  ((STREAM_MTU_PAYLOAD - STREAM_HEADER_SIZE) / STREAM_RECORD_SIZE)
+#define STREAM_MAX_DELAY_MS 250      //Longest a record waits for its datagram to fill
+#define STREAM_RING_SIZE    1024     //Samples buffered between control and sender thread (power of 2)
+#define STREAM_DEFAULT_HZ   10
+#define STREAM_DEFAULT_PORT 5005
+
+//Per-tick state, as sent after quantising
+typedef struct {
+	uint64_t tNs;           //Monotonic time of the tick
+	double lat, lon;        //Latest fix
+	double head;            //Heading steered on
+	double error;           //Heading error (degrees), wrapped to [-180, 180)
+	double speed;           //km/h
+	double distance;        //To the target waypoint (m)
+	double crossTrack;      //Off the active leg (m)
+	double fixAgeMs;        //Age of the fix when the tick used it
+	double lateUs;          //Fixed-rate tick wake-up lateness, 0 in the other modes
+	int dutyL, dutyR;       //Commanded wheel duties
+	int leg;                //Target waypoint (from 0)
+	int fixState;
+	int status;             //MissionStatus
+} StreamSample;
+
+//Record as decoded by a receiver
+typedef struct {
+	uint32_t tMs;
+	double lat, lon, head, error, speed, distance, crossTrack, fixAgeMs, lateUs;
+	int dutyL, dutyR, leg, fixState, status;
+} StreamRecord;
+
+//Datagram header as decoded by a receiver
+typedef struct {
+	uint32_t seq;
+	uint32_t dropped;
+	int count;
+} StreamHeader;
+
+//Sender counters
+typedef struct {
+	uint64_t samples;       //Samples queued by Stream_Push
+	uint64_t ringDrops;     //Samples lost because the ring was full
+	uint64_t datagrams;     //Datagrams sent
+	uint64_t sendDrops;     //Datagrams the socket would not take
+	uint64_t bytes;         //Bytes sent
+} StreamStats;
+
+//Opens a UDP socket to host:port and starts the sender thread, keeping rateHz samples per second
+int Stream_Open(const char *host, int port, double rateHz);
+
+//Queues a sample if one is due. Control thread only, never blocks
+void Stream_Push(const StreamSample *s);
+
+//Sends what is buffered and stops the sender thread
+void Stream_Close(void);
+
+//Copies the sender counters
+void Stream_GetStats(StreamStats *out);
+
+//Prints the sender counters
+void Stream_PrintStats(void);
+
+//Packs one record, returns STREAM_RECORD_SIZE. t0Ns is the rover time origin
+size_t Stream_Encode(uint8_t *out, const StreamSample *s, uint64_t t0Ns);
+
+//Checks a datagram's header and length. Returns -1 if it is not a stream datagram of this version
+int Stream_DecodeHeader(const uint8_t *buf, size_t len, StreamHeader *h);
+
+//Unpacks record i of a datagram that passed Stream_DecodeHeader
+void Stream_DecodeRecord(const uint8_t *buf, int i, StreamRecord *r);
+
+#endif
@@ -0,0 +1,158 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: telemetry.c
+Source Description: Shared-memory telemetry segment: seqlock-guarded state written by the rover, read by any
+                    number of monitoring processes
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "telemetry.h"
+#include "seqlock.h"
+
+_Static_assert(sizeof(TelemState) % 8 == 0, "TelemState must be a multiple of 8 bytes for the seqlock");
+
+//Segment layout
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;      //sizeof(TelemState)
+	int32_t pid;        //Writer
+	SeqLock lock;
+	uint32_t pad;
+	TelemState state;
+} TelemSegment;
+
+static TelemSegment *segment = NULL;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_Create
+Function Description: Creates (or takes over) the segment, sizes and maps it, and writes the header. The magic
+                      is written last so a reader never accepts a half-initialised segment
+Input Parameters: N/A
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int Telem_Create(void) {
+	int fd = shm_open(TELEM_SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, sizeof(TelemSegment)) != 0) {
+		close(fd);
+		return -1;
+	}
+	void *map = mmap(NULL, sizeof(TelemSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	segment = (TelemSegment *)map;
+	__atomic_store_n(&segment->magic, 0, __ATOMIC_RELAXED);
+	memset(&segment->state, 0, sizeof(segment->state));
+	atomic_store(&segment->lock.seq, 0);
+	segment->version = TELEM_VERSION;
+	segment->size = sizeof(TelemState);
+	segment->pid = (int32_t)getpid();
+	__atomic_store_n(&segment->magic, TELEM_MAGIC, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_Publish
+Function Description: Copies one snapshot into the segment under the seqlock
+Input Parameters: s - state
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Telem_Publish(const TelemState *s) {
+	if (segment)
+		SeqLock_Store(&segment->lock, &segment->state, s, sizeof(*s));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_Destroy
+Function Description: Marks the segment dead, unmaps it and removes its name. Mapped readers keep their view
+Input Parameters: N/A
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Telem_Destroy(void) {
+	if (!segment)
+		return;
+	__atomic_store_n(&segment->pid, 0, __ATOMIC_RELEASE);
+	munmap(segment, sizeof(TelemSegment));
+	segment = NULL;
+	shm_unlink(TELEM_SHM_NAME);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_Open
+Function Description: Maps the segment read-only and checks its header
+Input Parameters: r - reader
+Output Parameters: 0 on success, -1 if there is no segment, -2 if its layout does not match
+/---------------------------------------------------------------------------------------------------------*/
+int Telem_Open(TelemReader *r) {
+	struct stat st;
+	memset(r, 0, sizeof(*r));
+	r->fd = shm_open(TELEM_SHM_NAME, O_RDONLY, 0);
+	if (r->fd < 0)
+		return -1;
+	if (fstat(r->fd, &st) != 0 || (size_t)st.st_size < sizeof(TelemSegment)) {
+		close(r->fd);
+		return -2;
+	}
+	r->map = mmap(NULL, sizeof(TelemSegment), PROT_READ, MAP_SHARED, r->fd, 0);
+	if (r->map == MAP_FAILED) {
+		close(r->fd);
+		r->map = NULL;
+		return -1;
+	}
+
+	const TelemSegment *seg = (const TelemSegment *)r->map;
+	if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != TELEM_MAGIC || seg->version != TELEM_VERSION ||
+		seg->size != sizeof(TelemState)) {
+		Telem_Close(r);
+		return -2;
+	}
+	r->writerPid = seg->pid;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_Read
+Function Description: Takes a consistent snapshot, retrying while the writer is part way through a publish
+Input Parameters: r - reader, out - snapshot
+Output Parameters: Sequence number of the snapshot, 0 if nothing has been published
+/---------------------------------------------------------------------------------------------------------*/
+unsigned Telem_Read(TelemReader *r, TelemState *out) {
+	TelemSegment *seg = (TelemSegment *)r->map;
+	return SeqLock_Load(&seg->lock, &seg->state, out, sizeof(*out));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_WriterAlive
+Function Description: Checks that the process which created the segment is still running and has not closed it
+Input Parameters: r - reader
+Output Parameters: 1 if alive, 0 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int Telem_WriterAlive(const TelemReader *r) {
+	const TelemSegment *seg = (const TelemSegment *)r->map;
+	int32_t pid = __atomic_load_n(&seg->pid, __ATOMIC_ACQUIRE);
+	return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Telem_Close
+Function Description: Unmaps the segment
+Input Parameters: r - reader
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Telem_Close(TelemReader *r) {
+	if (r->map)
+		munmap(r->map, sizeof(TelemSegment));
+	if (r->fd >= 0)
+		close(r->fd);
+	r->map = NULL;
+	r->fd = -1;
+}
@@ -0,0 +1,86 @@
+#ifndef TELEMETRY_h_
+#define TELEMETRY_h_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /* Live telemetry in POSIX shared memory. The rover publishes its whole state once per control tick into the
+    segment TELEM_SHM_NAME, under a seqlock. Any number of local processes can map it read-only and take
+    consistent snapshots. Readers never write to the segment, so they cost the rover nothing whether or not
+    they are attached. The writer only copies one TelemState into memory. Readers check the magic, version and
+    size before trusting the layout, and can tell a stopped rover by the snapshot age or the writer's pid.
+
+    This header is plain C with C linkage, so C++ tools can include it and link telemetry.c.
+   */
+
+#define TELEM_SHM_NAME "/roco318_telemetry"
+#define TELEM_MAGIC    0x524f434fu  //"ROCO"
+#define TELEM_VERSION  1
+
+//Rover state in one tick
+typedef struct {
+	uint64_t tNs;           //Monotonic time of the snapshot
+	uint64_t ticks;         //Control loop iterations
+	uint64_t fixes;         //GPS fixes used
+	uint64_t fixRxNs;       //Monotonic time the latest fix arrived
+	uint64_t overruns;      //Fixed-rate ticks that started late
+	double lat, lon;        //Latest GPS fix
+	double gpsHead;         //GPS heading (degrees)
+	double gpsSpeed;        //GPS speed (km/h)
+	double navLat, navLon;  //Position steered on, the estimator's prediction with -e
+	double head;            //Heading steered on
+	double bearing;         //Bearing to the target waypoint
+	double error;           //Heading error, 0 to 360
+	double distance;        //To the target waypoint (m)
+	double crossTrack;      //Off the active leg (m), positive right
+	double dutyL, dutyR;    //Commanded wheel duties
+	double appliedL, appliedR;  //Duties applied by the motor ramps
+	uint32_t gpsTimeMs;     //GPS time of day
+	int32_t fixState;
+	int32_t leg, count;     //Target waypoint (from 0) and route length
+	int32_t status;         //MissionStatus
+	int32_t flags;          //TELEM_* below
+	char mode[24];          //Steering mode or turn table entry
+} TelemState;
+
+#define TELEM_PID       0x1  //PID heading controller, otherwise the turn table
+#define TELEM_ESTIMATOR 0x2  //Steering on the estimator's prediction
+#define TELEM_REALTIME  0x4  //Fixed-rate real-time loop
+
+//Read-only view of the segment
+typedef struct {
+	int fd;
+	void *map;
+	int32_t writerPid;
+} TelemReader;
+
+//Writer: creates the segment, returns -1 if it could not
+int Telem_Create(void);
+
+//Writer: publishes one snapshot, never blocks
+void Telem_Publish(const TelemState *s);
+
+//Writer: removes the segment
+void Telem_Destroy(void);
+
+//Reader: maps the segment. Returns 0, -1 if there is none, -2 if its layout does not match this build
+int Telem_Open(TelemReader *r);
+
+//Reader: takes a consistent snapshot. Returns its sequence number (changes with every publish), 0 if nothing has
+//been published yet
+unsigned Telem_Read(TelemReader *r, TelemState *out);
+
+//Reader: 1 if the writing process is still running
+int Telem_WriterAlive(const TelemReader *r);
+
+//Reader: unmaps the segment
+void Telem_Close(TelemReader *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
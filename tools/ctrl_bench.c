@@ -0,0 +1,316 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: ctrl_bench.c
+Source Description: Drives the rover model around a route with the bucket turn table, with the PID heading
+                    controller on each fix, and with the PID running faster on the Kalman filter's predicted
+                    pose, and compares time to arrival, distance travelled, tracking error and overshoot
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "../navigator.h"
+#include "../mission.h"
+#include "../heading_ctrl.h"
+#include "../rover_model.h"
+#include "../estimator.h"
+#include "../geodesy.h"
+
+#define FullSpeed 100
+#define TurnSpeed 80
+
+#define SIM_DT 0.005  //Model integration step (s)
+
+//Steering for one run
+typedef enum {
+	BENCH_BUCKET = 0,  //Turn table on each fix
+	BENCH_PID,         //PID on each fix
+	BENCH_EKF          //PID at the control rate on the estimator's predicted pose
+} BenchMode;
+
+static const char *benchModeNames[] = {"bucket", "pid", "pid+ekf"};
+
+//Result of driving one route with one controller
+typedef struct {
+	int arrived;
+	double time;        //Time to the final waypoint (s)
+	double distance;    //Distance travelled (m)
+	double xtMean;      //Mean absolute cross-track error (m)
+	double xtMax;
+	unsigned long pivots;  //Control ticks with the wheels turning opposite ways
+	double overshoot;   //Mean over legs of the peak true heading error after it first crosses zero (degrees)
+} BenchResult;
+
+//Per leg overshoot tracking on the true pose
+typedef struct {
+	size_t leg;
+	int sign;        //Sign of the error at the start of the leg
+	int crossed;
+	double peak;
+	double sum;
+	unsigned long legs;
+} Overshoot;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options]\n"
+		"  -m file      route to drive (GPX or CSV), default a 6 leg 40 m survey pattern\n"
+		"  -r hz        fix rate, and the control rate without the estimator (default 10)\n"
+		"  -e hz        control rate on the estimator's predicted pose, 0 to skip (default 50)\n"
+		"  -n metres    GPS position noise (default 0.3)\n"
+		"  -h degrees   heading noise (default 3)\n"
+		"  -s seed      first noise seed (default 1)\n"
+		"  -N runs      runs per controller with successive seeds, results averaged (default 5)\n"
+		"  -T seconds   give up after this long (default 900)\n", prog);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: surveyRoute
+Function Description: Lawnmower pattern of 40 m legs 10 m apart near the default target
+Input Parameters: wps - room for 6 waypoints
+Output Parameters: Number of waypoints
+/---------------------------------------------------------------------------------------------------------*/
+static size_t surveyRoute(Waypoint *wps) {
+	static const double en[6][2] = {{0, 40}, {10, 40}, {10, 0}, {20, 0}, {20, 40}, {30, 40}};
+	NavFrame f;
+	NavFrame_Init(&f, 50.364351, -4.141873, 0.0);
+	for (int i = 0; i < 6; i++) {
+		NavPoint p = {en[i][0], en[i][1]};
+		NavFrame_Unproject(&f, &p, &wps[i].lat, &wps[i].lon);
+	}
+	NavFrame_Free(&f);
+	return 6;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: trackOvershoot
+Function Description: Follows the true heading error to the current waypoint. Once the error has crossed zero
+                      on a leg, any further error the other way is overshoot; its peak is added up when the leg ends
+Input Parameters: os - tracker, model - true state, mission - route and current leg
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void trackOvershoot(Overshoot *os, const RoverModel *model, const Mission *mission) {
+	if (mission->leg != os->leg) {
+		if (os->leg > 0) { //Leg 0 is the run-in
+			os->sum += os->peak;
+			os->legs++;
+		}
+		os->leg = mission->leg;
+		os->sign = 0;
+		os->crossed = 0;
+		os->peak = 0.0;
+	}
+	if (mission->status != MISSION_ACTIVE)
+		return;
+
+	double lat, lon;
+	NavPoint p = {model->e, model->n};
+	NavFrame_Unproject(&model->frame, &p, &lat, &lon);
+	const Waypoint *wp = Mission_Target(mission);
+	double err = HeadingCtrl_Wrap(Geo_Bearing(lat, lon, wp->lat, wp->lon) - model->head);
+	int sign = err > 0.0 ? 1 : -1;
+
+	if (os->sign == 0)
+		os->sign = sign;
+	else if (sign != os->sign)
+		os->crossed = 1;
+	if (os->crossed && sign != os->sign && fabs(err) > os->peak)
+		os->peak = fabs(err);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: runRoute
+Function Description: Drives the model from 5 m short of the first waypoint, facing it, until the mission
+                      completes or time runs out
+Input Parameters: wps, n - route, mode - steering, params - model, rateHz - fix rate, ctrlHz - control rate for
+                  BENCH_EKF, seed - noise seed, timeout - seconds
+Output Parameters: Result
+/---------------------------------------------------------------------------------------------------------*/
+static BenchResult runRoute(const Waypoint *wps, size_t n, BenchMode mode, const RoverParams *params, double rateHz,
+	double ctrlHz, uint64_t seed, double timeout) {
+	BenchResult res = {0};
+	Mission mission;
+	MissionNav nav;
+	if (Mission_Init(&mission, wps, n, MISSION_ARRIVE_M, MISSION_HYST_M) != 0)
+		return res;
+
+	//Start 5 m before the first waypoint on the way in from the west
+	double lat0, lon0;
+	NavPoint start = {mission.frame.wp[0].e - 5.0, mission.frame.wp[0].n};
+	NavFrame_Unproject(&mission.frame, &start, &lat0, &lon0);
+
+	RoverModel model;
+	RoverModel_Init(&model, params, lat0, lon0, 90.0, seed);
+	HeadingGains gains;
+	HeadingCtrl_Defaults(&gains);
+	HeadingCtrl pid;
+	HeadingCtrl_Init(&pid, &gains);
+	EstParams estParams;
+	Est_Defaults(&estParams);
+	estParams.rPos = params->posNoise > 0.1 ? params->posNoise : 0.1;
+	estParams.rHead = params->headNoise > 1.0 ? params->headNoise : 1.0;
+	Estimator est;
+	Est_Init(&est, &estParams);
+
+	//Fixes every fixSteps model steps, control on the fix or every ctrlSteps with the estimator
+	long fixSteps = lround(1.0 / (rateHz * SIM_DT));
+	if (fixSteps < 1)
+		fixSteps = 1;
+	long ctrlSteps = mode == BENCH_EKF ? lround(1.0 / (ctrlHz * SIM_DT)) : fixSteps;
+	if (ctrlSteps < 1)
+		ctrlSteps = 1;
+	int left = 0, right = 0;
+	unsigned long ticks = 0;
+	double xtSum = 0.0;
+	Overshoot os = {0};
+	double lat, lon, head, speed;
+
+	for (long k = 0; model.t < timeout; k++) {
+		uint64_t tNs = (uint64_t)llround(model.t * 1e9);
+		if (k % fixSteps == 0) {
+			RoverModel_Fix(&model, &lat, &lon, &head, &speed);
+			if (mode == BENCH_EKF)
+				Est_Fix(&est, tNs, lat, lon, head, speed, 1);
+		}
+
+		if (k % ctrlSteps == 0) {
+			double dt = ctrlSteps * SIM_DT;
+			if (mode == BENCH_EKF) {
+				EstPose pose;
+				Est_Command(&est, tNs, model.dutyL, model.dutyR);
+				if (Est_PoseAt(&est, tNs, &pose) == 0) {
+					lat = pose.lat;
+					lon = pose.lon;
+					head = pose.head;
+					speed = pose.speed;
+				}
+			}
+			MissionStatus status = Mission_Update(&mission, lat, lon, &nav);
+			if (status == MISSION_ARRIVED) {
+				res.arrived = 1;
+				break;
+			}
+			if (nav.arrived)
+				HeadingCtrl_Reset(&pid);
+
+			if (mode == BENCH_BUCKET)
+				turnmode_duties(get_turnmode(getHeadingError(nav.bearing, head)), FullSpeed, TurnSpeed, &left, &right);
+			else
+				HeadingCtrl_Update(&pid, nav.bearing - head, speed, dt, &left, &right);
+
+			ticks++;
+			res.pivots += (left > 0) != (right > 0) && left != 0 && right != 0;
+			if (mission.leg > 0) { //Leg 0 is the run-in from the start point
+				xtSum += fabs(nav.crossTrack);
+				if (fabs(nav.crossTrack) > res.xtMax)
+					res.xtMax = fabs(nav.crossTrack);
+			}
+		}
+
+		RoverModel_Step(&model, left, right, SIM_DT);
+		trackOvershoot(&os, &model, &mission);
+	}
+
+	res.time = model.t;
+	res.distance = model.odometer;
+	res.xtMean = ticks ? xtSum / ticks : 0.0;
+	res.overshoot = os.legs ? os.sum / os.legs : 0.0;
+	Est_Free(&est);
+	RoverModel_Free(&model);
+	Mission_Free(&mission);
+	return res;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Runs each controller over the same route and prints a comparison
+Input Parameters: see usage()
+Output Parameters: 0 if every controller completed the route on every run, 1 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	const char *route = NULL;
+	double rateHz = 10.0, ctrlHz = 50.0, timeout = 900.0;
+	unsigned long seed = 1;
+	int runs = 5;
+	RoverParams params;
+	RoverModel_Defaults(&params);
+	params.posNoise = 0.3;
+	params.headNoise = 3.0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:r:e:n:h:s:N:T:")) != -1) {
+		switch (opt) {
+			case 'm': route = optarg; break;
+			case 'r': rateHz = atof(optarg); break;
+			case 'e': ctrlHz = atof(optarg); break;
+			case 'n': params.posNoise = atof(optarg); break;
+			case 'h': params.headNoise = atof(optarg); break;
+			case 's': seed = strtoul(optarg, NULL, 10); break;
+			case 'N': runs = atoi(optarg); break;
+			case 'T': timeout = atof(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (rateHz <= 0.0 || ctrlHz < 0.0 || runs < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	Waypoint survey[6];
+	Waypoint *wps = survey;
+	size_t n = surveyRoute(survey);
+	Mission loaded;
+	if (route) {
+		if (Mission_Load(&loaded, route, MISSION_ARRIVE_M, MISSION_HYST_M) != 0) {
+			printf("Cannot read route %s\n", route);
+			return 1;
+		}
+		wps = loaded.wps;
+		n = loaded.count;
+	}
+
+	double length = 5.0; //Run-in
+	for (size_t i = 1; i < n; i++)
+		length += Geo_Distance(wps[i - 1].lat, wps[i - 1].lon, wps[i].lat, wps[i].lon);
+
+	printf("Route: %zu waypoints, %.1f m, %.0f Hz fixes, %.0f Hz estimator control, noise %.2f m / %.1f deg, seeds %lu-%lu\n",
+		n, length, rateHz, ctrlHz, params.posNoise, params.headNoise, seed, seed + runs - 1);
+	printf("%-8s %9s %9s %9s %11s %11s %7s %9s\n", "mode", "arrival", "distance", "vs route", "mean xtrack", "max xtrack",
+		"pivots", "overshoot");
+
+	int ok = 1;
+	for (int mode = BENCH_BUCKET; mode <= (ctrlHz > 0.0 ? BENCH_EKF : BENCH_PID); mode++) {
+		BenchResult sum = {0};
+		int arrived = 0;
+		for (int i = 0; i < runs; i++) {
+			BenchResult r = runRoute(wps, n, (BenchMode)mode, &params, rateHz, ctrlHz, seed + i, timeout);
+			arrived += r.arrived;
+			sum.time += r.time;
+			sum.distance += r.distance;
+			sum.xtMean += r.xtMean;
+			if (r.xtMax > sum.xtMax)
+				sum.xtMax = r.xtMax;
+			sum.pivots += r.pivots;
+			sum.overshoot += r.overshoot;
+		}
+		ok &= (arrived == runs);
+		char arrival[24];
+		if (arrived == runs)
+			snprintf(arrival, sizeof(arrival), "%.1f s", sum.time / runs);
+		else
+			snprintf(arrival, sizeof(arrival), "%d/%d runs", arrived, runs);
+		printf("%-8s %9s %7.1f m %8.1f%% %9.2f m %9.2f m %7.1f %7.1f deg\n", benchModeNames[mode], arrival,
+			sum.distance / runs, 100.0 * sum.distance / runs / length, sum.xtMean / runs, sum.xtMax, (double)sum.pivots / runs,
+			sum.overshoot / runs);
+	}
+
+	if (route)
+		Mission_Free(&loaded);
+	return ok ? 0 : 1;
+}
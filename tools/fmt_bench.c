@@ -0,0 +1,203 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: fmt_bench.c
+Source Description: Checks that fmt.c gives the same bytes as printf for the formats the rover writes, then
+                    times one log record and one dashboard line with fprintf/snprintf against fmt.c
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../fmt.h"
+
+#define BENCH_VALUES 4096 //Distinct records cycled through while timing
+
+//Formats compared value by value: width and precision
+static const int checkFormats[][2] = {{9, 7}, {5, 2}, {0, 1}, {0, 2}, {0, 7}, {9, 5}, {0, 0}, {12, 17}};
+
+static uint64_t rngState = 0x9e3779b97f4a7c15ull;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: rng
+Function Description: xorshift64* generator, so every run checks the same values
+Input Parameters: N/A
+Output Parameters: Next 64 random bits
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t rng(void) {
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return rngState * 0x2545f4914f6cdd1dull;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: testValue
+Function Description: Picks a value to check: coordinates, angles, exact decimal ties, tiny and huge magnitudes,
+                      and arbitrary bit patterns
+Input Parameters: i - index
+Output Parameters: Value
+/---------------------------------------------------------------------------------------------------------*/
+static double testValue(uint64_t i) {
+	double u = (rng() >> 11) * 0x1p-53;
+	switch (i % 6) {
+	case 0: return 50.0 + u * 0.5;                                   //Latitude near the test site
+	case 1: return -4.0 - u * 0.5;                                   //Longitude
+	case 2: return u * 720.0 - 360.0;                                //Heading or error
+	case 3: return (double)(int64_t)(rng() % 2000001 - 1000000) / 8.0; //Ties at every precision below 3
+	case 4: return ldexp(u, (int)(rng() % 120) - 60);                //Tiny to large
+	default: {
+		uint64_t bits = rng();
+		double v;
+		memcpy(&v, &bits, sizeof(v));
+		return v;                                                    //Any double, NaN and infinities included
+	}
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowSec
+Function Description: Monotonic time
+Input Parameters: N/A
+Output Parameters: Seconds
+/---------------------------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: fmtRecord
+Function Description: One full CSV log row, as "%9.7f,%9.7f,%.2f,%u,%d\n"
+Input Parameters: out - buffer, lat, lon, head, timeMs, fix - row
+Output Parameters: End of the row
+/---------------------------------------------------------------------------------------------------------*/
+static char *fmtRecord(char *out, double lat, double lon, double head, unsigned timeMs, int fix) {
+	char *e = Fmt_Double(out, lat, 9, 7);
+	*e++ = ',';
+	e = Fmt_Double(e, lon, 9, 7);
+	*e++ = ',';
+	e = Fmt_Double(e, head, 0, 2);
+	*e++ = ',';
+	e = Fmt_Int(e, (long)timeMs);
+	*e++ = ',';
+	e = Fmt_Int(e, fix);
+	*e++ = '\n';
+	return e;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: fmtPanel
+Function Description: The navigator status panel, as "Location: %9.7f N %9.7f W\nHeading: %5.2f \nTarget
+                      Bearing: %5.2f \nError:%5.2f\n"
+Input Parameters: out - buffer, v - lat, lon, heading, bearing, error
+Output Parameters: End of the text
+/---------------------------------------------------------------------------------------------------------*/
+static char *fmtPanel(char *out, const double *v) {
+	char *e = Fmt_Str(out, "Location: ");
+	e = Fmt_Double(e, v[0], 9, 7);
+	e = Fmt_Str(e, " N ");
+	e = Fmt_Double(e, v[1], 9, 7);
+	e = Fmt_Str(e, " W\nHeading: ");
+	e = Fmt_Double(e, v[2], 5, 2);
+	e = Fmt_Str(e, " \nTarget Bearing: ");
+	e = Fmt_Double(e, v[3], 5, 2);
+	e = Fmt_Str(e, " \nError:");
+	e = Fmt_Double(e, v[4], 5, 2);
+	e = Fmt_Str(e, "\n");
+	return e;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: fmt_bench [-n checks] [-i iterations]
+Input Parameters: -n values to compare per format (default 2000000), -i records to time (default 2000000)
+Output Parameters: 0 if every value matched printf, 1 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	long checks = 2000000, iters = 2000000;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:i:")) != -1) {
+		switch (opt) {
+		case 'n': checks = atol(optarg); break;
+		case 'i': iters = atol(optarg); break;
+		default:
+			fprintf(stderr, "Usage: %s [-n checks] [-i iterations]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	//Byte-for-byte check against snprintf
+	long mismatches = 0;
+	char want[512], got[FMT_DOUBLE_MAX + 1];
+	size_t nFormats = sizeof(checkFormats) / sizeof(checkFormats[0]);
+	for (long i = 0; i < checks; i++) {
+		double v = testValue((uint64_t)i);
+		for (size_t f = 0; f < nFormats; f++) {
+			int w = checkFormats[f][0], p = checkFormats[f][1];
+			int n = snprintf(want, sizeof(want), "%*.*f", w, p, v);
+			char *e = Fmt_Double(got, v, w, p);
+			*e = '\0';
+			if (n >= FMT_DOUBLE_MAX)
+				continue; //Longer than Fmt_Double keeps
+			if (strcmp(want, got) != 0 && mismatches++ < 10)
+				printf("Mismatch: %%%d.%df of %a: printf \"%s\", fmt \"%s\"\n", w, p, v, want, got);
+		}
+		long k = (long)(rng() >> 1) * (i & 1 ? 1 : -1);
+		snprintf(want, sizeof(want), "%ld", k);
+		*Fmt_Int(got, k) = '\0';
+		if (strcmp(want, got) != 0 && mismatches++ < 10)
+			printf("Mismatch: %%ld of %ld: fmt \"%s\"\n", k, got);
+	}
+	printf("Checked %ld values in %zu formats and %ld integers: %ld mismatches\n", checks, nFormats, checks, mismatches);
+
+	//Timing, into a stream that discards the bytes so only the formatting and stdio costs are measured
+	FILE *sink = fopen("/dev/null", "w");
+	if (!sink) {
+		perror("/dev/null");
+		return 1;
+	}
+	static double rec[BENCH_VALUES][5];
+	for (int i = 0; i < BENCH_VALUES; i++) {
+		rec[i][0] = 50.3 + (rng() >> 11) * 0x1p-53 * 0.1;
+		rec[i][1] = -4.1 - (rng() >> 11) * 0x1p-53 * 0.1;
+		for (int j = 2; j < 5; j++)
+			rec[i][j] = (rng() >> 11) * 0x1p-53 * 360.0;
+	}
+
+	char line[8 * FMT_DOUBLE_MAX];
+	double t0 = nowSec();
+	for (long i = 0; i < iters; i++) {
+		const double *r = rec[i & (BENCH_VALUES - 1)];
+		fprintf(sink, "%9.7f,%9.7f,%.2f,%u,%d\n", r[0], r[1], r[2], (unsigned)i, 1);
+	}
+	double t1 = nowSec();
+	for (long i = 0; i < iters; i++) {
+		const double *r = rec[i & (BENCH_VALUES - 1)];
+		char *e = fmtRecord(line, r[0], r[1], r[2], (unsigned)i, 1);
+		fwrite(line, 1, (size_t)(e - line), sink);
+	}
+	double t2 = nowSec();
+	for (long i = 0; i < iters; i++) {
+		const double *r = rec[i & (BENCH_VALUES - 1)];
+		snprintf(line, sizeof(line), "Location: %9.7f N %9.7f W\nHeading: %5.2f \nTarget Bearing: %5.2f \nError:%5.2f\n",
+			r[0], r[1], r[2], r[3], r[4]);
+		__asm__ volatile("" : : "r"(line) : "memory");
+	}
+	double t3 = nowSec();
+	for (long i = 0; i < iters; i++) {
+		*fmtPanel(line, rec[i & (BENCH_VALUES - 1)]) = '\0';
+		__asm__ volatile("" : : "r"(line) : "memory");
+	}
+	double t4 = nowSec();
+	fclose(sink);
+
+	printf("Log record  fprintf %6.1f ns, fmt+fwrite %6.1f ns (%.1fx)\n", (t1 - t0) * 1e9 / iters,
+		(t2 - t1) * 1e9 / iters, (t1 - t0) / (t2 - t1));
+	printf("Panel text  snprintf %5.1f ns, fmt        %6.1f ns (%.1fx)\n", (t3 - t2) * 1e9 / iters,
+		(t4 - t3) * 1e9 / iters, (t3 - t2) / (t4 - t3));
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: geo_bench.c
+Source Description: Checks the Geo_*Batch kernels against the scalar libm functions over random point pairs, then
+                    times each batch against a plain loop over its scalar function
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../geodesy.h"
+
+#define BENCH_PATH_POINTS 1024    //Points sharing one path in the cross-track test
+#define BENCH_MIN_SEP     1e-3    //Pair separations are log-uniform between these (m)
+#define BENCH_MAX_SEP     2e6
+#define BENCH_XT_MAX      1e6     //Cross-track points lie within this of the path start (m)
+
+static uint64_t rngState = 0x9e3779b97f4a7c15ull;
+
+//Test set, struct of arrays
+typedef struct {
+	size_t n;
+	double *lat1, *lon1, *lat2, *lon2;   //Pairs
+	double *bearing, *dist;              //Destination inputs
+	double *polar;                       //Destination starts above 80 degrees
+	double *pathLat, *pathLon;           //Cross-track path ends, one per BENCH_PATH_POINTS points
+	double *lat3, *lon3;                 //Cross-track points
+	double *out, *out2, *ref, *ref2;
+} BenchSet;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: rng / uniform
+Function Description: xorshift64* generator, so every run checks the same pairs, and a uniform draw from it
+Input Parameters: lo, hi - range
+Output Parameters: Next 64 random bits, or a value in [lo, hi)
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t rng(void) {
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return rngState * 0x2545f4914f6cdd1dull;
+}
+
+static double uniform(double lo, double hi) {
+	return lo + (hi - lo) * ((rng() >> 11) * 0x1p-53);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowSec
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in seconds
+/---------------------------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: makeSet
+Function Description: Draws starts within 80 degrees of the equator, separations log-uniform from 1 mm to
+                      2000 km on random bearings, and cross-track points within 1000 km of each path start
+Input Parameters: s - set to fill, n - pairs
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+static int makeSet(BenchSet *s, size_t n) {
+	size_t paths = (n + BENCH_PATH_POINTS - 1) / BENCH_PATH_POINTS;
+	double **arrays[] = {&s->lat1, &s->lon1, &s->lat2, &s->lon2, &s->bearing, &s->dist, &s->polar, &s->lat3,
+		&s->lon3, &s->out, &s->out2, &s->ref, &s->ref2};
+	s->n = n;
+	for (size_t a = 0; a < sizeof(arrays) / sizeof(arrays[0]); a++)
+		if (!(*arrays[a] = malloc(n * sizeof(double))))
+			return -1;
+	s->pathLat = malloc(paths * sizeof(double));
+	s->pathLon = malloc(paths * sizeof(double));
+	if (!s->pathLat || !s->pathLon)
+		return -1;
+
+	for (size_t i = 0; i < n; i++) {
+		s->lat1[i] = uniform(-80.0, 80.0);
+		s->lon1[i] = uniform(-180.0, 180.0);
+		s->bearing[i] = uniform(0.0, 360.0);
+		s->dist[i] = exp(uniform(log(BENCH_MIN_SEP), log(BENCH_MAX_SEP)));
+		s->polar[i] = uniform(80.0, 89.9) * (rng() & 1 ? 1.0 : -1.0);
+		Geo_Destination(s->lat1[i], s->lon1[i], s->bearing[i], s->dist[i], &s->lat2[i], &s->lon2[i]);
+	}
+	for (size_t p = 0; p < paths; p++) {
+		size_t first = p * BENCH_PATH_POINTS;
+		Geo_Destination(s->lat1[first], s->lon1[first], uniform(0.0, 360.0), exp(uniform(log(10.0), log(1e6))),
+			&s->pathLat[p], &s->pathLon[p]);
+		for (size_t i = first; i < n && i < first + BENCH_PATH_POINTS; i++)
+			Geo_Destination(s->lat1[first], s->lon1[first], uniform(0.0, 360.0),
+				exp(uniform(log(BENCH_MIN_SEP), log(BENCH_XT_MAX))), &s->lat3[i], &s->lon3[i]);
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Kernel runners
+Function Description: Each computes one kernel over the whole set into out (and out2), by batch or by scalar loop
+Input Parameters: s - set
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void bearingBatch(BenchSet *s) {
+	Geo_BearingBatch(s->lat1, s->lon1, s->lat2, s->lon2, s->out, s->n);
+}
+
+static void bearingScalar(BenchSet *s) {
+	for (size_t i = 0; i < s->n; i++)
+		s->out[i] = Geo_Bearing(s->lat1[i], s->lon1[i], s->lat2[i], s->lon2[i]);
+}
+
+static void distanceBatch(BenchSet *s) {
+	Geo_DistanceBatch(s->lat1, s->lon1, s->lat2, s->lon2, s->out, s->n);
+}
+
+static void distanceScalar(BenchSet *s) {
+	for (size_t i = 0; i < s->n; i++)
+		s->out[i] = Geo_Distance(s->lat1[i], s->lon1[i], s->lat2[i], s->lon2[i]);
+}
+
+static void destinationBatch(BenchSet *s) {
+	Geo_DestinationBatch(s->lat1, s->lon1, s->bearing, s->dist, s->out, s->out2, s->n);
+}
+
+static void destinationScalar(BenchSet *s) {
+	for (size_t i = 0; i < s->n; i++)
+		Geo_Destination(s->lat1[i], s->lon1[i], s->bearing[i], s->dist[i], &s->out[i], &s->out2[i]);
+}
+
+static void crossTrackBatch(BenchSet *s) {
+	for (size_t i = 0; i < s->n; i += BENCH_PATH_POINTS) {
+		size_t p = i / BENCH_PATH_POINTS, k = s->n - i < BENCH_PATH_POINTS ? s->n - i : BENCH_PATH_POINTS;
+		Geo_CrossTrackBatch(s->lat1[i], s->lon1[i], s->pathLat[p], s->pathLon[p], s->lat3 + i, s->lon3 + i,
+			s->out + i, k);
+	}
+}
+
+static void crossTrackScalar(BenchSet *s) {
+	for (size_t i = 0; i < s->n; i++) {
+		size_t first = i - i % BENCH_PATH_POINTS;
+		s->out[i] = Geo_CrossTrack(s->lat1[first], s->lon1[first], s->pathLat[i / BENCH_PATH_POINTS],
+			s->pathLon[i / BENCH_PATH_POINTS], s->lat3[i], s->lon3[i]);
+	}
+}
+
+typedef void (*BenchFn)(BenchSet *s);
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: maxError
+Function Description: Largest difference between out and ref, angles compared the short way round
+Input Parameters: out, ref - results, n - count, angle - 1 to wrap the difference to [-180, 180)
+Output Parameters: Largest absolute difference
+/---------------------------------------------------------------------------------------------------------*/
+static double maxError(const double *out, const double *ref, size_t n, int angle) {
+	double worst = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		double d = out[i] - ref[i];
+		if (angle)
+			d -= 360.0 * floor(d / 360.0 + 0.5);
+		d = fabs(d);
+		if (d > worst || d != d)
+			worst = d;
+	}
+	return worst;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: rate
+Function Description: Best of reps timed runs
+Input Parameters: fn - runner, s - set, reps - runs
+Output Parameters: Million results per second
+/---------------------------------------------------------------------------------------------------------*/
+static double rate(BenchFn fn, BenchSet *s, int reps) {
+	double best = 1e30;
+	for (int r = 0; r < reps; r++) {
+		double t0 = nowSec();
+		fn(s);
+		double t = nowSec() - t0;
+		if (t < best)
+			best = t;
+	}
+	return s->n / best / 1e6;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Checks, then times, each batch kernel
+Input Parameters: -n pairs (default 2000000), -r timed runs per kernel (default 5)
+Output Parameters: 0 on success, 1 on bad options or out of memory
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	size_t n = 2000000;
+	int reps = 5, opt;
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+			case 'n': n = strtoul(optarg, NULL, 10); break;
+			case 'r': reps = atoi(optarg); break;
+			default:
+				printf("Usage: %s [-n pairs] [-r runs]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (n == 0 || reps < 1) {
+		printf("Usage: %s [-n pairs] [-r runs]\n", argv[0]);
+		return 1;
+	}
+
+	BenchSet s = {0};
+	if (makeSet(&s, n) != 0) {
+		printf("Out of memory for %zu pairs\n", n);
+		return 1;
+	}
+
+	//Accuracy against the scalar functions
+	printf("%zu pairs, separations %.0e to %.0e m\n", n, BENCH_MIN_SEP, BENCH_MAX_SEP);
+	bearingBatch(&s);
+	bearingScalar(&(BenchSet){.n = n, .lat1 = s.lat1, .lon1 = s.lon1, .lat2 = s.lat2, .lon2 = s.lon2, .out = s.ref});
+	printf("Geo_BearingBatch      max error %.2e degrees\n", maxError(s.out, s.ref, n, 1));
+	distanceBatch(&s);
+	distanceScalar(&(BenchSet){.n = n, .lat1 = s.lat1, .lon1 = s.lon1, .lat2 = s.lat2, .lon2 = s.lon2, .out = s.ref});
+	printf("Geo_DistanceBatch     max error %.2e m\n", maxError(s.out, s.ref, n, 0));
+	destinationBatch(&s);
+	destinationScalar(&(BenchSet){.n = n, .lat1 = s.lat1, .lon1 = s.lon1, .bearing = s.bearing, .dist = s.dist,
+		.out = s.ref, .out2 = s.ref2});
+	printf("Geo_DestinationBatch  max error %.2e degrees latitude, %.2e longitude (|lat| <= 80)\n",
+		maxError(s.out, s.ref, n, 0), maxError(s.out2, s.ref2, n, 1));
+	BenchSet polar = s;
+	polar.lat1 = s.polar;
+	destinationBatch(&polar);
+	destinationScalar(&(BenchSet){.n = n, .lat1 = s.polar, .lon1 = s.lon1, .bearing = s.bearing, .dist = s.dist,
+		.out = s.ref, .out2 = s.ref2});
+	printf("                      max error %.2e degrees latitude, %.2e longitude (80 < |lat| <= 89.9)\n",
+		maxError(s.out, s.ref, n, 0), maxError(s.out2, s.ref2, n, 1));
+	crossTrackBatch(&s);
+	crossTrackScalar(&(BenchSet){.n = n, .lat1 = s.lat1, .lon1 = s.lon1, .pathLat = s.pathLat, .pathLon = s.pathLon,
+		.lat3 = s.lat3, .lon3 = s.lon3, .out = s.ref});
+	printf("Geo_CrossTrackBatch   max error %.2e m (points within %.0f km of the path start)\n",
+		maxError(s.out, s.ref, n, 0), BENCH_XT_MAX / 1e3);
+
+	//Throughput, batch against a loop over the scalar function
+	static const struct {
+		const char *name;
+		BenchFn batch, scalar;
+	} kernels[] = {
+		{"bearing", bearingBatch, bearingScalar},
+		{"distance", distanceBatch, distanceScalar},
+		{"destination", destinationBatch, destinationScalar},
+		{"cross-track", crossTrackBatch, crossTrackScalar},
+	};
+	printf("%-12s %10s %10s\n", "M/s", "batch", "scalar");
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		double b = rate(kernels[k].batch, &s, reps);
+		double sc = rate(kernels[k].scalar, &s, reps);
+		printf("%-12s %10.1f %10.1f  %.2fx\n", kernels[k].name, b, sc, b / sc);
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: pwm_check.c
+Source Description: Runs the PWM engine against the mock GPIO and checks the recorded edges: measured duty and
+                    period per pin, plus the engine's own jitter report. Build with -DHAL_MOCK
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../hal.h"
+#include "../pwm_engine.h"
+
+#define CHECK_PINS 2
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: pwm_check [freqHz] [seconds] [dutyA] [dutyB] [tolerance]
+Input Parameters: PWM frequency (default 100), run time (default 2 s), duties of two test pins (default 30, 75),
+                  allowed duty error in percent (default 2, loosen on a loaded desktop)
+Output Parameters: 0 if every measured duty is within tolerance of the request, 1 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	int freq = argc > 1 ? atoi(argv[1]) : PWM_DEFAULT_FREQ;
+	double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+	int pins[CHECK_PINS] = {3, 7};
+	int duty[CHECK_PINS] = {argc > 3 ? atoi(argv[3]) : 30, argc > 4 ? atoi(argv[4]) : 75};
+	double tol = argc > 5 ? atof(argv[5]) : 2.0;
+
+	HALMock_Reset();
+	for (int i = 0; i < CHECK_PINS; i++)
+		PWM_AddChannel(pins[i], 0);
+	PWM_Init(freq, PWM_DEFAULT_RANGE);
+	PWM_SetDuties(pins, duty, CHECK_PINS);
+	usleep((useconds_t)(seconds * 1e6));
+	PWM_Stop();
+
+	HALWrite *w = malloc(HAL_MOCK_LOG * sizeof(HALWrite));
+	size_t n = HALMock_GetWrites(w, HAL_MOCK_LOG);
+	int ok = 1;
+
+	for (int p = 0; p < CHECK_PINS; p++) {
+		uint64_t lastRise = 0, highNs = 0, periodNs = 0, periods = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (w[i].pin != pins[p])
+				continue;
+			if (w[i].value == HIGH) {
+				if (lastRise && w[i].tNs > lastRise) {
+					periodNs += w[i].tNs - lastRise;
+					periods++;
+				}
+				lastRise = w[i].tNs;
+			} else if (lastRise && periods > 0) {
+				highNs += w[i].tNs - lastRise;
+			}
+		}
+		if (periods == 0) {
+			printf("Pin %d: no complete periods recorded\n", pins[p]);
+			ok = 0;
+			continue;
+		}
+		double measured = 100.0 * highNs / periodNs;
+		printf("Pin %d: requested %d%%, measured %.2f%%, mean period %.1f us over %llu periods\n",
+			pins[p], duty[p], measured, periodNs / 1e3 / periods, (unsigned long long)periods);
+		if (measured < duty[p] - tol || measured > duty[p] + tol)
+			ok = 0;
+	}
+
+	PWM_PrintJitter();
+	free(w);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: replay.c
+Source Description: Drives the navigator from a recorded track on a virtual clock, with no hardware, and prints 
+                    or checks the sequence of motor decisions it makes, from the turn table or the heading controller
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../track_io.h"
+#include "../navigator.h"
+#include "../geodesy.h"
+#include "../mission.h"
+#include "../heading_ctrl.h"
+#include "../profile.h"
+
+#define DAY_MS 86400000ull
+#define COG_MIN_MOVE_M 0.3  //Smallest movement that updates a derived course over ground
+
+//Virtual clock: track time mapped onto the wall clock, or not at all when running flat out
+typedef struct {
+	uint64_t startMs;       //Track time of the first fix
+	struct timespec wall0;  //Wall time of the first fix
+	double speed;           //Replay speed, 0 = as fast as possible
+} VirtualClock;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: clockWait
+Function Description: In real-time mode sleeps until the wall clock reaches a track time, using absolute deadlines
+                      so the replay does not drift. The sleep is resumed after a signal; any other failure is
+                      reported once and the replay goes on flat out
+Input Parameters: vc - virtual clock, tMs - track time of the next fix
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void clockWait(const VirtualClock *vc, uint64_t tMs) {
+	if (vc->speed <= 0.0)
+		return;
+
+	double offset = (tMs - vc->startMs) / 1000.0 / vc->speed;
+	struct timespec deadline = vc->wall0;
+	deadline.tv_sec += (time_t)offset;
+	deadline.tv_nsec += (long)((offset - floor(offset)) * 1e9);
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	static int reported;
+	int err;
+	while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL)) == EINTR)
+		;
+	if (err != 0 && !reported++)
+		fprintf(stderr, "clock_nanosleep failed (%s), replaying as fast as possible\n", strerror(err));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: prepareTrack
+Function Description: Makes the track look like live GPS data: synthesises time stamps at rateHz when the log has
+                      none, unwraps midnight, and derives course over ground when the log has no heading
+Input Parameters: list - track to fix up, rateHz - fix rate assumed for untimed logs, times - unwrapped times out
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void prepareTrack(TrackList *list, double rateHz, uint64_t *times) {
+	int timed = 0, headed = 0;
+	for (size_t i = 0; i < list->count; i++) {
+		timed |= (list->pts[i].timeMs != list->pts[0].timeMs);
+		headed |= (list->pts[i].head != 0.0);
+	}
+
+	uint64_t dayOffset = 0;
+	double cog = 0.0;
+	for (size_t i = 0; i < list->count; i++) {
+		TrackPoint *pt = &list->pts[i];
+
+		if (!timed) {
+			times[i] = (uint64_t)llround(i * 1000.0 / rateHz);
+		} else {
+			if (i > 0 && pt->timeMs + dayOffset + DAY_MS / 2 < times[i - 1])
+				dayOffset += DAY_MS;
+			times[i] = pt->timeMs + dayOffset;
+		}
+
+		if (!headed && i > 0) {
+			const TrackPoint *prev = &list->pts[i - 1];
+			if (Geo_Distance(prev->lat, prev->lon, pt->lat, pt->lon) >= COG_MIN_MOVE_M)
+				cog = Geo_Bearing(prev->lat, prev->lon, pt->lat, pt->lon);
+			pt->head = cog;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: compareGolden
+Function Description: Compares a trace line against the matching golden line
+Input Parameters: line, golden - trace lines, tol - allowed bearing difference (degrees)
+Output Parameters: 0 if they agree, 1 if the motor decision (turn mode or PID duties) differs, 2 if only the
+                   bearing differs
+/---------------------------------------------------------------------------------------------------------*/
+static int compareGolden(const char *line, const char *golden, double tol) {
+	unsigned long t1, t2;
+	double b1, b2, unused;
+	char m1[32], m2[32];
+
+	if (sscanf(line, "%lu,%lf,%lf,%lf,%lf,%lf,%31[^\n]", &t1, &unused, &unused, &unused, &b1, &unused, m1) != 7 ||
+		sscanf(golden, "%lu,%lf,%lf,%lf,%lf,%lf,%31[^\n]", &t2, &unused, &unused, &unused, &b2, &unused, m2) != 7)
+		return strcmp(line, golden) != 0;
+	if (t1 != t2 || strcmp(m1, m2) != 0)
+		return 1;
+	double diff = fabs(b1 - b2);
+	if (diff > 180.0)
+		diff = 360.0 - diff; //Bearings either side of north
+	return diff > tol ? 2 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options] <track.csv|gpx|trk>\n"
+		"  -t lat,lon   target (default 50.364351,-4.141873)\n"
+		"  -c ctrl      controller: pid (default, as the rover) or bucket for the turn table\n"
+		"  -P file      controller profile, as main.c -P (-c still picks the controller)\n"
+		"  -m file      follow the route in a GPX or CSV file instead of a single target\n"
+		"  -r hz        fix rate assumed for logs without GPS time (default 10)\n"
+		"  -x speed     real-time mode, 1 = recorded speed (default: as fast as possible)\n"
+		"  -o file      write the decision trace (- for stdout)\n"
+		"  -g file      compare the trace against a golden trace, exit 1 on any decision change\n"
+		"  -e degrees   bearing tolerance for the golden comparison (default 0.001)\n", prog);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Replays a track through the mission and get_turnmode or the heading controller
+Input Parameters: see usage()
+Output Parameters: 0 on success (and golden match), 1 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	double tLat = 50.364351f;
+	double tLon = -4.141873f;
+	double rateHz = 10.0;
+	double tol = 0.001;
+	const char *tracePath = NULL, *goldenPath = NULL, *route = NULL, *ctrlName = NULL, *profilePath = NULL;
+	VirtualClock vc = {0, {0, 0}, 0.0};
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:c:P:m:r:x:o:g:e:")) != -1) {
+		switch (opt) {
+			case 't': sscanf(optarg, "%lf,%lf", &tLat, &tLon); break;
+			case 'c': ctrlName = optarg; break;
+			case 'P': profilePath = optarg; break;
+			case 'm': route = optarg; break;
+			case 'r': rateHz = atof(optarg); break;
+			case 'x': vc.speed = atof(optarg); break;
+			case 'o': tracePath = optarg; break;
+			case 'g': goldenPath = optarg; break;
+			case 'e': tol = atof(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind >= argc || rateHz <= 0.0 || (ctrlName && strcmp(ctrlName, "pid") != 0 && strcmp(ctrlName, "bucket") != 0)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	//Controller settings as main.c takes them
+	Profile profile;
+	Profile_Defaults(&profile);
+	if (profilePath) {
+		int rc = Profile_Load(profilePath, &profile);
+		if (rc != 0) {
+			if (rc < 0)
+				printf("Cannot read profile %s\n", profilePath);
+			else
+				printf("Bad setting on line %d of profile %s\n", rc, profilePath);
+			return 1;
+		}
+	}
+	if (ctrlName)
+		profile.bucket = strcmp(ctrlName, "bucket") == 0;
+	HeadingCtrl ctrl;
+	HeadingCtrl_Init(&ctrl, &profile.gains);
+
+	TrackList track = {0};
+	if (TrackIO_Load(argv[optind], &track) != 0 || track.count == 0) {
+		printf("Cannot read %s\n", argv[optind]);
+		return 1;
+	}
+	uint64_t *times = malloc(track.count * sizeof(uint64_t));
+	prepareTrack(&track, rateHz, times);
+
+	FILE *trace = NULL;
+	if (tracePath)
+		trace = strcmp(tracePath, "-") == 0 ? stdout : fopen(tracePath, "w");
+	FILE *golden = goldenPath ? fopen(goldenPath, "r") : NULL;
+	if ((tracePath && !trace) || (goldenPath && !golden)) {
+		printf("Cannot open trace or golden file\n");
+		return 1;
+	}
+
+	unsigned long modeCount[TURN_OFF + 1] = {0};
+	unsigned long changes = 0, decisionDiffs = 0, bearingDiffs = 0;
+	long firstDiff = -1;
+	TurnMode mode = TURN_OFF;
+	char line[160], gline[160], decision[32], lastDecision[32] = "";
+
+	if (trace)
+		fprintf(trace, "t_ms,lat,lon,head,bearing,error,mode\n");
+	if (golden && !fgets(gline, sizeof(gline), golden)) //Skip the golden header
+		gline[0] = '\0';
+
+	Mission mission;
+	MissionNav nav;
+	Waypoint target = {tLat, tLon};
+	if (route ? Mission_Load(&mission, route, MISSION_ARRIVE_M, MISSION_HYST_M) != 0 :
+		Mission_Init(&mission, &target, 1, MISSION_ARRIVE_M, MISSION_HYST_M) != 0) {
+		printf("Cannot read route %s\n", route);
+		return 1;
+	}
+
+	vc.startMs = times[0];
+	clock_gettime(CLOCK_MONOTONIC, &vc.wall0);
+	struct timespec c0, c1;
+	clock_gettime(CLOCK_MONOTONIC, &c0);
+
+	for (size_t i = 0; i < track.count; i++) {
+		const TrackPoint *pt = &track.pts[i];
+		clockWait(&vc, times[i]);
+
+		//Same sequence as the control loop in main.c. Logs carry no ground speed, so the heading controller's gain
+		//schedule gets the speed from successive fixes
+		MissionStatus status = Mission_Update(&mission, pt->lat, pt->lon, &nav);
+		double bearingToTarget = nav.bearing;
+		double error = getHeadingError(bearingToTarget, pt->head);
+		double dt = i > 0 ? (times[i] - times[i - 1]) / 1000.0 : 0.0;
+		if (nav.arrived)
+			HeadingCtrl_Reset(&ctrl); //New leg
+		if (status == MISSION_ARRIVED) {
+			mode = TURN_OFF;
+			snprintf(decision, sizeof(decision), "%s", turnmode_name(mode));
+		} else if (profile.bucket) {
+			mode = get_turnmode_table(error, profile.thresholds);
+			snprintf(decision, sizeof(decision), "%s", turnmode_name(mode));
+		} else {
+			//Clamped as set_heading_pid does
+			const TrackPoint *prev = &track.pts[i > 0 ? i - 1 : 0];
+			double speed = dt > 0.0 ? Geo_Distance(prev->lat, prev->lon, pt->lat, pt->lon) / dt : 0.0;
+			int left, right, full = profile.fullSpeed;
+			HeadingCtrl_Update(&ctrl, bearingToTarget - pt->head, speed, dt, &left, &right);
+			left = left > full ? full : left < -full ? -full : left;
+			right = right > full ? full : right < -full ? -full : right;
+			snprintf(decision, sizeof(decision), "pid %d %d", left, right);
+		}
+
+		if (status == MISSION_ARRIVED || profile.bucket)
+			modeCount[mode]++;
+		if (i == 0 || strcmp(decision, lastDecision) != 0)
+			changes++;
+		memcpy(lastDecision, decision, sizeof(decision));
+
+		if (!trace && !golden)
+			continue;
+		snprintf(line, sizeof(line), "%llu,%.7f,%.7f,%.2f,%.6f,%.0f,%s\n",
+			(unsigned long long)times[i], pt->lat, pt->lon, pt->head, bearingToTarget, error, decision);
+		if (trace)
+			fputs(line, trace);
+		if (golden) {
+			int diff = fgets(gline, sizeof(gline), golden) ? compareGolden(line, gline, tol) : 1;
+			decisionDiffs += (diff == 1);
+			bearingDiffs += (diff == 2);
+			if (diff && firstDiff < 0) {
+				firstDiff = (long)i;
+				printf("First difference at fix %ld:\n  golden: %s  replay: %s", firstDiff, diff == 1 && feof(golden) ? "(end of file)\n" : gline, line);
+			}
+		}
+	}
+	if (golden && fgets(gline, sizeof(gline), golden))
+		decisionDiffs++; //Golden trace is longer than the replay
+
+	clock_gettime(CLOCK_MONOTONIC, &c1);
+	double wall = (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;
+	double span = (times[track.count - 1] - times[0]) / 1000.0;
+
+	FILE *out = (trace == stdout) ? stderr : stdout;
+	fprintf(out, "%zu fixes, %.1f s of track replayed in %.3f s (%.0f fixes/s, %.0fx real time)\n",
+		track.count, span, wall, track.count / (wall > 0 ? wall : 1e-9), span / (wall > 0 ? wall : 1e-9));
+	fprintf(out, "%lu decision changes (%s), %lu of %zu waypoints reached\n", changes, profile.bucket ? "bucket" : "pid",
+		mission.arrivals, mission.count);
+	if (!profile.bucket)
+		fprintf(out, "  %-16s %lu, %lu saturated\n", "pid", ctrl.updates, ctrl.saturated);
+	for (int m = TURN_FORWARDS; m <= TURN_OFF; m++)
+		if (modeCount[m])
+			fprintf(out, "  %-16s %lu\n", turnmode_name((TurnMode)m), modeCount[m]);
+	if (golden)
+		fprintf(out, "Golden: %lu decision differences, %lu bearing differences > %g deg\n", decisionDiffs, bearingDiffs, tol);
+
+	if (trace && trace != stdout)
+		fclose(trace);
+	if (golden)
+		fclose(golden);
+	free(times);
+	Mission_Free(&mission);
+	TrackIO_Free(&track);
+	return (decisionDiffs || bearingDiffs) ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: rover_cmd.c
+Source Description: Sends one command to a running rover's command port and prints its reply
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../command.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options and the commands
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [-p port] command...\n"
+		"  -p port    rover command port (default %d)\n"
+		"Commands:\n"
+		"  goto lat lon [lat lon ...]   replace the route\n"
+		"  route <file>                 replace the route with a file on the rover\n"
+		"  pause | stop | resume        ramp down and hold, cut the motors, or carry on\n"
+		"  speed <full> [turn]          duty limits, 0 to 100\n", prog, CMD_DEFAULT_PORT);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Joins the arguments into one command, sends it to 127.0.0.1 and waits a second for the reply
+Input Parameters: see usage()
+Output Parameters: 0 if the rover accepted the command, 1 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	int port = CMD_DEFAULT_PORT;
+	char text[CMD_MAX_LEN + 1] = "", reply[128];
+	size_t len = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "+p:")) != -1) {
+		switch (opt) {
+			case 'p': port = atoi(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind == argc) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (int i = optind; i < argc; i++) {
+		int n = snprintf(text + len, sizeof(text) - len, "%s%s", i > optind ? " " : "", argv[i]);
+		if (n < 0 || (size_t)n >= sizeof(text) - len) {
+			printf("Command longer than %d bytes\n", CMD_MAX_LEN);
+			return 1;
+		}
+		len += (size_t)n;
+	}
+
+	struct sockaddr_in addr;
+	struct timeval tv = {1, 0};
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return 1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || send(fd, text, len, 0) != (ssize_t)len) {
+		printf("Cannot send to 127.0.0.1:%d\n", port);
+		close(fd);
+		return 1;
+	}
+	ssize_t n = recv(fd, reply, sizeof(reply) - 1, 0);
+	close(fd);
+	if (n < 0) {
+		printf("No reply, is the rover running?\n");
+		return 1;
+	}
+	reply[n] = '\0';
+	fputs(reply, stdout);
+	return strncmp(reply, "ok", 2) != 0;
+}
@@ -0,0 +1,151 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: roversim.c
+Source Description: Runs thousands of simulated rovers over random routes on a work-stealing pool and reports how
+                    they navigated and how many rover-seconds were simulated per second of wall time
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../sim_batch.h"
+#include "../pool.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowSec
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in seconds
+/---------------------------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options]\n"
+		"  -N rovers    rovers to simulate (default 4096)\n"
+		"  -T seconds   simulated time per rover (default 600)\n"
+		"  -j threads   pool size (default: one per core)\n"
+		"  -c pid|bucket  controller (default pid, as the rover)\n"
+		"  -r hz        GPS fix rate (default 10)\n"
+		"  -w count     waypoints per route (default 3, at most %d)\n"
+		"  -g log       measure the GPS jitter from this log's stationary stretches (default %s)\n"
+		"  -s seed      scenario seed (default 1)\n"
+		"  -p           patrol: a rover that completes its route gets a new one, for throughput runs\n"
+		"  -S           scaling: run with 1, 2, 4 ... threads up to -j and compare\n", prog, SIM_MAX_WPS,
+		SIM_LOG_DEFAULT);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: runOnce
+Function Description: Sets up a batch, runs it on the pool and prints the results
+Input Parameters: pool - threads, count - rovers, sp, cfg - simulation, verbose - 1 to print the navigation figures
+Output Parameters: Rover-seconds per wall second, 0 if the batch couldn't be allocated
+/---------------------------------------------------------------------------------------------------------*/
+static double runOnce(Pool *pool, size_t count, const SimParams *sp, const SimConfig *cfg, int verbose) {
+	SimBatch b;
+	if (Sim_Init(&b, count, sp, cfg) != 0) {
+		printf("Out of memory for %zu rovers\n", count);
+		return 0.0;
+	}
+	unsigned long steals = Pool_Steals(pool);
+	double t0 = nowSec();
+	Pool_Run(pool, Sim_Chunks(&b), Sim_RunChunk, &b);
+	double wall = nowSec() - t0;
+
+	SimSummary s;
+	Sim_Summarise(&b, &s);
+	double rate = s.roverSeconds / wall;
+	if (verbose) {
+		printf("Arrived: %zu of %zu rovers, %.1f s and %.1f m on average (%.2fx the route), %.1f wheel reversals "
+			"per rover, %lu routes in all\n", s.arrived, s.rovers, s.meanArrive, s.meanPath, s.meanExcess,
+			s.meanReversals, s.routes);
+	}
+	printf("%3d threads: %.0f rover-s in %.2f s wall, %.0f rover-s per s, %lu steals\n", Pool_Threads(pool),
+		s.roverSeconds, wall, rate, Pool_Steals(pool) - steals);
+	Sim_Free(&b);
+	return rate;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Measures the GPS jitter, then runs the batch once or at each thread count
+Input Parameters: see usage()
+Output Parameters: 0 on success, 1 on bad options or if the log can't be used
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	size_t count = 4096;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN), scaling = 0;
+	const char *log = SIM_LOG_DEFAULT;
+	SimParams sp;
+	SimConfig cfg;
+	Sim_Defaults(&sp);
+	Sim_DefaultConfig(&cfg, SIM_PID);
+	int opt;
+
+	while ((opt = getopt(argc, argv, "N:T:j:c:r:w:g:s:pS")) != -1) {
+		switch (opt) {
+			case 'N': count = strtoul(optarg, NULL, 10); break;
+			case 'T': sp.timeout = atof(optarg); break;
+			case 'j': threads = atoi(optarg); break;
+			case 'c': cfg.ctrl = strcmp(optarg, "bucket") == 0 ? SIM_BUCKET : SIM_PID; break;
+			case 'r': sp.fixHz = atof(optarg); break;
+			case 'w': sp.wps = atoi(optarg); break;
+			case 'g': log = optarg; break;
+			case 's': sp.seed = strtoull(optarg, NULL, 10); break;
+			case 'p': sp.patrol = 1; break;
+			case 'S': scaling = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (count == 0 || sp.timeout <= 0.0 || sp.fixHz <= 0.0 || sp.wps < 1 || sp.wps > SIM_MAX_WPS) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+
+	if (SimNoise_FromLog(log, &sp.noise) != 0) {
+		printf("No stationary stretch in %s to measure the GPS jitter from\n", log);
+		return 1;
+	}
+	printf("GPS: %.0f Hz, jitter %.2f m east %.2f m north, %.3f correlation per fix, %.1f%% repeated fixes "
+		"(%zu fixes in %zu stationary stretches of %s)\n", sp.fixHz, sp.noise.sdE, sp.noise.sdN, sp.noise.rho,
+		100.0 * sp.noise.repeat, sp.noise.fixes, sp.noise.runs, log);
+	printf("Sim: %zu rovers, %s, %d-waypoint routes, %.0f s each%s\n", count, cfg.ctrl == SIM_PID ? "pid" : "bucket",
+		sp.wps, sp.timeout, sp.patrol ? ", patrolling" : "");
+
+	if (!scaling) {
+		Pool *pool = Pool_Create(threads);
+		if (!pool)
+			return 1;
+		runOnce(pool, count, &sp, &cfg, 1);
+		Pool_Destroy(pool);
+		return 0;
+	}
+
+	double base = 0.0;
+	for (int t = 1; ; t = t * 2 < threads ? t * 2 : threads) {
+		Pool *pool = Pool_Create(t);
+		if (!pool)
+			return 1;
+		double rate = runOnce(pool, count, &sp, &cfg, t == 1);
+		Pool_Destroy(pool);
+		if (t == 1)
+			base = rate;
+		else if (base > 0.0)
+			printf("             %.2fx one thread, %.0f%% of linear\n", rate / base, 100.0 * rate / base / t);
+		if (t == threads)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: telem_mon.c
+Source Description: Attaches to the rover's shared-memory telemetry and prints or records live snapshots, without
+                    touching the control process
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "../telemetry.h"
+
+static volatile sig_atomic_t stop = 0;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sig_handler
+Function Description: Stops the monitor on Ctrl + C
+Input Parameters: signum
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sig_handler(int signum) {
+	stop = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock, the same clock as the snapshot times
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options]\n"
+		"  -r hz      snapshots per second (default 5)\n"
+		"  -n count   stop after this many snapshots (default: until Ctrl+C)\n"
+		"  -c         CSV, one line per new snapshot, for recording\n"
+		"  -w         wait for the rover to start instead of failing\n"
+		"  -b         measure how many snapshots per second a reader can take\n", prog);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: printCsv / printLine
+Function Description: Prints a snapshot as a CSV row, or as a readable status line
+Input Parameters: s - snapshot, ageMs - how old it is
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void printCsv(const TelemState *s) {
+	printf("%llu,%llu,%llu,%u,%.7f,%.7f,%.2f,%.2f,%.7f,%.7f,%.2f,%.2f,%.2f,%.2f,%.2f,%.0f,%.0f,%.1f,%.1f,%d,%d,%d,%d,%s\n",
+		(unsigned long long)s->tNs, (unsigned long long)s->ticks, (unsigned long long)s->fixes, s->gpsTimeMs,
+		s->lat, s->lon, s->gpsHead, s->gpsSpeed, s->navLat, s->navLon, s->head, s->bearing, s->error, s->distance,
+		s->crossTrack, s->dutyL, s->dutyR, s->appliedL, s->appliedR, s->fixState, s->leg, s->count, s->status, s->mode);
+}
+
+static void printLine(const TelemState *s, double ageMs) {
+	printf("%7.1f ms  tick %-8llu fix %-6llu %10.7f %11.7f  head %6.2f  brg %6.2f  err %6.2f  wp %d/%d %7.1f m  "
+		"xt %5.1f m  %s  duty %4.0f %4.0f\n", ageMs, (unsigned long long)s->ticks, (unsigned long long)s->fixes,
+		s->navLat, s->navLon, s->head, s->bearing, s->error, s->leg + 1, s->count, s->distance, s->crossTrack, s->mode,
+		s->dutyL, s->dutyR);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Opens the telemetry segment and prints snapshots at the requested rate
+Input Parameters: see usage()
+Output Parameters: 0 on success, 1 if the segment cannot be opened
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	double rateHz = 5.0;
+	long count = 0;
+	int csv = 0, wait = 0, bench = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:n:cwb")) != -1) {
+		switch (opt) {
+			case 'r': rateHz = atof(optarg); break;
+			case 'n': count = atol(optarg); break;
+			case 'c': csv = 1; break;
+			case 'w': wait = 1; break;
+			case 'b': bench = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (rateHz <= 0.0) {
+		usage(argv[0]);
+		return 1;
+	}
+	signal(SIGINT, sig_handler);
+
+	TelemReader reader;
+	int rc;
+	while ((rc = Telem_Open(&reader)) != 0) {
+		if (rc == -2) {
+			printf("Telemetry segment %s has a different layout, rebuild the monitor\n", TELEM_SHM_NAME);
+			return 1;
+		}
+		if (!wait || stop) {
+			printf("No telemetry at %s, is the rover running?\n", TELEM_SHM_NAME);
+			return 1;
+		}
+		usleep(200000);
+	}
+
+	TelemState s;
+	if (bench) {
+		uint64_t t0 = nowNs(), reads = 0;
+		unsigned first = Telem_Read(&reader, &s), last = first;
+		while (nowNs() - t0 < 1000000000ull) {
+			last = Telem_Read(&reader, &s);
+			reads++;
+		}
+		printf("%llu snapshots in 1 s (%.0f ns each), writer published %u times meanwhile\n",
+			(unsigned long long)reads, 1e9 / reads, (last - first) / 2);
+		Telem_Close(&reader);
+		return 0;
+	}
+
+	if (csv)
+		printf("t_ns,ticks,fixes,gps_time_ms,lat,lon,gps_head,gps_speed,nav_lat,nav_lon,head,bearing,error,distance,"
+			"cross_track,duty_l,duty_r,applied_l,applied_r,fix_state,leg,count,status,mode\n");
+
+	unsigned lastSeq = 0;
+	long shown = 0;
+	uint64_t period = (uint64_t)(1e9 / rateHz);
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop && (count == 0 || shown < count)) {
+		unsigned seq = Telem_Read(&reader, &s);
+		if (seq != 0 && seq != lastSeq) {
+			if (csv)
+				printCsv(&s);
+			else
+				printLine(&s, (nowNs() - s.tNs) / 1e6);
+			fflush(stdout);
+			lastSeq = seq;
+			shown++;
+		} else if (!Telem_WriterAlive(&reader)) {
+			printf("Rover stopped\n");
+			break;
+		}
+
+		next.tv_sec += (time_t)(period / 1000000000ull);
+		next.tv_nsec += (long)(period % 1000000000ull);
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	Telem_Close(&reader);
+	return 0;
+}
@@ -0,0 +1,324 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: telem_rx.c
+Source Description: Ground-station receiver for the rover's binary UDP telemetry stream: decodes datagrams into
+                    status lines or CSV and counts lost datagrams. -t runs the stream over loopback as a self-test
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../telem_stream.h"
+
+#define RX_TEST_SAMPLES 20000  //Samples streamed by the self-test
+#define RX_TEST_BURST   200    //Pushed between receiver drains, well inside the ring
+#define RX_TEST_GAP_US  5000   //Between bursts: 40 kHz, the sender empties the ring every 10 ms
+
+static volatile sig_atomic_t stop = 0;
+
+static const char *statusNames[] = {"empty", "active", "arrived"};  //MissionStatus
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sig_handler
+Function Description: Stops the receiver on Ctrl + C
+Input Parameters: signum
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sig_handler(int signum) {
+	stop = 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowNs
+Function Description: Reads the monotonic clock, the clock the rover stamps samples with
+Input Parameters: N/A
+Output Parameters: Time in nanoseconds
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options]\n"
+		"  -p port    UDP port to listen on (default %d)\n"
+		"  -n count   stop after this many records (default: until Ctrl+C)\n"
+		"  -c         CSV, one line per record, for recording\n"
+		"  -q         no per-record output, only the summary\n"
+		"  -t         loopback self-test: stream synthetic samples to this process and check them\n",
+		prog, STREAM_DEFAULT_PORT);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: openSocket
+Function Description: Binds a UDP socket to a port on the loopback or every interface
+Input Parameters: port - 0 for any free port, loopback - 1 to bind 127.0.0.1 only
+Output Parameters: Socket, or -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+static int openSocket(int port, int loopback) {
+	struct sockaddr_in addr;
+	struct timeval tv = {0, 200000};  //So Ctrl + C is seen while the rover is silent
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	addr.sin_addr.s_addr = htonl(loopback ? INADDR_LOOPBACK : INADDR_ANY);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	return fd;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: printCsv / printLine
+Function Description: Prints a record as a CSV row, or as a readable status line
+Input Parameters: r - record
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void printCsv(const StreamRecord *r) {
+	printf("%u,%.7f,%.7f,%.2f,%.2f,%.2f,%.1f,%.1f,%d,%d,%.1f,%.0f,%d,%d,%d\n", r->tMs, r->lat, r->lon, r->head,
+		r->error, r->speed, r->distance, r->crossTrack, r->dutyL, r->dutyR, r->fixAgeMs, r->lateUs, r->leg,
+		r->fixState, r->status);
+}
+
+static void printLine(const StreamRecord *r) {
+	printf("%9.3f s  %10.7f %11.7f  head %6.2f  err %7.2f  %5.2f km/h  wp %-3d %7.1f m  xt %6.1f m  duty %4d %4d  "
+		"fix %d %6.1f ms old  late %5.0f us  %s\n", r->tMs / 1e3, r->lat, r->lon, r->head, r->error, r->speed,
+		r->leg + 1, r->distance, r->crossTrack, r->dutyL, r->dutyR, r->fixState, r->fixAgeMs, r->lateUs,
+		r->status >= 0 && r->status < 3 ? statusNames[r->status] : "?");
+}
+
+//Receiver counters
+typedef struct {
+	unsigned long datagrams, records, bad, lost;
+	uint32_t nextSeq, senderDrops;
+	int started;
+} RxStats;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: account
+Function Description: Checks a datagram's sequence number against the last, counting the ones that never came.
+                      One arriving behind the last is counted as received late, not as a loss
+Input Parameters: st - counters, h - datagram header
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void account(RxStats *st, const StreamHeader *h) {
+	if (st->started && (int32_t)(h->seq - st->nextSeq) > 0)
+		st->lost += h->seq - st->nextSeq;
+	if (!st->started || (int32_t)(h->seq - st->nextSeq) >= 0)
+		st->nextSeq = h->seq + 1;
+	st->started = 1;
+	st->datagrams++;
+	st->records += (unsigned long)h->count;
+	st->senderDrops = h->dropped;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: near
+Function Description: Whether a decoded field is the sent value clamped to the field and rounded to its step
+Input Parameters: got - decoded, sent - original, step - field resolution, lo, hi - field range
+Output Parameters: 1 if it matches
+/---------------------------------------------------------------------------------------------------------*/
+static int near(double got, double sent, double step, double lo, double hi) {
+	double want = sent < lo ? lo : sent > hi ? hi : sent;
+	return fabs(got - want) <= step * 0.5 + 1e-9;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: testSample
+Function Description: Synthetic sample i: a slow drive around the test site, with every tenth sample pushing the
+                      fields past their ranges to exercise the clamping
+Input Parameters: s - sample out, i - index, t0Ns - stream start
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void testSample(StreamSample *s, int i, uint64_t t0Ns) {
+	double wild = i % 10 == 9 ? 1e3 : 1.0;
+	s->tNs = t0Ns + (uint64_t)i * 1000000ull + 500000;  //1 kHz, mid-ms so the stream's slightly earlier origin
+	                                                     //still gives tMs == i
+	s->lat = 50.364351 + i * 1.3e-7;
+	s->lon = -4.141873 - i * 0.9e-7;
+	s->head = fmod(i * 0.37, 360.0);
+	s->error = fmod(i * 1.13, 360.0) - 180.0;
+	s->error *= wild;
+	s->speed = 3.6 + sin(i * 0.01);
+	s->distance = (250.0 - i * 0.01) * wild;
+	s->crossTrack = sin(i * 0.003) * 4.0 * wild;
+	s->fixAgeMs = (i % 100) * 0.13 * wild;
+	s->lateUs = (i % 37) * 3.0 * wild;
+	s->dutyL = (int)((i % 201 - 100) * wild);
+	s->dutyR = (int)((100 - i % 201) * wild);
+	s->leg = i / 1000;
+	s->fixState = i % 2;
+	s->status = i % 3;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: checkRecord
+Function Description: Compares a decoded record with the sample it came from
+Input Parameters: r - record, s - sample, i - its index
+Output Parameters: 1 if every field matches
+/---------------------------------------------------------------------------------------------------------*/
+static int checkRecord(const StreamRecord *r, const StreamSample *s, int i) {
+	return r->tMs == (uint32_t)i &&
+		near(r->lat, s->lat, 1e-7, -90.0, 90.0) && near(r->lon, s->lon, 1e-7, -180.0, 180.0) &&
+		near(r->head, s->head, 0.01, 0.0, 359.99) && near(r->error, s->error, 0.01, -180.0, 180.0) &&
+		near(r->speed, s->speed, 0.01, 0.0, 655.35) && near(r->distance, s->distance, 0.1, 0.0, 6553.5) &&
+		near(r->crossTrack, s->crossTrack, 0.1, -3276.8, 3276.7) &&
+		near(r->fixAgeMs, s->fixAgeMs, 0.1, 0.0, 6553.5) && near(r->lateUs, s->lateUs, 1.0, 0.0, 65535.0) &&
+		near(r->dutyL, s->dutyL, 1.0, -100.0, 100.0) && near(r->dutyR, s->dutyR, 1.0, -100.0, 100.0) &&
+		r->leg == s->leg && r->fixState == s->fixState && r->status == s->status;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: drain
+Function Description: Reads every datagram waiting on the socket, checking the self-test's or printing the live ones
+Input Parameters: fd - socket, st - counters, flags - 0 to wait for the first datagram, test - 1 to check against
+                  testSample, t0Ns - self-test stream start, csv, quiet - output, limit - records to stop after
+Output Parameters: Records that did not match (self-test)
+/---------------------------------------------------------------------------------------------------------*/
+static unsigned long drain(int fd, RxStats *st, int flags, int test, uint64_t t0Ns, int csv, int quiet, long limit) {
+	static uint8_t buf[STREAM_MTU_PAYLOAD + 1];
+	unsigned long mismatches = 0;
+	ssize_t len;
+
+	while (!stop && (limit <= 0 || st->records < (unsigned long)limit) &&
+		(len = recv(fd, buf, sizeof(buf), flags)) >= 0) {
+		StreamHeader h;
+		flags = MSG_DONTWAIT;
+		if (Stream_DecodeHeader(buf, (size_t)len, &h) != 0) {
+			st->bad++;
+			continue;
+		}
+		for (int i = 0; i < h.count; i++) {
+			StreamRecord r;
+			Stream_DecodeRecord(buf, i, &r);
+			if (test) {
+				StreamSample s;
+				int n = (int)(st->records + (unsigned long)i);
+				testSample(&s, n, t0Ns);
+				mismatches += !checkRecord(&r, &s, n);
+			} else if (!quiet) {
+				if (csv)
+					printCsv(&r);
+				else
+					printLine(&r);
+			}
+		}
+		account(st, &h);
+		if (!test && !quiet)
+			fflush(stdout);
+	}
+	return mismatches;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: selfTest
+Function Description: Streams synthetic samples through Stream_Push to a loopback socket in this process, and checks
+                      every record arrives, in order, with each field as sent to within its resolution
+Input Parameters: N/A
+Output Parameters: 0 if everything arrived intact, 1 if not
+/---------------------------------------------------------------------------------------------------------*/
+static int selfTest(void) {
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int fd = openSocket(0, 1);
+	if (fd < 0 || getsockname(fd, (struct sockaddr *)&addr, &addrLen) != 0) {
+		printf("Self-test: cannot bind a loopback socket\n");
+		return 1;
+	}
+	if (Stream_Open("127.0.0.1", ntohs(addr.sin_port), 0.0) != 0) {
+		printf("Self-test: cannot open the stream\n");
+		close(fd);
+		return 1;
+	}
+	uint64_t t0Ns = nowNs(); //Just after Stream_Open's time origin
+
+	RxStats st = {0};
+	unsigned long mismatches = 0;
+	uint64_t pushNs = 0;
+	StreamSample s;
+	for (int i = 0; i < RX_TEST_SAMPLES; ) {
+		uint64_t t = nowNs();
+		for (int end = i + RX_TEST_BURST; i < end && i < RX_TEST_SAMPLES; i++) {
+			testSample(&s, i, t0Ns);
+			Stream_Push(&s);
+		}
+		pushNs += nowNs() - t;
+		mismatches += drain(fd, &st, MSG_DONTWAIT, 1, t0Ns, 0, 1, 0);
+		usleep(RX_TEST_GAP_US);
+	}
+	Stream_Close();
+	mismatches += drain(fd, &st, MSG_DONTWAIT, 1, t0Ns, 0, 1, 0);
+	close(fd);
+
+	StreamStats ss;
+	Stream_GetStats(&ss);
+	printf("Self-test: %d samples pushed (%.0f ns each), %lu datagrams of up to %d records, %lu records received\n",
+		RX_TEST_SAMPLES, (double)pushNs / RX_TEST_SAMPLES, st.datagrams, STREAM_MAX_RECORDS, st.records);
+	printf("Self-test: %lu mismatched, %lu lost datagrams, %lu bad, %llu ring and %llu send drops\n", mismatches,
+		st.lost, st.bad, (unsigned long long)ss.ringDrops, (unsigned long long)ss.sendDrops);
+	int ok = mismatches == 0 && st.lost == 0 && st.bad == 0 && st.records == RX_TEST_SAMPLES;
+	printf("Self-test: %s\n", ok ? "passed" : "FAILED");
+	return !ok;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Listens for the rover's stream and prints each record, then a summary
+Input Parameters: see usage()
+Output Parameters: 0 on success, 1 if the port cannot be bound or the self-test fails
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	int port = STREAM_DEFAULT_PORT;
+	long count = 0;
+	int csv = 0, quiet = 0, test = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:n:cqt")) != -1) {
+		switch (opt) {
+			case 'p': port = atoi(optarg); break;
+			case 'n': count = atol(optarg); break;
+			case 'c': csv = 1; break;
+			case 'q': quiet = 1; break;
+			case 't': test = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (test)
+		return selfTest();
+
+	int fd = openSocket(port, 0);
+	if (fd < 0) {
+		printf("Cannot listen on UDP port %d\n", port);
+		return 1;
+	}
+	signal(SIGINT, sig_handler);
+	if (csv)
+		printf("tMs,lat,lon,head,error,speed,distance,crossTrack,dutyL,dutyR,fixAgeMs,lateUs,leg,fixState,status\n");
+
+	RxStats st = {0};
+	while (!stop && (count <= 0 || st.records < (unsigned long)count))
+		drain(fd, &st, 0, 0, 0, csv, quiet, count);
+	close(fd);
+
+	fprintf(stderr, "Received %lu datagrams, %lu records; %lu datagrams lost, %lu not recognised, %u samples dropped "
+		"by the rover\n", st.datagrams, st.records, st.lost, st.bad, st.senderDrops);
+	return 0;
+}
@@ -0,0 +1,80 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: trackconv.c
+Source Description: Converts GPS logs between CSV, GPX and the native binary track format and reports the size 
+                    and reload time of each
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../track_io.h"
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: fileSize
+Function Description: Size of a file on disk
+Input Parameters: path - file name
+Output Parameters: Size in bytes, 0 if it can't be read
+/---------------------------------------------------------------------------------------------------------*/
+static long long fileSize(const char *path) {
+	struct stat st;
+	return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: timedLoad
+Function Description: Loads a file and measures how long it took
+Input Parameters: path - file name, list - list to fill
+Output Parameters: Load time in milliseconds, negative on failure
+/---------------------------------------------------------------------------------------------------------*/
+static double timedLoad(const char *path, TrackList *list) {
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	int rc = TrackIO_Load(path, list);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (rc != 0)
+		return -1.0;
+	return (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: trackconv <input.csv|gpx|trk> <output.csv|gpx|trk>
+Input Parameters: argv[1] - input file, argv[2] - output file
+Output Parameters: 0 on success, 1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	TrackList in = {0}, back = {0};
+
+	if (argc != 3) {
+		printf("Usage: %s <input.csv|gpx|trk> <output.csv|gpx|trk>\n", argv[0]);
+		return 1;
+	}
+
+	double loadIn = timedLoad(argv[1], &in);
+	if (loadIn < 0.0) {
+		printf("Cannot read %s\n", argv[1]);
+		return 1;
+	}
+	if (TrackIO_Save(argv[2], in.pts, in.count) != 0) {
+		printf("Cannot write %s\n", argv[2]);
+		return 1;
+	}
+	double loadOut = timedLoad(argv[2], &back);
+
+	long long inBytes = fileSize(argv[1]);
+	long long outBytes = fileSize(argv[2]);
+	double perPoint = in.count ? 1.0 / in.count : 0.0;
+
+	printf("%zu points\n", in.count);
+	printf("%-24s %10lld bytes (%6.1f B/point), load %8.3f ms\n", argv[1], inBytes, inBytes * perPoint, loadIn);
+	printf("%-24s %10lld bytes (%6.1f B/point), load %8.3f ms\n", argv[2], outBytes, outBytes * perPoint, loadOut);
+	if (outBytes > 0)
+		printf("Size ratio %.1f:1\n", (double)inBytes / outBytes);
+	if (back.count != in.count)
+		printf("Warning: %zu points read back\n", back.count);
+
+	TrackIO_Free(&in);
+	TrackIO_Free(&back);
+	return 0;
+}
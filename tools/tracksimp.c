@@ -0,0 +1,227 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: tracksimp.c
+Source Description: Shrinks GPS logs with Douglas-Peucker simplification, in memory or streamed through a fixed
+                    window for logs too large to load, and optionally checks the worst error of the result
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../track_io.h"
+#include "../simplify.h"
+
+#define MATCH_M 0.02    //Output points are rounded to 1e-7 degrees, so match them to the input within 2 cm
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: fileSize
+Function Description: Size of a file on disk
+Input Parameters: path - file name
+Output Parameters: Size in bytes, 0 if it can't be read
+/---------------------------------------------------------------------------------------------------------*/
+static long long fileSize(const char *path) {
+	struct stat st;
+	return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: writePoint
+Function Description: Simplifier callback, writes a kept point
+Input Parameters: ctx - track writer, pt - point
+Output Parameters: 0 on success, -1 on write failure
+/---------------------------------------------------------------------------------------------------------*/
+static int writePoint(void *ctx, const TrackPoint *pt) {
+	return TrackIO_Write((TrackWriter *)ctx, pt);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: simplifyStream
+Function Description: Reads, decimates, simplifies and writes one point at a time through a fixed window
+Input Parameters: in - input file, w - open writer, tolM - tolerance, window - points held, dec - decimator or
+                  NULL, count - points read out
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+static int simplifyStream(const char *in, TrackWriter *w, double tolM, size_t window, SimplifyDecimator *dec,
+	unsigned long *count) {
+	TrackReader r;
+	Simplifier s;
+	TrackPoint pt;
+	int rc;
+
+	if (TrackIO_OpenRead(&r, in) != 0)
+		return -1;
+	if (Simplify_Init(&s, tolM, window, writePoint, w) != 0) {
+		TrackIO_CloseRead(&r);
+		return -1;
+	}
+
+	*count = 0;
+	while ((rc = TrackIO_Read(&r, &pt)) > 0) {
+		(*count)++;
+		if (dec && !Simplify_DecimateKeep(dec, &pt))
+			continue;
+		if (Simplify_Push(&s, &pt) != 0) {
+			rc = -1;
+			break;
+		}
+	}
+	if (rc == 0)
+		rc = Simplify_Finish(&s);
+
+	Simplify_Free(&s);
+	TrackIO_CloseRead(&r);
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: simplifyMemory
+Function Description: Loads the whole track, decimates and simplifies it in one pass and writes it
+Input Parameters: in - input file, w - open writer, tolM - tolerance, dec - decimator or NULL, count - points
+                  read out
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+static int simplifyMemory(const char *in, TrackWriter *w, double tolM, SimplifyDecimator *dec, unsigned long *count) {
+	TrackList list = {0};
+	int rc = TrackIO_Load(in, &list);
+
+	*count = list.count;
+	if (rc == 0) {
+		size_t n = 0;
+		for (size_t i = 0; i < list.count; i++)
+			if (!dec || Simplify_DecimateKeep(dec, &list.pts[i]))
+				list.pts[n++] = list.pts[i];
+		size_t kept = Simplify_Track(list.pts, n, tolM);
+		if (kept == 0 && n > 0)
+			rc = -1;
+		for (size_t i = 0; i < kept && rc == 0; i++)
+			rc = TrackIO_Write(w, &list.pts[i]);
+	}
+	TrackIO_Free(&list);
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: verify
+Function Description: Streams the input and the simplified output side by side and measures how far each input
+                      point is from the output segment that spans it
+Input Parameters: in, out - file names, maxErr - worst distance out (m)
+Output Parameters: 0 on success, -1 if either file can't be read or the output is not a subsequence of the input
+/---------------------------------------------------------------------------------------------------------*/
+static int verify(const char *in, const char *out, double *maxErr) {
+	TrackReader ri, ro;
+	TrackPoint p, a, b;
+	int rc = -1, more;
+
+	*maxErr = 0.0;
+	if (TrackIO_OpenRead(&ri, in) != 0)
+		return -1;
+	if (TrackIO_OpenRead(&ro, out) != 0) {
+		TrackIO_CloseRead(&ri);
+		return -1;
+	}
+
+	if (TrackIO_Read(&ro, &a) > 0) {
+		b = a;
+		more = TrackIO_Read(&ro, &b) > 0;
+		while (TrackIO_Read(&ri, &p) > 0) {
+			double err = Simplify_SegmentError(&a, &b, &p);
+			if (err > *maxErr)
+				*maxErr = err;
+			//Move on to the next segment once its end point has been reached
+			if (more && Simplify_SegmentError(&b, &b, &p) < MATCH_M) {
+				a = b;
+				more = TrackIO_Read(&ro, &b) > 0;
+			}
+		}
+		rc = more ? -1 : 0;
+	}
+
+	TrackIO_CloseRead(&ri);
+	TrackIO_CloseRead(&ro);
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options] <input.csv|gpx|trk> <output.csv|gpx|trk>\n"
+		"  -t metres    tolerance, the furthest any point may be from the simplified track (default 1)\n"
+		"  -w points    stream through a window of this many points instead of loading the whole log (e.g. %d)\n"
+		"  -i ms        first keep at most one point per interval, by GPS time\n"
+		"  -f           CSV output with heading, time and fix state columns\n"
+		"  -v           check the worst error of the output against the input\n", prog, SIMPLIFY_DEFAULT_WINDOW);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Simplifies a track and reports the reduction
+Input Parameters: see usage()
+Output Parameters: 0 on success, 1 on failure or if the checked error exceeds the tolerance
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	double tolM = 1.0;
+	size_t window = 0;
+	long interval = 0;
+	int full = 0, check = 0, opt;
+
+	while ((opt = getopt(argc, argv, "t:w:i:fv")) != -1) {
+		switch (opt) {
+			case 't': tolM = atof(optarg); break;
+			case 'w': window = (size_t)atol(optarg); break;
+			case 'i': interval = atol(optarg); break;
+			case 'f': full = 1; break;
+			case 'v': check = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (argc - optind != 2 || tolM < 0.0 || interval < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	const char *in = argv[optind], *out = argv[optind + 1];
+
+	TrackWriter w;
+	SimplifyDecimator dec;
+	unsigned long count = 0;
+	struct timespec t0, t1;
+
+	if (TrackIO_Create(&w, out, full) != 0) {
+		printf("Cannot write %s\n", out);
+		return 1;
+	}
+	Simplify_DecimateInit(&dec, (uint32_t)interval);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	int rc = window ? simplifyStream(in, &w, tolM, window, interval ? &dec : NULL, &count) :
+		simplifyMemory(in, &w, tolM, interval ? &dec : NULL, &count);
+	if (TrackIO_Finish(&w) != 0)
+		rc = -1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (rc != 0) {
+		printf("Cannot simplify %s\n", in);
+		return 1;
+	}
+
+	double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+	printf("%lu -> %zu points (%.1fx) at %.2f m, %s in %.1f ms (%.1f M points/s)\n", count, w.count,
+		count / (w.count ? (double)w.count : 1.0), tolM, window ? "streamed" : "in memory", ms,
+		count / (ms > 0.0 ? ms : 1e-6) / 1e3);
+	printf("%lld -> %lld bytes\n", fileSize(in), fileSize(out));
+
+	if (check) {
+		double maxErr;
+		if (verify(in, out, &maxErr) != 0) {
+			printf("Check failed: %s is not a simplification of %s\n", out, in);
+			return 1;
+		}
+		printf("Worst error %.3f m (tolerance %.2f m%s)\n", maxErr, tolM, interval ? ", plus time decimation" : "");
+		if (!interval && maxErr > tolM + MATCH_M)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,372 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: trackstats.c
+Source Description: Summarises GPS logs (distance, speed profile, heading, position spread, bounds) for one file
+                    or a directory of them. CSV logs are mapped, cut into chunks at line ends and parsed on every
+                    core, and the per-chunk statistics are merged in file order
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "../track_io.h"
+#include "../track_stats.h"
+#include "../geodesy.h"
+
+#define CHUNK_BYTES (8u << 20)  //Fixed chunk size, so results do not depend on the thread count
+#define MAX_THREADS 64
+
+//One log
+typedef struct {
+	char *path;
+	TrackFile file;         //CSV mapping, never opened for other formats
+	const char *map;        //Mapped CSV, NULL for other formats
+	size_t size;
+	size_t firstJob, jobs;
+	int failed;
+	TrackStats stats;
+} LogFile;
+
+//One chunk of a mapped CSV, or a whole GPX or track file
+typedef struct {
+	LogFile *log;
+	size_t off, len;
+	TrackStats stats;
+} Job;
+
+typedef struct {
+	Job *jobs;
+	size_t count;
+	atomic_size_t next;
+	double rateHz;
+} WorkQueue;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: loadOther
+Function Description: Reads a GPX or track file point by point; these are not split
+Input Parameters: job - job for the whole file
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void loadOther(Job *job) {
+	TrackReader r;
+	TrackPoint pt;
+	int rc;
+
+	if (TrackIO_OpenRead(&r, job->log->path) != 0) {
+		job->log->failed = 1;
+		return;
+	}
+	while ((rc = TrackIO_Read(&r, &pt)) > 0)
+		TrackStats_Add(&job->stats, &pt, r.fmt == FMT_TRK);
+	if (rc < 0)
+		job->log->failed = 1;
+	TrackIO_CloseRead(&r);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: worker
+Function Description: Takes jobs off the queue until it is empty
+Input Parameters: arg - work queue
+Output Parameters: NULL
+/---------------------------------------------------------------------------------------------------------*/
+static void *worker(void *arg) {
+	WorkQueue *q = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_explicit(&q->next, 1, memory_order_relaxed)) < q->count) {
+		Job *job = &q->jobs[i];
+		TrackStats_Init(&job->stats, q->rateHz);
+		if (job->log->map)
+			TrackStats_ParseCSV(&job->stats, job->log->map + job->off, job->len);
+		else
+			loadOther(job);
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: mapLog
+Function Description: Maps a CSV log read-only and sequentially, with the same helper as binary tracks
+Input Parameters: log - log to map
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+static int mapLog(LogFile *log) {
+	if (Track_Open(&log->file, log->path) != 0)
+		return -1;
+	log->map = (const char *)log->file.base;
+	log->size = log->file.size;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: addJobs
+Function Description: Cuts a log into jobs. CSV chunks start just after a line end, so each holds whole rows
+Input Parameters: log - log, jobs, count, cap - job array to grow
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+static int addJobs(LogFile *log, Job **jobs, size_t *count, size_t *cap) {
+	log->firstJob = *count;
+	size_t off = 0;
+	do {
+		size_t end = log->size;
+		if (log->map && log->size - off > CHUNK_BYTES) {
+			const char *nl = memchr(log->map + off + CHUNK_BYTES - 1, '\n', log->size - off - CHUNK_BYTES + 1);
+			end = nl ? (size_t)(nl - log->map) + 1 : log->size;
+		}
+		if (*count == *cap) {
+			size_t newCap = *cap ? *cap * 2 : 64;
+			Job *j = realloc(*jobs, newCap * sizeof(Job));
+			if (!j)
+				return -1;
+			*jobs = j;
+			*cap = newCap;
+		}
+		(*jobs)[(*count)++] = (Job){.log = log, .off = off, .len = end - off};
+		off = end;
+	} while (log->map && off < log->size);
+	log->jobs = *count - log->firstJob;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: compareNames
+Function Description: qsort comparison for file names
+Input Parameters: a, b - pointers to names
+Output Parameters: strcmp order
+/---------------------------------------------------------------------------------------------------------*/
+static int compareNames(const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: addPath
+Function Description: Adds a log, or every .csv, .gpx and .trk file in a directory (sorted by name)
+Input Parameters: path - file or directory, logs, count, cap - log array to grow
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+static int addPath(const char *path, LogFile **logs, size_t *count, size_t *cap) {
+	struct stat st;
+	char **names = NULL;
+	size_t n = 0;
+
+	if (stat(path, &st) != 0)
+		return -1;
+	if (S_ISDIR(st.st_mode)) {
+		DIR *dir = opendir(path);
+		struct dirent *de;
+		if (!dir)
+			return -1;
+		while ((de = readdir(dir))) {
+			const char *dot = strrchr(de->d_name, '.');
+			if (!dot || (strcmp(dot, ".csv") && strcmp(dot, ".gpx") && strcmp(dot, ".trk")))
+				continue;
+			char **nn = realloc(names, (n + 1) * sizeof(char *));
+			if (!nn)
+				break;
+			names = nn;
+			names[n] = malloc(strlen(path) + strlen(de->d_name) + 2);
+			sprintf(names[n++], "%s/%s", path, de->d_name);
+		}
+		closedir(dir);
+		qsort(names, n, sizeof(char *), compareNames);
+	} else {
+		names = malloc(sizeof(char *));
+		names[n++] = strdup(path);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (*count == *cap) {
+			*cap = *cap ? *cap * 2 : 16;
+			*logs = realloc(*logs, *cap * sizeof(LogFile));
+		}
+		LogFile *log = &(*logs)[(*count)++];
+		memset(log, 0, sizeof(*log));
+		log->path = names[i];
+	}
+	free(names);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: speedText
+Function Description: Formats a speed percentile, which may only be known to be past the top of the histogram
+Input Parameters: buf, len - text out, v - percentile from TrackStats_SpeedPercentile
+Output Parameters: buf
+/---------------------------------------------------------------------------------------------------------*/
+static const char *speedText(char *buf, size_t len, double v) {
+	if (isinf(v))
+		snprintf(buf, len, ">%.2f", STATS_SPEED_TOP);
+	else
+		snprintf(buf, len, "%.1f", v);
+	return buf;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: printReport
+Function Description: Prints the full summary of a log or of all logs
+Input Parameters: name - title, s - statistics
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void printReport(const char *name, const TrackStats *s) {
+	double dist = TrackStats_Sum(&s->distance), secs = TrackStats_Sum(&s->seconds);
+	double sdE, sdN;
+	char p50[16], p90[16], p99[16];
+
+	printf("%s: %llu points, %llu other rows\n", name, (unsigned long long)s->points, (unsigned long long)s->skipped);
+	if (s->points == 0)
+		return;
+
+	printf("  Distance  %.1f m in %.1f s", dist, secs);
+	if (s->timedSteps < s->steps)
+		printf(" (%llu of %llu steps at an assumed %g Hz)", (unsigned long long)(s->steps - s->timedSteps),
+			(unsigned long long)s->steps, s->rateHz);
+	printf("\n  Speed     mean %.2f m/s, median %s, 90%% %s, 99%% %s, max %.2f\n", secs > 0.0 ? dist / secs : 0.0,
+		speedText(p50, sizeof(p50), TrackStats_SpeedPercentile(s, 0.5)),
+		speedText(p90, sizeof(p90), TrackStats_SpeedPercentile(s, 0.9)),
+		speedText(p99, sizeof(p99), TrackStats_SpeedPercentile(s, 0.99)), s->maxSpeed);
+
+	//Circular mean and standard deviation, from the heading column if there is one
+	const StatSum *hs = s->headings ? &s->headSin : &s->cogSin, *hc = s->headings ? &s->headCos : &s->cogCos;
+	uint64_t hn = s->headings ? s->headings : s->courses;
+	if (hn) {
+		double sn = TrackStats_Sum(hs), cs = TrackStats_Sum(hc);
+		double mean = atan2(sn, cs) * 180.0 / GEO_PI, r = sqrt(sn * sn + cs * cs) / hn;
+		printf("  Heading   mean %.1f deg, circular sd %.1f deg (%llu %s)\n", mean < 0.0 ? mean + 360.0 : mean,
+			r > 0.0 ? sqrt(-2.0 * log(r)) * 180.0 / GEO_PI : 180.0, (unsigned long long)hn,
+			s->headings ? "headings" : "courses over ground");
+	}
+
+	TrackStats_Spread(s, &sdE, &sdN);
+	printf("  Spread    mean %.7f,%.7f, sd E %.2f m N %.2f m, CEP %.2f m, 2DRMS %.2f m\n", s->meanLat, s->meanLon,
+		sdE, sdN, 0.59 * (sdE + sdN), 2.0 * sqrt(sdE * sdE + sdN * sdN));
+	printf("  Bounds    %.7f,%.7f to %.7f,%.7f (%.1f m E x %.1f m N)\n", s->minLat, s->minLon, s->maxLat, s->maxLon,
+		Geo_Distance(s->meanLat, s->minLon, s->meanLat, s->maxLon), Geo_Distance(s->minLat, s->meanLon, s->maxLat, s->meanLon));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options] <log or directory>...\n"
+		"  -j threads   parser threads (default: one per core)\n"
+		"  -r hz        fix rate assumed for logs without GPS time (default 10)\n"
+		"  -q           one line per log and the total only\n", prog);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Queues every chunk of every log, parses them on a thread pool and reports
+Input Parameters: see usage()
+Output Parameters: 0 on success, 1 if any log could not be read
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double rateHz = 10.0;
+	int quiet = 0, opt, rc = 0;
+
+	while ((opt = getopt(argc, argv, "j:r:q")) != -1) {
+		switch (opt) {
+			case 'j': threads = atol(optarg); break;
+			case 'r': rateHz = atof(optarg); break;
+			case 'q': quiet = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind >= argc || rateHz <= 0.0) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_THREADS)
+		threads = MAX_THREADS;
+
+	LogFile *logs = NULL;
+	size_t nLogs = 0, capLogs = 0;
+	for (int i = optind; i < argc; i++) {
+		if (addPath(argv[i], &logs, &nLogs, &capLogs) != 0) {
+			printf("Cannot read %s\n", argv[i]);
+			rc = 1;
+		}
+	}
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	Job *jobs = NULL;
+	size_t nJobs = 0, capJobs = 0, bytes = 0;
+	for (size_t i = 0; i < nLogs; i++) {
+		if (TrackIO_Format(logs[i].path) == FMT_CSV && mapLog(&logs[i]) != 0) {
+			logs[i].failed = 1;
+			continue;
+		}
+		if (TrackIO_Format(logs[i].path) != FMT_CSV) {
+			struct stat st;
+			logs[i].size = stat(logs[i].path, &st) == 0 ? (size_t)st.st_size : 0;
+		}
+		bytes += logs[i].size;
+		if (addJobs(&logs[i], &jobs, &nJobs, &capJobs) != 0) {
+			printf("Out of memory\n");
+			return 1;
+		}
+	}
+
+	WorkQueue q = {jobs, nJobs, 0, rateHz};
+	pthread_t tid[MAX_THREADS];
+	long started = 0;
+	for (long i = 1; i < threads && (size_t)i < nJobs; i++)
+		if (pthread_create(&tid[started], NULL, worker, &q) == 0)
+			started++;
+	worker(&q);
+	for (long i = 0; i < started; i++)
+		pthread_join(tid[i], NULL);
+
+	//Merge chunks in file order, then files into the total
+	TrackStats total;
+	TrackStats_Init(&total, rateHz);
+	for (size_t i = 0; i < nLogs; i++) {
+		LogFile *log = &logs[i];
+		TrackStats_Init(&log->stats, rateHz);
+		for (size_t j = 0; j < log->jobs; j++)
+			TrackStats_Merge(&log->stats, &jobs[log->firstJob + j].stats, 1);
+		TrackStats_Merge(&total, &log->stats, 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	for (size_t i = 0; i < nLogs; i++) {
+		LogFile *log = &logs[i];
+		if (log->failed) {
+			printf("%s: cannot read\n", log->path);
+			rc = 1;
+		} else if (quiet || nLogs > 1) {
+			printf("%-40s %9llu points %10.1f m %8.1f s\n", log->path, (unsigned long long)log->stats.points,
+				TrackStats_Sum(&log->stats.distance), TrackStats_Sum(&log->stats.seconds));
+		} else {
+			printReport(log->path, &log->stats);
+		}
+	}
+	if (nLogs > 1)
+		printReport("Total", &total);
+
+	double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	printf("%zu logs, %.1f MB in %.3f s (%.0f MB/s, %zu chunks on %ld threads)\n", nLogs, bytes / 1e6, secs,
+		bytes / 1e6 / (secs > 0.0 ? secs : 1e-9), nJobs, started + 1);
+
+	for (size_t i = 0; i < nLogs; i++) {
+		if (logs[i].map)
+			Track_Close(&logs[i].file);
+		free(logs[i].path);
+	}
+	free(logs);
+	free(jobs);
+	return rc;
+}
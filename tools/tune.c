@@ -0,0 +1,392 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: tune.c
+Source Description: Tunes the steering by a parallel sweep: random turn tables, duty limits and heading controller
+                    gains are each driven over the same simulated routes, ranked on arrival time, path length and
+                    wheel reversals, and the best is written out as a profile for main.c -P
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../sim_batch.h"
+#include "../pool.h"
+#include "../profile.h"
+
+#define TUNE_WAVE_ROVERS 32768   //Rovers simulated at once, over as many candidates as fit
+#define TUNE_PROFILE_DEFAULT "tuned.profile"
+#define TUNE_SWEEP_SALT 0x5357454550000000ull  //Mixed into the seed for the sweep generator ("SWEEP")
+
+//One configuration under test
+typedef struct {
+	SimConfig cfg;
+	SimSummary s;
+	double meanT;          //Mean time to complete the route, the time limit for rovers that didn't (s)
+	double cost;           //Weighted score against the reference, lower is better
+	int builtIn;           //1 for the rover's own settings
+} Candidate;
+
+//Batches of one wave, for the pool
+typedef struct {
+	SimBatch *b;
+	size_t chunks;         //Per batch, all batches are the same size
+} Wave;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nowSec
+Function Description: Reads the monotonic clock
+Input Parameters: N/A
+Output Parameters: Time in seconds
+/---------------------------------------------------------------------------------------------------------*/
+static double nowSec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: nextRandom / pick / pickStep
+Function Description: Sweep generator (splitmix64), kept apart from the scenario seeds so every candidate sees the
+                      same routes. Seeded with the salted seed, since from the bare seed its stream would be the
+                      same numbers as the rovers' seedFor states. Uniform in [lo, hi], and a multiple of step in
+                      [lo, hi]
+Input Parameters: state - generator state, lo, hi - range, step - spacing
+Output Parameters: Random bits, or sample
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t nextRandom(uint64_t *state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static double pick(uint64_t *state, double lo, double hi) {
+	return lo + (hi - lo) * ((nextRandom(state) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+static int pickStep(uint64_t *state, int lo, int hi, int step) {
+	return lo + step * (int)(nextRandom(state) % (uint64_t)((hi - lo) / step + 1));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sampleBucket / samplePid
+Function Description: Draws a candidate around the rover's settings. The turn table is drawn symmetric about
+                      180 degrees, as the rover turns the same either way: a forwards band of 2 to 30 degrees each
+                      side, and hard turns from 10 degrees past that up to 150 degrees. The heading controller's
+                      proportional gain is drawn on a log scale
+Input Parameters: state - sweep generator, cfg - candidate to fill
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sampleBucket(uint64_t *state, SimConfig *cfg) {
+	Sim_DefaultConfig(cfg, SIM_BUCKET);
+	cfg->fullSpeed = pickStep(state, 50, 100, 5);
+	cfg->turnSpeed = pickStep(state, 0, cfg->fullSpeed, 5);
+	int fwd = pickStep(state, 20, 300, 10);
+	int hard = pickStep(state, fwd + 100, 1500, 10);
+	int t[TURN_THRESHOLDS] = {fwd, hard, 1800, 3600 - hard, 3600 - fwd};
+	memcpy(cfg->thresholds, t, sizeof(t));
+}
+
+static void samplePid(uint64_t *state, SimConfig *cfg) {
+	Sim_DefaultConfig(cfg, SIM_PID);
+	cfg->fullSpeed = pickStep(state, 50, 100, 5);
+	cfg->gains.baseDuty = cfg->fullSpeed;
+	cfg->gains.kp = exp(pick(state, log(0.05), log(2.0)));
+	cfg->gains.ki = pick(state, 0.0, 0.05);
+	cfg->gains.kd = pick(state, 0.0, 0.3);
+	cfg->gains.pivotDeg = pickStep(state, 45, 180, 5);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: runTask
+Function Description: Runs one chunk of one candidate's batch. PoolFn signature
+Input Parameters: wave - Wave, task - batch * chunks + chunk
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void runTask(void *wave, size_t task) {
+	Wave *w = wave;
+	Sim_RunChunk(&w->b[task / w->chunks], task % w->chunks);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: evaluate
+Function Description: Drives every candidate over the same count routes, as many candidates at a time as fit in
+                      TUNE_WAVE_ROVERS, each wave's chunks spread over the pool together
+Input Parameters: pool - threads, c - candidates, n - how many, count - rovers each, sp - simulation
+Output Parameters: Rover-seconds simulated, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+static double evaluate(Pool *pool, Candidate *c, size_t n, size_t count, const SimParams *sp) {
+	size_t per = TUNE_WAVE_ROVERS / count;
+	if (per < 1)
+		per = 1;
+	SimBatch *b = calloc(per, sizeof(*b));
+	if (!b)
+		return -1.0;
+
+	double roverSeconds = 0.0;
+	for (size_t first = 0; first < n; first += per) {
+		size_t m = n - first < per ? n - first : per;
+		for (size_t i = 0; i < m; i++) {
+			if (Sim_Init(&b[i], count, sp, &c[first + i].cfg) != 0) {
+				while (i--)
+					Sim_Free(&b[i]);
+				free(b);
+				return -1.0;
+			}
+		}
+		Wave w = {b, Sim_Chunks(&b[0])};
+		Pool_Run(pool, m * w.chunks, runTask, &w);
+		for (size_t i = 0; i < m; i++) {
+			Candidate *k = &c[first + i];
+			Sim_Summarise(&b[i], &k->s);
+			k->meanT = (k->s.meanArrive * k->s.arrived + sp->timeout * (k->s.rovers - k->s.arrived)) / k->s.rovers;
+			roverSeconds += k->s.roverSeconds;
+			Sim_Free(&b[i]);
+		}
+	}
+	free(b);
+	return roverSeconds;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: score
+Function Description: Costs each candidate as the weighted sum of its mean time, path over route length and
+                      reversals, each over the reference's, so the reference scores the sum of the weights
+Input Parameters: c - candidates, n - how many, ref - reference, wt, wp, wr - weights
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void score(Candidate *c, size_t n, const Candidate *ref, double wt, double wp, double wr) {
+	double t0 = ref->meanT > 0.0 ? ref->meanT : 1.0;
+	double p0 = ref->s.meanExcess > 0.0 ? ref->s.meanExcess : 1.0;
+	double r0 = ref->s.meanReversals + 1.0;
+	for (size_t i = 0; i < n; i++) {
+		double excess = c[i].s.arrived ? c[i].s.meanExcess : 2.0 * p0; //Nothing arrived, count a long way round
+		c[i].cost = wt * c[i].meanT / t0 + wp * excess / p0 + wr * (c[i].s.meanReversals + 1.0) / r0;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: byCost
+Function Description: qsort order, cheapest first
+Input Parameters: a, b - candidates
+Output Parameters: Comparison
+/---------------------------------------------------------------------------------------------------------*/
+static int byCost(const void *a, const void *b) {
+	double x = ((const Candidate *)a)->cost, y = ((const Candidate *)b)->cost;
+	return x < y ? -1 : x > y;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: describe
+Function Description: Writes a candidate's settings on one line
+Input Parameters: c - candidate, text - buffer, size - its size
+Output Parameters: text
+/---------------------------------------------------------------------------------------------------------*/
+static const char *describe(const Candidate *c, char *text, size_t size) {
+	const SimConfig *cfg = &c->cfg;
+	if (cfg->ctrl == SIM_BUCKET)
+		snprintf(text, size, "bucket full %3d turn %3d table %d/%d/%d/%d/%d", cfg->fullSpeed, cfg->turnSpeed,
+			cfg->thresholds[0], cfg->thresholds[1], cfg->thresholds[2], cfg->thresholds[3], cfg->thresholds[4]);
+	else
+		snprintf(text, size, "pid    full %3d kp %.3f ki %.4f kd %.3f pivot %.0f", cfg->fullSpeed, cfg->gains.kp,
+			cfg->gains.ki, cfg->gains.kd, cfg->gains.pivotDeg);
+	return text;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: printTable
+Function Description: Prints candidates in order with their results
+Input Parameters: c - candidates, n - how many to print
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void printTable(const Candidate *c, size_t n) {
+	char text[128];
+	printf("rank  cost   arrived  time (s)  path  reversals  settings\n");
+	for (size_t i = 0; i < n; i++)
+		printf("%4zu  %5.3f  %5.1f%%  %8.1f  %4.2fx  %9.1f  %s%s\n", i + 1, c[i].cost,
+			100.0 * c[i].s.arrived / c[i].s.rovers, c[i].meanT, c[i].s.meanExcess, c[i].s.meanReversals,
+			describe(&c[i], text, sizeof(text)), c[i].builtIn ? "  (built in)" : "");
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: usage
+Function Description: Prints the command line options
+Input Parameters: prog - program name
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void usage(const char *prog) {
+	printf("Usage: %s [options]\n"
+		"  -c pid|bucket|both  controllers to tune (default both)\n"
+		"  -n count     candidates drawn per controller (default 200)\n"
+		"  -N rovers    routes each candidate is screened on (default 256)\n"
+		"  -k count     finalists per controller re-run on fresh routes (default 8)\n"
+		"  -M rovers    routes each finalist is re-run on (default 2048)\n"
+		"  -T seconds   time limit per route (default 300)\n"
+		"  -W t,p,r     weights of arrival time, path length and wheel reversals (default 1,1,1)\n"
+		"  -j threads   pool size (default: one per core)\n"
+		"  -w count     waypoints per route (default 3, at most %d)\n"
+		"  -g log       measure the GPS jitter from this log's stationary stretches (default %s)\n"
+		"  -s seed      sweep and route seed (default 1)\n"
+		"  -o file      profile to write the best settings to (default %s)\n", prog, SIM_MAX_WPS,
+		SIM_LOG_DEFAULT, TUNE_PROFILE_DEFAULT);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Main
+Function Description: Screens the sweep, re-runs the best of each controller on fresh routes against the rover's
+                      own settings, ranks them and writes the winner as a profile
+Input Parameters: see usage()
+Output Parameters: 0 on success, 1 on bad options, an unusable log, no memory or an unwritable profile
+/---------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+	size_t draws = 200, screenN = 256, finalK = 8, finalN = 2048;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int tuneBucket = 1, tunePid = 1;
+	double wt = 1.0, wp = 1.0, wr = 1.0;
+	const char *log = SIM_LOG_DEFAULT, *out = TUNE_PROFILE_DEFAULT;
+	SimParams sp;
+	Sim_Defaults(&sp);
+	sp.timeout = 300.0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:n:N:k:M:T:W:j:w:g:s:o:")) != -1) {
+		switch (opt) {
+			case 'c':
+				tuneBucket = strcmp(optarg, "pid") != 0;
+				tunePid = strcmp(optarg, "bucket") != 0;
+				break;
+			case 'n': draws = strtoul(optarg, NULL, 10); break;
+			case 'N': screenN = strtoul(optarg, NULL, 10); break;
+			case 'k': finalK = strtoul(optarg, NULL, 10); break;
+			case 'M': finalN = strtoul(optarg, NULL, 10); break;
+			case 'T': sp.timeout = atof(optarg); break;
+			case 'W':
+				if (sscanf(optarg, "%lf,%lf,%lf", &wt, &wp, &wr) != 3 || wt < 0.0 || wp < 0.0 || wr < 0.0) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'j': threads = atoi(optarg); break;
+			case 'w': sp.wps = atoi(optarg); break;
+			case 'g': log = optarg; break;
+			case 's': sp.seed = strtoull(optarg, NULL, 10); break;
+			case 'o': out = optarg; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (screenN == 0 || finalN == 0 || finalK == 0 || sp.timeout <= 0.0 || sp.wps < 1 || sp.wps > SIM_MAX_WPS) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+	if (finalK > draws)
+		finalK = draws;
+
+	if (SimNoise_FromLog(log, &sp.noise) != 0) {
+		printf("No stationary stretch in %s to measure the GPS jitter from\n", log);
+		return 1;
+	}
+	printf("GPS: %.0f Hz, jitter %.2f m east %.2f m north, %.3f correlation per fix, %.1f%% repeated fixes\n",
+		sp.fixHz, sp.noise.sdE, sp.noise.sdN, sp.noise.rho, 100.0 * sp.noise.repeat);
+
+	//Candidate 0 is the rover as it runs with no profile and the reference for the costs, then the built-in turn
+	//table if that is being tuned, then the draws for each controller
+	int ctrls = tuneBucket + tunePid;
+	size_t refs = 1 + tuneBucket;
+	Candidate *c = calloc(refs + draws * ctrls, sizeof(*c));
+	Candidate *fin = calloc(refs + finalK * ctrls, sizeof(*fin));
+	Pool *pool = Pool_Create(threads);
+	if (!c || !fin || !pool) {
+		printf("Out of memory\n");
+		return 1;
+	}
+	for (size_t i = 0; i < refs; i++) {
+		Sim_DefaultConfig(&c[i].cfg, i == 0 ? SIM_PID : SIM_BUCKET);
+		c[i].builtIn = 1;
+	}
+	uint64_t seed = sp.seed, sweep = sp.seed ^ TUNE_SWEEP_SALT;
+	size_t n = refs;
+	for (size_t i = 0; i < draws; i++) {
+		if (tuneBucket)
+			sampleBucket(&sweep, &c[n++].cfg);
+		if (tunePid)
+			samplePid(&sweep, &c[n++].cfg);
+	}
+
+	//Screen everything on one set of routes
+	printf("Screening %zu candidates on %zu %d-waypoint routes each, %d threads\n", n, screenN, sp.wps,
+		Pool_Threads(pool));
+	double t0 = nowSec();
+	double simSec = evaluate(pool, c, n, screenN, &sp);
+	if (simSec < 0.0) {
+		printf("Out of memory\n");
+		return 1;
+	}
+	double wall = nowSec() - t0;
+	printf("  %.0f rover-s in %.1f s wall, %.0f rover-s per s\n", simSec, wall, simSec / wall);
+	score(c, n, &c[0], wt, wp, wr);
+
+	//Finalists: the references and the cheapest of each controller
+	size_t f;
+	for (f = 0; f < refs; f++)
+		fin[f] = c[f];
+	qsort(c + refs, n - refs, sizeof(*c), byCost);
+	size_t haveB = 0, haveP = 0;
+	for (size_t i = refs; i < n; i++) {
+		size_t *have = c[i].cfg.ctrl == SIM_BUCKET ? &haveB : &haveP;
+		if (*have < finalK) {
+			fin[f++] = c[i];
+			(*have)++;
+		}
+	}
+
+	//Re-run them on routes none of them was picked on, so the ranking isn't luck on the screening set
+	sp.seed++;
+	printf("Re-running %zu finalists on %zu fresh routes each\n", f, finalN);
+	t0 = nowSec();
+	simSec = evaluate(pool, fin, f, finalN, &sp);
+	if (simSec < 0.0) {
+		printf("Out of memory\n");
+		return 1;
+	}
+	wall = nowSec() - t0;
+	printf("  %.0f rover-s in %.1f s wall, %.0f rover-s per s\n", simSec, wall, simSec / wall);
+	score(fin, f, &fin[0], wt, wp, wr);
+	qsort(fin, f, sizeof(*fin), byCost);
+	printf("Weights %.2g time, %.2g path, %.2g reversals; %.2g is the rover's built-in settings\n", wt, wp, wr,
+		wt + wp + wr);
+	printTable(fin, f);
+
+	//Write the winner
+	const Candidate *best = &fin[0];
+	Profile prof;
+	Profile_Defaults(&prof);
+	prof.bucket = best->cfg.ctrl == SIM_BUCKET;
+	prof.fullSpeed = best->cfg.fullSpeed;
+	prof.turnSpeed = best->cfg.turnSpeed;
+	memcpy(prof.thresholds, best->cfg.thresholds, sizeof(prof.thresholds));
+	prof.gains = best->cfg.gains;
+	prof.gains.baseDuty = prof.fullSpeed;
+
+	char text[128], comment[512];
+	snprintf(comment, sizeof(comment), "Written by tools/tune.c: %s\n"
+		"Cost %.3f against %.3f built in, over %zu routes of %d waypoints (tune -s %llu)\n"
+		"Arrived %.1f%%, %.1f s, %.2fx the route, %.1f wheel reversals", describe(best, text, sizeof(text)),
+		best->cost, wt + wp + wr, finalN, sp.wps, (unsigned long long)seed, 100.0 * best->s.arrived / best->s.rovers,
+		best->meanT, best->s.meanExcess, best->s.meanReversals);
+	int rc = Profile_Save(out, &prof, comment);
+	if (rc != 0)
+		printf("Cannot write %s\n", out);
+	else if (best->builtIn)
+		printf("Nothing beat the built-in settings, wrote them to %s\n", out);
+	else
+		printf("Wrote %s, load it with rover -P %s\n", out, out);
+
+	Pool_Destroy(pool);
+	free(fin);
+	free(c);
+	return rc != 0;
+}
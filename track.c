@@ -0,0 +1,301 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: track.c
+Source Description: Delta/varint encoder and zero-copy mmap reader for the native binary track format
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "track.h"
+#include "crc32.h"
+
+#define HEADER_SIZE sizeof(TrackBlockHeader)
+#define MAX_POINT_BYTES 40  //Four varints of at most 10 bytes
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: toFixed / toCentiDeg
+Function Description: Converts degrees to the stored integer units
+Input Parameters: deg - value in degrees
+Output Parameters: 1e-7 degrees, or 0.01 degrees in [0, 36000)
+/---------------------------------------------------------------------------------------------------------*/
+static int32_t toFixed(double deg) {
+	return (int32_t)lround(deg * 1e7);
+}
+
+static int32_t toCentiDeg(double deg) {
+	if (!isfinite(deg))
+		return 0;
+	int32_t h = (int32_t)(lround(deg * 100.0) % 36000);
+	return h < 0 ? h + 36000 : h;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: zigzag / unzigzag
+Function Description: Maps signed deltas onto unsigned values so small magnitudes give short varints
+Input Parameters: v - value to map
+Output Parameters: Mapped value
+/---------------------------------------------------------------------------------------------------------*/
+static uint64_t zigzag(int64_t v) {
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: putVarint
+Function Description: Writes 7 bits per byte, high bit set on every byte but the last
+Input Parameters: p - output position, v - value
+Output Parameters: Position after the varint
+/---------------------------------------------------------------------------------------------------------*/
+static uint8_t *putVarint(uint8_t *p, uint64_t v) {
+	while (v >= 0x80) {
+		*p++ = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: getVarint
+Function Description: Reads a varint, refusing to run past end
+Input Parameters: p - input position, end - end of payload, v - decoded value
+Output Parameters: Position after the varint, NULL if truncated
+/---------------------------------------------------------------------------------------------------------*/
+static const uint8_t *getVarint(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+	uint64_t result = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7) {
+		uint8_t byte = *p++;
+		result |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			*v = result;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: headerCrc
+Function Description: CRC over the first point held in the header and the payload
+Input Parameters: h - block header, payload - encoded points
+Output Parameters: CRC-32
+/---------------------------------------------------------------------------------------------------------*/
+static uint32_t headerCrc(const TrackBlockHeader *h, const uint8_t *payload) {
+	uint32_t crc = Crc32(0, &h->lat0, HEADER_SIZE - offsetof(TrackBlockHeader, lat0));
+	return Crc32(crc, payload, h->payloadLen);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_BlockInit
+Function Description: Starts an empty block, leaving room for the header
+Input Parameters: b - encoder state, buf - block buffer, cap - buffer size
+Output Parameters: 0 on success, -1 if the buffer can't hold a header and one point
+/---------------------------------------------------------------------------------------------------------*/
+int Track_BlockInit(TrackBlock *b, uint8_t *buf, size_t cap) {
+	if (cap < HEADER_SIZE + MAX_POINT_BYTES)
+		return -1;
+	memset(b, 0, sizeof(*b));
+	b->buf = buf;
+	b->cap = cap;
+	b->len = HEADER_SIZE;
+	memset(buf, 0, HEADER_SIZE);
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_BlockAppend
+Function Description: Stores the first point of a block in the header and every later point as deltas
+Input Parameters: b - encoder state, pt - point to append
+Output Parameters: 0 on success, -1 if the block has no room left
+/---------------------------------------------------------------------------------------------------------*/
+int Track_BlockAppend(TrackBlock *b, const TrackPoint *pt) {
+	int32_t lat = toFixed(pt->lat);
+	int32_t lon = toFixed(pt->lon);
+	int32_t head = toCentiDeg(pt->head);
+	uint32_t fix = (uint32_t)pt->fixState & 3;
+
+	if (b->count == 0) {
+		TrackBlockHeader *h = (TrackBlockHeader *)b->buf;
+		h->lat0 = lat;
+		h->lon0 = lon;
+		h->time0 = pt->timeMs;
+		h->head0 = (uint16_t)head;
+		h->fix0 = (uint8_t)fix;
+	} else {
+		if (b->len + MAX_POINT_BYTES > b->cap)
+			return -1;
+
+		int32_t dHead = head - b->head;
+		if (dHead >= 18000)
+			dHead -= 36000;
+		else if (dHead < -18000)
+			dHead += 36000;
+
+		uint8_t *p = b->buf + b->len;
+		p = putVarint(p, zigzag((int64_t)lat - b->lat));
+		p = putVarint(p, zigzag((int64_t)lon - b->lon));
+		p = putVarint(p, zigzag(dHead));
+		p = putVarint(p, (zigzag((int64_t)pt->timeMs - b->time) << 2) | fix);
+		b->len = (size_t)(p - b->buf);
+	}
+
+	b->lat = lat;
+	b->lon = lon;
+	b->head = head;
+	b->time = pt->timeMs;
+	b->count++;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_BlockFinish
+Function Description: Completes the header. Can be called repeatedly as a block grows
+Input Parameters: b - encoder state, blockSize - distance to the next block (0 to use the encoded length)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Track_BlockFinish(TrackBlock *b, uint32_t blockSize) {
+	TrackBlockHeader *h = (TrackBlockHeader *)b->buf;
+	h->magic = TRACK_MAGIC;
+	h->version = TRACK_VERSION;
+	h->headerSize = HEADER_SIZE;
+	h->blockSize = blockSize ? blockSize : (uint32_t)b->len;
+	h->payloadLen = (uint32_t)(b->len - HEADER_SIZE);
+	h->count = b->count;
+	h->crc = headerCrc(h, b->buf + HEADER_SIZE);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_Open
+Function Description: Maps a file read-only and tells the kernel it will be read front to back. The mapping keeps
+                      the file open, so the descriptor is closed straight away and many files can be mapped at once
+Input Parameters: f - mapping to fill, path - file to open
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int Track_Open(TrackFile *f, const char *path) {
+	struct stat st;
+
+	f->base = NULL;
+	f->size = 0;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	f->size = (size_t)st.st_size;
+	void *m = f->size ? mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
+	if (m == MAP_FAILED)
+		return -1;
+	if (!m)
+		return 0;
+	//Advice values are not flags, so each is its own call. Either may be refused, which only costs read-ahead
+	(void)madvise(m, f->size, MADV_SEQUENTIAL);
+	(void)madvise(m, f->size, MADV_WILLNEED);
+	f->base = m;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_Close
+Function Description: Unmaps a track file
+Input Parameters: f - mapping to release
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Track_Close(TrackFile *f) {
+	if (f->base)
+		munmap((void *)f->base, f->size);
+	f->base = NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_Begin
+Function Description: Positions an iterator before the first point
+Input Parameters: f - mapped track, it - iterator to reset
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void Track_Begin(const TrackFile *f, TrackIter *it) {
+	memset(it, 0, sizeof(*it));
+	it->file = f;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: loadBlock
+Function Description: Validates the next block header and payload and loads its first point
+Input Parameters: it - iterator
+Output Parameters: 1 if a block was loaded, 0 at end of file, -1 on corruption
+/---------------------------------------------------------------------------------------------------------*/
+static int loadBlock(TrackIter *it) {
+	const TrackFile *f = it->file;
+	TrackBlockHeader h;
+
+	if (it->next + HEADER_SIZE > f->size)
+		return 0;
+	memcpy(&h, f->base + it->next, HEADER_SIZE);
+	if (h.magic != TRACK_MAGIC || h.headerSize < HEADER_SIZE || h.blockSize < HEADER_SIZE)
+		return h.magic == 0 ? 0 : -1; //Zero magic is unwritten preallocated space
+	if (it->next + h.headerSize + h.payloadLen > f->size)
+		return -1;
+
+	const uint8_t *payload = f->base + it->next + h.headerSize;
+	if (headerCrc(&h, payload) != h.crc)
+		return -1;
+
+	it->p = payload;
+	it->end = payload + h.payloadLen;
+	it->left = h.count;
+	it->lat = h.lat0;
+	it->lon = h.lon0;
+	it->time = h.time0;
+	it->head = h.head0;
+	it->fix = h.fix0;
+	it->pending = 1;
+	it->next += h.blockSize;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: Track_Next
+Function Description: Decodes the next point straight out of the mapping
+Input Parameters: it - iterator, out - point to fill
+Output Parameters: 1 if a point was returned, 0 at the end, -1 if the file is corrupt
+/---------------------------------------------------------------------------------------------------------*/
+int Track_Next(TrackIter *it, TrackPoint *out) {
+	while (it->left == 0) {
+		int rc = loadBlock(it);
+		if (rc <= 0)
+			return rc;
+	}
+
+	if (it->pending) {
+		it->pending = 0;
+	} else {
+		uint64_t dLat, dLon, dHead, dTime;
+		const uint8_t *p = it->p;
+		if (!(p = getVarint(p, it->end, &dLat)) || !(p = getVarint(p, it->end, &dLon)) ||
+			!(p = getVarint(p, it->end, &dHead)) || !(p = getVarint(p, it->end, &dTime)))
+			return -1;
+		it->p = p;
+		it->lat += (int32_t)unzigzag(dLat);
+		it->lon += (int32_t)unzigzag(dLon);
+		it->head = (it->head + (int32_t)unzigzag(dHead) + 36000) % 36000;
+		it->time += (uint32_t)unzigzag(dTime >> 2);
+		it->fix = (int)(dTime & 3);
+	}
+	it->left--;
+
+	out->lat = it->lat * 1e-7;
+	out->lon = it->lon * 1e-7;
+	out->head = it->head * 0.01;
+	out->timeMs = it->time;
+	out->fixState = it->fix;
+	return 1;
+}
@@ -0,0 +1,96 @@
+#ifndef TRACK_h_
+#define TRACK_h_
+
+#include <stdint.h>
+#include <stddef.h>
+
+  /* Native binary track format (.trk)
+
+    A file is a sequence of blocks. Every block starts with a TrackBlockHeader holding the first point in full,
+    followed by count-1 points stored as deltas from the previous point:
+
+      varint zigzag(dLat)                    1e-7 degree units
+      varint zigzag(dLon)                    1e-7 degree units
+      varint zigzag(dHead)                   0.01 degree units, wrapped to [-180, 180)
+      varint zigzag(dTime) << 2 | fixState   ms, fix state in the low two bits
+
+    All integers are little-endian. blockSize is the distance to the next header, so a writer may pad a block
+    (the logger keeps blocks page aligned) and a reader may hop from block to block without decoding points.
+   */
+
+#define TRACK_MAGIC   0x4B525452u   //"RTRK"
+#define TRACK_VERSION 1
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;
+	uint32_t blockSize;     //Bytes from this header to the next one
+	uint32_t payloadLen;    //Bytes of delta encoded points after the header
+	uint32_t count;         //Points in this block, including the one in the header
+	uint32_t crc;           //CRC-32 of the payload
+	int32_t lat0;           //First point latitude (1e-7 degrees)
+	int32_t lon0;           //First point longitude (1e-7 degrees)
+	uint32_t time0;         //First point GPS time of day (ms)
+	uint16_t head0;         //First point heading (0.01 degrees)
+	uint8_t fix0;           //First point fix state
+	uint8_t reserved;
+} TrackBlockHeader;
+
+//One decoded track point
+typedef struct {
+	double lat;         //Latitude (degrees)
+	double lon;         //Longitude (degrees)
+	double head;        //Heading (degrees)
+	uint32_t timeMs;    //GPS time of day (ms since UTC midnight)
+	int fixState;       //Position fix state
+} TrackPoint;
+
+//Encoder state for one block being filled in memory
+typedef struct {
+	uint8_t *buf;       //Block buffer, header included
+	size_t cap;         //Buffer capacity
+	size_t len;         //Bytes used, header included
+	uint32_t count;
+	int32_t lat, lon;   //Previous point, fixed point
+	uint32_t time;
+	int32_t head;
+} TrackBlock;
+
+//Read-only mapping of a file, the descriptor is closed once mapped
+typedef struct {
+	const uint8_t *base;
+	size_t size;
+} TrackFile;
+
+//Iterator over the points of a mapped track
+typedef struct {
+	const TrackFile *file;
+	size_t next;                //Offset of the next block header
+	const uint8_t *p, *end;     //Payload still to decode in the current block
+	uint32_t left;              //Points still to return from the current block
+	int32_t lat, lon;
+	uint32_t time;
+	int32_t head;
+	int fix;
+	int pending;                //Header point not yet returned
+} TrackIter;
+
+//Start a new block in buf. Returns -1 if cap can't hold a header
+int Track_BlockInit(TrackBlock *b, uint8_t *buf, size_t cap);
+
+//Append a point. Returns 0 on success, -1 if the block is full
+int Track_BlockAppend(TrackBlock *b, const TrackPoint *pt);
+
+//Fill in the header (count, length and CRC) so the first b->len bytes can be written out
+void Track_BlockFinish(TrackBlock *b, uint32_t blockSize);
+
+//Map a track file, or any file read front to back, for reading
+int Track_Open(TrackFile *f, const char *path);
+void Track_Close(TrackFile *f);
+
+//Iterate every point in a mapped track. Track_Next returns 1 for a point, 0 at the end and -1 on corruption
+void Track_Begin(const TrackFile *f, TrackIter *it);
+int Track_Next(TrackIter *it, TrackPoint *out);
+
+#endif
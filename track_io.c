@@ -0,0 +1,367 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: track_io.c
+Source Description: Loads and saves tracks as CSV logs, GPX files or native binary tracks
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "track_io.h"
+#include "fmt.h"
+
+#define TRK_BLOCK_SIZE 4096 //Block size used when converting to a track file
+#define GPX_WINDOW 65536    //GPX text read at a time
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Format
+Function Description: Picks the file format from the extension
+Input Parameters: path - file name
+Output Parameters: Track format
+/---------------------------------------------------------------------------------------------------------*/
+TrackFormat TrackIO_Format(const char *path) {
+	const char *dot = strrchr(path, '.');
+	if (dot && strcmp(dot, ".gpx") == 0)
+		return FMT_GPX;
+	if (dot && strcmp(dot, ".trk") == 0)
+		return FMT_TRK;
+	return FMT_CSV;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Append
+Function Description: Adds a point, doubling the array when it fills
+Input Parameters: list - list to grow, pt - point to add
+Output Parameters: 0 on success, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Append(TrackList *list, const TrackPoint *pt) {
+	if (list->count == list->cap) {
+		size_t cap = list->cap ? list->cap * 2 : 1024;
+		TrackPoint *pts = realloc(list->pts, cap * sizeof(TrackPoint));
+		if (!pts)
+			return -1;
+		list->pts = pts;
+		list->cap = cap;
+	}
+	list->pts[list->count++] = *pt;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Free
+Function Description: Releases a list
+Input Parameters: list - list to empty
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackIO_Free(TrackList *list) {
+	free(list->pts);
+	list->pts = NULL;
+	list->count = list->cap = 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: readCSV
+Function Description: Reads the next "lat,lon[,head,timeMs,fixState]" row. Header rows and anything else that
+                      does not start with two numbers are skipped. Missing columns default to heading 0, time 0
+                      and a fix
+Input Parameters: r - reader, pt - point out
+Output Parameters: 1 for a point, 0 at the end of the file
+/---------------------------------------------------------------------------------------------------------*/
+static int readCSV(TrackReader *r, TrackPoint *pt) {
+	char line[256];
+
+	while (fgets(line, sizeof(line), r->fp)) {
+		TrackPoint p = {0.0, 0.0, 0.0, 0, 1};
+		unsigned long timeMs = 0;
+		int n = sscanf(line, "%lf ,%lf ,%lf ,%lu ,%d", &p.lat, &p.lon, &p.head, &timeMs, &p.fixState);
+		if (n < 2)
+			continue;
+		p.timeMs = (uint32_t)timeMs;
+		*pt = p;
+		return 1;
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: attrValue
+Function Description: Finds name="value" inside a tag and parses the value as a number
+Input Parameters: tag - start of the tag, tagEnd - end of the tag, name - attribute name with '=', out - value
+Output Parameters: 1 if found, 0 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+static int attrValue(const char *tag, const char *tagEnd, const char *name, double *out) {
+	size_t len = strlen(name);
+	for (const char *p = tag; p + len < tagEnd; p++) {
+		if ((p == tag || p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\n') && strncmp(p, name, len) == 0) {
+			p += len;
+			if (*p == '"' || *p == '\'')
+				p++;
+			*out = strtod(p, NULL);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: fillGPX
+Function Description: Moves the unread text to the start of the window and reads more after it, doubling the
+                      window if one tag fills it
+Input Parameters: r - reader
+Output Parameters: Bytes read, 0 at the end of the file, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+static long fillGPX(TrackReader *r) {
+	memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+	r->len -= r->pos;
+	r->pos = 0;
+	if (r->len + 1 >= r->cap) {
+		char *buf = realloc(r->buf, r->cap * 2);
+		if (!buf)
+			return -1;
+		r->buf = buf;
+		r->cap *= 2;
+	}
+	size_t got = fread(r->buf + r->len, 1, r->cap - 1 - r->len, r->fp);
+	r->len += got;
+	r->buf[r->len] = '\0';
+	return (long)got;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: readGPX
+Function Description: Returns the lat/lon attributes of the next wpt, rtept or trkpt element, in file order.
+                      Extension elements (such as GDAL's duplicated ogr:lat/ogr:lon) are ignored
+Input Parameters: r - reader, pt - point out
+Output Parameters: 1 for a point, 0 at the end of the file, -1 if out of memory
+/---------------------------------------------------------------------------------------------------------*/
+static int readGPX(TrackReader *r, TrackPoint *pt) {
+	for (;;) {
+		char *lt = memchr(r->buf + r->pos, '<', r->len - r->pos);
+		char *gt = lt ? memchr(lt, '>', r->len - (size_t)(lt - r->buf)) : NULL;
+		if (!gt) {
+			//Keep a partial tag for the next read
+			r->pos = lt ? (size_t)(lt - r->buf) : r->len;
+			long got = fillGPX(r);
+			if (got <= 0)
+				return (int)got;
+			continue;
+		}
+		r->pos = (size_t)(gt - r->buf) + 1;
+		if (strncmp(lt, "<wpt", 4) != 0 && strncmp(lt, "<rtept", 6) != 0 && strncmp(lt, "<trkpt", 6) != 0)
+			continue;
+
+		TrackPoint p = {0.0, 0.0, 0.0, 0, 1};
+		if (attrValue(lt, gt, "lat=", &p.lat) && attrValue(lt, gt, "lon=", &p.lon)) {
+			*pt = p;
+			return 1;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_OpenRead
+Function Description: Opens a track of any format for reading one point at a time. Track files are mapped and
+                      decoded block by block, text files are read in small pieces, so memory use does not grow
+                      with the file
+Input Parameters: r - reader, path - file name
+Output Parameters: 0 on success, -1 if the file can't be opened
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_OpenRead(TrackReader *r, const char *path) {
+	memset(r, 0, sizeof(*r));
+	r->fmt = TrackIO_Format(path);
+	if (r->fmt == FMT_TRK) {
+		if (Track_Open(&r->file, path) != 0)
+			return -1;
+		Track_Begin(&r->file, &r->it);
+		return 0;
+	}
+
+	r->fp = fopen(path, "r");
+	if (!r->fp)
+		return -1;
+	if (r->fmt == FMT_GPX) {
+		r->cap = GPX_WINDOW;
+		r->buf = malloc(r->cap);
+		if (!r->buf) {
+			fclose(r->fp);
+			return -1;
+		}
+		r->buf[0] = '\0';
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Read
+Function Description: Reads the next point
+Input Parameters: r - reader, pt - point out
+Output Parameters: 1 for a point, 0 at the end, -1 on corruption or out of memory
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Read(TrackReader *r, TrackPoint *pt) {
+	if (r->fmt == FMT_TRK)
+		return Track_Next(&r->it, pt);
+	return r->fmt == FMT_GPX ? readGPX(r, pt) : readCSV(r, pt);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_CloseRead
+Function Description: Closes a reader
+Input Parameters: r - reader
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackIO_CloseRead(TrackReader *r) {
+	if (r->fmt == FMT_TRK)
+		Track_Close(&r->file);
+	else if (r->fp)
+		fclose(r->fp);
+	free(r->buf);
+	r->buf = NULL;
+	r->fp = NULL;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Load
+Function Description: Loads a track in whichever format its extension names
+Input Parameters: path - file name, list - list to append to
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Load(const char *path, TrackList *list) {
+	TrackReader r;
+	TrackPoint pt;
+	int rc;
+
+	if (TrackIO_OpenRead(&r, path) != 0)
+		return -1;
+	while ((rc = TrackIO_Read(&r, &pt)) > 0) {
+		if (TrackIO_Append(list, &pt) != 0) {
+			rc = -1;
+			break;
+		}
+	}
+	TrackIO_CloseRead(&r);
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Create
+Function Description: Creates a file for writing one point at a time and writes any header. CSV output matches
+                      the rover log unless full is set
+Input Parameters: w - writer, path - file name, full - CSV with heading, time and fix state columns
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Create(TrackWriter *w, const char *path, int full) {
+	memset(w, 0, sizeof(*w));
+	w->fmt = TrackIO_Format(path);
+	w->full = full;
+	w->fp = fopen(path, w->fmt == FMT_TRK ? "wb" : "w");
+	if (!w->fp)
+		return -1;
+
+	if (w->fmt == FMT_TRK) {
+		w->buf = malloc(TRK_BLOCK_SIZE);
+		if (!w->buf) {
+			fclose(w->fp);
+			return -1;
+		}
+		Track_BlockInit(&w->block, w->buf, TRK_BLOCK_SIZE);
+	} else if (w->fmt == FMT_GPX) {
+		fprintf(w->fp, "<?xml version=\"1.0\"?>\n<gpx version=\"1.1\" creator=\"ROCO318\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n<trk><trkseg>\n");
+	} else {
+		fprintf(w->fp, full ? "lat,lon,head,time_ms,fix\n" : "lat,lon\n");
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: flushBlock
+Function Description: Writes the track block being filled as a compact (unpadded) block
+Input Parameters: w - writer
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void flushBlock(TrackWriter *w) {
+	if (w->block.count == 0)
+		return;
+	Track_BlockFinish(&w->block, 0);
+	if (fwrite(w->buf, 1, w->block.len, w->fp) != w->block.len)
+		w->err = 1;
+	Track_BlockInit(&w->block, w->buf, TRK_BLOCK_SIZE);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Write
+Function Description: Writes the next point
+Input Parameters: w - writer, pt - point
+Output Parameters: 0 on success, -1 on write failure
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Write(TrackWriter *w, const TrackPoint *pt) {
+	if (w->fmt == FMT_TRK) {
+		if (Track_BlockAppend(&w->block, pt) != 0) {
+			flushBlock(w);
+			Track_BlockAppend(&w->block, pt);
+		}
+	} else {
+		char line[3 * FMT_DOUBLE_MAX + 2 * FMT_INT_MAX + 32];
+		char *e;
+		if (w->fmt == FMT_GPX) { //"<trkpt lat=\"%.7f\" lon=\"%.7f\"/>\n"
+			e = Fmt_Str(line, "<trkpt lat=\"");
+			e = Fmt_Double(e, pt->lat, 0, 7);
+			e = Fmt_Str(e, "\" lon=\"");
+			e = Fmt_Double(e, pt->lon, 0, 7);
+			e = Fmt_Str(e, "\"/>\n");
+		} else { //"%9.7f,%9.7f,%.2f,%u,%d\n", or the first two columns
+			e = Fmt_Double(line, pt->lat, 9, 7);
+			*e++ = ',';
+			e = Fmt_Double(e, pt->lon, 9, 7);
+			if (w->full) {
+				*e++ = ',';
+				e = Fmt_Double(e, pt->head, 0, 2);
+				*e++ = ',';
+				e = Fmt_Int(e, (long)pt->timeMs);
+				*e++ = ',';
+				e = Fmt_Int(e, pt->fixState);
+			}
+			*e++ = '\n';
+		}
+		if (fwrite(line, 1, (size_t)(e - line), w->fp) != (size_t)(e - line))
+			w->err = 1;
+	}
+	w->count++;
+	return w->err ? -1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Finish
+Function Description: Writes the last block or the GPX footer and closes the file
+Input Parameters: w - writer
+Output Parameters: 0 on success, -1 if any write failed
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Finish(TrackWriter *w) {
+	if (w->fmt == FMT_TRK)
+		flushBlock(w);
+	else if (w->fmt == FMT_GPX)
+		fprintf(w->fp, "</trkseg></trk>\n</gpx>\n");
+
+	int rc = w->err ? -1 : 0;
+	if (ferror(w->fp))
+		rc = -1;
+	if (fclose(w->fp) != 0)
+		rc = -1;
+	free(w->buf);
+	w->buf = NULL;
+	w->fp = NULL;
+	return rc;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackIO_Save
+Function Description: Saves points in whichever format the extension names. CSV output matches the rover log
+Input Parameters: path - file name, pts, n - points to write
+Output Parameters: 0 on success, -1 on failure
+/---------------------------------------------------------------------------------------------------------*/
+int TrackIO_Save(const char *path, const TrackPoint *pts, size_t n) {
+	TrackWriter w;
+	if (TrackIO_Create(&w, path, 0) != 0)
+		return -1;
+	for (size_t i = 0; i < n; i++)
+		TrackIO_Write(&w, &pts[i]);
+	return TrackIO_Finish(&w);
+}
@@ -0,0 +1,70 @@
+#ifndef TRACK_IO_h_
+#define TRACK_IO_h_
+
+#include <stdio.h>
+#include <stddef.h>
+#include "track.h"
+
+//Growable array of track points
+typedef struct {
+	TrackPoint *pts;
+	size_t count;
+	size_t cap;
+} TrackList;
+
+//File formats, picked from the file extension
+typedef enum {FMT_CSV = 0, FMT_GPX = 1, FMT_TRK = 2} TrackFormat;
+
+//Streaming reader, holds one point (CSV), a 64 KiB window (GPX) or a file mapping (track) at a time
+typedef struct {
+	TrackFormat fmt;
+	FILE *fp;
+	TrackFile file;
+	TrackIter it;
+	char *buf;          //GPX text window
+	size_t len, pos, cap;
+} TrackReader;
+
+//Streaming writer
+typedef struct {
+	TrackFormat fmt;
+	FILE *fp;
+	int full;           //CSV: heading, time and fix state columns as well as position
+	uint8_t *buf;       //Track block being filled
+	TrackBlock block;
+	size_t count;
+	int err;
+} TrackWriter;
+
+//Format implied by a file name (.gpx, .trk, anything else is CSV)
+TrackFormat TrackIO_Format(const char *path);
+
+//Add a point to a list. Returns -1 if out of memory
+int TrackIO_Append(TrackList *list, const TrackPoint *pt);
+
+//Load every point of a CSV, GPX or track file. Returns -1 if the file can't be read
+int TrackIO_Load(const char *path, TrackList *list);
+
+//Write points as CSV, GPX or a track file. Returns -1 on write failure
+int TrackIO_Save(const char *path, const TrackPoint *pts, size_t n);
+
+//Release a list
+void TrackIO_Free(TrackList *list);
+
+//Open a file of any format for reading point by point. Returns -1 if it can't be opened
+int TrackIO_OpenRead(TrackReader *r, const char *path);
+
+//Read the next point. Returns 1 for a point, 0 at the end, -1 on error
+int TrackIO_Read(TrackReader *r, TrackPoint *pt);
+void TrackIO_CloseRead(TrackReader *r);
+
+//Create a file of any format to write point by point. full - CSV keeps heading, time and fix state
+int TrackIO_Create(TrackWriter *w, const char *path, int full);
+
+//Write the next point. Returns -1 on write failure
+int TrackIO_Write(TrackWriter *w, const TrackPoint *pt);
+
+//Flush and close. Returns -1 if any write failed
+int TrackIO_Finish(TrackWriter *w);
+
+#endif
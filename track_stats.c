@@ -0,0 +1,396 @@
+/*---------------------------------------------------------------------------------------------------------/
+Source Name: track_stats.c
+Source Description: Mergeable summary statistics of GPS logs (distance, speed, heading, position spread and
+                    bounds) and a fast CSV row parser to feed them
+/---------------------------------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "track_stats.h"
+#include "geodesy.h"
+
+#define DAY_MS 86400000ll
+#define MAX_DIGITS 19       //Digits that fit in the 64-bit mantissa accumulator
+#define RAD_PER_DEG (GEO_PI / 180.0)
+#define STATS_BATCH 256     //Points parsed before their steps are computed together
+
+static const double pow10tab[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+	1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+//Parsed points waiting for the batch geodesy functions
+typedef struct {
+	TrackPoint pts[STATS_BATCH];
+	uint8_t headed[STATS_BATCH];
+	double lat1[STATS_BATCH], lon1[STATS_BATCH], lat2[STATS_BATCH], lon2[STATS_BATCH];
+	double dist[STATS_BATCH];
+	size_t count;
+} StatsBatch;
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sumAdd
+Function Description: Adds to a compensated (Neumaier) sum
+Input Parameters: s - sum, x - value
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sumAdd(StatSum *s, double x) {
+	double t = s->sum + x;
+	if (fabs(s->sum) >= fabs(x))
+		s->comp += (s->sum - t) + x;
+	else
+		s->comp += (x - t) + s->sum;
+	s->sum = t;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: sumMerge
+Function Description: Adds one compensated sum to another
+Input Parameters: a - sum to add to, b - sum to add
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void sumMerge(StatSum *a, const StatSum *b) {
+	sumAdd(a, b->sum);
+	a->comp += b->comp;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_Sum
+Function Description: Value of a compensated sum
+Input Parameters: s - sum
+Output Parameters: Sum
+/---------------------------------------------------------------------------------------------------------*/
+double TrackStats_Sum(const StatSum *s) {
+	return s->sum + s->comp;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_Init
+Function Description: Empty statistics
+Input Parameters: s - statistics, rateHz - fix rate assumed for logs without GPS time
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackStats_Init(TrackStats *s, double rateHz) {
+	memset(s, 0, sizeof(*s));
+	s->rateHz = rateHz;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: accumulateStep
+Function Description: Adds the step between two consecutive points: distance, time (from GPS time when both points
+                      have it, otherwise one fix period), speed and course over ground
+Input Parameters: s - statistics, a, b - consecutive points, d - haversine distance (m), lonScale - cosine of the
+                  latitude, for the course over ground
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void accumulateStep(TrackStats *s, const TrackPoint *a, const TrackPoint *b, double d, double lonScale) {
+	double dt = 1.0 / s->rateHz;
+
+	if (a->timeMs && b->timeMs) {
+		long long dtMs = (long long)b->timeMs - (long long)a->timeMs;
+		if (dtMs < -DAY_MS / 2)
+			dtMs += DAY_MS; //Past midnight
+		if (dtMs > 0) {
+			dt = dtMs / 1000.0;
+			s->timedSteps++;
+		}
+	}
+
+	double speed = d / dt;
+	//Compared before the cast, a glitch can be fast enough to overflow an int
+	s->speedHist[speed < STATS_SPEED_TOP ? (int)(speed / STATS_SPEED_STEP) : STATS_SPEED_BINS - 1]++;
+	if (speed > s->maxSpeed)
+		s->maxSpeed = speed;
+	sumAdd(&s->distance, d);
+	sumAdd(&s->seconds, dt);
+	s->steps++;
+
+	if (d >= STATS_COG_MIN_M) {
+		//Only the direction is needed, and over one step a flat east-north frame gives it to well under 0.01 degrees
+		double dLon = b->lon - a->lon;
+		if (dLon > 180.0)
+			dLon -= 360.0;
+		else if (dLon < -180.0)
+			dLon += 360.0;
+		double e = dLon * lonScale, n = b->lat - a->lat, r = sqrt(e * e + n * n);
+		sumAdd(&s->cogSin, e / r);
+		sumAdd(&s->cogCos, n / r);
+		s->courses++;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: addStep
+Function Description: Adds the step between two consecutive points with the scalar geodesy functions
+Input Parameters: s - statistics, a, b - consecutive points
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void addStep(TrackStats *s, const TrackPoint *a, const TrackPoint *b) {
+	accumulateStep(s, a, b, Geo_Distance(a->lat, a->lon, b->lat, b->lon), cos(a->lat * RAD_PER_DEG));
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: addPoint
+Function Description: Adds a point's position moments, bounds and heading, but not the step to it
+Input Parameters: s - statistics, pt - point, haveHead - the row had a heading column
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void addPoint(TrackStats *s, const TrackPoint *pt, int haveHead) {
+	if (s->points == 0) {
+		s->first = *pt;
+		s->minLat = s->maxLat = pt->lat;
+		s->minLon = s->maxLon = pt->lon;
+	}
+	s->last = *pt;
+
+	//Welford
+	double n = (double)++s->points;
+	double dLat = pt->lat - s->meanLat, dLon = pt->lon - s->meanLon;
+	s->meanLat += dLat / n;
+	s->meanLon += dLon / n;
+	s->m2Lat += dLat * (pt->lat - s->meanLat);
+	s->m2Lon += dLon * (pt->lon - s->meanLon);
+
+	if (pt->lat < s->minLat) s->minLat = pt->lat;
+	if (pt->lat > s->maxLat) s->maxLat = pt->lat;
+	if (pt->lon < s->minLon) s->minLon = pt->lon;
+	if (pt->lon > s->maxLon) s->maxLon = pt->lon;
+
+	if (haveHead) {
+		sumAdd(&s->headSin, sin(pt->head * RAD_PER_DEG));
+		sumAdd(&s->headCos, cos(pt->head * RAD_PER_DEG));
+		s->headings++;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_Add
+Function Description: Adds the next point
+Input Parameters: s - statistics, pt - point, haveHead - the row had a heading column
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackStats_Add(TrackStats *s, const TrackPoint *pt, int haveHead) {
+	if (s->points > 0)
+		addStep(s, &s->last, pt);
+	addPoint(s, pt, haveHead);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: addBatch
+Function Description: Adds a run of points, with the step distances worked out by the SIMD batch haversine
+Input Parameters: s - statistics, b - parsed points
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+static void addBatch(TrackStats *s, StatsBatch *b) {
+	TrackPoint prev = s->last;
+	size_t i0 = 0, m = 0;
+
+	if (s->points == 0 && b->count > 0) {
+		addPoint(s, &b->pts[0], b->headed[0]);
+		prev = b->pts[0];
+		i0 = 1;
+	}
+	for (size_t i = i0; i < b->count; i++, m++) {
+		b->lat1[m] = i == i0 ? prev.lat : b->pts[i - 1].lat;
+		b->lon1[m] = i == i0 ? prev.lon : b->pts[i - 1].lon;
+		b->lat2[m] = b->pts[i].lat;
+		b->lon2[m] = b->pts[i].lon;
+	}
+	Geo_DistanceBatch(b->lat1, b->lon1, b->lat2, b->lon2, b->dist, m);
+
+	//The batch spans a few hundred fixes, so one longitude scale serves all of it
+	double lonScale = cos(prev.lat * RAD_PER_DEG);
+	for (size_t i = i0, j = 0; i < b->count; i++, j++) {
+		accumulateStep(s, i == i0 ? &prev : &b->pts[i - 1], &b->pts[i], b->dist[j], lonScale);
+		addPoint(s, &b->pts[i], b->headed[i]);
+	}
+	b->count = 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_Merge
+Function Description: Appends the statistics of b to a. Moments are combined with Chan's formula
+Input Parameters: a - statistics to extend, b - statistics to append, adjacent - b follows a in the same file
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackStats_Merge(TrackStats *a, const TrackStats *b, int adjacent) {
+	a->skipped += b->skipped;
+	if (b->points == 0)
+		return;
+	if (a->points == 0) {
+		uint64_t skipped = a->skipped;
+		double rateHz = a->rateHz;
+		*a = *b;
+		a->skipped = skipped;
+		a->rateHz = rateHz;
+		return;
+	}
+
+	if (adjacent)
+		addStep(a, &a->last, &b->first);
+
+	double na = (double)a->points, nb = (double)b->points, n = na + nb;
+	double dLat = b->meanLat - a->meanLat, dLon = b->meanLon - a->meanLon;
+	a->meanLat += dLat * nb / n;
+	a->meanLon += dLon * nb / n;
+	a->m2Lat += b->m2Lat + dLat * dLat * na * nb / n;
+	a->m2Lon += b->m2Lon + dLon * dLon * na * nb / n;
+	a->points += b->points;
+
+	if (b->minLat < a->minLat) a->minLat = b->minLat;
+	if (b->maxLat > a->maxLat) a->maxLat = b->maxLat;
+	if (b->minLon < a->minLon) a->minLon = b->minLon;
+	if (b->maxLon > a->maxLon) a->maxLon = b->maxLon;
+
+	a->steps += b->steps;
+	a->timedSteps += b->timedSteps;
+	sumMerge(&a->distance, &b->distance);
+	sumMerge(&a->seconds, &b->seconds);
+	if (b->maxSpeed > a->maxSpeed)
+		a->maxSpeed = b->maxSpeed;
+	for (int i = 0; i < STATS_SPEED_BINS; i++)
+		a->speedHist[i] += b->speedHist[i];
+
+	a->headings += b->headings;
+	a->courses += b->courses;
+	sumMerge(&a->headSin, &b->headSin);
+	sumMerge(&a->headCos, &b->headCos);
+	sumMerge(&a->cogSin, &b->cogSin);
+	sumMerge(&a->cogCos, &b->cogCos);
+	a->last = b->last;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_ParseDouble
+Function Description: Parses a decimal number to the same value as strtod. When there is no exponent and the
+                      digits, read as one integer, are at most 2^53, the mantissa and the power of ten are both
+                      exact doubles, so one division gives the correctly rounded value. Anything else is copied
+                      out and handed to strtod
+Input Parameters: p - text position, advanced past the number, end - end of the text, out - value
+Output Parameters: 1 if a number was read, 0 otherwise
+/---------------------------------------------------------------------------------------------------------*/
+int TrackStats_ParseDouble(const char **p, const char *end, double *out) {
+	const char *s = *p;
+	while (s < end && (*s == ' ' || *s == '\t'))
+		s++;
+	const char *start = s;
+
+	int neg = 0;
+	if (s < end && (*s == '-' || *s == '+'))
+		neg = (*s++ == '-');
+
+	uint64_t mant = 0;
+	const char *digits = s;
+	while (s < end && (unsigned)(*s - '0') < 10)
+		mant = mant * 10 + (uint64_t)(*s++ - '0');
+	long count = s - digits, frac = 0;
+	if (s < end && *s == '.') {
+		const char *f = ++s;
+		while (s < end && (unsigned)(*s - '0') < 10)
+			mant = mant * 10 + (uint64_t)(*s++ - '0');
+		frac = s - f;
+		count += frac;
+	}
+	if (count == 0)
+		return 0;
+
+	if (count > MAX_DIGITS || mant > (1ull << 53) || frac >= (long)(sizeof(pow10tab) / sizeof(pow10tab[0])) ||
+		(s < end && (*s == 'e' || *s == 'E'))) {
+		char buf[64];
+		size_t len = 0;
+		while (start + len < end && len < sizeof(buf) - 1 && start[len] && strchr("0123456789+-.eE", start[len]))
+			len++;
+		memcpy(buf, start, len);
+		buf[len] = '\0';
+		char *stop;
+		*out = strtod(buf, &stop);
+		*p = start + (stop - buf);
+		return 1;
+	}
+
+	double v = (double)mant / pow10tab[frac];
+	*out = neg ? -v : v;
+	*p = s;
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_ParseCSV
+Function Description: Reads rows with the same rules as TrackIO_Load: up to five comma separated numbers, rows
+                      without at least two are skipped, missing columns default to heading 0, time 0 and a fix
+Input Parameters: s - statistics to add to, text, len - rows
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackStats_ParseCSV(TrackStats *s, const char *text, size_t len) {
+	const char *p = text, *end = text + len;
+	StatsBatch b;
+
+	b.count = 0;
+	while (p < end) {
+		double v[5];
+		int n = 0;
+
+		while (n < 5 && TrackStats_ParseDouble(&p, end, &v[n])) {
+			n++;
+			while (p < end && (*p == ' ' || *p == '\t'))
+				p++;
+			if (p == end || *p != ',')
+				break;
+			p++;
+		}
+
+		if (n >= 2) {
+			TrackPoint *pt = &b.pts[b.count];
+			pt->lat = v[0];
+			pt->lon = v[1];
+			pt->head = n > 2 ? v[2] : 0.0;
+			pt->timeMs = n > 3 ? (uint32_t)v[3] : 0;
+			pt->fixState = n > 4 ? (int)v[4] : 1;
+			b.headed[b.count] = (n > 2);
+			if (++b.count == STATS_BATCH)
+				addBatch(s, &b);
+		}
+
+		//Usually already at the line end
+		const char *nl = (p < end && *p == '\n') ? p : (p < end ? memchr(p, '\n', (size_t)(end - p)) : NULL);
+		if (!nl)
+			nl = end;
+		if (n < 2) {
+			//Header or other text, but not a blank line
+			while (p < nl && (*p == ' ' || *p == '\t' || *p == '\r'))
+				p++;
+			s->skipped += (p < nl);
+		}
+		p = nl < end ? nl + 1 : end;
+	}
+	addBatch(s, &b);
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_SpeedPercentile
+Function Description: Speed below which a fraction of steps fall, taken from the histogram at the bin's upper edge.
+                      The last bin has no upper edge, so a percentile that lands there is reported as unbounded
+Input Parameters: s - statistics, frac - fraction (0 to 1)
+Output Parameters: Speed (m/s), INFINITY if it is STATS_SPEED_TOP or more
+/---------------------------------------------------------------------------------------------------------*/
+double TrackStats_SpeedPercentile(const TrackStats *s, double frac) {
+	uint64_t want = (uint64_t)ceil(frac * s->steps), seen = 0;
+	for (int i = 0; i < STATS_SPEED_BINS - 1; i++) {
+		seen += s->speedHist[i];
+		if (seen >= want)
+			return (i + 1) * STATS_SPEED_STEP;
+	}
+	return INFINITY;
+}
+
+/*---------------------------------------------------------------------------------------------------------/
+Function Name: TrackStats_Spread
+Function Description: Position standard deviations, scaled to metres at the mean latitude
+Input Parameters: s - statistics, sdE, sdN - standard deviations out (m)
+Output Parameters: N/A
+/---------------------------------------------------------------------------------------------------------*/
+void TrackStats_Spread(const TrackStats *s, double *sdE, double *sdN) {
+	double mPerDeg = GEO_EARTH_RADIUS * RAD_PER_DEG;
+	double n = s->points > 1 ? (double)(s->points - 1) : 1.0;
+	*sdN = sqrt(s->m2Lat / n) * mPerDeg;
+	*sdE = sqrt(s->m2Lon / n) * mPerDeg * cos(s->meanLat * RAD_PER_DEG);
+}
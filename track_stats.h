@@ -0,0 +1,70 @@
+#ifndef TRACK_STATS_h_
+#define TRACK_STATS_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "track.h"
+
+  /* Summary statistics of a CSV log, built so that any piece of a file can be parsed on its own and the pieces
+    merged afterwards with the same result as one pass. Position spread uses Welford's running mean and variance,
+    merged with Chan's pairwise formula. Distance, time and heading sums are compensated (Neumaier) so the order
+    of summation, and so the number of threads, changes them by no more than an ulp or two. Each piece remembers
+    its first and last point, and the merge adds the step between them.
+    TrackStats_ParseCSV reads rows with a decimal parser that always gives the same value as strtod. A number with
+    no exponent whose digits, read as one integer, are at most 2^53 (so any number of up to 15 digits, which covers
+    every log the rover writes) is converted with one exact division; anything else is handed to strtod.
+   */
+
+#define STATS_SPEED_BINS  128    //Speed histogram bins
+#define STATS_SPEED_STEP  0.25   //Bin width (m/s)
+#define STATS_SPEED_TOP   ((STATS_SPEED_BINS - 1) * STATS_SPEED_STEP)  //Speeds from here up share the last bin
+#define STATS_COG_MIN_M   0.3    //Shortest step that gives a course over ground
+
+//Compensated sum
+typedef struct {
+	double sum, comp;
+} StatSum;
+
+typedef struct {
+	double rateHz;               //Fix rate assumed for rows without GPS time
+	uint64_t points, skipped;    //Rows read and rows that are not points
+	double meanLat, meanLon;     //Welford moments of position (degrees)
+	double m2Lat, m2Lon;
+	double minLat, maxLat, minLon, maxLon;
+	uint64_t steps, timedSteps;  //Steps between consecutive points, and those timed by GPS time
+	StatSum distance;            //Haversine path length (m)
+	StatSum seconds;             //Time covered by the steps (s)
+	double maxSpeed;
+	uint64_t speedHist[STATS_SPEED_BINS];
+	uint64_t headings, courses;  //Heading column values, and course over ground steps
+	StatSum headSin, headCos;
+	StatSum cogSin, cogCos;
+	TrackPoint first, last;
+} TrackStats;
+
+//Empty statistics. rateHz - fix rate assumed for logs without GPS time
+void TrackStats_Init(TrackStats *s, double rateHz);
+
+//Add the next point. haveHead - the row had a heading column
+void TrackStats_Add(TrackStats *s, const TrackPoint *pt, int haveHead);
+
+//Append the statistics of b to a. adjacent - b is the next piece of the same file, so the step between them counts
+void TrackStats_Merge(TrackStats *a, const TrackStats *b, int adjacent);
+
+//Parse "lat,lon[,head,timeMs,fixState]" rows from text[0..len). The text should start at the beginning of a row
+void TrackStats_ParseCSV(TrackStats *s, const char *text, size_t len);
+
+//Parse a decimal number, advancing *p. Returns 0 if there is no number at *p
+int TrackStats_ParseDouble(const char **p, const char *end, double *out);
+
+//Value of a compensated sum
+double TrackStats_Sum(const StatSum *s);
+
+//Speed below which the given fraction (0 to 1) of steps fall, from the histogram (m/s). INFINITY when that is in
+//the last bin, which only says it is at least STATS_SPEED_TOP
+double TrackStats_SpeedPercentile(const TrackStats *s, double frac);
+
+//Position standard deviations east and north (m)
+void TrackStats_Spread(const TrackStats *s, double *sdE, double *sdN);
+
+#endif